@@ -0,0 +1,163 @@
+#include "bench.hpp"
+
+#include "chunker/AsyncChunkManager.hpp"
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  const int JOB_COUNT = 16;
+  const int CHUNKS_PER_JOB = 24;
+  const int CHUNK_SIZE = 16;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // a strip of chunks, starting at x
+  struct bench_job {
+    long x;
+  };
+
+  struct bench_chunker {
+    std::vector<ChunkIdentifier> Chunk(const bench_job& job) {
+      std::vector<ChunkIdentifier> res;
+      for (int i = 0; i < CHUNKS_PER_JOB; i++) {
+        res.push_back(ChunkIdentifier(job.x + i * CHUNK_SIZE, 0, CHUNK_SIZE, CHUNK_SIZE, ChunkNeighbors()));
+      }
+
+      return res;
+    }
+
+    uint64_t Stitch(const bench_job&, const std::vector<std::shared_ptr<bench_chunk>>& chunks) {
+      uint64_t res = 0;
+      for (auto& chunk : chunks) {
+        res ^= chunk->value;
+      }
+
+      return res;
+    }
+  };
+
+  // ~20us of arithmetic per chunk
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      for (int i = 0; i < 4096; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      }
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    typedef bench_gen gen_type;
+    typedef bench_chunker chunker_type;
+    typedef bench_chunk chunk_type;
+    typedef bench_job job_type;
+
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+
+  // every run starts on untouched ground, so nothing is cached yet
+  bench_job MakeJob(long run, int job) {
+    return bench_job { (run * JOB_COUNT + job) * CHUNKS_PER_JOB * CHUNK_SIZE };
+  }
+
+  // each job shares half its strip w the next
+  bench_job MakeOverlappingJob(long run, int job) {
+    return bench_job { (run * JOB_COUNT * 2 + job) * (CHUNKS_PER_JOB / 2) * CHUNK_SIZE };
+  }
+}
+
+// a burst of independent jobs - the old manager ran them one at a time, each waiting on the whole pool
+CHUNKER_BENCH(async_jobs_burst) {
+  auto factory = std::make_shared<bench_factory>();
+
+  {
+    // replica of the previous job loop - chunk, enqueue, wait for the pool, stitch, next
+    TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(4, factory);
+    bench_chunker chunker;
+    long run = 0;
+    bench::BenchResult& result = state.Measure("async_jobs_burst/serial", [&] {
+      run++;
+      for (int i = 0; i < JOB_COUNT; i++) {
+        bench_job job = MakeJob(run, i);
+        std::vector<ChunkKey> keys;
+        for (auto& id : chunker.Chunk(job)) {
+          keys.push_back(ChunkKey(id));
+        }
+
+        pool.EnqueueBulk(keys);
+        pool.Wait();
+        std::vector<std::shared_ptr<bench_chunk>> chunks;
+        for (auto& key : keys) {
+          chunks.push_back(pool.GetChunk(key));
+        }
+
+        chunker.Stitch(job, chunks);
+      }
+    });
+
+    result.Counter("jobs", JOB_COUNT)
+      .Counter("us_per_job", result.ns_per_iter / JOB_COUNT / 1000.0);
+  }
+
+  {
+    AsyncChunkManager<bench_factory> mgr(bench_chunker(), factory, 4);
+    long run = 0;
+    std::vector<std::future<uint64_t>> futures;
+    bench::BenchResult& result = state.Measure("async_jobs_burst/dispatcher", [&] {
+      run++;
+      futures.clear();
+      for (int i = 0; i < JOB_COUNT; i++) {
+        futures.push_back(mgr.Enqueue(MakeJob(run, i)));
+      }
+
+      for (auto& future : futures) {
+        future.get();
+      }
+    });
+
+    result.Counter("jobs", JOB_COUNT)
+      .Counter("us_per_job", result.ns_per_iter / JOB_COUNT / 1000.0);
+  }
+}
+
+// jobs overlapping their neighbours, all in flight at once - shared chunks should only be generated once
+CHUNKER_BENCH(async_jobs_overlap) {
+  auto factory = std::make_shared<bench_factory>();
+  AsyncChunkManager<bench_factory> mgr(bench_chunker(), factory, 4);
+  GenerationStats before = mgr.GetGenerationStats();
+  long run = 0;
+  std::vector<std::future<uint64_t>> futures;
+  bench::BenchResult& result = state.Measure("async_jobs_overlap/dispatcher", [&] {
+    run++;
+    futures.clear();
+    for (int i = 0; i < JOB_COUNT; i++) {
+      futures.push_back(mgr.Enqueue(MakeOverlappingJob(run, i)));
+    }
+
+    for (auto& future : futures) {
+      future.get();
+    }
+  });
+
+  GenerationStats after = mgr.GetGenerationStats();
+  double runs = static_cast<double>(run);
+  result.Counter("requested", JOB_COUNT * CHUNKS_PER_JOB)
+    .Counter("unique", (JOB_COUNT + 1) * CHUNKS_PER_JOB / 2)
+    .Counter("generated", (after.generated - before.generated) / runs)
+    .Counter("cache_hits", (after.cache_hits - before.cache_hits) / runs)
+    .Counter("deduped", (after.deduped - before.deduped) / runs);
+}
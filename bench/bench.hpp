@@ -0,0 +1,121 @@
+#ifndef CHUNKER_BENCH_H_
+#define CHUNKER_BENCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// tiny self-contained timing harness - no external deps
+// benches register themselves w CHUNKER_BENCH, and report one or more results through BenchState
+// results print as a table, or as json (--json) for diffing between releases
+
+namespace chunker {
+  namespace bench {
+    struct BenchResult {
+      std::string name;
+      size_t iterations;
+      double ns_per_iter;
+      std::vector<std::pair<std::string, double>> counters;
+
+      BenchResult& Counter(const std::string& counter, double value) {
+        counters.push_back(std::make_pair(counter, value));
+        return *this;
+      }
+    };
+
+    /**
+     * @return size_t number of global operator new calls made so far, on any thread
+     */
+    size_t AllocationCount();
+
+    class BenchState {
+    public:
+      BenchState(double min_time_s) : min_time_(min_time_s) {}
+
+      /**
+       * @brief sets a named knob for benches to read - from `--set name=value` on the command line
+       */
+      void SetParam(const std::string& name, double value) {
+        params_[name] = value;
+      }
+
+      bool HasParam(const std::string& name) const {
+        return (params_.count(name) != 0);
+      }
+
+      /**
+       * @return double - the param's value, or fallback if it wasn't set
+       */
+      double Param(const std::string& name, double fallback) const {
+        auto itr = params_.find(name);
+        return (itr == params_.end() ? fallback : itr->second);
+      }
+
+      double MinTime() const { return min_time_; }
+
+      const std::map<std::string, double>& Params() const { return params_; }
+
+      /**
+       * @brief Times func, running it in growing batches until min time has elapsed.
+       *
+       * @param name - name of this result
+       * @param func - function to time. one call is one iteration.
+       * @return BenchResult& - result, which counters can be attached to
+       */
+      template <typename Func>
+      BenchResult& Measure(const std::string& name, Func&& func) {
+        typedef std::chrono::steady_clock clock;
+
+        // warm up
+        func();
+
+        size_t batch = 1;
+        size_t total_iters = 0;
+        double total_ns = 0.0;
+        while (total_ns < min_time_ * 1e9) {
+          auto start = clock::now();
+          for (size_t i = 0; i < batch; i++) {
+            func();
+          }
+
+          total_ns += std::chrono::duration<double, std::nano>(clock::now() - start).count();
+          total_iters += batch;
+          batch *= 2;
+        }
+
+        BenchResult result;
+        result.name = name;
+        result.iterations = total_iters;
+        result.ns_per_iter = total_ns / total_iters;
+        results_.push_back(result);
+        return results_.back();
+      }
+
+      const std::vector<BenchResult>& Results() const { return results_; }
+    private:
+      double min_time_;
+      std::map<std::string, double> params_;
+      std::vector<BenchResult> results_;
+    };
+
+    typedef void (*BenchFunc)(BenchState&);
+
+    std::vector<std::pair<std::string, BenchFunc>>& BenchRegistry();
+
+    struct BenchRegistrar {
+      BenchRegistrar(const char* name, BenchFunc func) {
+        BenchRegistry().push_back(std::make_pair(std::string(name), func));
+      }
+    };
+  }
+}
+
+#define CHUNKER_BENCH(name) \
+  static void name(::chunker::bench::BenchState& state); \
+  static ::chunker::bench::BenchRegistrar name##_registrar(#name, name); \
+  static void name(::chunker::bench::BenchState& state)
+
+#endif // CHUNKER_BENCH_H_
@@ -0,0 +1,280 @@
+#include "bench.hpp"
+
+#include "chunker/util/Trace.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+// count every heap allocation, so benches can report alloc counts. every form of new goes through
+// CountedMalloc and every form of delete through CountedFree, aligned ones included.
+// both stay out of line - inlined, gcc sees free() on a pointer from operator new in library code
+// and warns (-Wmismatched-new-delete) even though the pair matches
+static std::atomic<size_t> alloc_count(0);
+
+__attribute__((noinline)) static void* CountedMalloc(size_t size, size_t align) {
+  alloc_count.fetch_add(1, std::memory_order_relaxed);
+  size = (size == 0 ? 1 : size);
+  if (align <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+
+  // aligned_alloc wants a multiple of the alignment
+  return std::aligned_alloc(align, (size + align - 1) / align * align);
+}
+
+static void* CountedAllocOrThrow(size_t size, size_t align) {
+  void* ptr = CountedMalloc(size, align);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+__attribute__((noinline)) static void CountedFree(void* ptr) noexcept {
+  std::free(ptr);
+}
+
+void* operator new(size_t size) {
+  return CountedAllocOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size) {
+  return CountedAllocOrThrow(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t align) {
+  return CountedAllocOrThrow(size, static_cast<size_t>(align));
+}
+
+void* operator new[](size_t size, std::align_val_t align) {
+  return CountedAllocOrThrow(size, static_cast<size_t>(align));
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return CountedMalloc(size, alignof(std::max_align_t));
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return CountedMalloc(size, alignof(std::max_align_t));
+}
+
+void* operator new(size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return CountedMalloc(size, static_cast<size_t>(align));
+}
+
+void* operator new[](size_t size, std::align_val_t align, const std::nothrow_t&) noexcept {
+  return CountedMalloc(size, static_cast<size_t>(align));
+}
+
+void operator delete(void* ptr) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  CountedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept {
+  CountedFree(ptr);
+}
+
+namespace chunker {
+  namespace bench {
+    size_t AllocationCount() {
+      return alloc_count.load(std::memory_order_relaxed);
+    }
+
+    std::vector<std::pair<std::string, BenchFunc>>& BenchRegistry() {
+      static std::vector<std::pair<std::string, BenchFunc>> registry;
+      return registry;
+    }
+  }
+}
+
+namespace {
+  // json string, w quotes and backslashes escaped - names are plain ascii, so that's all we need
+  std::string JsonString(const std::string& str) {
+    std::string res = "\"";
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        res += '\\';
+      }
+
+      res += c;
+    }
+
+    return res + "\"";
+  }
+
+  // json has no nan / inf - those go out as null
+  std::string JsonNumber(double value) {
+    if (!std::isfinite(value)) {
+      return "null";
+    }
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.17g", value);
+    return buf;
+  }
+
+  // one result per line, so two runs diff cleanly
+  bool WriteJson(const char* path, const chunker::bench::BenchState& state) {
+    std::FILE* file = (std::strcmp(path, "-") == 0 ? stdout : std::fopen(path, "w"));
+    if (file == nullptr) {
+      return false;
+    }
+
+    std::fprintf(file, "{\n  \"min_time_s\": %g,\n  \"params\": {", state.MinTime());
+    const char* sep = "";
+    for (auto& param : state.Params()) {
+      std::fprintf(file, "%s%s: %s", sep, JsonString(param.first).c_str(), JsonNumber(param.second).c_str());
+      sep = ", ";
+    }
+
+    std::fprintf(file, "},\n  \"results\": [");
+    sep = "\n";
+    for (auto& result : state.Results()) {
+      std::fprintf(file, "%s    {\"name\": %s, \"iterations\": %zu, \"ns_per_iter\": %s, \"counters\": {",
+        sep, JsonString(result.name).c_str(), result.iterations, JsonNumber(result.ns_per_iter).c_str());
+      const char* counter_sep = "";
+      for (auto& counter : result.counters) {
+        std::fprintf(file, "%s%s: %s", counter_sep, JsonString(counter.first).c_str(), JsonNumber(counter.second).c_str());
+        counter_sep = ", ";
+      }
+
+      std::fprintf(file, "}}");
+      sep = ",\n";
+    }
+
+    std::fprintf(file, "\n  ]\n}\n");
+    return (file == stdout || std::fclose(file) == 0);
+  }
+}
+
+// usage: chunker_bench [filter] [--min-time seconds] [--set name=value]... [--json path] [--trace path]
+// runs every bench whose name contains filter. --set passes knobs through to benches (see BenchState::Param).
+// --json writes results to path ("-" for stdout) instead of printing a table.
+// --trace writes a chrome trace of the last events on each thread to path - needs a build w CHUNKER_ENABLE_TRACE.
+int main(int argc, char** argv) {
+  using namespace chunker::bench;
+  const char* filter = nullptr;
+  const char* json_path = nullptr;
+  const char* trace_path = nullptr;
+  double min_time = 0.25;
+  std::vector<std::pair<std::string, double>> params;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if (std::strcmp(arg, "--json") == 0 && has_value) {
+      json_path = argv[++i];
+    } else if (std::strcmp(arg, "--trace") == 0 && has_value) {
+      trace_path = argv[++i];
+    } else if (std::strcmp(arg, "--min-time") == 0 && has_value) {
+      min_time = std::atof(argv[++i]);
+    } else if (std::strcmp(arg, "--set") == 0 && has_value) {
+      std::string param(argv[++i]);
+      size_t eq = param.find('=');
+      if (eq == std::string::npos) {
+        std::fprintf(stderr, "--set expects name=value, got %s\n", param.c_str());
+        return 1;
+      }
+
+      params.push_back(std::make_pair(param.substr(0, eq), std::atof(param.c_str() + eq + 1)));
+    } else if (arg[0] == '-' && arg[1] == '-') {
+      std::fprintf(stderr, "unknown option %s\n", arg);
+      return 1;
+    } else {
+      filter = arg;
+    }
+  }
+
+  BenchState state(min_time);
+  for (auto& param : params) {
+    state.SetParam(param.first, param.second);
+  }
+
+  for (auto& bench : BenchRegistry()) {
+    if (filter != nullptr && std::strstr(bench.first.c_str(), filter) == nullptr) {
+      continue;
+    }
+
+    bench.second(state);
+  }
+
+  if (trace_path != nullptr) {
+    if (!chunker::util::TRACE_ENABLED) {
+      std::fprintf(stderr, "built w/o CHUNKER_ENABLE_TRACE - %s will be empty\n", trace_path);
+    }
+
+    if (!chunker::util::TraceRecorder::Instance().Dump(trace_path)) {
+      std::fprintf(stderr, "couldn't write %s\n", trace_path);
+      return 1;
+    }
+  }
+
+  if (json_path != nullptr) {
+    if (!WriteJson(json_path, state)) {
+      std::fprintf(stderr, "couldn't write %s\n", json_path);
+      return 1;
+    }
+
+    return 0;
+  }
+
+  for (auto& result : state.Results()) {
+    std::printf("%-48s %12zu iters %14.1f ns/iter", result.name.c_str(), result.iterations, result.ns_per_iter);
+    for (auto& counter : result.counters) {
+      std::printf("  %s=%.2f", counter.first.c_str(), counter.second);
+    }
+
+    std::printf("\n");
+  }
+
+  return 0;
+}
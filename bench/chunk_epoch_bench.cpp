@@ -0,0 +1,116 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/GenerationEpoch.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/lod/lod_node.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+using namespace chunker::lod;
+
+namespace {
+  const int TREE_SIZE = 8192;
+  const int MIN_CHUNK_SIZE = 16;
+  const int UPDATE_COUNT = 16;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // ~20us of arithmetic per chunk, checking for cancellation every ~2us
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier, const CancelToken& token) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      for (int block = 0; block < 8; block++) {
+        if (token.Cancelled()) {
+          return nullptr;
+        }
+
+        for (int i = 0; i < 512; i++) {
+          seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        }
+      }
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+
+  struct leaf {
+    long x;
+    long y;
+    size_t size;
+  };
+
+  void CollectLeaves(const lod_node* node, long x, long y, size_t size, std::vector<leaf>& output) {
+    if (node->tl == nullptr) {
+      output.push_back({ x, y, size });
+      return;
+    }
+
+    long half = static_cast<long>(size / 2);
+    CollectLeaves(node->bl, x,        y,        half, output);
+    CollectLeaves(node->br, x + half, y,        half, output);
+    CollectLeaves(node->tl, x,        y + half, half, output);
+    CollectLeaves(node->tr, x + half, y + half, half, output);
+  }
+}
+
+// a viewer moving fast enough that every update lands before the last one finishes - how much stale work gets done?
+CHUNKER_BENCH(chunk_epoch_fast_move) {
+  LodTreeGenerator tree_gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  tree_gen.cascade_factor = 2.0;
+  std::vector<std::vector<leaf>> leaf_sets;
+  for (int i = 0; i < UPDATE_COUNT; i++) {
+    glm::vec3 viewer(TREE_SIZE * 0.5f + i * 150.0f, 0.0f, TREE_SIZE * 0.5f + i * 90.0f);
+    leaf_sets.emplace_back();
+    CollectLeaves(tree_gen.CreateLodTree(viewer, 3), 0, 0, TREE_SIZE, leaf_sets.back());
+  }
+
+  for (bool epochs : { false, true }) {
+    auto factory = std::make_shared<bench_factory>();
+    TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(4, factory);
+    std::string name = std::string("chunk_epoch_fast_move/") + (epochs ? "epochs" : "no_epochs");
+    GenerationStats before = pool.Stats();
+
+    // each run moves to untouched ground, so nothing is cached yet
+    long run = 0;
+    std::vector<ChunkKey> keys;
+    bench::BenchResult& result = state.Measure(name, [&] {
+      long offset = (++run) * TREE_SIZE * 2;
+      for (auto& leaves : leaf_sets) {
+        keys.clear();
+        for (auto& l : leaves) {
+          keys.push_back(ChunkKey(ChunkIdentifier(l.x + offset, l.y, l.size, MIN_CHUNK_SIZE, ChunkNeighbors())));
+        }
+
+        if (epochs) {
+          pool.AdvanceEpoch(std::make_shared<GenerationEpoch::LiveSet>(keys.begin(), keys.end()));
+        }
+
+        pool.EnqueueBulk(keys);
+      }
+
+      pool.Wait();
+    });
+
+    GenerationStats after = pool.Stats();
+    double runs = static_cast<double>(run);
+    result.Counter("generated", (after.generated - before.generated) / runs)
+      .Counter("cache_hits", (after.cache_hits - before.cache_hits) / runs)
+      .Counter("dropped", (after.dropped - before.dropped) / runs)
+      .Counter("aborted", (after.aborted - before.aborted) / runs)
+      .Counter("final_chunks", static_cast<double>(leaf_sets.back().size()));
+  }
+}
@@ -0,0 +1,156 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace chunker;
+using namespace chunker::lod;
+
+namespace {
+  // the old identifier hash - xor of field hashes
+  struct legacy_hash {
+    size_t operator()(const ChunkIdentifier& identifier) const {
+      auto fract_hash = [](const util::DyadicScale& scale) {
+        util::Fraction f = scale.AsFraction();
+        return std::hash<long>()(f.numerator) ^ std::hash<long>()(f.denominator);
+      };
+
+      const ChunkNeighbors& n = identifier.neighbors;
+      size_t neighbor_hash = fract_hash(n.l) ^ fract_hash(n.r) ^ fract_hash(n.u) ^ fract_hash(n.d)
+        ^ fract_hash(n.tl) ^ fract_hash(n.tr) ^ fract_hash(n.bl) ^ fract_hash(n.br);
+
+      std::hash<long> long_hash;
+      return (((long_hash(identifier.x) ^ (long_hash(identifier.y) + std::hash<glm::u64vec2>()(identifier.sample_dims))) * identifier.size) ^ identifier.chunk_res)
+        ^ fract_hash(identifier.scale) ^ neighbor_hash;
+    }
+  };
+
+  // every identifier a viewer sweeping across the world would request
+  std::vector<ChunkIdentifier> CollectKeySet(double max_gen_distance, int min_chunk_size, double cascade_factor) {
+    int size = 1 << static_cast<int>(ceil(log2(max_gen_distance)) + 2);
+    LodTreeGenerator gen(size, min_chunk_size);
+    gen.cascade_factor = cascade_factor;
+
+    std::vector<ChunkIdentifier> res;
+    LinearLodTree tree;
+    for (int step = 0; step < 64; step++) {
+      // viewer moves diagonally; tree is re-centered on chunk-aligned offsets like ChunkManager does
+      int viewer_x = step * 37;
+      int viewer_y = step * 23;
+      glm::ivec2 offset((viewer_x / min_chunk_size) * min_chunk_size - size / 2, (viewer_y / min_chunk_size) * min_chunk_size - size / 2);
+      tree.Build(gen.CreateLodTree(glm::vec3(viewer_x - offset.x, 0.0f, viewer_y - offset.y), 3), size);
+
+      for (uint64_t leaf : tree.Leaves()) {
+        glm::ivec2 origin = tree.LeafOrigin(leaf);
+        res.push_back(ChunkIdentifier(offset.x + origin.x, offset.y + origin.y, origin.x, origin.y, tree.LeafSize(leaf), min_chunk_size, tree));
+      }
+    }
+
+    std::unordered_set<ChunkKey> unique;
+    std::vector<ChunkIdentifier> deduped;
+    for (auto& identifier : res) {
+      if (unique.insert(ChunkKey(identifier)).second) {
+        deduped.push_back(identifier);
+      }
+    }
+
+    return deduped;
+  }
+
+  // keys sharing a full hash value, and keys sharing a bucket in a power-of-two table sized to fit them
+  template <typename HashFunc, typename KeyType>
+  void CountCollisions(const std::vector<KeyType>& keys, HashFunc hash, double* full, double* bucket) {
+    std::vector<size_t> hashes;
+    for (auto& key : keys) {
+      hashes.push_back(hash(key));
+    }
+
+    size_t bucket_mask = 1;
+    while (bucket_mask < hashes.size()) {
+      bucket_mask <<= 1;
+    }
+
+    bucket_mask -= 1;
+
+    std::vector<size_t> buckets;
+    for (size_t h : hashes) {
+      buckets.push_back(h & bucket_mask);
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    std::sort(buckets.begin(), buckets.end());
+    *full = static_cast<double>(keys.size() - (std::unique(hashes.begin(), hashes.end()) - hashes.begin())) / keys.size();
+    *bucket = static_cast<double>(keys.size() - (std::unique(buckets.begin(), buckets.end()) - buckets.begin())) / keys.size();
+  }
+}
+
+CHUNKER_BENCH(chunk_key) {
+  struct key_config {
+    double max_gen_distance;
+    int min_chunk_size;
+    double cascade_factor;
+  };
+
+  const key_config configs[] = {
+    { 512.0,  16, 2.0 },
+    { 2048.0, 16, 8.0 },
+    { 8192.0, 32, 8.0 }
+  };
+
+  for (auto& config : configs) {
+    std::vector<ChunkIdentifier> identifiers = CollectKeySet(config.max_gen_distance, config.min_chunk_size, config.cascade_factor);
+    std::vector<ChunkKey> keys(identifiers.begin(), identifiers.end());
+    std::string suffix = "/" + std::to_string(static_cast<int>(config.max_gen_distance)) + "/" + std::to_string(config.min_chunk_size);
+    double key_count = static_cast<double>(keys.size());
+
+    double legacy_full, legacy_bucket, identifier_full, identifier_bucket, key_full, key_bucket;
+    CountCollisions(identifiers, legacy_hash(), &legacy_full, &legacy_bucket);
+    CountCollisions(identifiers, std::hash<ChunkIdentifier>(), &identifier_full, &identifier_bucket);
+    CountCollisions(keys, std::hash<ChunkKey>(), &key_full, &key_bucket);
+
+    std::unordered_set<ChunkIdentifier, legacy_hash> legacy_set(identifiers.begin(), identifiers.end());
+    std::unordered_set<ChunkIdentifier> identifier_set(identifiers.begin(), identifiers.end());
+    std::unordered_set<ChunkKey> key_set(keys.begin(), keys.end());
+
+    size_t sink = 0;
+    state.Measure("chunk_key/lookup/legacy_hash" + suffix, [&] {
+      for (auto& identifier : identifiers) {
+        sink += legacy_set.count(identifier);
+      }
+    }).Counter("keys", key_count).Counter("bytes", sizeof(ChunkIdentifier))
+      .Counter("hash_collisions", legacy_full).Counter("bucket_collisions", legacy_bucket);
+
+    state.Measure("chunk_key/lookup/identifier" + suffix, [&] {
+      for (auto& identifier : identifiers) {
+        sink += identifier_set.count(identifier);
+      }
+    }).Counter("keys", key_count).Counter("bytes", sizeof(ChunkIdentifier))
+      .Counter("hash_collisions", identifier_full).Counter("bucket_collisions", identifier_bucket);
+
+    state.Measure("chunk_key/lookup/packed_key" + suffix, [&] {
+      for (auto& key : keys) {
+        sink += key_set.count(key);
+      }
+    }).Counter("keys", key_count).Counter("bytes", sizeof(ChunkKey))
+      .Counter("hash_collisions", key_full).Counter("bucket_collisions", key_bucket);
+
+    // packing cost, paid once per identifier on enqueue
+    state.Measure("chunk_key/pack" + suffix, [&] {
+      for (auto& identifier : identifiers) {
+        sink += ChunkKey(identifier).Hash();
+      }
+    }).Counter("keys", key_count);
+
+    if (sink == 0) {
+      state.Measure("chunk_key/sink", [] {});
+    }
+  }
+}
@@ -0,0 +1,79 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkManager.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace chunker;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  const int UPDATE_COUNT = 24;
+
+  // time between updates - the pool works through prefetches while the "frame" runs
+  const std::chrono::milliseconds FRAME_TIME(20);
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // 300us per chunk, mostly spent waiting - stands in for a generator blocked on io or a gpu readback.
+  // a cpu-bound one would hide the difference on small machines, where the pool and the "frame" share cores
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      std::this_thread::sleep_for(std::chrono::microseconds(300));
+      return std::make_shared<bench_chunk>(bench_chunk { static_cast<uint64_t>(identifier.x * 31 + identifier.y) });
+    }
+  };
+
+  struct bench_factory {
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+}
+
+// a viewer flying in a straight line - how long does each update stall on chunks at the leading edge?
+CHUNKER_BENCH(chunk_prefetch_flyover) {
+  glm::vec3 velocity(1500.0f, 0.0f, 450.0f);
+  auto factory = std::make_shared<bench_factory>();
+
+  for (bool prefetch : { false, true }) {
+    double stall_ns = 0.0;
+    GenerationStats stats {};
+    long run = 0;
+    bench::BenchResult& result = state.Measure(std::string("chunk_prefetch_flyover/") + (prefetch ? "prefetch" : "none"), [&] {
+      ChunkManager<bench_factory, bench_gen, bench_chunk> mgr(factory, 4, 512.0, 16, 2.0);
+      if (prefetch) {
+        mgr.SetPrefetch(0.1, 64);
+      }
+
+      // fresh ground every run
+      glm::vec3 start(static_cast<float>(++run) * 65536.0f, 0.0f, 0.0f);
+      float frame_s = std::chrono::duration<float>(FRAME_TIME).count();
+      for (int i = 0; i <= UPDATE_COUNT; i++) {
+        mgr.UpdateChunkData(start + velocity * (i * frame_s), velocity);
+        clock_type::time_point before = clock_type::now();
+        mgr.wait();
+
+        // the first update fills the whole tree either way
+        if (i > 0) {
+          stall_ns += std::chrono::duration<double, std::nano>(clock_type::now() - before).count();
+        }
+
+        std::this_thread::sleep_for(FRAME_TIME);
+      }
+
+      stats = mgr.GetGenerationStats();
+    });
+
+    double updates = static_cast<double>(result.iterations + 1) * UPDATE_COUNT;
+    result.Counter("stall_us_per_update", stall_ns / updates / 1000.0)
+      .Counter("generated_last_run", static_cast<double>(stats.generated));
+  }
+}
@@ -0,0 +1,251 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/ChunkPriority.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/lod/lod_node.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+using namespace chunker::lod;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  const int TREE_SIZE = 8192;
+  const int MIN_CHUNK_SIZE = 16;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // tracks how many of the chunks nearest the viewer are done
+  struct ring_state {
+    ViewerDistancePriority viewer;
+    std::atomic<size_t> done;
+    std::atomic<int64_t> done_at;
+    size_t count;
+  };
+
+  // tracks how many chunks the viewer can see, within some radius, are done
+  struct view_state {
+    ViewConePriority view;
+    double radius;
+    std::atomic<size_t> done;
+    std::atomic<int64_t> done_at;
+    size_t count;
+
+    bool Wanted(const ChunkKey& key) const {
+      return (view.distance(key).distance <= radius && view.InView(key));
+    }
+  };
+
+  // ~20us of arithmetic per chunk, then marks ring chunks as ready
+  struct bench_gen {
+    ring_state* ring;
+    view_state* view;
+
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      for (int i = 0; i < 4096; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      }
+
+      if (ring != nullptr && ring->viewer(ChunkKey(identifier)).distance <= MIN_CHUNK_SIZE) {
+        if (ring->done.fetch_add(1) + 1 == ring->count) {
+          ring->done_at.store(clock_type::now().time_since_epoch().count());
+        }
+      }
+
+      if (view != nullptr && view->Wanted(ChunkKey(identifier))) {
+        if (view->done.fetch_add(1) + 1 == view->count) {
+          view->done_at.store(clock_type::now().time_since_epoch().count());
+        }
+      }
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    ring_state* ring;
+    view_state* view;
+
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>(bench_gen { ring, view });
+    }
+  };
+
+  // tree order, as ChunkManager's walk emits them - bl, br, tl, tr
+  void CollectKeys(const lod_node* node, long x, long y, size_t size, std::vector<ChunkKey>& output) {
+    if (node->tl == nullptr) {
+      output.push_back(ChunkKey(ChunkIdentifier(x, y, size, MIN_CHUNK_SIZE, ChunkNeighbors())));
+      return;
+    }
+
+    long half = static_cast<long>(size / 2);
+    CollectKeys(node->bl, x,        y,        half, output);
+    CollectKeys(node->br, x + half, y,        half, output);
+    CollectKeys(node->tl, x,        y + half, half, output);
+    CollectKeys(node->tr, x + half, y + half, half, output);
+  }
+}
+
+// a full leaf set lands at once, as after a teleport - how long until the chunks around the viewer are ready?
+CHUNKER_BENCH(chunk_priority_teleport) {
+  glm::vec3 viewer(TREE_SIZE * 0.5f + 40.0f, 0.0f, TREE_SIZE * 0.5f + 72.0f);
+  LodTreeGenerator tree_gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  tree_gen.cascade_factor = 2.0;
+  std::vector<ChunkKey> keys;
+  CollectKeys(tree_gen.CreateLodTree(viewer, 3), 0, 0, TREE_SIZE, keys);
+
+  ring_state ring;
+  ring.viewer = ViewerDistancePriority { viewer.x, viewer.z };
+  ring.count = 0;
+  for (auto& key : keys) {
+    ring.count += (ring.viewer(key).distance <= MIN_CHUNK_SIZE ? 1 : 0);
+  }
+
+  for (bool nearest_first : { false, true }) {
+    // tiny budget - every iteration regenerates everything
+    auto factory = std::make_shared<bench_factory>(bench_factory { &ring, nullptr });
+    TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(4, factory, 1);
+    if (nearest_first) {
+      pool.SetViewer(viewer);
+    }
+
+    double ring_ns = 0.0;
+    size_t samples = 0;
+    std::string name = std::string("chunk_priority_teleport/") + (nearest_first ? "nearest_first" : "tree_order");
+    bench::BenchResult& result = state.Measure(name, [&] {
+      ring.done.store(0);
+      int64_t start = clock_type::now().time_since_epoch().count();
+      pool.EnqueueBulk(keys);
+      pool.Wait();
+      ring_ns += std::chrono::duration<double, std::nano>(clock_type::duration(ring.done_at.load() - start)).count();
+      samples++;
+    });
+
+    result.Counter("chunks", static_cast<double>(keys.size()))
+      .Counter("ring_chunks", static_cast<double>(ring.count))
+      .Counter("ring_ready_us", ring_ns / samples / 1000.0)
+      .Counter("all_ready_us", result.ns_per_iter / 1000.0);
+  }
+}
+
+// same teleport, but the consumer takes each chunk as it lands instead of waiting on the whole set
+CHUNKER_BENCH(chunk_priority_streaming) {
+  glm::vec3 viewer(TREE_SIZE * 0.5f + 40.0f, 0.0f, TREE_SIZE * 0.5f + 72.0f);
+  LodTreeGenerator tree_gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  tree_gen.cascade_factor = 2.0;
+  std::vector<ChunkKey> keys;
+  CollectKeys(tree_gen.CreateLodTree(viewer, 3), 0, 0, TREE_SIZE, keys);
+
+  ring_state ring;
+  ring.viewer = ViewerDistancePriority { viewer.x, viewer.z };
+  ring.count = 0;
+
+  for (bool streaming : { false, true }) {
+    auto factory = std::make_shared<bench_factory>(bench_factory { &ring, nullptr });
+    TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(4, factory, 1);
+    pool.SetViewer(viewer);
+
+    // mean over every chunk of (time it reached the consumer - enqueue time)
+    std::atomic<int64_t> latency_sum(0);
+    std::atomic<int64_t> first_at(0);
+    int64_t start = 0;
+    auto on_ready = [&](const ChunkKey&, const std::shared_ptr<bench_chunk>&) {
+      int64_t now = clock_type::now().time_since_epoch().count();
+      int64_t expected = 0;
+      first_at.compare_exchange_strong(expected, now);
+      latency_sum.fetch_add(now - start);
+    };
+
+    double mean_ns = 0.0;
+    double first_ns = 0.0;
+    size_t samples = 0;
+    std::string name = std::string("chunk_priority_streaming/") + (streaming ? "callback" : "wait");
+    bench::BenchResult& result = state.Measure(name, [&] {
+      latency_sum.store(0);
+      first_at.store(0);
+      start = clock_type::now().time_since_epoch().count();
+      pool.EnqueueBulk(keys, streaming ? on_ready : decltype(pool)::ReadyCallback());
+      pool.Wait();
+      int64_t end = clock_type::now().time_since_epoch().count();
+      if (!streaming) {
+        latency_sum.store((end - start) * static_cast<int64_t>(keys.size()));
+        first_at.store(end);
+      }
+
+      mean_ns += std::chrono::duration<double, std::nano>(clock_type::duration(latency_sum.load())).count() / keys.size();
+      first_ns += std::chrono::duration<double, std::nano>(clock_type::duration(first_at.load() - start)).count();
+      samples++;
+    });
+
+    result.Counter("chunks", static_cast<double>(keys.size()))
+      .Counter("first_chunk_us", first_ns / samples / 1000.0)
+      .Counter("mean_ready_us", mean_ns / samples / 1000.0);
+  }
+}
+
+// a full leaf set was queued while the viewer faced +x, and the viewer has just turned to face -x.
+// how long until everything now in view (out to a radius) is ready?
+CHUNKER_BENCH(chunk_priority_turn) {
+  const double VIEW_RADIUS = 1024.0;
+  const double HALF_ANGLE = 0.8;
+  glm::vec3 viewer(TREE_SIZE * 0.5f + 40.0f, 0.0f, TREE_SIZE * 0.5f + 72.0f);
+  LodTreeGenerator tree_gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  tree_gen.cascade_factor = 2.0;
+  std::vector<ChunkKey> keys;
+  CollectKeys(tree_gen.CreateLodTree(viewer, 3), 0, 0, TREE_SIZE, keys);
+
+  ViewConePriority before = ViewConePriority::Facing(viewer.x, viewer.z, 1.0, 0.0, HALF_ANGLE, TREE_SIZE * 2.0);
+  ViewConePriority after = ViewConePriority::Facing(viewer.x, viewer.z, -1.0, 0.0, HALF_ANGLE, TREE_SIZE * 2.0);
+
+  view_state view;
+  view.view = after;
+  view.radius = VIEW_RADIUS;
+  view.count = 0;
+  for (auto& key : keys) {
+    view.count += (view.Wanted(key) ? 1 : 0);
+  }
+
+  for (std::string variant : { "nearest_first", "cone_stale", "cone_reprioritized" }) {
+    auto factory = std::make_shared<bench_factory>(bench_factory { nullptr, &view });
+    TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(4, factory, 1);
+
+    double view_ns = 0.0;
+    size_t samples = 0;
+    bench::BenchResult& result = state.Measure("chunk_priority_turn/" + variant, [&] {
+      view.done.store(0);
+      if (variant == "nearest_first") {
+        pool.SetViewer(viewer);
+      } else {
+        pool.SetPriority(before);
+      }
+
+      int64_t start = clock_type::now().time_since_epoch().count();
+      pool.EnqueueBulk(keys);
+      if (variant == "cone_reprioritized") {
+        pool.SetPriority(after);
+        pool.Reprioritize();
+      }
+
+      pool.Wait();
+      view_ns += std::chrono::duration<double, std::nano>(clock_type::duration(view.done_at.load() - start)).count();
+      samples++;
+    });
+
+    result.Counter("chunks", static_cast<double>(keys.size()))
+      .Counter("in_view_chunks", static_cast<double>(view.count))
+      .Counter("in_view_ready_us", view_ns / samples / 1000.0)
+      .Counter("all_ready_us", result.ns_per_iter / 1000.0);
+  }
+}
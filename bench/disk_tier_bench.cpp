@@ -0,0 +1,101 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  const int CHUNK_COUNT = 256;
+  const int CHUNK_SIZE = 16;
+  const size_t PAYLOAD_BYTES = 4096;
+
+  struct bench_chunk {
+    std::vector<uint8_t> payload;
+
+    size_t ByteSize() const {
+      return sizeof(bench_chunk) + payload.size();
+    }
+
+    void Serialize(std::vector<uint8_t>& output) const {
+      output.insert(output.end(), payload.begin(), payload.end());
+    }
+
+    static std::shared_ptr<bench_chunk> Deserialize(const uint8_t* data, size_t size) {
+      auto res = std::make_shared<bench_chunk>();
+      res->payload.assign(data, data + size);
+      return res;
+    }
+  };
+
+  // ~200us of arithmetic per chunk - a cheap-ish terrain generator
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      auto res = std::make_shared<bench_chunk>();
+      res->payload.resize(PAYLOAD_BYTES);
+      for (int i = 0; i < 40960; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        res->payload[i % PAYLOAD_BYTES] ^= static_cast<uint8_t>(seed >> 56);
+      }
+
+      return res;
+    }
+  };
+
+  struct bench_factory {
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+
+  typedef TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool_type;
+}
+
+// a process restart over the same ground - regenerate everything, or read it back from the last run's disk tier
+CHUNKER_BENCH(disk_tier_restart) {
+  std::filesystem::path directory = std::filesystem::temp_directory_path() / "chunker_bench_disk_tier";
+  std::filesystem::remove_all(directory);
+
+  std::vector<ChunkKey> keys;
+  for (int i = 0; i < CHUNK_COUNT; i++) {
+    keys.push_back(ChunkKey(ChunkIdentifier((i % 16) * CHUNK_SIZE, (i / 16) * CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, ChunkNeighbors())));
+  }
+
+  auto factory = std::make_shared<bench_factory>();
+
+  // the run before - leaves every chunk on disk once it's torn down
+  {
+    pool_type pool(4, factory);
+    pool.OpenDiskTier(directory.string());
+    pool.EnqueueBulk(keys);
+  }
+
+  for (bool disk : { false, true }) {
+    GenerationStats stats {};
+    bench::BenchResult& result = state.Measure(std::string("disk_tier_restart/") + (disk ? "disk_tier" : "regenerate"), [&] {
+      pool_type pool(4, factory);
+      if (disk) {
+        pool.OpenDiskTier(directory.string());
+      }
+
+      pool.EnqueueBulk(keys);
+      pool.Wait();
+      stats = pool.Stats();
+    });
+
+    result.Counter("chunks", CHUNK_COUNT)
+      .Counter("generated", static_cast<double>(stats.generated))
+      .Counter("disk_hits", static_cast<double>(stats.disk_hits))
+      .Counter("us_per_chunk", result.ns_per_iter / CHUNK_COUNT / 1000.0);
+  }
+
+  std::filesystem::remove_all(directory);
+}
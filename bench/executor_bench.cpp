@@ -0,0 +1,210 @@
+#include "bench.hpp"
+
+#include "chunker/util/WorkStealingExecutor.hpp"
+
+#include <tbb/concurrent_queue.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  const size_t TASKS_PER_BATCH = 4096;
+
+  // stand-in for Generate - a couple of microseconds of arithmetic
+  uint64_t BusyWork(uint64_t seed) {
+    for (int i = 0; i < 512; i++) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    }
+
+    return seed;
+  }
+
+  // the previous pool - a thread per worker, each w its own mutex + two condvars, all polling one shared queue
+  class LegacyPool {
+    struct worker {
+      std::mutex lock;
+      std::condition_variable cond;
+      std::condition_variable wait_cond;
+      std::atomic<bool> active { true };
+      std::atomic<bool> running { false };
+      std::thread thread;
+    };
+
+  public:
+    LegacyPool(size_t thread_count, std::function<void(uint64_t)> handler) : handler_(handler) {
+      for (size_t i = 0; i < thread_count; i++) {
+        workers_.push_back(std::make_unique<worker>());
+      }
+
+      for (auto& w : workers_) {
+        w->thread = std::thread(&LegacyPool::ThreadFunc, this, w.get());
+      }
+    }
+
+    ~LegacyPool() {
+      for (auto& w : workers_) {
+        {
+          std::lock_guard lock(w->lock);
+          w->active = false;
+        }
+
+        w->cond.notify_all();
+        w->thread.join();
+      }
+    }
+
+    void Enqueue(uint64_t task) {
+      queue_.push(task);
+    }
+
+    void Wake() {
+      for (auto& w : workers_) {
+        w->cond.notify_all();
+        w->wait_cond.notify_all();
+      }
+    }
+
+    void Wait() {
+      for (auto& w : workers_) {
+        std::unique_lock lock(w->lock);
+        w->cond.notify_all();
+        w->wait_cond.wait(lock, [&] { return (queue_.empty() && !w->running) || !w->active; });
+      }
+    }
+
+  private:
+    void ThreadFunc(worker* w) {
+      uint64_t task = 0;
+      while (true) {
+        {
+          std::unique_lock lock(w->lock);
+          if (queue_.empty()) {
+            w->wait_cond.notify_all();
+            w->cond.wait(lock);
+          }
+
+          if (!w->active) {
+            return;
+          }
+        }
+
+        w->running = true;
+        if (queue_.try_pop(task)) {
+          handler_(task);
+        }
+
+        w->running = false;
+      }
+    }
+
+    std::function<void(uint64_t)> handler_;
+    std::vector<std::unique_ptr<worker>> workers_;
+    tbb::concurrent_queue<uint64_t> queue_;
+  };
+
+  struct legacy_adapter {
+    LegacyPool pool;
+
+    legacy_adapter(size_t thread_count, std::function<void(uint64_t)> handler) : pool(thread_count, handler) {}
+
+    void Submit(uint64_t task) {
+      pool.Enqueue(task);
+      pool.Wake();
+    }
+
+    void SubmitBulk(const std::vector<uint64_t>& tasks) {
+      for (uint64_t task : tasks) {
+        pool.Enqueue(task);
+      }
+
+      pool.Wake();
+    }
+
+    void Wait() {
+      pool.Wait();
+    }
+  };
+
+  struct stealing_adapter {
+    util::WorkStealingExecutor<uint64_t> executor;
+
+    stealing_adapter(size_t thread_count, std::function<void(uint64_t)> handler)
+      : executor(thread_count, [handler](size_t, uint64_t& task) { handler(task); }) {}
+
+    void Submit(uint64_t task) {
+      executor.Submit(task);
+    }
+
+    void SubmitBulk(const std::vector<uint64_t>& tasks) {
+      executor.SubmitBulk(tasks.begin(), tasks.end());
+    }
+
+    void Wait() {
+      executor.Wait();
+    }
+  };
+
+  // a batch of TASKS_PER_BATCH tasks per iteration, like a full leaf set after a teleport
+  template <typename PoolType>
+  void MeasureThroughput(bench::BenchState& state, const std::string& name) {
+    std::vector<uint64_t> tasks;
+    for (size_t i = 0; i < TASKS_PER_BATCH; i++) {
+      tasks.push_back(i);
+    }
+
+    for (size_t thread_count : { 1, 2, 4, 8 }) {
+      std::atomic<uint64_t> sink(0);
+      PoolType pool(thread_count, [&](uint64_t task) { sink.fetch_add(BusyWork(task), std::memory_order_relaxed); });
+      bench::BenchResult& result = state.Measure(name + "/threads:" + std::to_string(thread_count), [&] {
+        pool.SubmitBulk(tasks);
+        pool.Wait();
+      });
+
+      result.Counter("ns_per_task", result.ns_per_iter / TASKS_PER_BATCH);
+    }
+  }
+
+  // one task into a pool whose workers have gone idle - time from submit until a worker starts on it
+  template <typename PoolType>
+  void MeasureWakeLatency(bench::BenchState& state, const std::string& name) {
+    std::atomic<int64_t> started(0);
+    PoolType pool(4, [&](uint64_t) {
+      started.store(clock_type::now().time_since_epoch().count());
+    });
+
+    double total_ns = 0.0;
+    size_t samples = 0;
+    bench::BenchResult& result = state.Measure(name, [&] {
+      // long enough for every worker to park
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      int64_t submitted = clock_type::now().time_since_epoch().count();
+      pool.Submit(0);
+      pool.Wait();
+      total_ns += std::chrono::duration<double, std::nano>(clock_type::duration(started.load() - submitted)).count();
+      samples++;
+    });
+
+    result.Counter("wake_us", total_ns / samples / 1000.0);
+  }
+}
+
+CHUNKER_BENCH(executor_throughput) {
+  MeasureThroughput<legacy_adapter>(state, "executor_throughput/condvar_queue");
+  MeasureThroughput<stealing_adapter>(state, "executor_throughput/work_stealing");
+}
+
+CHUNKER_BENCH(executor_wake) {
+  MeasureWakeLatency<legacy_adapter>(state, "executor_wake/condvar_queue");
+  MeasureWakeLatency<stealing_adapter>(state, "executor_wake/work_stealing");
+}
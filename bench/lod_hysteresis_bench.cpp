@@ -0,0 +1,68 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkManager.hpp"
+
+#include <memory>
+#include <random>
+#include <string>
+
+using namespace chunker;
+
+namespace {
+  const int UPDATE_COUNT = 400;
+
+  // viewer drifts to a new spot every so often, and jitters around it in between
+  const int HOVER_UPDATES = 50;
+  const float JITTER = 1.0f;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // ~20us of arithmetic per chunk
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      for (int i = 0; i < 4096; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      }
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+}
+
+// a jittery camera hovering in place - how many chunks does each update regenerate?
+CHUNKER_BENCH(lod_hysteresis_jitter) {
+  auto factory = std::make_shared<bench_factory>();
+
+  for (double hysteresis : { 0.0, 0.25, 0.5 }) {
+    GenerationStats stats {};
+    bench::BenchResult& result = state.Measure("lod_hysteresis_jitter/h=" + std::to_string(hysteresis).substr(0, 4), [&] {
+      ChunkManager<bench_factory, bench_gen, bench_chunk> mgr(factory, 4, 1024.0, 16, 2.0);
+      mgr.SetHysteresis(hysteresis);
+
+      // same path for every variant
+      std::mt19937 rng(1);
+      std::uniform_real_distribution<float> jitter(-JITTER, JITTER);
+      for (int i = 0; i < UPDATE_COUNT; i++) {
+        float drift = static_cast<float>(i / HOVER_UPDATES);
+        mgr.UpdateChunkData(glm::vec3(100.0f + drift * 37.0f + jitter(rng), 0.0f, 80.0f + drift * 23.0f + jitter(rng)));
+        mgr.wait();
+      }
+
+      stats = mgr.GetGenerationStats();
+    });
+
+    result.Counter("generated_per_update", static_cast<double>(stats.generated) / UPDATE_COUNT)
+      .Counter("requested_per_update", static_cast<double>(stats.generated + stats.cache_hits + stats.deduped) / UPDATE_COUNT)
+      .Counter("us_per_update", result.ns_per_iter / UPDATE_COUNT / 1000.0);
+  }
+}
@@ -0,0 +1,288 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/lod/lod_neighborhood.hpp"
+#include "chunker/lod/lod_node.hpp"
+
+#include <tbb/global_control.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+using namespace chunker::lod;
+
+namespace {
+  struct tree_config {
+    double max_gen_distance;
+    int min_chunk_size;
+    double cascade_factor;
+  };
+
+  const tree_config configs[] = {
+    { 512.0,  16, 2.0 },
+    { 2048.0, 16, 2.0 },
+    { 2048.0, 16, 8.0 },
+    { 8192.0, 32, 8.0 }
+  };
+
+  // matches ChunkManager's sizing
+  int TreeSize(double max_gen_distance) {
+    return 1 << static_cast<int>(ceil(log2(max_gen_distance)) + 2);
+  }
+
+  std::string ConfigName(const char* prefix, const tree_config& config) {
+    return std::string(prefix) + "/" + std::to_string(static_cast<int>(config.max_gen_distance))
+      + "/" + std::to_string(config.min_chunk_size) + "/" + std::to_string(static_cast<int>(config.cascade_factor));
+  }
+
+  size_t CountNodes(const lod_node* node) {
+    if (node == nullptr) {
+      return 0;
+    }
+
+    return 1 + CountNodes(node->bl) + CountNodes(node->br) + CountNodes(node->tl) + CountNodes(node->tr);
+  }
+
+  struct leaf {
+    long x;
+    long y;
+    size_t size;
+  };
+
+  void CollectLeaves(const lod_node* node, long x, long y, size_t size, std::vector<leaf>& output) {
+    if (node->tl == nullptr) {
+      output.push_back({ x, y, size });
+      return;
+    }
+
+    long half = static_cast<long>(size / 2);
+    CollectLeaves(node->bl, x,        y,        half, output);
+    CollectLeaves(node->br, x + half, y,        half, output);
+    CollectLeaves(node->tl, x,        y + half, half, output);
+    CollectLeaves(node->tr, x + half, y + half, half, output);
+  }
+
+  // keeps identifier construction from being optimized out
+  size_t NeighborSum(const ChunkIdentifier& identifier) {
+    const ChunkNeighbors& n = identifier.neighbors;
+    return static_cast<size_t>(n.l.Exponent() + n.r.Exponent() + n.u.Exponent() + n.d.Exponent()
+      + n.tl.Exponent() + n.tr.Exponent() + n.bl.Exponent() + n.br.Exponent());
+  }
+
+  // identifiers for every leaf, resolving neighbors during the walk (as ChunkManager does)
+  size_t WalkIdentifiers(const lod_node* node, long x, long y, size_t size, size_t tree_res, size_t chunk_res, const lod_neighborhood& neighborhood) {
+    if (node->tl == nullptr) {
+      ChunkNeighbors neighbors;
+      neighbors.bl = util::DyadicScale(neighborhood.GetNeighborSize(-1, -1, x, y, size, tree_res));
+      neighbors.tr = util::DyadicScale(neighborhood.GetNeighborSize( 1,  1, x, y, size, tree_res));
+      neighbors.tl = util::DyadicScale(neighborhood.GetNeighborSize(-1,  1, x, y, size, tree_res));
+      neighbors.br = util::DyadicScale(neighborhood.GetNeighborSize( 1, -1, x, y, size, tree_res));
+      neighbors.l  = util::DyadicScale(neighborhood.GetNeighborSize(-1,  0, x, y, size, tree_res));
+      neighbors.r  = util::DyadicScale(neighborhood.GetNeighborSize( 1,  0, x, y, size, tree_res));
+      neighbors.u  = util::DyadicScale(neighborhood.GetNeighborSize( 0,  1, x, y, size, tree_res));
+      neighbors.d  = util::DyadicScale(neighborhood.GetNeighborSize( 0, -1, x, y, size, tree_res));
+      ChunkIdentifier identifier(x, y, size, chunk_res, neighbors);
+      return NeighborSum(identifier);
+    }
+
+    long half = static_cast<long>(size / 2);
+    return WalkIdentifiers(node->bl, x,        y,        half, tree_res, chunk_res, neighborhood.Descend(0, 0))
+         + WalkIdentifiers(node->br, x + half, y,        half, tree_res, chunk_res, neighborhood.Descend(1, 0))
+         + WalkIdentifiers(node->tl, x,        y + half, half, tree_res, chunk_res, neighborhood.Descend(0, 1))
+         + WalkIdentifiers(node->tr, x + half, y + half, half, tree_res, chunk_res, neighborhood.Descend(1, 1));
+  }
+
+  // old behavior: one heap allocation per node, recursive free
+  lod_node* HeapClone(const lod_node* node) {
+    if (node == nullptr) {
+      return nullptr;
+    }
+
+    lod_node* res = lod_node::lod_node_alloc();
+    res->bl = HeapClone(node->bl);
+    res->br = HeapClone(node->br);
+    res->tl = HeapClone(node->tl);
+    res->tr = HeapClone(node->tr);
+    return res;
+  }
+}
+
+CHUNKER_BENCH(lod_tree_build) {
+  for (auto& config : configs) {
+    int size = TreeSize(config.max_gen_distance);
+    LodTreeGenerator gen(size, config.min_chunk_size);
+    gen.cascade_factor = config.cascade_factor;
+
+    // jitter position a bit so we aren't building the exact same tree every time
+    float step = 0.0f;
+    glm::vec3 center(size / 2.0f, 0.0f, size / 2.0f);
+    auto build = [&] {
+      step += 0.37f;
+      return gen.CreateLodTree(center + glm::vec3(fmod(step, 16.0f), 0.0f, 0.0f), 3);
+    };
+
+    size_t nodes = CountNodes(build());
+
+    // steady state: allocs per tree once both arenas have warmed up
+    gen.RetainTree();
+    build();
+    gen.RetainTree();
+
+    const size_t sample_count = 64;
+    size_t allocs_before = bench::AllocationCount();
+    for (size_t i = 0; i < sample_count; i++) {
+      build();
+      gen.RetainTree();
+    }
+
+    double arena_allocs = static_cast<double>(bench::AllocationCount() - allocs_before) / sample_count;
+
+    state.Measure(ConfigName("lod_tree_build/arena", config), [&] {
+      build();
+      gen.RetainTree();
+    }).Counter("nodes", static_cast<double>(nodes)).Counter("allocs_per_tree", arena_allocs);
+
+    // per-node new/delete, as lod_node_alloc / lod_node_free did before the arena
+    allocs_before = bench::AllocationCount();
+    for (size_t i = 0; i < sample_count; i++) {
+      lod_node::lod_node_free(HeapClone(build()));
+    }
+
+    double heap_allocs = static_cast<double>(bench::AllocationCount() - allocs_before) / sample_count;
+
+    state.Measure(ConfigName("lod_tree_build/heap", config), [&] {
+      lod_node::lod_node_free(HeapClone(build()));
+    }).Counter("nodes", static_cast<double>(nodes)).Counter("allocs_per_tree", heap_allocs);
+  }
+}
+
+CHUNKER_BENCH(lod_point_lookup) {
+  for (auto& config : configs) {
+    int size = TreeSize(config.max_gen_distance);
+    LodTreeGenerator gen(size, config.min_chunk_size);
+    gen.cascade_factor = config.cascade_factor;
+    lod_node* tree = gen.CreateLodTree(glm::vec3(size / 2.0f, 0.0f, size / 2.0f), 3);
+    LinearLodTree linear_tree(tree, size);
+
+    // fixed pseudo-random sample set
+    std::vector<glm::vec2> samples;
+    uint32_t seed = 12345;
+    for (int i = 0; i < 1024; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      float x = static_cast<float>(seed % (size * 2)) * 0.5f;
+      seed = seed * 1664525u + 1013904223u;
+      float y = static_cast<float>(seed % (size * 2)) * 0.5f;
+      samples.push_back(glm::vec2(x, y));
+    }
+
+    size_t sink = 0;
+    state.Measure(ConfigName("lod_point_lookup/pointer", config), [&] {
+      for (auto& sample : samples) {
+        sink += lod_node::GetChunkSize(tree, size, sample);
+      }
+    }).Counter("samples", static_cast<double>(samples.size()));
+
+    state.Measure(ConfigName("lod_point_lookup/linear", config), [&] {
+      for (auto& sample : samples) {
+        sink += linear_tree.GetChunkSize(sample);
+      }
+    }).Counter("samples", static_cast<double>(samples.size())).Counter("leaves", static_cast<double>(linear_tree.LeafCount()));
+
+    // keep the lookups alive
+    if (sink == 0) {
+      state.Measure("lod_point_lookup/sink", [] {});
+    }
+  }
+}
+
+// serial vs split builds. "forced" splits every build, "gated" only once trees pass parallel_min_nodes (the default).
+// the last config is big enough to pass the gate. hw_threads is what the box has - threads past that can't speed anything up
+CHUNKER_BENCH(lod_tree_parallel) {
+  const tree_config big_configs[] = {
+    { 8192.0,  16, 32.0 },
+    { 16384.0, 8,  64.0 },
+    { 16384.0, 8,  512.0 }
+  };
+
+  double hw_threads = static_cast<double>(std::thread::hardware_concurrency());
+  for (auto& config : big_configs) {
+    int size = TreeSize(config.max_gen_distance);
+    glm::vec3 center(size / 2.0f, 0.0f, size / 2.0f);
+
+    for (int levels : { 0, 2, 3 }) {
+      for (bool gated : { false, true }) {
+        for (size_t threads : { 1, 2, 4, 8 }) {
+          if (levels == 0 && (threads > 1 || gated)) {
+            continue;
+          }
+
+          tbb::global_control control(tbb::global_control::max_allowed_parallelism, threads);
+          LodTreeGenerator gen(size, config.min_chunk_size);
+          gen.cascade_factor = config.cascade_factor;
+          gen.parallel_levels = levels;
+          gen.parallel_min_nodes = (gated ? LodTreeGenerator::DEFAULT_PARALLEL_MIN_NODES : 0);
+
+          size_t nodes = CountNodes(gen.CreateLodTree(center, 3));
+          std::string mode = (levels == 0 ? "serial" : (gated ? "gated" : "forced"));
+          std::string name = ConfigName("lod_tree_parallel", config) + "/" + mode + "/levels:" + std::to_string(levels) + "/threads:" + std::to_string(threads);
+          state.Measure(name, [&] {
+            gen.CreateLodTree(center, 3);
+          }).Counter("nodes", static_cast<double>(nodes))
+            .Counter("split", (levels > 0 && nodes >= gen.parallel_min_nodes) ? 1.0 : 0.0)
+            .Counter("hw_threads", hw_threads);
+        }
+      }
+    }
+  }
+}
+
+CHUNKER_BENCH(chunk_identifier_build) {
+  for (auto& config : configs) {
+    int size = TreeSize(config.max_gen_distance);
+    LodTreeGenerator gen(size, config.min_chunk_size);
+    gen.cascade_factor = config.cascade_factor;
+    lod_node* tree = gen.CreateLodTree(glm::vec3(size / 2.0f, 0.0f, size / 2.0f), 3);
+    LinearLodTree linear_tree(tree, size);
+
+    std::vector<leaf> leaves;
+    CollectLeaves(tree, 0, 0, size, leaves);
+    double leaf_count = static_cast<double>(leaves.size());
+
+    size_t sink = 0;
+    state.Measure(ConfigName("chunk_identifier_build/pointer_samples", config), [&] {
+      for (auto& l : leaves) {
+        ChunkIdentifier identifier(l.x, l.y, l.x, l.y, l.size, config.min_chunk_size, size, tree);
+        sink += NeighborSum(identifier);
+      }
+    }).Counter("leaves", leaf_count);
+
+    state.Measure(ConfigName("chunk_identifier_build/linear_samples", config), [&] {
+      for (auto& l : leaves) {
+        ChunkIdentifier identifier(l.x, l.y, l.x, l.y, l.size, config.min_chunk_size, linear_tree);
+        sink += NeighborSum(identifier);
+      }
+    }).Counter("leaves", leaf_count);
+
+    // step-scaled identifiers - GetChunkStep per sample
+    state.Measure(ConfigName("chunk_identifier_build/scaled_samples", config), [&] {
+      for (auto& l : leaves) {
+        ChunkIdentifier identifier(glm::i64vec2(l.x, l.y), glm::ivec2(l.x, l.y), config.min_chunk_size, util::DyadicScale(l.size, config.min_chunk_size), size, tree);
+        sink += NeighborSum(identifier);
+      }
+    }).Counter("leaves", leaf_count);
+
+    state.Measure(ConfigName("chunk_identifier_build/neighborhood_walk", config), [&] {
+      sink += WalkIdentifiers(tree, 0, 0, size, size, config.min_chunk_size, lod_neighborhood::Root(tree));
+    }).Counter("leaves", leaf_count);
+
+    if (sink == 0) {
+      state.Measure("chunk_identifier_build/sink", [] {});
+    }
+  }
+}
@@ -0,0 +1,189 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkKey.hpp"
+#include "chunker/util/HashList.hpp"
+#include "chunker/util/LRUCache.hpp"
+#include "chunker/util/ShardedLRUCache.hpp"
+#include "chunker/traits/chunk_cost.hpp"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  const size_t KEY_COUNT = 4096;
+  const size_t OPS_PER_THREAD = 16384;
+
+  // the previous LRUCache layout - HashList of keys, plus a separate value map
+  template <typename KeyType, typename ValueType>
+  class LegacyLRUCache {
+  public:
+    LegacyLRUCache(int capacity) : capacity_(capacity) {}
+
+    bool Fetch(const KeyType& key, ValueType* output) {
+      std::lock_guard lock(mutex_);
+      if (key_cache_.Contains(key)) {
+        key_cache_.PushFront(key);
+        *output = value_cache_.at(key);
+        return true;
+      }
+
+      return false;
+    }
+
+    void Put(const KeyType& key, const ValueType& value) {
+      std::lock_guard lock(mutex_);
+      key_cache_.PushFront(key);
+      if (value_cache_.find(key) == value_cache_.end() && key_cache_.Size() > static_cast<size_t>(capacity_)) {
+        KeyType key_last;
+        key_cache_.PopBack(&key_last);
+        value_cache_.erase(key_last);
+      }
+
+      value_cache_.insert_or_assign(key, value);
+    }
+
+  private:
+    util::HashList<KeyType> key_cache_;
+    std::unordered_map<KeyType, ValueType> value_cache_;
+    int capacity_;
+    std::recursive_mutex mutex_;
+  };
+
+  std::vector<ChunkKey> MakeKeys() {
+    std::vector<ChunkKey> res;
+    for (size_t i = 0; i < KEY_COUNT; i++) {
+      ChunkIdentifier identifier(static_cast<long>(i % 64) * 16, static_cast<long>(i / 64) * 16, 16, 16, ChunkNeighbors());
+      res.push_back(ChunkKey(identifier));
+    }
+
+    return res;
+  }
+
+  // cheap chunks, as the pool sees them: mostly fetch hits, some puts
+  template <typename CacheType>
+  void Worker(CacheType& cache, const std::vector<ChunkKey>& keys, uint32_t seed) {
+    std::shared_ptr<int> chunk;
+    for (size_t i = 0; i < OPS_PER_THREAD; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      const ChunkKey& key = keys[(seed >> 8) % keys.size()];
+      if ((seed & 0xF) == 0) {
+        cache.Put(key, chunk);
+      } else {
+        cache.Fetch(key, &chunk);
+      }
+    }
+  }
+
+  template <typename CacheType>
+  void MeasureScaling(bench::BenchState& state, const std::string& name, const std::vector<ChunkKey>& keys) {
+    CacheType cache(static_cast<int>(KEY_COUNT));
+    auto value = std::make_shared<int>(0);
+    for (auto& key : keys) {
+      cache.Put(key, value);
+    }
+
+    // powers of two, up to max_threads (--set max_threads=N).
+    // hw_threads is what the box has - past that, threads time slice and contention shows up as preemption, not spinning
+    size_t max_threads = static_cast<size_t>(state.Param("max_threads", 16));
+    double hw_threads = static_cast<double>(std::thread::hardware_concurrency());
+    for (size_t thread_count = 1; thread_count <= max_threads; thread_count *= 2) {
+      std::vector<std::thread> threads(thread_count);
+      bench::BenchResult& result = state.Measure(name + "/threads:" + std::to_string(thread_count), [&] {
+        for (size_t i = 0; i < thread_count; i++) {
+          threads[i] = std::thread([&, i] { Worker(cache, keys, static_cast<uint32_t>(i * 7919 + 1)); });
+        }
+
+        for (auto& thread : threads) {
+          thread.join();
+        }
+      });
+
+      double ops = static_cast<double>(thread_count * OPS_PER_THREAD);
+      result.Counter("ops", ops).Counter("ns_per_op", result.ns_per_iter / ops).Counter("hw_threads", hw_threads);
+    }
+  }
+}
+
+// single thread: hit-heavy mix, then a churn mix where most puts evict
+template <typename CacheType>
+void MeasureOps(bench::BenchState& state, const std::string& name, const std::vector<ChunkKey>& keys) {
+  for (size_t key_range : { KEY_COUNT / 2, KEY_COUNT }) {
+    CacheType cache(static_cast<int>(KEY_COUNT / 2));
+    auto value = std::make_shared<int>(0);
+    for (size_t i = 0; i < KEY_COUNT / 2; i++) {
+      cache.Put(keys[i], value);
+    }
+
+    std::vector<ChunkKey> range(keys.begin(), keys.begin() + key_range);
+    size_t allocs_before = bench::AllocationCount();
+    Worker(cache, range, 1);
+    double allocs = static_cast<double>(bench::AllocationCount() - allocs_before) / OPS_PER_THREAD;
+
+    std::string mix = (key_range == KEY_COUNT / 2 ? "/hits" : "/churn");
+    bench::BenchResult& result = state.Measure(name + mix, [&] {
+      Worker(cache, range, 1);
+    });
+
+    result.Counter("ns_per_op", result.ns_per_iter / OPS_PER_THREAD).Counter("allocs_per_op", allocs);
+  }
+}
+
+CHUNKER_BENCH(lru_cache_ops) {
+  std::vector<ChunkKey> keys = MakeKeys();
+  MeasureOps<LegacyLRUCache<ChunkKey, std::shared_ptr<int>>>(state, "lru_cache_ops/hashlist", keys);
+  MeasureOps<util::LRUCache<ChunkKey, std::shared_ptr<int>>>(state, "lru_cache_ops/slab", keys);
+}
+
+namespace {
+  // stand-in for a generated chunk - payload size varies w lod
+  struct SizedChunk {
+    size_t bytes;
+
+    size_t ByteSize() const {
+      return bytes;
+    }
+  };
+}
+
+// byte budget: chunks of 4KiB-64KiB churn through a 16MiB cache
+CHUNKER_BENCH(lru_cache_budget) {
+  typedef util::LRUCache<ChunkKey, std::shared_ptr<SizedChunk>, traits::chunk_cost<std::shared_ptr<SizedChunk>>> CacheType;
+  std::vector<ChunkKey> keys = MakeKeys();
+  std::vector<std::shared_ptr<SizedChunk>> chunks;
+  for (size_t i = 0; i < keys.size(); i++) {
+    chunks.push_back(std::make_shared<SizedChunk>(SizedChunk { static_cast<size_t>(4096) << (i % 5) }));
+  }
+
+  const size_t budget = static_cast<size_t>(16) << 20;
+  CacheType cache(budget);
+  uint32_t seed = 1;
+  bench::BenchResult& result = state.Measure("lru_cache_budget/churn", [&] {
+    std::shared_ptr<SizedChunk> chunk;
+    for (size_t i = 0; i < OPS_PER_THREAD; i++) {
+      seed = seed * 1664525u + 1013904223u;
+      size_t ind = (seed >> 8) % keys.size();
+      if (!cache.Fetch(keys[ind], &chunk)) {
+        cache.Put(keys[ind], chunks[ind]);
+      }
+    }
+  });
+
+  result.Counter("ns_per_op", result.ns_per_iter / OPS_PER_THREAD)
+    .Counter("budget_mib", static_cast<double>(budget) / (1 << 20))
+    .Counter("usage_mib", static_cast<double>(cache.Usage()) / (1 << 20))
+    .Counter("high_water_mib", static_cast<double>(cache.HighWaterMark()) / (1 << 20))
+    .Counter("entries", static_cast<double>(cache.Size()));
+}
+
+CHUNKER_BENCH(lru_cache_threads) {
+  std::vector<ChunkKey> keys = MakeKeys();
+  MeasureScaling<util::LRUCache<ChunkKey, std::shared_ptr<int>>>(state, "lru_cache_threads/single_lock", keys);
+  MeasureScaling<util::ShardedLRUCache<ChunkKey, std::shared_ptr<int>, 16>>(state, "lru_cache_threads/sharded_16", keys);
+  MeasureScaling<util::ShardedLRUCache<ChunkKey, std::shared_ptr<int>, 64>>(state, "lru_cache_threads/sharded_64", keys);
+}
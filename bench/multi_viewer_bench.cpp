@@ -0,0 +1,105 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkManager.hpp"
+#include "chunker/MultiViewerChunkManager.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  const int VIEWER_COUNT = 8;
+  const int UPDATE_COUNT = 16;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // ~20us of arithmetic per chunk
+  struct bench_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      for (int i = 0; i < 4096; i++) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      }
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>();
+    }
+  };
+
+  // a party of players walking together, a few units apart - on fresh ground every run
+  std::vector<glm::vec3> PartyPositions(long run, int update) {
+    std::vector<glm::vec3> res;
+    for (int i = 0; i < VIEWER_COUNT; i++) {
+      res.push_back(glm::vec3(run * 65536.0f + update * 40.0f + i * 12.0f, 0.0f, (i % 3) * 15.0f));
+    }
+
+    return res;
+  }
+}
+
+// players near each other - a manager (pool, threads, cache) per player, or one manager for all of them
+CHUNKER_BENCH(multi_viewer_party) {
+  auto factory = std::make_shared<bench_factory>();
+
+  {
+    long run = 0;
+    size_t generated = 0;
+    bench::BenchResult& result = state.Measure("multi_viewer_party/manager_per_viewer", [&] {
+      run++;
+      std::vector<std::unique_ptr<ChunkManager<bench_factory, bench_gen, bench_chunk>>> managers;
+      for (int i = 0; i < VIEWER_COUNT; i++) {
+        managers.push_back(std::make_unique<ChunkManager<bench_factory, bench_gen, bench_chunk>>(factory, 1, 512.0, 16, 2.0));
+      }
+
+      for (int update = 0; update < UPDATE_COUNT; update++) {
+        std::vector<glm::vec3> positions = PartyPositions(run, update);
+        for (int i = 0; i < VIEWER_COUNT; i++) {
+          managers[i]->UpdateChunkData(positions[i]);
+        }
+
+        for (auto& mgr : managers) {
+          mgr->wait();
+        }
+      }
+
+      generated = 0;
+      for (auto& mgr : managers) {
+        generated += mgr->GetGenerationStats().generated;
+      }
+    });
+
+    result.Counter("generated_per_run", static_cast<double>(generated))
+      .Counter("us_per_update", result.ns_per_iter / UPDATE_COUNT / 1000.0);
+  }
+
+  {
+    long run = 0;
+    size_t generated = 0;
+    size_t trees = 0;
+    bench::BenchResult& result = state.Measure("multi_viewer_party/shared", [&] {
+      run++;
+      MultiViewerChunkManager<bench_factory, bench_gen, bench_chunk> mgr(factory, VIEWER_COUNT, 512.0, 16, 2.0);
+      for (int update = 0; update < UPDATE_COUNT; update++) {
+        mgr.UpdateViewers(PartyPositions(run, update));
+        mgr.wait();
+      }
+
+      generated = mgr.GetGenerationStats().generated;
+      trees = mgr.GetTreeCount();
+    });
+
+    result.Counter("generated_per_run", static_cast<double>(generated))
+      .Counter("trees", static_cast<double>(trees))
+      .Counter("us_per_update", result.ns_per_iter / UPDATE_COUNT / 1000.0);
+  }
+}
@@ -0,0 +1,80 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  // spins for cost_ns per chunk - a stand-in for real generation, w a cost we control
+  struct bench_gen {
+    int64_t cost_ns;
+
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t seed = static_cast<uint64_t>(identifier.x * 31 + identifier.y);
+      auto deadline = clock_type::now() + std::chrono::nanoseconds(cost_ns);
+      do {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      } while (clock_type::now() < deadline);
+
+      return std::make_shared<bench_chunk>(bench_chunk { seed });
+    }
+  };
+
+  struct bench_factory {
+    int64_t cost_ns;
+
+    std::shared_ptr<bench_gen> Create() {
+      return std::make_shared<bench_gen>(bench_gen { cost_ns });
+    }
+  };
+
+  // the value of a param if it was set, otherwise a sweep
+  std::vector<double> Sweep(const bench::BenchState& state, const std::string& param, std::vector<double> fallback) {
+    if (state.HasParam(param)) {
+      return { state.Param(param, 0.0) };
+    }
+
+    return fallback;
+  }
+}
+
+// a batch of distinct chunks through the whole pool - enqueue, generate, cache, wait - w nothing cached up front.
+// knobs: --set gen_cost_us=N, --set threads=N, --set chunks=N
+CHUNKER_BENCH(pool_throughput) {
+  size_t chunk_count = static_cast<size_t>(state.Param("chunks", 1024));
+  std::vector<ChunkKey> keys;
+  for (size_t i = 0; i < chunk_count; i++) {
+    keys.push_back(ChunkKey(ChunkIdentifier(static_cast<long>(i % 64) * 16, static_cast<long>(i / 64) * 16, 16, 16, ChunkNeighbors())));
+  }
+
+  for (double cost_us : Sweep(state, "gen_cost_us", { 0.0, 20.0, 200.0 })) {
+    for (double threads : Sweep(state, "threads", { 1.0, 2.0, 4.0, 8.0 })) {
+      auto factory = std::make_shared<bench_factory>(bench_factory { static_cast<int64_t>(cost_us * 1000.0) });
+
+      // tiny budget - every iteration regenerates everything
+      TypedChunkThreadPool<bench_factory, bench_gen, bench_chunk> pool(static_cast<size_t>(threads), factory, 1);
+      std::string name = "pool_throughput/cost_us:" + std::to_string(static_cast<int>(cost_us)) + "/threads:" + std::to_string(static_cast<int>(threads));
+      bench::BenchResult& result = state.Measure(name, [&] {
+        pool.EnqueueBulk(keys);
+        pool.Wait();
+      });
+
+      double ideal_ns = cost_us * 1000.0 * chunk_count / threads;
+      result.Counter("chunks_per_s", chunk_count * 1e9 / result.ns_per_iter)
+        .Counter("overhead_ns_per_chunk", (result.ns_per_iter - ideal_ns) * threads / chunk_count);
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#include "bench.hpp"
+
+#include "chunker/util/DyadicScale.hpp"
+#include "chunker/util/Fraction.hpp"
+
+#include <vector>
+
+using namespace chunker::util;
+
+namespace {
+  // the ops GetChunkStep + ChunkIdentifier do per sample: halve down the tree, then clamp against our own step
+  template <typename ScaleType>
+  size_t StepChain(const std::vector<int>& depths, const ScaleType& base, const ScaleType& own) {
+    size_t res = 0;
+    for (int depth : depths) {
+      ScaleType step = base;
+      for (int i = 0; i < depth; i++) {
+        step = step / 2;
+      }
+
+      ScaleType neighbor = (step < own ? own : step);
+      res += (neighbor == own ? 1 : 0);
+    }
+
+    return res;
+  }
+}
+
+CHUNKER_BENCH(scale_arith) {
+  std::vector<int> depths;
+  uint32_t seed = 12345;
+  for (int i = 0; i < 1024; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    depths.push_back(static_cast<int>((seed >> 16) % 12));
+  }
+
+  size_t sink = 0;
+  state.Measure("scale_arith/fraction", [&] {
+    sink += StepChain(depths, Fraction(4096, 16), Fraction(1, 4));
+  }).Counter("samples", static_cast<double>(depths.size()));
+
+  state.Measure("scale_arith/dyadic", [&] {
+    sink += StepChain(depths, DyadicScale(4096, 16), DyadicScale(1, 4));
+  }).Counter("samples", static_cast<double>(depths.size()));
+
+  if (sink == 0) {
+    state.Measure("scale_arith/sink", [] {});
+  }
+}
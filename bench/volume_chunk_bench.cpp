@@ -0,0 +1,110 @@
+#include "bench.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkManager.hpp"
+#include "chunker/VolumeChunkIdentifier.hpp"
+#include "chunker/VolumeChunkManager.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+using namespace chunker;
+
+namespace {
+  const int UPDATE_COUNT = 8;
+  const double GEN_DISTANCE = 256.0;
+
+  // height of the world - the same as the volume tree's vertical extent
+  const long WORLD_HEIGHT = 1024;
+
+  struct bench_chunk {
+    uint64_t value;
+  };
+
+  std::atomic<uint64_t> cells_generated(0);
+
+  // a little arithmetic per cell, so cost tracks cell count
+  uint64_t FillCells(uint64_t seed, uint64_t cells) {
+    for (uint64_t i = 0; i < cells; i++) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    }
+
+    cells_generated += cells;
+    return seed;
+  }
+
+  // heightmap style - every chunk is a full height column of cells
+  struct column_gen {
+    std::shared_ptr<bench_chunk> Generate(const ChunkIdentifier& identifier) {
+      uint64_t res = identifier.chunk_res;
+      uint64_t cells = res * res * (WORLD_HEIGHT / identifier.GetStepSize());
+      return std::make_shared<bench_chunk>(bench_chunk { FillCells(static_cast<uint64_t>(identifier.x * 31 + identifier.y), cells) });
+    }
+  };
+
+  struct volume_gen {
+    std::shared_ptr<bench_chunk> Generate(const VolumeChunkIdentifier& identifier) {
+      uint64_t res = identifier.chunk_res;
+      return std::make_shared<bench_chunk>(bench_chunk { FillCells(static_cast<uint64_t>(identifier.x * 31 + identifier.y * 17 + identifier.z), res * res * res) });
+    }
+  };
+
+  template <typename Gen>
+  struct bench_factory {
+    std::shared_ptr<Gen> Create() {
+      return std::make_shared<Gen>();
+    }
+  };
+
+  glm::vec3 ViewerPosition(long run, int update) {
+    return glm::vec3(run * 65536.0f + update * 24.0f, 0.0f, update * 9.0f);
+  }
+}
+
+// a viewer walking across a deep world - full height columns vs an octree which only refines near the viewer's height
+CHUNKER_BENCH(volume_chunk_walk) {
+  {
+    auto factory = std::make_shared<bench_factory<column_gen>>();
+    long run = 0;
+    uint64_t cells = 0;
+    size_t chunks = 0;
+    bench::BenchResult& result = state.Measure("volume_chunk_walk/columns", [&] {
+      run++;
+      cells_generated = 0;
+      ChunkManager<bench_factory<column_gen>, column_gen, bench_chunk> mgr(factory, 4, GEN_DISTANCE, 16, 2.0);
+      for (int update = 0; update < UPDATE_COUNT; update++) {
+        mgr.UpdateChunkData(ViewerPosition(run, update));
+        mgr.wait();
+      }
+
+      cells = cells_generated;
+      chunks = mgr.GetChunkCount();
+    });
+
+    result.Counter("cells_per_run", static_cast<double>(cells))
+      .Counter("visible_chunks", static_cast<double>(chunks));
+  }
+
+  {
+    auto factory = std::make_shared<bench_factory<volume_gen>>();
+    long run = 0;
+    uint64_t cells = 0;
+    size_t chunks = 0;
+    bench::BenchResult& result = state.Measure("volume_chunk_walk/octree", [&] {
+      run++;
+      cells_generated = 0;
+      VolumeChunkManager<bench_factory<volume_gen>, volume_gen, bench_chunk> mgr(factory, 4, GEN_DISTANCE, 16, 2.0);
+      for (int update = 0; update < UPDATE_COUNT; update++) {
+        mgr.UpdateChunkData(ViewerPosition(run, update));
+        mgr.wait();
+      }
+
+      cells = cells_generated;
+      chunks = mgr.GetChunkCount();
+    });
+
+    result.Counter("cells_per_run", static_cast<double>(cells))
+      .Counter("visible_chunks", static_cast<double>(chunks));
+  }
+}
@@ -1,14 +1,21 @@
 #ifndef ASYNC_CHUNK_MANAGER_H_
 #define ASYNC_CHUNK_MANAGER_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
 #include <future>
 #include <memory>
 #include <mutex>
 #include <queue>
+#include <string>
 #include <thread>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
 
 #include "chunker/traits/chunker_type.hpp"
 
@@ -29,91 +36,244 @@ namespace chunker {
     // denotes how tasks are added to the queue
     typename Job = typename GenFactory::job_type,
     // type of data returned by mgr
-    typename Result = decltype(std::declval<Chunker&>().Stitch(std::declval<Job&>(), std::vector<std::shared_ptr<Chunk>> {}))
+    typename Result = decltype(std::declval<Chunker&>().Stitch(std::declval<Job&>(), std::vector<std::shared_ptr<Chunk>> {})),
+    // cache for finished chunks
+    typename Cache = ChunkCache<Chunk>
     // could virt this
   >
   class AsyncChunkManager {
     typedef std::promise<Result> PromiseType;
     static_assert(traits::chunker_type<Chunker, Chunk, Job, Result>::value);
     static_assert(traits::stitcher_type<Chunker, Chunk, Job, Result>::value);
+    typedef TypedChunkThreadPool<GenFactory, Generator, Chunk, Cache> PoolType;
    public:
+    /**
+     * @param chunker - splits jobs into chunks, and stitches them back together.
+     * jobs run concurrently, so Stitch may be called from several pool threads at once, alongside Chunk on the dispatcher.
+     * @param factory - creates a generator per pool thread
+     * @param max_threads - number of generator threads
+     * @param cache_budget - budget for cached chunks, in the cache's cost units (bytes by default, if the chunk has a ByteSize())
+     */
     AsyncChunkManager(
       Chunker chunker,
       std::shared_ptr<GenFactory> factory,
-      size_t max_threads
-    ) : chunker_(chunker), factory_(factory), pool_(max_threads, factory_) {}
-    // result type needs to be shared if this is the case
-    // note: we still need to wrap this with some sort of "job queueing" or "job wrapping" system
-    // whatever lol thats fine though
-    std::future<Result> Enqueue(const Job& job) {
-      PromiseType promise;
-      std::future<Result> future = promise.get_future();
-      auto pair = std::make_pair(job, std::move(promise));
+      size_t max_threads,
+      size_t cache_budget = PoolType::DEFAULT_CACHE_BUDGET
+    ) : chunker_(chunker), factory_(factory), pool_(max_threads, factory_, cache_budget),
+        dispatcher_(&AsyncChunkManager::DispatchFunc, this) {}
 
+    // drops jobs which haven't been dispatched yet - their futures get broken_promise
+    ~AsyncChunkManager() {
       {
         std::lock_guard<std::mutex> lock(queue_lock_);
-        bool queue_empty = job_queue_.empty();
+        stop_ = true;
+      }
 
-        job_queue_.push(std::move(pair));
-        if (queue_empty) {
-          start_thread();
-        }
+      queue_cond_.notify_all();
+      dispatcher_.join();
+
+      // in-flight jobs still reference their state from worker callbacks
+      pool_.Wait();
+    }
+
+    AsyncChunkManager(const AsyncChunkManager& other) = delete;
+    AsyncChunkManager& operator=(const AsyncChunkManager& other) = delete;
+
+    /**
+     * @brief queues a job. its chunks go to the pool as soon as the dispatcher picks it up,
+     * alongside those of any other job in flight.
+     *
+     * @return std::future<Result> - ready once every chunk in the job is done, and stitched
+     * holds the exception instead if Chunk or Stitch throws, or Chunk returns an identifier ChunkKey can't pack
+     */
+    std::future<Result> Enqueue(const Job& job) {
+      auto state = std::make_unique<job_state>(job);
+      std::future<Result> future = state->promise.get_future();
+
+      {
+        std::lock_guard<std::mutex> lock(queue_lock_);
+        job_queue_.push(std::move(state));
+        jobs_outstanding_++;
       }
 
+      queue_cond_.notify_all();
       return future;
     }
 
+    /**
+     * @brief blocks until every job enqueued so far is stitched
+     */
     void wait() {
-      pool_.Wait();
+      CHUNKER_TRACE_SCOPE("manager", "wait");
+      std::unique_lock<std::mutex> lock(queue_lock_);
+      done_cond_.wait(lock, [&] { return jobs_outstanding_ == 0; });
     }
 
-   private:
-    typedef std::pair<Job, PromiseType> pair_type;
-    typedef std::pair<ChunkIdentifier, Chunk> chunk_data_type;
+    /**
+     * @brief cost of chunks currently held by the cache (bytes, w the default cache and a chunk w a ByteSize())
+     */
+    size_t GetCacheUsage() {
+      return pool_.CacheUsage();
+    }
 
-    void start_thread() {
-      std::thread { &AsyncChunkManager::async_func, this }.detach();
+    /**
+     * @brief highest cache usage seen so far
+     */
+    size_t GetCacheHighWaterMark() {
+      return pool_.CacheHighWaterMark();
+    }
+
+    /**
+     * @brief keeps chunks on disk in directory, behind the memory cache - see TypedChunkThreadPool::OpenDiskTier
+     */
+    void OpenDiskTier(const std::string& directory, size_t budget = PoolType::DEFAULT_DISK_BUDGET) {
+      pool_.OpenDiskTier(directory, budget);
     }
-    void async_func() {
-      std::unique_lock<std::mutex> lock(queue_lock_);
-      pair_type& item = job_queue_.front();
-      lock.unlock();
 
-      std::vector<ChunkIdentifier> ids = chunker_.Chunk(item.first);
+    /**
+     * @brief counts of generated and cached chunks - deduped counts chunks shared by overlapping jobs in flight together
+     */
+    GenerationStats GetGenerationStats() const {
+      return pool_.Stats();
+    }
 
-      for (auto id : ids) {
-        pool_.Enqueue(id);
-      }
+    /**
+     * @brief snapshot of the pool's queue depth, latencies, worker time and cache traffic - see TypedChunkThreadPool::Metrics
+     */
+    PipelineMetrics GetMetrics() const {
+      return pool_.Metrics();
+    }
 
-      pool_.Wake();
-      pool_.Wait();
+   private:
+    /**
+     * @brief one job in flight. keys are deduped, so each one completes exactly once -
+     * remaining is the job's latch, and whichever worker brings it to zero stitches.
+     */
+    struct job_state {
+      Job job;
+      PromiseType promise;
+
+      // chunk ids in the order Chunk() returned them
+      std::vector<ChunkKey> keys;
 
+      // unique keys -> slot in chunks. read only once the job is submitted
+      std::unordered_map<ChunkKey, size_t> slots;
       std::vector<std::shared_ptr<Chunk>> chunks;
-      for (auto id : ids) {
+      std::atomic<size_t> remaining;
+
+      explicit job_state(const Job& job) : job(job), remaining(0) {}
+    };
+
+    typedef std::unique_ptr<job_state> job_ptr;
+
+    // long lived - splits queued jobs into chunks and hands them to the pool. never blocks on generation
+    void DispatchFunc() {
+      CHUNKER_TRACE_THREAD_NAME("dispatcher", 0);
+      std::vector<ChunkKey> unique;
+      while (true) {
+        job_state* state;
+        {
+          std::unique_lock<std::mutex> lock(queue_lock_);
+          queue_cond_.wait(lock, [&] { return stop_ || !job_queue_.empty(); });
+          if (stop_) {
+            return;
+          }
+
+          // owned by in_flight_ until it's stitched
+          state = job_queue_.front().get();
+          in_flight_.emplace(state, std::move(job_queue_.front()));
+          job_queue_.pop();
+        }
+
+        CHUNKER_TRACE_SCOPE("job", "dispatch");
+        try {
+          std::vector<ChunkIdentifier> ids = chunker_.Chunk(state->job);
+
+          // pack once - the pool queues and caches by key
+          unique.clear();
+          state->keys.reserve(ids.size());
+          for (auto& id : ids) {
+            state->keys.emplace_back(id);
+            if (state->slots.emplace(state->keys.back(), unique.size()).second) {
+              unique.push_back(state->keys.back());
+            }
+          }
+        } catch (...) {
+          // ie. an identifier ChunkKey can't pack. fails this job, rather than handing it some other chunk
+          state->promise.set_exception(std::current_exception());
+          RetireJob(state);
+          continue;
+        }
+
+        state->chunks.resize(unique.size());
+        state->remaining.store(unique.size());
+        if (unique.empty()) {
+          FinishJob(state);
+          continue;
+        }
+
+        pool_.EnqueueBulk(unique, [this, state](const ChunkKey& key, const std::shared_ptr<Chunk>& chunk) {
+          // slots is read only by now, and each unique key lands once - no two workers write the same slot
+          state->chunks[state->slots.find(key)->second] = chunk;
+          if (state->remaining.fetch_sub(1) == 1) {
+            FinishJob(state);
+          }
+        });
+      }
+    }
+
+    // runs on the worker which finished the job's last chunk
+    void FinishJob(job_state* state) {
+      std::vector<std::shared_ptr<Chunk>> chunks;
+      chunks.reserve(state->keys.size());
+      for (auto& key : state->keys) {
         // contiguous? should be
-        chunks.push_back(pool_.GetChunk(id));
+        chunks.push_back(state->chunks[state->slots.find(key)->second]);
+      }
+
+      try {
+        CHUNKER_TRACE_SCOPE_ARGS("job", "stitch", util::CountTraceArgs(chunks.size()));
+        state->promise.set_value(chunker_.Stitch(state->job, chunks));
+      } catch (...) {
+        state->promise.set_exception(std::current_exception());
       }
 
-      Result r = chunker_.Stitch(item.first, chunks);
-      item.second.set_value(r);
+      RetireJob(state);
+    }
 
+    // drops a job whose promise is set
+    void RetireJob(job_state* state) {
+      job_ptr finished;
       {
         std::lock_guard<std::mutex> lock(queue_lock_);
-        job_queue_.pop();
-        if (!job_queue_.empty()) {
-          // while loop? iddk later lol
-          this->start_thread();
-        }
+        auto itr = in_flight_.find(state);
+        finished = std::move(itr->second);
+        in_flight_.erase(itr);
+        jobs_outstanding_--;
       }
+
+      done_cond_.notify_all();
     }
 
     mutable std::mutex queue_lock_;
-    std::queue<std::pair<Job, PromiseType>> job_queue_;
+    std::condition_variable queue_cond_;
+    std::condition_variable done_cond_;
+    std::queue<job_ptr> job_queue_;
+
+    // chunked and submitted, but not stitched yet
+    std::unordered_map<job_state*, job_ptr> in_flight_;
+
+    // queued + in flight
+    size_t jobs_outstanding_ = 0;
+    bool stop_ = false;
 
     Chunker chunker_;
     std::shared_ptr<GenFactory> factory_;
 
-    TypedChunkThreadPool<GenFactory, Generator, Chunk> pool_;
+    PoolType pool_;
+
+    // last - started once everything it touches exists
+    std::thread dispatcher_;
   };
 }
 
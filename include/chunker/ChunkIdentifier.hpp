@@ -2,10 +2,14 @@
 #define CHUNK_IDENTIFIER_H_
 
 #include <algorithm>
+#include <array>
 #include <functional>
 
 #include "chunker/lod/lod_node.hpp"
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/util/DyadicScale.hpp"
 #include "chunker/util/Fraction.hpp"
+#include "chunker/util/Hash.hpp"
 
 #include "gog43/Logger.hpp"
 
@@ -14,18 +18,19 @@
 #include <glm/gtx/hash.hpp>
 
 namespace chunker {
+  // neighbor sizes / steps - all powers of two
   struct ChunkNeighbors {
     // edges
-    util::Fraction l;
-    util::Fraction r;
-    util::Fraction u;
-    util::Fraction d;
+    util::DyadicScale l;
+    util::DyadicScale r;
+    util::DyadicScale u;
+    util::DyadicScale d;
 
     // corners
-    util::Fraction tl;
-    util::Fraction tr;
-    util::Fraction bl;
-    util::Fraction br;
+    util::DyadicScale tl;
+    util::DyadicScale tr;
+    util::DyadicScale bl;
+    util::DyadicScale br;
 
     bool operator==(const ChunkNeighbors& rhs) const {
       return (
@@ -39,6 +44,22 @@ namespace chunker {
         && br == rhs.br
       );
     }
+
+    // as Fractions, in field order - l, r, u, d, tl, tr, bl, br. for callers written against the old Fraction fields
+    std::array<util::Fraction, 8> AsFractions() const {
+      return { l.AsFraction(), r.AsFraction(), u.AsFraction(), d.AsFraction(), tl.AsFraction(), tr.AsFraction(), bl.AsFraction(), br.AsFraction() };
+    }
+
+    // field order as AsFractions. throws std::invalid_argument unless every size is zero or a power of two
+    static ChunkNeighbors FromFractions(const std::array<util::Fraction, 8>& sizes) {
+      ChunkNeighbors res;
+      util::DyadicScale* fields[] = { &res.l, &res.r, &res.u, &res.d, &res.tl, &res.tr, &res.bl, &res.br };
+      for (size_t i = 0; i < sizes.size(); i++) {
+        *fields[i] = util::DyadicScale(sizes[i]);
+      }
+
+      return res;
+    }
   };
 
   struct ChunkIdentifier {
@@ -52,7 +73,7 @@ namespace chunker {
     // vec2 specifying x/y dims
 
 
-    util::Fraction scale;
+    util::DyadicScale scale;
     glm::u64vec2 sample_dims;
     // tba: swap scale over to double
     // (add a sample param for it :3 i think only collider and splat are using it)
@@ -66,23 +87,84 @@ namespace chunker {
       size = 0;
       chunk_res = 0;
 
-      scale = 1;
+      scale = util::DyadicScale(1);
       sample_dims.x = 0;
       sample_dims.y = 0;
 
-      neighbors.bl = 0;
-      neighbors.l = 0;
-      neighbors.tl = 0;
-      neighbors.br = 0;
-      neighbors.r = 0;
-      neighbors.tr = 0;
-      neighbors.u = 0;
-      neighbors.d = 0;
+      neighbors.bl = util::DyadicScale::Zero();
+      neighbors.l = util::DyadicScale::Zero();
+      neighbors.tl = util::DyadicScale::Zero();
+      neighbors.br = util::DyadicScale::Zero();
+      neighbors.r = util::DyadicScale::Zero();
+      neighbors.tr = util::DyadicScale::Zero();
+      neighbors.u = util::DyadicScale::Zero();
+      neighbors.d = util::DyadicScale::Zero();
     }
 
     // dont like that this is locked to pot - eventually might want to break out of that
 
-    ChunkIdentifier(const glm::i64vec2& global_offset, const glm::ivec2& tree_offset, size_t chunk_res, const chunker::util::Fraction& scale, size_t tree_res, const lod::lod_node* tree) {
+    ChunkIdentifier(const glm::i64vec2& global_offset, const glm::ivec2& tree_offset, size_t chunk_res, const chunker::util::DyadicScale& scale, size_t tree_res, const lod::lod_node* tree) {
+      util::DyadicScale base_scale(tree_res, chunk_res);
+      InitScaled(global_offset, tree_offset, chunk_res, scale, [&](const glm::vec2& sample) {
+        return lod::lod_node::GetChunkStep(tree, base_scale, tree_res, sample);
+      });
+    }
+
+    ChunkIdentifier(const glm::i64vec2& global_offset, const glm::ivec2& tree_offset, size_t chunk_res, const chunker::util::DyadicScale& scale, const lod::LinearLodTree& tree) {
+      util::DyadicScale base_scale(tree.TreeRes(), chunk_res);
+      InitScaled(global_offset, tree_offset, chunk_res, scale, [&](const glm::vec2& sample) {
+        return tree.GetChunkStep(base_scale, sample);
+      });
+    }
+
+    // deprecate :3
+    ChunkIdentifier(long x, long y, long tree_x, long tree_y, size_t chunk_size, size_t chunk_res, size_t tree_res, const lod::lod_node* tree) {
+      InitSized(x, y, tree_x, tree_y, chunk_size, chunk_res, [&](const glm::vec2& sample) {
+        return lod::lod_node::GetChunkSize(tree, tree_res, sample);
+      });
+    }
+
+    ChunkIdentifier(long x, long y, long tree_x, long tree_y, size_t chunk_size, size_t chunk_res, const lod::LinearLodTree& tree) {
+      InitSized(x, y, tree_x, tree_y, chunk_size, chunk_res, [&](const glm::vec2& sample) {
+        return tree.GetChunkSize(sample);
+      });
+    }
+
+    // neighbors already resolved, ie. during a tree walk
+    ChunkIdentifier(long x, long y, size_t chunk_size, size_t chunk_res, const ChunkNeighbors& neighbors) {
+      this->x = x;
+      this->y = y;
+      this->size = chunk_size;
+      this->chunk_res = chunk_res;
+      this->sample_dims = glm::u64vec2(chunk_res);
+      this->neighbors = neighbors;
+    }
+
+    size_t GetStepSize() const {
+      return (size / chunk_res);
+    }
+
+    // scale as a Fraction, as it was before it became a DyadicScale
+    util::Fraction ScaleFraction() const {
+      return scale.AsFraction();
+    }
+
+    // throws std::invalid_argument unless scale is a power of two
+    void SetScale(const util::Fraction& scale) {
+      this->scale = util::DyadicScale(scale);
+    }
+
+    // tba: need specifiers for chunk edges
+    // (probably just eight ints specifying the chunk's eight neighbors as these are relevant for generation as well)
+
+    bool operator==(const ChunkIdentifier& rhs) const {
+      return (rhs.x == x && rhs.y == y && rhs.size == size && rhs.chunk_res == chunk_res && rhs.scale == scale && rhs.sample_dims == sample_dims && rhs.neighbors == neighbors);
+    }
+
+   private:
+    // SampleFunc: (tree-space sample point) -> step size of the chunk at that point
+    template <typename SampleFunc>
+    void InitScaled(const glm::i64vec2& global_offset, const glm::ivec2& tree_offset, size_t chunk_res, const chunker::util::DyadicScale& scale, SampleFunc sample) {
       // idea: should be able to offset in generation by a simple amount (tba)
 
       // global offset can be totally arbitrary
@@ -91,8 +173,9 @@ namespace chunker {
       this->scale = scale;
       this->sample_dims = glm::ivec2(chunk_res);
 
-      size_t chunk_size = static_cast<size_t>(scale * chunk_res);
-      util::Fraction base_scale(tree_res, chunk_res);
+      size_t chunk_size = static_cast<size_t>(scale.Apply(chunk_res));
+      this->size = chunk_size;
+      this->chunk_res = chunk_res;
 
       // lod calculations
       glm::vec2 near_corner = glm::vec2(tree_offset.x - 0.5f, tree_offset.y - 0.5f);
@@ -106,22 +189,17 @@ namespace chunker {
       // print these out next
       // want to get consistent generatioN!!!
       // (the issue is specifically corner cases, and how this neighbor table is gen'd)
-      neighbors.bl = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, near_corner)                           , scale);
-      neighbors.tr = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, far_corner)                            , scale);
-      neighbors.tl = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, glm::vec2(near_corner.x, far_corner.y)), scale);
-      neighbors.br = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, glm::vec2(far_corner.x, near_corner.y)), scale);
-      neighbors.l = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, near_corner + glm::vec2(0.0, half_size)), scale);
-      neighbors.r = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, far_corner - glm::vec2(0.0, half_size)) , scale);
-      neighbors.u = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, far_corner - glm::vec2(half_size, 0.0)) , scale);
-      neighbors.d = std::max(lod::lod_node::GetChunkStep(tree, base_scale, tree_res, near_corner + glm::vec2(half_size, 0.0)), scale);
+      SampleNeighbors(near_corner, far_corner, half_size, scale, sample);
     }
 
-    // deprecate :3
-    ChunkIdentifier(long x, long y, long tree_x, long tree_y, size_t chunk_size, size_t chunk_res, size_t tree_res, const lod::lod_node* tree) {
+    // SampleFunc: (tree-space sample point) -> size of the chunk at that point
+    template <typename SampleFunc>
+    void InitSized(long x, long y, long tree_x, long tree_y, size_t chunk_size, size_t chunk_res, SampleFunc sample) {
       this->x = x;
       this->y = y;
       this->size = chunk_size;
       this->chunk_res = chunk_res;
+      this->sample_dims = glm::u64vec2(chunk_res);
 
       // lod calculations
       glm::vec2 near_corner = glm::vec2(tree_x - 0.5f, tree_y - 0.5f);
@@ -131,25 +209,20 @@ namespace chunker {
 
       // take eight lod samples
       // figured it out - offset and tree no longer match!
-      neighbors.bl = std::max(lod::lod_node::GetChunkSize(tree, tree_res, near_corner)                           , chunk_size);
-      neighbors.tr = std::max(lod::lod_node::GetChunkSize(tree, tree_res, far_corner)                            , chunk_size);
-      neighbors.tl = std::max(lod::lod_node::GetChunkSize(tree, tree_res, glm::vec2(near_corner.x, far_corner.y)), chunk_size);
-      neighbors.br = std::max(lod::lod_node::GetChunkSize(tree, tree_res, glm::vec2(far_corner.x, near_corner.y)), chunk_size);
-      neighbors.l = std::max(lod::lod_node::GetChunkSize(tree, tree_res, near_corner + glm::vec2(0.0, half_size)), chunk_size);
-      neighbors.r = std::max(lod::lod_node::GetChunkSize(tree, tree_res, far_corner - glm::vec2(0.0, half_size)) , chunk_size);
-      neighbors.u = std::max(lod::lod_node::GetChunkSize(tree, tree_res, far_corner - glm::vec2(half_size, 0.0)) , chunk_size);
-      neighbors.d = std::max(lod::lod_node::GetChunkSize(tree, tree_res, near_corner + glm::vec2(half_size, 0.0)), chunk_size);
+      SampleNeighbors(near_corner, far_corner, half_size, chunk_size, sample);
     }
 
-    size_t GetStepSize() const {
-      return (size / chunk_res);
-    }
-
-    // tba: need specifiers for chunk edges
-    // (probably just eight ints specifying the chunk's eight neighbors as these are relevant for generation as well)
-
-    bool operator==(const ChunkIdentifier& rhs) const {
-      return (rhs.x == x && rhs.y == y && rhs.size == size && rhs.chunk_res == chunk_res && rhs.scale == scale && rhs.sample_dims == sample_dims && rhs.neighbors == neighbors);
+    // ValueType is a DyadicScale, or a (power of two) size - converted explicitly, so a bad size throws rather than truncating
+    template <typename ValueType, typename SampleFunc>
+    void SampleNeighbors(const glm::vec2& near_corner, const glm::vec2& far_corner, float half_size, const ValueType& own, SampleFunc sample) {
+      neighbors.bl = util::DyadicScale(std::max<ValueType>(sample(near_corner), own));
+      neighbors.tr = util::DyadicScale(std::max<ValueType>(sample(far_corner), own));
+      neighbors.tl = util::DyadicScale(std::max<ValueType>(sample(glm::vec2(near_corner.x, far_corner.y)), own));
+      neighbors.br = util::DyadicScale(std::max<ValueType>(sample(glm::vec2(far_corner.x, near_corner.y)), own));
+      neighbors.l = util::DyadicScale(std::max<ValueType>(sample(near_corner + glm::vec2(0.0, half_size)), own));
+      neighbors.r = util::DyadicScale(std::max<ValueType>(sample(far_corner - glm::vec2(0.0, half_size)), own));
+      neighbors.u = util::DyadicScale(std::max<ValueType>(sample(far_corner - glm::vec2(half_size, 0.0)), own));
+      neighbors.d = util::DyadicScale(std::max<ValueType>(sample(near_corner + glm::vec2(half_size, 0.0)), own));
     }
   };
 }
@@ -157,31 +230,32 @@ namespace chunker {
 namespace std {
   template<>
   struct hash<chunker::ChunkNeighbors> {
-    hash<chunker::util::Fraction> fract_hash;
+    hash<chunker::util::DyadicScale> scale_hash;
     size_t operator()(const chunker::ChunkNeighbors& n) const {
-      return (
-        fract_hash(n.l)
-        ^ fract_hash(n.r)
-        ^ fract_hash(n.u)
-        ^ fract_hash(n.d)
-        ^ fract_hash(n.tl)
-        ^ fract_hash(n.tr)
-        ^ fract_hash(n.bl)
-        ^ fract_hash(n.br)
-      );
+      // combined in order - xor would collide on every permutation of the same sizes
+      uint64_t res = scale_hash(n.l);
+      for (const chunker::util::DyadicScale* scale : { &n.r, &n.u, &n.d, &n.tl, &n.tr, &n.bl, &n.br }) {
+        res = chunker::util::HashCombine(res, scale_hash(*scale));
+      }
+
+      return static_cast<size_t>(res);
     }
   };
 
   template<>
   struct hash<chunker::ChunkIdentifier> {
-    std::hash<long> long_hash;
-    std::hash<size_t> size_t_hash;
-    std::hash<glm::u64vec2> vec_hash;
-    std::hash<chunker::util::Fraction> fract_hash;
+    std::hash<chunker::util::DyadicScale> scale_hash;
     std::hash<chunker::ChunkNeighbors> neighbor_hash;
     size_t operator()(const chunker::ChunkIdentifier& identifier) const {
-      // this is fine for now i think
-      return ((long_hash(identifier.x) ^ long_hash(identifier.y) + vec_hash(identifier.sample_dims)) * identifier.size ^ identifier.chunk_res) ^ fract_hash(identifier.scale) ^ neighbor_hash(identifier.neighbors);
+      using chunker::util::HashCombine;
+      uint64_t res = chunker::util::HashMix64(static_cast<uint64_t>(identifier.x));
+      res = HashCombine(res, static_cast<uint64_t>(identifier.y));
+      res = HashCombine(res, identifier.size);
+      res = HashCombine(res, identifier.chunk_res);
+      res = HashCombine(res, identifier.sample_dims.x);
+      res = HashCombine(res, identifier.sample_dims.y);
+      res = HashCombine(res, scale_hash(identifier.scale));
+      return static_cast<size_t>(HashCombine(res, neighbor_hash(identifier.neighbors)));
     }
   };
 }
@@ -0,0 +1,230 @@
+#ifndef CHUNK_KEY_H_
+#define CHUNK_KEY_H_
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/util/DyadicScale.hpp"
+#include "chunker/util/Hash.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace chunker {
+  /**
+   * @brief Packed, 32 byte form of a ChunkIdentifier, w a hash computed once on construction.
+   *
+   * Sizes, scales and neighbors are all powers of two, so they're stored as exponents:
+   * eight int8 neighbor exponents, and a u32 holding the scale exponent + 6 bit log2s of size, chunk_res and sample dims.
+   * Round-trips losslessly through Identifier() for any identifier the library produces. Identifiers from elsewhere
+   * (ie. a Chunker's) are checked - a size, chunk_res or sample dim which isn't zero or a power of two (below 2^63) throws,
+   * rather than packing to some other chunk's key. Use TryCreate to check without throwing.
+   *
+   * This is what the pool queues and caches by - generators still receive a full ChunkIdentifier.
+   */
+  class ChunkKey {
+  public:
+    ChunkKey() : ChunkKey(ChunkIdentifier()) {}
+
+    /**
+     * @brief throws std::invalid_argument if identifier can't be packed losslessly
+     */
+    explicit ChunkKey(const ChunkIdentifier& identifier) : x_(0), y_(0), neighbors_(), meta_(0), hash_(0) {
+      if (!Init(identifier)) {
+        throw std::invalid_argument("ChunkKey: size, chunk_res and sample dims must be zero or powers of two");
+      }
+    }
+
+    /**
+     * @return false if identifier can't be packed losslessly. output is untouched then
+     */
+    static bool TryCreate(const ChunkIdentifier& identifier, ChunkKey* output) {
+      ChunkKey res;
+      if (!res.Init(identifier)) {
+        return false;
+      }
+
+      *output = res;
+      return true;
+    }
+
+    /**
+     * @return ChunkIdentifier - the identifier this key was created from
+     */
+    ChunkIdentifier Identifier() const {
+      ChunkIdentifier res;
+      res.x = static_cast<long>(x_);
+      res.y = static_cast<long>(y_);
+      res.size = UnpackLog2(meta_ >> SIZE_SHIFT);
+      res.chunk_res = UnpackLog2(meta_ >> CHUNK_RES_SHIFT);
+      res.sample_dims = glm::u64vec2(UnpackLog2(meta_ >> SAMPLE_X_SHIFT), UnpackLog2(meta_ >> SAMPLE_Y_SHIFT));
+      res.scale = UnpackExponent(static_cast<int8_t>(meta_ & 0xFF));
+
+      ChunkNeighbors& n = res.neighbors;
+      util::DyadicScale* scales[NEIGHBOR_COUNT] = { &n.l, &n.r, &n.u, &n.d, &n.tl, &n.tr, &n.bl, &n.br };
+      for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+        *scales[i] = UnpackExponent(neighbors_[i]);
+      }
+
+      return res;
+    }
+
+    operator ChunkIdentifier() const {
+      return Identifier();
+    }
+
+    long X() const { return static_cast<long>(x_); }
+    long Y() const { return static_cast<long>(y_); }
+    size_t Size() const { return UnpackLog2(meta_ >> SIZE_SHIFT); }
+
+    /**
+     * @return size_t - precomputed hash of this key
+     */
+    size_t Hash() const {
+      return static_cast<size_t>(hash_);
+    }
+
+    bool operator==(const ChunkKey& rhs) const {
+      // hash goes first - mismatches almost always bail there
+      return (hash_ == rhs.hash_ && x_ == rhs.x_ && y_ == rhs.y_ && meta_ == rhs.meta_
+        && std::memcmp(neighbors_, rhs.neighbors_, sizeof(neighbors_)) == 0);
+    }
+
+    bool operator!=(const ChunkKey& rhs) const {
+      return !(*this == rhs);
+    }
+
+    // bytes written by Pack - everything but the hash, which Unpack recomputes
+    static const size_t PACKED_SIZE = 28;
+
+    /**
+     * @brief writes this key's fields to output, in host byte order. stable across runs, for naming things on disk.
+     * @param output - at least PACKED_SIZE bytes
+     */
+    void Pack(uint8_t* output) const {
+      std::memcpy(output, &x_, sizeof(x_));
+      std::memcpy(output + 8, &y_, sizeof(y_));
+      std::memcpy(output + 16, neighbors_, sizeof(neighbors_));
+      std::memcpy(output + 24, &meta_, sizeof(meta_));
+    }
+
+    /**
+     * @brief inverse of Pack
+     * @param data - PACKED_SIZE bytes
+     */
+    static ChunkKey Unpack(const uint8_t* data) {
+      ChunkKey res;
+      std::memcpy(&res.x_, data, sizeof(res.x_));
+      std::memcpy(&res.y_, data + 8, sizeof(res.y_));
+      std::memcpy(res.neighbors_, data + 16, sizeof(res.neighbors_));
+      std::memcpy(&res.meta_, data + 24, sizeof(res.meta_));
+      res.hash_ = res.ComputeHash();
+      return res;
+    }
+
+  private:
+    static const int NEIGHBOR_COUNT = 8;
+
+    // meta layout, low to high: scale exponent (8), log2 size (6), log2 chunk_res (6), log2 sample dims x / y (6 + 6)
+    static const int SIZE_SHIFT = 8;
+    static const int CHUNK_RES_SHIFT = 14;
+    static const int SAMPLE_X_SHIFT = 20;
+    static const int SAMPLE_Y_SHIFT = 26;
+    static const uint32_t LOG2_MASK = 0x3F;
+
+    // log2 code for zero
+    static const uint32_t LOG2_ZERO = LOG2_MASK;
+
+    // exponent code for zero
+    static const int8_t EXPONENT_ZERO = INT8_MIN;
+
+    // false leaves this key half written
+    bool Init(const ChunkIdentifier& identifier) {
+      uint32_t size, chunk_res, sample_x, sample_y;
+      if (!PackLog2(identifier.size, &size) || !PackLog2(identifier.chunk_res, &chunk_res)
+        || !PackLog2(identifier.sample_dims.x, &sample_x) || !PackLog2(identifier.sample_dims.y, &sample_y)) {
+        return false;
+      }
+
+      x_ = identifier.x;
+      y_ = identifier.y;
+
+      const ChunkNeighbors& n = identifier.neighbors;
+      const util::DyadicScale* scales[NEIGHBOR_COUNT] = { &n.l, &n.r, &n.u, &n.d, &n.tl, &n.tr, &n.bl, &n.br };
+      for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+        neighbors_[i] = PackExponent(*scales[i]);
+      }
+
+      meta_ = static_cast<uint8_t>(PackExponent(identifier.scale))
+        | (size << SIZE_SHIFT)
+        | (chunk_res << CHUNK_RES_SHIFT)
+        | (sample_x << SAMPLE_X_SHIFT)
+        | (sample_y << SAMPLE_Y_SHIFT);
+
+      hash_ = ComputeHash();
+      return true;
+    }
+
+    // DyadicScale keeps exponents within +-62, so they always fit
+    static_assert(util::DyadicScale::MAX_EXPONENT < INT8_MAX);
+
+    static int8_t PackExponent(const util::DyadicScale& scale) {
+      return (scale.IsZero() ? EXPONENT_ZERO : static_cast<int8_t>(scale.Exponent()));
+    }
+
+    static util::DyadicScale UnpackExponent(int8_t exponent) {
+      return (exponent == EXPONENT_ZERO ? util::DyadicScale::Zero() : util::DyadicScale::FromExponent(exponent));
+    }
+
+    // false unless value is zero or a power of two - anything else wouldn't round-trip
+    static bool PackLog2(uint64_t value, uint32_t* code) {
+      if (value == 0) {
+        *code = LOG2_ZERO;
+        return true;
+      }
+
+      if (!util::impl::IsPowerOfTwo(value)) {
+        return false;
+      }
+
+      // 2^63 would collide w zero's code
+      *code = static_cast<uint32_t>(util::impl::Log2PowerOfTwo(value));
+      return (*code != LOG2_ZERO);
+    }
+
+    static size_t UnpackLog2(uint32_t code) {
+      code &= LOG2_MASK;
+      return (code == LOG2_ZERO ? 0 : static_cast<size_t>(1) << code);
+    }
+
+    uint32_t ComputeHash() const {
+      uint64_t packed_neighbors;
+      std::memcpy(&packed_neighbors, neighbors_, sizeof(packed_neighbors));
+
+      uint64_t res = util::HashMix64(static_cast<uint64_t>(x_));
+      res = util::HashCombine(res, static_cast<uint64_t>(y_));
+      res = util::HashCombine(res, packed_neighbors);
+      res = util::HashCombine(res, meta_);
+      return static_cast<uint32_t>(res ^ (res >> 32));
+    }
+
+    int64_t x_;
+    int64_t y_;
+    int8_t neighbors_[NEIGHBOR_COUNT];
+    uint32_t meta_;
+    uint32_t hash_;
+  };
+
+  static_assert(sizeof(ChunkKey) == 32);
+}
+
+namespace std {
+  template<>
+  struct hash<chunker::ChunkKey> {
+    size_t operator()(const chunker::ChunkKey& key) const {
+      return key.Hash();
+    }
+  };
+}
+
+#endif // CHUNK_KEY_H_
@@ -3,13 +3,27 @@
 
 #include "chunker/traits/chunk_gen_type.hpp"
 #include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/lod/lod_neighborhood.hpp"
 #include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/ChunkPriority.hpp"
+#include "chunker/PipelineMetrics.hpp"
 
 #include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
 
 #include <glm/glm.hpp>
 
 #include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 // how to constrain chunk gen?
 // - type trait - we need a method which handles "generation" (accepting x/y and lod, returning returntype)
@@ -24,12 +38,69 @@
 
 namespace chunker {
   // takes responsibility for orchestrating chunk generation
-  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType>
+  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType, typename Cache = ChunkCache<ChunkType>>
   class ChunkManager {
-    typedef chunker::TypedChunkThreadPool<ChunkGenFactory, ChunkGenerator, ChunkType> PoolType;
+    typedef chunker::TypedChunkThreadPool<ChunkGenFactory, ChunkGenerator, ChunkType, Cache> PoolType;
     static_assert(chunker::traits::chunk_gen_type<ChunkGenerator, ChunkType>::value);
     static_assert(chunker::traits::chunk_gen_factory_type<ChunkGenFactory, ChunkGenerator>::value);
+
+    struct visible_chunk {
+      chunker::ChunkKey key;
+      std::shared_ptr<ChunkType> chunk;
+
+      // false until the chunk has been picked up from the pool
+      bool ready;
+    };
+
+    typedef std::unordered_map<uint64_t, visible_chunk> VisibleMap;
    public:
+    /**
+     * @brief iterates over the chunks covering the current tree. derefs to the chunk's shared_ptr, as the cache
+     * iterator begin()/end() used to return did - the visible set is a hash map now, so it only goes forward, in no
+     * particular order.
+     */
+    class iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using difference_type = std::ptrdiff_t;
+      using value_type = std::shared_ptr<ChunkType>;
+      using reference = std::shared_ptr<ChunkType>&;
+      using pointer = std::shared_ptr<ChunkType>*;
+
+      iterator() : itr_() {}
+      explicit iterator(typename VisibleMap::iterator itr) : itr_(itr) {}
+
+      iterator& operator++() {
+        ++itr_;
+        return *this;
+      }
+
+      iterator operator++(int) {
+        iterator stop(*this);
+        ++itr_;
+        return stop;
+      }
+
+      reference operator*() const {
+        return itr_->second.chunk;
+      }
+
+      pointer operator->() const {
+        return &itr_->second.chunk;
+      }
+
+      bool operator==(const iterator& other) const {
+        return itr_ == other.itr_;
+      }
+
+      bool operator!=(const iterator& other) const {
+        return !(itr_ == other.itr_);
+      }
+
+     private:
+      typename VisibleMap::iterator itr_;
+    };
+
     // tba: want some better LOD configuration (ie: constant LOD for generation for splats)
     // - putting that info in "cascade factor" makes sense
     // - add a flag to indicate LOD bias (default scale is 1:1, only decrease rn but eventually we can increase too)
@@ -42,6 +113,7 @@ namespace chunker {
      * @param max_gen_distance - the max distance to generate tiles from
      * @param min_chunk_size - min size, in units, of a given chunk
      * @param cascade_factor - rate at which to decrease LOD as we back away from player
+     * @param cache_budget - budget for cached chunks, in the cache's cost units (bytes by default, if the chunk has a ByteSize())
      */
     ChunkManager(
       std::shared_ptr<ChunkGenFactory> chunk_factory,
@@ -50,7 +122,8 @@ namespace chunker {
       size_t min_chunk_size,
       double cascade_factor,
       // tba: remove default
-      long lod_bias = 0
+      long lod_bias = 0,
+      size_t cache_budget = PoolType::DEFAULT_CACHE_BUDGET
     ) : factory(chunk_factory),
         gen_dist_(max_gen_distance),
         // ensure tree size is at least 4x the max gen distance
@@ -58,143 +131,618 @@ namespace chunker {
         min_chunk_size_(min_chunk_size),
         cascade_factor_(cascade_factor),
         last_tree_(nullptr),
+        last_offset_(0, 0),
         tree_gen_(tree_size_, min_chunk_size_ << std::min(-lod_bias, 0L)),
-        thread_pool_(thread_count, factory),
-        chunk_count_(0) 
+        prefetch_gen_(tree_size_, min_chunk_size_ << std::min(-lod_bias, 0L)),
+        thread_pool_(thread_count, factory, cache_budget),
+        chunk_count_(0),
+        nearest_first_(false),
+        facing_(false),
+        view_half_angle_(0.8),
+        streaming_(false),
+        prefetch_lookahead_(0.0),
+        prefetch_budget_(0)
     {
       tree_gen_.cascade_factor = cascade_factor;
+      prefetch_gen_.cascade_factor = cascade_factor;
     }
 
     bool UpdateChunkData(const glm::vec3& local_position) {
-      // figure out the generation center, based on origin
-      long nudge_factor = tree_size_ >> MAX_CHUNK_SIZE_FACTOR;
+      return Update(local_position, nullptr, nullptr);
+    }
+
+    /**
+     * @brief Updates for a viewer moving at velocity (units per second). With prefetch on, also queues up chunks around
+     * where the viewer will be after the lookahead set in SetPrefetch.
+     */
+    bool UpdateChunkData(const glm::vec3& local_position, const glm::vec3& velocity) {
+      glm::vec3 predicted = local_position + velocity * static_cast<float>(prefetch_lookahead_);
+      return Update(local_position, (prefetch_budget_ > 0 ? &predicted : nullptr), nullptr);
+    }
+
+    /**
+     * @brief Updates, prefetching around a predicted future position rather than one extrapolated from velocity.
+     */
+    bool UpdateChunkDataTowards(const glm::vec3& local_position, const glm::vec3& predicted_position) {
+      return Update(local_position, (prefetch_budget_ > 0 ? &predicted_position : nullptr), nullptr);
+    }
+
+    /**
+     * @brief Updates for a viewer looking along forward. Chunks inside the view cone (see SetViewCone) generate first,
+     * nearest first - chunks behind the viewer wait until they're done. Chunks already queued are reordered too, so
+     * turning around pulls what's now in view to the front w/o waiting on the tree to change.
+     * The cone only orders generation - chunks outside it are still generated, at the same LOD, just later. It doesn't
+     * depend on SetNearestFirst, which only picks the order for updates w/o a view direction.
+     *
+     * @param forward - view direction. only its xz part is used.
+     */
+    bool UpdateChunkDataFacing(const glm::vec3& local_position, const glm::vec3& forward) {
+      return Update(local_position, nullptr, &forward);
+    }
+
+    /**
+     * @brief Sets the half angle (radians) of the view cone used by UpdateChunkDataFacing. Defaults to 0.8 - a bit
+     * over 90 degrees of horizontal fov, w some slack for turning.
+     */
+    void SetViewCone(double half_angle) {
+      view_half_angle_ = half_angle;
+    }
+
+    /**
+     * @brief Prefetches chunks for the tree at a predicted viewer position, so they're cached by the time the viewer arrives.
+     * Prefetched chunks run behind every visible chunk, and never hold up begin(). Nearest the predicted position go first.
+     * Costs one extra tree build per update.
+     *
+     * @param lookahead - seconds ahead to extrapolate velocity, in UpdateChunkData(position, velocity)
+     * @param budget - max chunks newly queued for prefetch per update. 0 turns prefetching off.
+     */
+    void SetPrefetch(double lookahead, size_t budget) {
+      prefetch_lookahead_ = lookahead;
+      prefetch_budget_ = budget;
+    }
+
+    /**
+     * @brief Keeps split nodes split until the viewer is hysteresis * their threshold past it, rather than merging right at the threshold.
+     * Stops a viewer hovering on a cascade boundary from regenerating a ring of chunks every update. 0 (the default) turns it off.
+     */
+    void SetHysteresis(double hysteresis) {
+      tree_gen_.hysteresis = hysteresis;
+    }
+
+    /**
+     * @brief Splits tree construction across tbb tasks below the given number of levels. 0 builds serially.
+     * Trees under LodTreeGenerator::DEFAULT_PARALLEL_MIN_NODES nodes build serially regardless - forking costs more there.
+     */
+    void SetTreeParallelism(int levels) {
+      tree_gen_.parallel_levels = levels;
+      prefetch_gen_.parallel_levels = levels;
+    }
 
+    /**
+     * @brief Reports chunks as they finish, through PollReady. Off by default - finished chunks queue up until polled.
+     */
+    void SetStreaming(bool streaming) {
+      streaming_ = streaming;
+    }
+
+    /**
+     * @brief Picks up every visible chunk which has finished since the last poll, without blocking.
+     * Only chunks enqueued while streaming is on are reported.
+     *
+     * @param func - (const std::shared_ptr<ChunkType>&) -> void, called once per newly ready chunk
+     * @return size_t - number of chunks reported
+     */
+    template <typename Func>
+    size_t PollReady(Func&& func) {
+      size_t res = 0;
+      ready_queue_.Drain([&](std::pair<chunker::ChunkKey, std::shared_ptr<ChunkType>>& item) {
+        if (item.second == nullptr) {
+          // cancelled
+          return;
+        }
+
+        auto itr = visible_.find(LeafForKey(item.first));
+        if (itr == visible_.end() || itr->second.ready || itr->second.key != item.first) {
+          // picked up already, or no longer visible
+          return;
+        }
+
+        itr->second.chunk = item.second;
+        itr->second.ready = true;
+        func(itr->second.chunk);
+        res++;
+      });
+
+      return res;
+    }
+
+    /**
+     * @brief Generates chunks nearest the viewer first, finer LODs first on ties. Otherwise chunks generate in tree order.
+     * Updates w a view direction (UpdateChunkDataFacing) use the view cone either way.
+     */
+    void SetNearestFirst(bool nearest_first) {
+      nearest_first_ = nearest_first;
+
+      // facing - the view cone stays in place until the next update w/o a view direction
+      if (!nearest_first_ && !facing_) {
+        thread_pool_.SetPriority(nullptr);
+      }
+    }
+
+    size_t GetChunkCount() {
+      return chunk_count_;
+    }
+
+    /**
+     * @brief leaves enqueued, but not yet picked up by begin(). may include some already streamed through PollReady,
+     * or since dropped - these are pruned once they outnumber the visible set.
+     */
+    size_t GetPendingCount() {
+      return pending_.size();
+    }
+
+    /**
+     * @brief cost of chunks currently held by the cache (bytes, w the default cache and a chunk w a ByteSize())
+     */
+    size_t GetCacheUsage() {
+      return thread_pool_.CacheUsage();
+    }
+
+    /**
+     * @brief counts of generated, deduped and cancelled chunks - cancelled chunks were queued for a tree we've since moved past
+     */
+    GenerationStats GetGenerationStats() const {
+      return thread_pool_.Stats();
+    }
+
+    /**
+     * @brief snapshot of the pool's metrics (see TypedChunkThreadPool::Metrics), plus time spent per update building
+     * the tree and diffing it against the last one. safe to call from any thread, while updates run.
+     */
+    ChunkManagerMetrics GetMetrics() const {
+      return ChunkManagerMetrics { thread_pool_.Metrics(), tree_metrics_.Snapshot() };
+    }
+
+    /**
+     * @brief highest cache usage seen so far
+     */
+    size_t GetCacheHighWaterMark() {
+      return thread_pool_.CacheHighWaterMark();
+    }
+
+    /**
+     * @brief keeps chunks on disk in directory, behind the memory cache - see TypedChunkThreadPool::OpenDiskTier
+     */
+    void OpenDiskTier(const std::string& directory, size_t budget = PoolType::DEFAULT_DISK_BUDGET) {
+      thread_pool_.OpenDiskTier(directory, budget);
+    }
+
+    void wait() {
+      ResolvePending();
+    }
+
+    /**
+     * @brief iterates over the chunks covering the current tree. blocks until all of them are ready.
+     */
+    iterator begin() {
+      ResolvePending();
+      return iterator(visible_.begin());
+    }
+
+    iterator end() {
+      ResolvePending();
+      return iterator(visible_.end());
+    }
+
+   private:
+    static const long MAX_CHUNK_SIZE_FACTOR = 3;
+
+    // predicted is optional - where to prefetch around
+    // forward is optional - where the viewer is looking
+    bool Update(const glm::vec3& local_position, const glm::vec3* predicted, const glm::vec3* forward) {
       // relative to bottom left corner of tree
-      glm::vec3 relative_pos(local_position);
+      glm::vec3 relative_pos;
 
       // maintains offset of bottom left corner of tree
+      glm::ivec2 offset = TreeOffset(local_position, &relative_pos);
+
+      // if the tree moved, every chunk's world position moved with it
+      bool recentered = (offset != last_offset_);
+      CHUNKER_TRACE_SCOPE("tree", "update");
+      impl::Bump(tree_metrics_.updates, 1);
+      int64_t build_start = impl::NowNs();
+
+      // bias impl:
+      // - multiply min chunk size
+      // tree is owned by the generator - dropped on the next call unless retained.
+      // the last tree only lines up w this one if we haven't recentered - hysteresis needs it
+      chunker::lod::lod_node* tree = tree_gen_.CreateLodTree(relative_pos, MAX_CHUNK_SIZE_FACTOR, (recentered ? nullptr : last_tree_));
+
+      // flat copy of the tree - cheap to compare and diff, and used for neighbor lookups
+      linear_tree_.Build(tree, static_cast<size_t>(tree_size_));
+
+      // diff covers working out what changed, and patching the visible set to match
+      int64_t diff_start = impl::NowNs();
+      tree_metrics_.build.Record(diff_start - build_start);
+      CHUNKER_TRACE_SPAN("tree", "build", build_start, diff_start, util::TraceArgs());
+      if (last_tree_ != nullptr && !recentered) {
+        bool trees_equal = (linear_tree_ == last_linear_tree_);
+        if (trees_equal) {
+          int64_t diff_end = impl::NowNs();
+          tree_metrics_.diff.Record(diff_end - diff_start);
+          CHUNKER_TRACE_SPAN("tree", "diff", diff_start, diff_end, util::TraceArgs());
+
+          // nothing visible changed, but the prediction may have
+          if (predicted != nullptr) {
+            SelectPrefetch(*predicted, offset);
+
+            // cancel dropped prefetches now, rather than at the next tree change - only touches the dropped keys
+            if (!retired_.empty()) {
+              AdvanceEpoch();
+            }
+
+            thread_pool_.Prefetch(prefetch_keys_);
+          }
+
+          // or the view direction - reorder whatever's still queued
+          if (forward != nullptr && !thread_pool_.Empty()) {
+            ApplyPriority(local_position, forward);
+            thread_pool_.Reprioritize();
+          }
+
+          return true;
+        }
+
+        // only touch the leaves which changed
+        chunker::lod::LinearLodTree::Diff(last_linear_tree_, linear_tree_, &tree_diff_);
+        PatchChunks(offset);
+      } else {
+        // update chunks based on tree state
+        // manager will retain responsibility for stepping down the chunk tree
+        // pass offset to control how the genned chunks are offset
+        UpdateChunks(tree, offset);
+      }
+
+      int64_t diff_end = impl::NowNs();
+      tree_metrics_.diff.Record(diff_end - diff_start);
+      CHUNKER_TRACE_SPAN("tree", "diff", diff_start, diff_end, util::CountTraceArgs(visible_.size()));
+      chunk_count_ = visible_.size();
+      if (predicted != nullptr) {
+        SelectPrefetch(*predicted, offset);
+      } else {
+        retired_.insert(retired_.end(), prefetch_queued_.begin(), prefetch_queued_.end());
+        prefetch_queued_.clear();
+        prefetch_keys_.clear();
+      }
+
+      // visible chunks need to fit in cache until we've picked them up
+      thread_pool_.Reserve(chunk_count_ + prefetch_queued_.size());
+      ApplyPriority(local_position, forward);
+
+      AdvanceEpoch();
+      FlushEnqueued();
+      thread_pool_.Prefetch(prefetch_keys_);
+
+      // streaming callers may never call begin() to drain pending_ - keep it to about the visible set
+      if (pending_.size() > 2 * visible_.size()) {
+        PrunePending();
+      }
+
+      tree_gen_.RetainTree();
+      last_tree_ = tree;
+      last_offset_ = offset;
+      std::swap(linear_tree_, last_linear_tree_);
+      return false;
+    }
+
+    // picks how newly queued chunks are ordered
+    void ApplyPriority(const glm::vec3& local_position, const glm::vec3* forward) {
+      if (forward != nullptr) {
+        // anything in view beats anything out of view
+        double penalty = static_cast<double>(tree_size_) * 2.0;
+        thread_pool_.SetPriority(ViewConePriority::Facing(local_position.x, local_position.z, forward->x, forward->z, view_half_angle_, penalty));
+      } else if (nearest_first_) {
+        thread_pool_.SetViewer(local_position);
+      } else if (facing_) {
+        thread_pool_.SetPriority(nullptr);
+      }
+
+      facing_ = (forward != nullptr);
+    }
+
+    /**
+     * @brief figures out where the tree sits for a given viewer position
+     *
+     * @param local_position - viewer position
+     * @param relative_pos - output - viewer position relative to the bottom left corner of the tree
+     * @return glm::ivec2 - bottom left corner of the tree
+     */
+    glm::ivec2 TreeOffset(const glm::vec3& local_position, glm::vec3* relative_pos) const {
+      // figure out the generation center, based on origin
+      long nudge_factor = tree_size_ >> MAX_CHUNK_SIZE_FACTOR;
+      *relative_pos = local_position;
       glm::ivec2 offset(0, 0);
 
-      while (relative_pos.x > nudge_factor) {
-        relative_pos.x -= nudge_factor;
+      while (relative_pos->x > nudge_factor) {
+        relative_pos->x -= nudge_factor;
         offset.x += nudge_factor;
       }
 
-      while (relative_pos.x < -nudge_factor) {
-        relative_pos.x += nudge_factor;
+      while (relative_pos->x < -nudge_factor) {
+        relative_pos->x += nudge_factor;
         offset.x -= nudge_factor;
       }
 
-      while (relative_pos.z > nudge_factor) {
-        relative_pos.z -= nudge_factor;
+      while (relative_pos->z > nudge_factor) {
+        relative_pos->z -= nudge_factor;
         offset.y += nudge_factor;
       }
 
-      while (relative_pos.z < -nudge_factor) {
-        relative_pos.z += nudge_factor;
+      while (relative_pos->z < -nudge_factor) {
+        relative_pos->z += nudge_factor;
         offset.y -= nudge_factor;
       }
 
       // we need to recenter relative pos within the tree
-
       long half_size = tree_size_ / 2;
 
-      relative_pos.x += half_size;
-      relative_pos.z += half_size;
+      relative_pos->x += half_size;
+      relative_pos->z += half_size;
 
       // recenter - this tracks bottom left corner of the tree now
       offset.x -= half_size;
       offset.y -= half_size;
+      return offset;
+    }
 
-      
-      // bias impl:
-      // - multiply min chunk size
-      chunker::lod::lod_node* tree = tree_gen_.CreateLodTree(relative_pos, MAX_CHUNK_SIZE_FACTOR);
-      if (last_tree_ != nullptr) {
-        bool trees_equal = chunker::lod::lod_node::CompareTrees(tree, last_tree_);
-        if (trees_equal) {
-          chunker::lod::lod_node::lod_node_free(tree);
-          return true;
+    /**
+     * @brief builds the tree at predicted, and picks the leaves to prefetch - those not visible or cached already, nearest
+     * predicted first. fills prefetch_keys_ w up to prefetch_budget_ new keys, and prefetch_queued_ w everything
+     * prefetched which should stay queued.
+     *
+     * @param offset - offset of the current tree, which visible_ is built against
+     */
+    void SelectPrefetch(const glm::vec3& predicted, const glm::ivec2 offset) {
+      glm::vec3 relative_pos;
+      glm::ivec2 predicted_offset = TreeOffset(predicted, &relative_pos);
+      prefetch_tree_.Build(prefetch_gen_.CreateLodTree(relative_pos, MAX_CHUNK_SIZE_FACTOR), static_cast<size_t>(tree_size_));
+
+      ViewerDistancePriority priority { predicted.x, predicted.z };
+      prefetch_candidates_.clear();
+      for (uint64_t leaf : prefetch_tree_.Leaves()) {
+        chunker::ChunkKey key(CreateIdentifier(prefetch_tree_, leaf, predicted_offset));
+        auto itr = visible_.find(LeafForKey(key, linear_tree_, offset));
+        if ((itr != visible_.end() && itr->second.key == key) || thread_pool_.HasChunk(key)) {
+          continue;
         }
+
+        prefetch_candidates_.emplace_back(priority(key), key);
       }
 
-      // update chunks based on tree state
-      // manager will retain responsibility for stepping down the chunk tree
-      // pass offset to control how the genned chunks are offset
-      UpdateChunks(tree, offset);
-      chunker::lod::lod_node::lod_node_free(last_tree_);
-      last_tree_ = tree;
-      return false;
+      std::sort(prefetch_candidates_.begin(), prefetch_candidates_.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+      });
+
+      // still queued from an earlier update - keep, w/o spending budget on them
+      prefetch_keys_.clear();
+      prefetch_kept_.clear();
+      for (auto& candidate : prefetch_candidates_) {
+        if (prefetch_queued_.count(candidate.second) != 0) {
+          prefetch_kept_.insert(candidate.second);
+        } else if (prefetch_keys_.size() < prefetch_budget_) {
+          prefetch_keys_.push_back(candidate.second);
+          prefetch_kept_.insert(candidate.second);
+        }
+      }
+
+      // dropped prefetches - if one's visible now, enqueueing it revives it
+      for (auto& key : prefetch_queued_) {
+        if (prefetch_kept_.count(key) == 0) {
+          retired_.push_back(key);
+        }
+      }
+
+      std::swap(prefetch_queued_, prefetch_kept_);
     }
 
-    size_t GetChunkCount() {
-      return chunk_count_;
+    // rebuilds the visible set from scratch
+    void UpdateChunks(const chunker::lod::lod_node* tree, const glm::ivec2 offset) {
+      // prep thread pool
+      // specify offset
+      // specify current node size
+      // pass in the whole tree (for tree gen)
+      visible_.clear();
+      pending_.clear();
+      rebuilt_ = true;
+      size_t node_size = static_cast<size_t>(tree_size_);
+      UpdateChunks_Recurse(offset.x, offset.y, 0, 0, node_size, tree, chunker::lod::lod_neighborhood::Root(tree));
     }
 
-    void wait() {
-      thread_pool_.Wait();
+    // patches the visible set using tree_diff_
+    void PatchChunks(const glm::ivec2 offset) {
+      for (uint64_t leaf : tree_diff_.removed) {
+        auto itr = visible_.find(leaf);
+        retired_.push_back(itr->second.key);
+        visible_.erase(itr);
+      }
+
+      for (uint64_t leaf : tree_diff_.added) {
+        AddChunk(leaf, chunker::ChunkKey(CreateIdentifier(leaf, offset)));
+      }
+
+      // leaves which stayed put, but whose neighbors may have changed lod
+      for (uint64_t leaf : tree_diff_.touched) {
+        chunker::ChunkKey key(CreateIdentifier(leaf, offset));
+        visible_chunk& entry = visible_.at(leaf);
+        if (entry.key != key) {
+          retired_.push_back(entry.key);
+          AddChunk(leaf, key);
+        }
+      }
+    }
+
+    chunker::ChunkIdentifier CreateIdentifier(uint64_t leaf, const glm::ivec2 offset) {
+      return CreateIdentifier(linear_tree_, leaf, offset);
+    }
+
+    chunker::ChunkIdentifier CreateIdentifier(const chunker::lod::LinearLodTree& tree, uint64_t leaf, const glm::ivec2 offset) {
+      glm::ivec2 origin = tree.LeafOrigin(leaf);
+      size_t size = tree.LeafSize(leaf);
+      return chunker::ChunkIdentifier(offset.x + origin.x, offset.y + origin.y, origin.x, origin.y, size, min_chunk_size_, tree);
+    }
+
+    void AddChunk(uint64_t leaf, const chunker::ChunkKey& key) {
+      visible_chunk& entry = visible_[leaf];
+      entry.key = key;
+      entry.chunk = nullptr;
+      entry.ready = false;
+      pending_.push_back(leaf);
+      enqueued_.push_back(key);
     }
 
-    typename PoolType::CacheType::iterator begin() {
-      if (!thread_pool_.Empty()) {
+    // picks up finished chunks for every pending leaf
+    void ResolvePending() {
+      CHUNKER_TRACE_SCOPE("manager", "resolve_pending");
+      while (!pending_.empty()) {
         thread_pool_.Wait();
+
+        missed_.clear();
+        for (uint64_t leaf : pending_) {
+          auto itr = visible_.find(leaf);
+          if (itr == visible_.end() || itr->second.ready) {
+            // dropped from the tree, or duplicate
+            continue;
+          }
+
+          visible_chunk& entry = itr->second;
+          if (thread_pool_.FetchChunk(entry.key, &entry.chunk)) {
+            entry.ready = true;
+          } else {
+            // evicted before we got to it - generate it again
+            enqueued_.push_back(entry.key);
+            missed_.push_back(leaf);
+          }
+        }
+
+        std::swap(pending_, missed_);
+        FlushEnqueued();
       }
+    }
 
-      return thread_pool_.BoundedIterator(chunk_count_);
+    // drops pending leaves which are ready (ie. streamed through PollReady) or gone, and duplicates
+    void PrunePending() {
+      pending_.erase(std::remove_if(pending_.begin(), pending_.end(), [&](uint64_t leaf) {
+        auto itr = visible_.find(leaf);
+        return (itr == visible_.end() || itr->second.ready);
+      }), pending_.end());
+
+      std::sort(pending_.begin(), pending_.end());
+      pending_.erase(std::unique(pending_.begin(), pending_.end()), pending_.end());
     }
 
-    typename PoolType::CacheType::iterator end() {
-      if (!thread_pool_.Empty()) {
-        thread_pool_.Wait();
+    // queued work from older trees is dropped, unless it's still visible.
+    // patched trees only retire the keys they dropped - O(changed). a rebuilt tree publishes the whole live set, as does
+    // a patch once more keys have been retired than are visible, which keeps the retired set (and this) amortized O(changed)
+    void AdvanceEpoch() {
+      bool rebuilt = rebuilt_;
+      rebuilt_ = false;
+      if (thread_pool_.Empty()) {
+        // nothing older is queued
+        thread_pool_.AdvanceEpoch(nullptr);
+        retired_.clear();
+        return;
+      }
+
+      if (!rebuilt && thread_pool_.RetiredCount() + retired_.size() <= visible_.size()) {
+        // kept prefetches aren't enqueued again, so nothing would revive them
+        retired_.erase(std::remove_if(retired_.begin(), retired_.end(), [&](const chunker::ChunkKey& key) {
+          return prefetch_queued_.count(key) != 0;
+        }), retired_.end());
+
+        thread_pool_.AdvanceEpoch(retired_);
+        retired_.clear();
+        return;
+      }
+
+      retired_.clear();
+      auto live = std::make_shared<GenerationEpoch::LiveSet>();
+      live->reserve(visible_.size() + prefetch_queued_.size());
+      for (auto& entry : visible_) {
+        live->insert(entry.second.key);
       }
-      
-      return thread_pool_.End();
+
+      // prefetches we still want - anything else prefetched is dropped
+      live->insert(prefetch_queued_.begin(), prefetch_queued_.end());
+
+      thread_pool_.AdvanceEpoch(std::move(live));
     }
 
-   private:
-    static const long MAX_CHUNK_SIZE_FACTOR = 3;
+    // hands the batch of keys built up by AddChunk / ResolvePending to the pool in one go
+    void FlushEnqueued() {
+      thread_pool_.EnqueueBulk(enqueued_, streaming_ ? PoolType::PushTo(ready_queue_) : nullptr);
+      enqueued_.clear();
+    }
 
-    void UpdateChunks(const chunker::lod::lod_node* tree, const glm::ivec2 offset) {
-      // prep thread pool
-      // specify offset
-      // specify current node size
-      // pass in the whole tree (for tree gen)
-      size_t node_size = static_cast<size_t>(tree_size_);
-      // tba: cache chunk count somewhere
-      // (alt: we obviously can't generate index data here!!)
-      chunk_count_ = UpdateChunks_Recurse(offset.x, offset.y, 0, 0, node_size, tree, tree);
-      thread_pool_.Wake();
+    // packed leaf a key was created for, against the current tree. keys from other trees map to leaves which won't match.
+    // only valid between updates - the current tree is in last_linear_tree_ by then
+    uint64_t LeafForKey(const chunker::ChunkKey& key) const {
+      return LeafForKey(key, last_linear_tree_, last_offset_);
+    }
+
+    // as above, against tree sitting at offset
+    uint64_t LeafForKey(const chunker::ChunkKey& key, const chunker::lod::LinearLodTree& tree, const glm::ivec2 offset) const {
+      long x = key.X() - offset.x;
+      long y = key.Y() - offset.y;
+      size_t size = key.Size();
+      if (tree.TreeRes() == 0 || x < 0 || y < 0 || x >= tree_size_ || y >= tree_size_ || size == 0 || size > static_cast<size_t>(tree_size_)) {
+        return UINT64_MAX;
+      }
+
+      int depth = 0;
+      while ((static_cast<size_t>(tree_size_) >> depth) > size) {
+        depth++;
+      }
+
+      return tree.MakeLeaf(glm::ivec2(static_cast<int>(x), static_cast<int>(y)), depth);
     }
 
     // offsets are world space
-    size_t UpdateChunks_Recurse(
+    // neighborhood tracks the nodes around this one, so leaves can read off their neighbors' lods directly
+    void UpdateChunks_Recurse(
       long offset_x,
       long offset_y,
       long tree_x,
       long tree_y,
       size_t node_size,
       const chunker::lod::lod_node* node,
-      const chunker::lod::lod_node* tree
+      const chunker::lod::lod_neighborhood& neighborhood
     ) {
       if (node->tl == nullptr) {
         // no children - generate this node
         // need to encode origin of tree
-        chunker::ChunkIdentifier identifier(offset_x, offset_y, tree_x, tree_y, node_size, min_chunk_size_, tree_size_, tree);
-        thread_pool_.Enqueue(identifier);
-        // enqueue
-        return 1;
+        size_t tree_res = static_cast<size_t>(tree_size_);
+        chunker::ChunkNeighbors neighbors;
+        neighbors.bl = util::DyadicScale(neighborhood.GetNeighborSize(-1, -1, tree_x, tree_y, node_size, tree_res));
+        neighbors.tr = util::DyadicScale(neighborhood.GetNeighborSize( 1,  1, tree_x, tree_y, node_size, tree_res));
+        neighbors.tl = util::DyadicScale(neighborhood.GetNeighborSize(-1,  1, tree_x, tree_y, node_size, tree_res));
+        neighbors.br = util::DyadicScale(neighborhood.GetNeighborSize( 1, -1, tree_x, tree_y, node_size, tree_res));
+        neighbors.l  = util::DyadicScale(neighborhood.GetNeighborSize(-1,  0, tree_x, tree_y, node_size, tree_res));
+        neighbors.r  = util::DyadicScale(neighborhood.GetNeighborSize( 1,  0, tree_x, tree_y, node_size, tree_res));
+        neighbors.u  = util::DyadicScale(neighborhood.GetNeighborSize( 0,  1, tree_x, tree_y, node_size, tree_res));
+        neighbors.d  = util::DyadicScale(neighborhood.GetNeighborSize( 0, -1, tree_x, tree_y, node_size, tree_res));
+
+        chunker::ChunkIdentifier identifier(offset_x, offset_y, node_size, min_chunk_size_, neighbors);
+        AddChunk(linear_tree_.MakeLeaf(glm::ivec2(tree_x, tree_y), neighborhood.depths[1][1]), chunker::ChunkKey(identifier));
       } else {
         assert(node->tr != nullptr);
         assert(node->bl != nullptr);
         assert(node->br != nullptr);
         long half_size = node_size >> 1;
 
-        size_t chunk_count = 0;
-        chunk_count += UpdateChunks_Recurse(offset_x,             offset_y,             tree_x,             tree_y,             half_size, node->bl, tree);
-        chunk_count += UpdateChunks_Recurse(offset_x + half_size, offset_y,             tree_x + half_size, tree_y,             half_size, node->br, tree);
-        chunk_count += UpdateChunks_Recurse(offset_x,             offset_y + half_size, tree_x,             tree_y + half_size, half_size, node->tl, tree);
-        chunk_count += UpdateChunks_Recurse(offset_x + half_size, offset_y + half_size, tree_x + half_size, tree_y + half_size, half_size, node->tr, tree);
-        return chunk_count;
+        UpdateChunks_Recurse(offset_x,             offset_y,             tree_x,             tree_y,             half_size, node->bl, neighborhood.Descend(0, 0));
+        UpdateChunks_Recurse(offset_x + half_size, offset_y,             tree_x + half_size, tree_y,             half_size, node->br, neighborhood.Descend(1, 0));
+        UpdateChunks_Recurse(offset_x,             offset_y + half_size, tree_x,             tree_y + half_size, half_size, node->tl, neighborhood.Descend(0, 1));
+        UpdateChunks_Recurse(offset_x + half_size, offset_y + half_size, tree_x + half_size, tree_y + half_size, half_size, node->tr, neighborhood.Descend(1, 1));
       }
     }
 
@@ -204,14 +752,62 @@ namespace chunker {
     size_t min_chunk_size_;
     double cascade_factor_;
 
-    // mem leak here lole
+    // owned by tree_gen_ (retained buffer)
     chunker::lod::lod_node* last_tree_ = nullptr;
+    chunker::lod::LinearLodTree last_linear_tree_;
+
+    glm::ivec2 last_offset_;
+
+    // scratch - holds the tree being built
+    chunker::lod::LinearLodTree linear_tree_;
+    chunker::lod::LodTreeDiff tree_diff_;
     chunker::lod::LodTreeGenerator tree_gen_;
-    chunker::TypedChunkThreadPool<ChunkGenFactory, ChunkGenerator, ChunkType> thread_pool_;
+
+    // trees at the predicted viewer position - kept apart, so they never clobber the retained tree
+    chunker::lod::LodTreeGenerator prefetch_gen_;
+    chunker::lod::LinearLodTree prefetch_tree_;
+
+    // workers push into this - declared before the pool, so it outlives the pool's threads
+    typename PoolType::ReadyQueue ready_queue_;
+    PoolType thread_pool_;
 
     size_t chunk_count_;
+    bool nearest_first_;
+
+    // build / diff times per update
+    impl::TreeUpdateCounters tree_metrics_;
+
+    // true while chunks are ordered by view cone
+    bool facing_;
+    double view_half_angle_;
+    bool streaming_;
+
+    // chunks covering the current tree, keyed by packed leaf
+    VisibleMap visible_;
+
+    // leaves whose chunks have been enqueued, but not picked up yet
+    std::vector<uint64_t> pending_;
+    std::vector<uint64_t> missed_;
+
+    // keys waiting to be handed to the pool
+    std::vector<chunker::ChunkKey> enqueued_;
+
+    // keys dropped since the last epoch - see AdvanceEpoch
+    std::vector<chunker::ChunkKey> retired_;
+
+    // visible set was rebuilt from scratch since the last epoch
+    bool rebuilt_ = false;
+
+    double prefetch_lookahead_;
+    size_t prefetch_budget_;
+
+    // prefetched keys still wanted - kept alive across epochs
+    std::unordered_set<chunker::ChunkKey> prefetch_queued_;
 
-    // tba: need a thread pool
+    // scratch for SelectPrefetch
+    std::unordered_set<chunker::ChunkKey> prefetch_kept_;
+    std::vector<std::pair<ChunkPriority, chunker::ChunkKey>> prefetch_candidates_;
+    std::vector<chunker::ChunkKey> prefetch_keys_;
   };
 }
 
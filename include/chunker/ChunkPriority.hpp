@@ -0,0 +1,140 @@
+#ifndef CHUNK_PRIORITY_H_
+#define CHUNK_PRIORITY_H_
+
+#include "chunker/ChunkKey.hpp"
+#include "chunker/VolumeChunkKey.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief urgency of a queued chunk - lower runs sooner.
+   * orders by distance first, then by size, so finer LODs win ties.
+   */
+  struct ChunkPriority {
+    double distance;
+    size_t size;
+
+    bool operator<(const ChunkPriority& rhs) const {
+      if (distance != rhs.distance) {
+        return (distance < rhs.distance);
+      }
+
+      return (size < rhs.size);
+    }
+
+    bool operator==(const ChunkPriority& rhs) const {
+      return (distance == rhs.distance && size == rhs.size);
+    }
+  };
+
+  /**
+   * @brief default priority - distance on the xz plane from a viewer to the nearest point of a chunk.
+   * zero for the chunk(s) under the viewer, so those fall back on size.
+   */
+  struct ViewerDistancePriority {
+    double viewer_x;
+    double viewer_z;
+
+    ChunkPriority operator()(const ChunkKey& key) const {
+      double size = static_cast<double>(key.Size());
+      double dx = std::max({ static_cast<double>(key.X()) - viewer_x, 0.0, viewer_x - (static_cast<double>(key.X()) + size) });
+      double dz = std::max({ static_cast<double>(key.Y()) - viewer_z, 0.0, viewer_z - (static_cast<double>(key.Y()) + size) });
+      return ChunkPriority { std::sqrt(dx * dx + dz * dz), key.Size() };
+    }
+  };
+
+  /**
+   * @brief ViewerDistancePriority, w chunks outside the viewer's view cone pushed back by a fixed distance.
+   * the cone is on the xz plane - chunks have no height. chunks overlapping the viewer always count as in view.
+   */
+  struct ViewConePriority {
+    ViewerDistancePriority distance;
+
+    // unit length, on the xz plane. zero treats every chunk as in view
+    double forward_x;
+    double forward_z;
+
+    // radians, from forward to the edge of the view
+    double half_angle;
+
+    // added to the distance of out of view chunks. larger than any distance in the tree puts every chunk in view first
+    double out_of_view_penalty;
+
+    /**
+     * @param forward_x, forward_z - view direction on the xz plane. needn't be normalized.
+     */
+    static ViewConePriority Facing(double viewer_x, double viewer_z, double forward_x, double forward_z, double half_angle, double out_of_view_penalty) {
+      double length = std::sqrt(forward_x * forward_x + forward_z * forward_z);
+      if (length > 0.0) {
+        forward_x /= length;
+        forward_z /= length;
+      }
+
+      return ViewConePriority { ViewerDistancePriority { viewer_x, viewer_z }, forward_x, forward_z, half_angle, out_of_view_penalty };
+    }
+
+    // tests the chunk's bounding circle against the cone
+    bool InView(const ChunkKey& key) const {
+      double half_size = static_cast<double>(key.Size()) * 0.5;
+      double to_x = static_cast<double>(key.X()) + half_size - distance.viewer_x;
+      double to_z = static_cast<double>(key.Y()) + half_size - distance.viewer_z;
+      double center_dist = std::sqrt(to_x * to_x + to_z * to_z);
+      double radius = half_size * std::sqrt(2.0);
+      if (center_dist <= radius || (forward_x == 0.0 && forward_z == 0.0)) {
+        return true;
+      }
+
+      double cos_angle = std::clamp((to_x * forward_x + to_z * forward_z) / center_dist, -1.0, 1.0);
+      return (std::acos(cos_angle) <= half_angle + std::asin(radius / center_dist));
+    }
+
+    ChunkPriority operator()(const ChunkKey& key) const {
+      ChunkPriority res = distance(key);
+      if (!InView(key)) {
+        res.distance += out_of_view_penalty;
+      }
+
+      return res;
+    }
+  };
+
+  /**
+   * @brief distance to whichever of several viewers is nearest - for a pool shared between them
+   */
+  struct NearestViewerPriority {
+    std::vector<ViewerDistancePriority> viewers;
+
+    ChunkPriority operator()(const ChunkKey& key) const {
+      ChunkPriority res { std::numeric_limits<double>::infinity(), key.Size() };
+      for (auto& viewer : viewers) {
+        res = std::min(res, viewer(key));
+      }
+
+      return res;
+    }
+  };
+
+  /**
+   * @brief ViewerDistancePriority for volume chunks - full 3D distance from the viewer to the nearest point of a chunk
+   */
+  struct VolumeDistancePriority {
+    double viewer_x;
+    double viewer_y;
+    double viewer_z;
+
+    ChunkPriority operator()(const VolumeChunkKey& key) const {
+      double size = static_cast<double>(key.Size());
+      double dx = std::max({ static_cast<double>(key.X()) - viewer_x, 0.0, viewer_x - (static_cast<double>(key.X()) + size) });
+      double dy = std::max({ static_cast<double>(key.Y()) - viewer_y, 0.0, viewer_y - (static_cast<double>(key.Y()) + size) });
+      double dz = std::max({ static_cast<double>(key.Z()) - viewer_z, 0.0, viewer_z - (static_cast<double>(key.Z()) + size) });
+      return ChunkPriority { std::sqrt(dx * dx + dy * dy + dz * dz), key.Size() };
+    }
+  };
+}
+
+#endif // CHUNK_PRIORITY_H_
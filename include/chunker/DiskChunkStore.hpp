@@ -0,0 +1,471 @@
+#ifndef DISK_CHUNK_STORE_H_
+#define DISK_CHUNK_STORE_H_
+
+#include "chunker/ChunkKey.hpp"
+#include "chunker/traits/chunk_serializer.hpp"
+#include "chunker/util/LRUCache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief on-disk chunk cache tier - one file per chunk in a local directory, named after its packed ChunkKey.
+   *
+   * All file I/O happens on the store's own thread: WriteBack only queues chunks to be serialized and written, and
+   * LoadAsync queues a read, handing the chunk back through a callback. Reads go ahead of writes. Keys already on disk
+   * are indexed in memory, so a miss never touches the disk, and chunks still waiting to be written are served straight
+   * from the queue.
+   *
+   * The store is budgeted in bytes on disk. Once a write puts it over, the least recently written or loaded files are
+   * deleted until it fits again.
+   *
+   * Files are written to a temp name and renamed into place, so a crash never leaves a partial chunk behind.
+   *
+   * @tparam ChunkType - chunk type. must be traits::chunk_serializable
+   * @tparam KeyType - key chunks are stored under. needs Pack / Unpack and PACKED_SIZE, like ChunkKey
+   */
+  template <typename ChunkType, typename Serializer = traits::chunk_serializer<ChunkType>, typename KeyType = ChunkKey>
+  class DiskChunkStore {
+  public:
+    typedef std::vector<std::pair<KeyType, std::shared_ptr<ChunkType>>> ChunkList;
+
+    // (chunk) - nullptr if the file couldn't be read back
+    typedef std::function<void(const std::shared_ptr<ChunkType>&)> LoadCallback;
+
+    // 4GiB
+    static constexpr size_t DEFAULT_BUDGET = static_cast<size_t>(4) << 30;
+
+    /**
+     * @param directory - created if it doesn't exist. chunks already in it are picked up, newest kept if they're over budget.
+     * @param budget - bytes of chunk files to keep on disk
+     */
+    explicit DiskChunkStore(const std::string& directory, size_t budget = DEFAULT_BUDGET)
+      : directory_(directory), on_disk_(budget), written_(0), failed_(0), evicted_(0), writing_(false), stop_(false) {
+      // here rather than on the class, so pools of unserializable chunks can still hold a (null) store
+      static_assert(traits::chunk_serializable<ChunkType>::value, "chunk type needs a traits::chunk_serializer");
+      std::error_code err;
+      std::filesystem::create_directories(directory_, err);
+      LoadIndex();
+      writer_ = std::thread(&DiskChunkStore::WriterFunc, this);
+    }
+
+    DiskChunkStore(const DiskChunkStore& other) = delete;
+    DiskChunkStore& operator=(const DiskChunkStore& other) = delete;
+
+    // finishes any queued reads and writes first
+    ~DiskChunkStore() {
+      {
+        std::lock_guard lock(lock_);
+        stop_ = true;
+      }
+
+      write_cond_.notify_all();
+      writer_.join();
+    }
+
+    /**
+     * @brief fetches a chunk from the write queue, or from disk. reads the file on the calling thread - see LoadAsync.
+     *
+     * @param key - key to look up
+     * @param output - output param for the chunk
+     * @return true if the chunk was found and read back
+     * @return false otherwise
+     */
+    bool Load(const KeyType& key, std::shared_ptr<ChunkType>* output) {
+      {
+        std::lock_guard lock(lock_);
+        auto itr = pending_.find(key);
+        if (itr != pending_.end()) {
+          *output = itr->second;
+          return true;
+        }
+
+        if (!on_disk_.Refresh(key)) {
+          return false;
+        }
+      }
+
+      return ReadChunk(key, output);
+    }
+
+    /**
+     * @brief reads a chunk back on the store's thread, then calls done from it. chunks still queued for writing are
+     * handed to done right away, on the calling thread. unreadable files are dropped, and done receives nullptr.
+     *
+     * @param key - key to look up
+     * @param done - called once, unless this returns false
+     * @return false if key isn't stored - done isn't called
+     */
+    bool LoadAsync(const KeyType& key, LoadCallback done) {
+      std::shared_ptr<ChunkType> queued;
+      {
+        std::lock_guard lock(lock_);
+        auto itr = pending_.find(key);
+        if (itr != pending_.end()) {
+          queued = itr->second;
+        } else if (on_disk_.Refresh(key)) {
+          reads_.emplace_back(key, std::move(done));
+        } else {
+          return false;
+        }
+      }
+
+      if (queued != nullptr) {
+        done(queued);
+      } else {
+        write_cond_.notify_one();
+      }
+
+      return true;
+    }
+
+    bool Has(const KeyType& key) {
+      std::lock_guard lock(lock_);
+      return (pending_.count(key) != 0 || on_disk_.Has(key));
+    }
+
+    /**
+     * @brief queues chunks to be written. skips nulls, and keys which are already on disk or queued.
+     * @param chunks - chunks to write. left empty.
+     */
+    void WriteBack(ChunkList& chunks) {
+      bool queued = false;
+      {
+        std::lock_guard lock(lock_);
+        for (auto& item : chunks) {
+          if (item.second == nullptr || on_disk_.Has(item.first)) {
+            continue;
+          }
+
+          if (pending_.emplace(item.first, item.second).second) {
+            queue_.push_back(std::move(item));
+            queued = true;
+          }
+        }
+      }
+
+      chunks.clear();
+      if (queued) {
+        write_cond_.notify_one();
+      }
+    }
+
+    /**
+     * @brief blocks until every chunk queued so far is written, and every queued read is handed back
+     */
+    void Flush() {
+      std::unique_lock lock(lock_);
+      flush_cond_.wait(lock, [&] { return queue_.empty() && reads_.empty() && !writing_; });
+    }
+
+    // chunks on disk, or queued to be
+    size_t Size() {
+      std::lock_guard lock(lock_);
+      return on_disk_.Size() + pending_.size();
+    }
+
+    // bytes of chunk files on disk
+    size_t Usage() {
+      return on_disk_.Usage();
+    }
+
+    size_t Budget() {
+      return on_disk_.Capacity();
+    }
+
+    // chunks written since construction
+    size_t Written() const {
+      return written_.load(std::memory_order_relaxed);
+    }
+
+    // writes which failed, and were dropped
+    size_t Failed() const {
+      return failed_.load(std::memory_order_relaxed);
+    }
+
+    // files deleted to stay within budget
+    size_t Evicted() const {
+      return evicted_.load(std::memory_order_relaxed);
+    }
+
+    const std::filesystem::path& Directory() const {
+      return directory_;
+    }
+
+  private:
+    // magic + format version
+    static constexpr size_t HEADER_SIZE = 8;
+    static constexpr const char* MAGIC = "CHNK";
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    static constexpr const char* EXTENSION = ".chunk";
+    static constexpr const char* TEMP_EXTENSION = ".tmp";
+
+    // the index charges each file its size
+    struct file_cost {
+      size_t operator()(uint64_t bytes) const {
+        return static_cast<size_t>(bytes);
+      }
+    };
+
+    typedef util::LRUCache<KeyType, uint64_t, file_cost> IndexType;
+
+    static bool CheckHeader(const uint8_t* data) {
+      uint32_t version;
+      std::memcpy(&version, data + 4, sizeof(version));
+      return (std::memcmp(data, MAGIC, 4) == 0 && version == FORMAT_VERSION);
+    }
+
+    static std::string FileStem(const KeyType& key) {
+      static const char* HEX = "0123456789abcdef";
+      uint8_t packed[KeyType::PACKED_SIZE];
+      key.Pack(packed);
+
+      std::string res;
+      res.reserve(KeyType::PACKED_SIZE * 2);
+      for (uint8_t byte : packed) {
+        res.push_back(HEX[byte >> 4]);
+        res.push_back(HEX[byte & 0xF]);
+      }
+
+      return res;
+    }
+
+    // false if stem isn't a packed key
+    static bool ParseStem(const std::string& stem, KeyType* output) {
+      if (stem.size() != KeyType::PACKED_SIZE * 2) {
+        return false;
+      }
+
+      uint8_t packed[KeyType::PACKED_SIZE];
+      for (size_t i = 0; i < KeyType::PACKED_SIZE; i++) {
+        int hi = HexValue(stem[i * 2]);
+        int lo = HexValue(stem[i * 2 + 1]);
+        if (hi < 0 || lo < 0) {
+          return false;
+        }
+
+        packed[i] = static_cast<uint8_t>((hi << 4) | lo);
+      }
+
+      *output = KeyType::Unpack(packed);
+      return true;
+    }
+
+    static int HexValue(char c) {
+      if (c >= '0' && c <= '9') {
+        return c - '0';
+      }
+
+      if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+      }
+
+      return -1;
+    }
+
+    std::filesystem::path PathFor(const KeyType& key) const {
+      return directory_ / (FileStem(key) + EXTENSION);
+    }
+
+    // indexes chunks left by earlier runs, oldest first, and clears out temp files from interrupted writes
+    void LoadIndex() {
+      struct found_file {
+        KeyType key;
+        uint64_t bytes;
+        std::filesystem::file_time_type written;
+      };
+
+      std::vector<found_file> found;
+      std::error_code err;
+      for (auto itr = std::filesystem::directory_iterator(directory_, err); !err && itr != std::filesystem::directory_iterator(); itr.increment(err)) {
+        const std::filesystem::path& path = itr->path();
+        std::error_code file_err;
+        if (path.extension() == TEMP_EXTENSION) {
+          std::filesystem::remove(path, file_err);
+          continue;
+        }
+
+        KeyType key;
+        if (path.extension() == EXTENSION && ParseStem(path.stem().string(), &key)) {
+          uint64_t bytes = itr->file_size(file_err);
+          std::filesystem::file_time_type written = itr->last_write_time(file_err);
+          if (!file_err) {
+            found.push_back(found_file { key, bytes, written });
+          }
+        }
+      }
+
+      std::sort(found.begin(), found.end(), [](const found_file& a, const found_file& b) { return a.written < b.written; });
+      for (auto& file : found) {
+        on_disk_.Put(file.key, file.bytes, &dropped_);
+      }
+
+      RemoveDropped();
+    }
+
+    // deletes the files of keys the index dropped
+    void RemoveDropped() {
+      for (auto& item : dropped_) {
+        std::error_code err;
+        std::filesystem::remove(PathFor(item.first), err);
+        evicted_.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      dropped_.clear();
+    }
+
+    // reads key's file back. any thread
+    bool ReadChunk(const KeyType& key, std::shared_ptr<ChunkType>* output) {
+      std::shared_ptr<ChunkType> chunk;
+      {
+        std::ifstream file(PathFor(key), std::ios::binary | std::ios::ate);
+        std::streamoff size = (file ? static_cast<std::streamoff>(file.tellg()) : 0);
+        if (size >= static_cast<std::streamoff>(HEADER_SIZE)) {
+          std::vector<uint8_t> data(static_cast<size_t>(size));
+          file.seekg(0);
+          if (file.read(reinterpret_cast<char*>(data.data()), size) && CheckHeader(data.data())) {
+            chunk = Serializer::Deserialize(data.data() + HEADER_SIZE, data.size() - HEADER_SIZE);
+          }
+        }
+      }
+
+      if (chunk == nullptr) {
+        // corrupt, or removed from under us - forget it, so it's generated again
+        if (on_disk_.Erase(key)) {
+          std::error_code err;
+          std::filesystem::remove(PathFor(key), err);
+        }
+
+        return false;
+      }
+
+      *output = std::move(chunk);
+      return true;
+    }
+
+    bool WriteChunk(const KeyType& key, const ChunkType& chunk, std::vector<uint8_t>& buffer) {
+      buffer.clear();
+      buffer.resize(HEADER_SIZE);
+      std::memcpy(buffer.data(), MAGIC, 4);
+      std::memcpy(buffer.data() + 4, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+      Serializer::Serialize(chunk, buffer);
+
+      std::filesystem::path path = PathFor(key);
+      std::filesystem::path temp = path;
+      temp += TEMP_EXTENSION;
+      {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()))) {
+          return false;
+        }
+      }
+
+      std::error_code err;
+      std::filesystem::rename(temp, path, err);
+      return !err;
+    }
+
+    // the store's I/O thread - reads first, as someone's waiting on them
+    void WriterFunc() {
+      std::vector<uint8_t> buffer;
+      std::deque<std::pair<KeyType, std::shared_ptr<ChunkType>>> batch;
+      std::deque<std::pair<KeyType, LoadCallback>> reads;
+      std::vector<std::pair<KeyType, uint64_t>> done;
+      std::unique_lock lock(lock_);
+      while (true) {
+        write_cond_.wait(lock, [&] { return stop_ || !queue_.empty() || !reads_.empty(); });
+        if (queue_.empty() && reads_.empty()) {
+          // stopping, and nothing left to do
+          return;
+        }
+
+        reads.swap(reads_);
+        batch.swap(queue_);
+        writing_ = true;
+        lock.unlock();
+
+        for (auto& item : reads) {
+          std::shared_ptr<ChunkType> chunk;
+          ReadChunk(item.first, &chunk);
+          item.second(chunk);
+        }
+
+        reads.clear();
+        done.clear();
+        for (auto& item : batch) {
+          if (WriteChunk(item.first, *item.second, buffer)) {
+            done.emplace_back(item.first, buffer.size());
+            written_.fetch_add(1, std::memory_order_relaxed);
+          } else {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+          }
+        }
+
+        lock.lock();
+        for (auto& item : batch) {
+          pending_.erase(item.first);
+        }
+
+        for (auto& item : done) {
+          on_disk_.Put(item.first, item.second, &dropped_);
+        }
+
+        // nothing else touches the files of dropped keys - they're out of the index, and not queued
+        lock.unlock();
+        RemoveDropped();
+        lock.lock();
+
+        batch.clear();
+        writing_ = false;
+        flush_cond_.notify_all();
+      }
+    }
+
+    std::filesystem::path directory_;
+
+    std::mutex lock_;
+    std::condition_variable write_cond_;
+    std::condition_variable flush_cond_;
+
+    // keys w a complete file on disk -> file size, least recently written or loaded last
+    IndexType on_disk_;
+
+    // dropped from the index to stay within budget - their files are deleted next. I/O thread (or constructor) only
+    typename IndexType::EvictList dropped_;
+
+    // queued for writing - readable until the write lands
+    std::unordered_map<KeyType, std::shared_ptr<ChunkType>> pending_;
+    std::deque<std::pair<KeyType, std::shared_ptr<ChunkType>>> queue_;
+
+    // queued for reading
+    std::deque<std::pair<KeyType, LoadCallback>> reads_;
+
+    std::atomic<size_t> written_;
+    std::atomic<size_t> failed_;
+    std::atomic<size_t> evicted_;
+
+    bool writing_;
+    bool stop_;
+
+    std::thread writer_;
+  };
+}
+
+#endif // DISK_CHUNK_STORE_H_
@@ -0,0 +1,190 @@
+#ifndef GENERATION_EPOCH_H_
+#define GENERATION_EPOCH_H_
+
+#include "chunker/ChunkKey.hpp"
+#include "chunker/util/Hash.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief generation epochs, shared by a pool and its workers.
+   *
+   * Every queued chunk is stamped w the epoch it was enqueued in. Epochs move on one of two ways:
+   * - Advance publishes the full set of keys still wanted. chunks from before it are stale unless their key is in the set.
+   * - Retire publishes just the keys which stopped being wanted - O(changed), for callers who know what changed.
+   *   chunks from before it are stale if their key was retired after they were enqueued.
+   * Stale chunks are dropped before generating, and generators which take a CancelToken can bail out part way through.
+   *
+   * @tparam KeyType - key chunks are queued by
+   */
+  template <typename KeyType>
+  class BasicGenerationEpoch {
+  public:
+    typedef std::unordered_set<KeyType> LiveSet;
+    typedef std::vector<KeyType> RetiredList;
+
+    BasicGenerationEpoch() : epoch_(0), retired_count_(0) {}
+
+    uint64_t Current() const {
+      return epoch_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief starts a new epoch. costs O(live) for the caller to build - see Retire.
+     * forgets everything retired so far, as the live set covers it.
+     *
+     * @param live - keys from older epochs which are still wanted. nullptr drops everything older.
+     * @return uint64_t - the new epoch
+     */
+    uint64_t Advance(std::shared_ptr<const LiveSet> live) {
+      // publish the set before the epoch, so anyone who sees the new epoch sees this set (or a newer one)
+      auto base = std::make_shared<const base_state>(base_state { std::move(live), Current() + 1 });
+      std::atomic_store_explicit(&base_, std::move(base), std::memory_order_release);
+      ClearRetired();
+      return epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    }
+
+    /**
+     * @brief starts a new epoch, dropping only the retired keys - everything else queued stays live
+     *
+     * @param retired - keys no longer wanted
+     * @return uint64_t - the new epoch
+     */
+    uint64_t Retire(const RetiredList& retired) {
+      uint64_t next = Current() + 1;
+      for (auto& key : retired) {
+        retired_shard& s = ShardFor(key);
+        std::lock_guard lock(s.lock);
+        if (s.keys.insert_or_assign(key, next).second) {
+          retired_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+
+      return epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    }
+
+    /**
+     * @brief key is wanted again - chunks queued for it before it was retired stay live
+     */
+    void Revive(const KeyType& key) {
+      if (retired_count_.load(std::memory_order_relaxed) == 0) {
+        return;
+      }
+
+      retired_shard& s = ShardFor(key);
+      std::lock_guard lock(s.lock);
+      if (s.keys.erase(key) != 0) {
+        retired_count_.fetch_sub(1, std::memory_order_relaxed);
+      }
+    }
+
+    /**
+     * @return size_t - keys retired since the last Advance
+     */
+    size_t RetiredCount() const {
+      return retired_count_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @return true if key, enqueued in epoch, is no longer wanted
+     */
+    bool IsStale(const KeyType& key, uint64_t epoch) const {
+      if (epoch == epoch_.load(std::memory_order_acquire)) {
+        return false;
+      }
+
+      std::shared_ptr<const base_state> base = std::atomic_load_explicit(&base_, std::memory_order_acquire);
+      if (base != nullptr && epoch < base->since && (base->live == nullptr || base->live->count(key) == 0)) {
+        return true;
+      }
+
+      if (retired_count_.load(std::memory_order_relaxed) == 0) {
+        return false;
+      }
+
+      const retired_shard& s = ShardFor(key);
+      std::lock_guard lock(s.lock);
+      auto itr = s.keys.find(key);
+      return (itr != s.keys.end() && itr->second > epoch);
+    }
+
+  private:
+    static const size_t SHARD_COUNT = 16;
+
+    // last full live set, and the epoch it was published w
+    struct base_state {
+      std::shared_ptr<const LiveSet> live;
+      uint64_t since;
+    };
+
+    // retired key -> epoch it was retired in. sharded like InFlightTable, as every worker checks it
+    struct alignas(64) retired_shard {
+      mutable std::mutex lock;
+      std::unordered_map<KeyType, uint64_t> keys;
+    };
+
+    retired_shard& ShardFor(const KeyType& key) {
+      return retired_[static_cast<size_t>(util::HashMix64(static_cast<uint64_t>(key.Hash())) >> 32) & (SHARD_COUNT - 1)];
+    }
+
+    const retired_shard& ShardFor(const KeyType& key) const {
+      return retired_[static_cast<size_t>(util::HashMix64(static_cast<uint64_t>(key.Hash())) >> 32) & (SHARD_COUNT - 1)];
+    }
+
+    void ClearRetired() {
+      for (auto& s : retired_) {
+        std::lock_guard lock(s.lock);
+        retired_count_.fetch_sub(s.keys.size(), std::memory_order_relaxed);
+        s.keys.clear();
+      }
+    }
+
+    std::atomic<uint64_t> epoch_;
+    std::shared_ptr<const base_state> base_;
+    std::array<retired_shard, SHARD_COUNT> retired_;
+    std::atomic<size_t> retired_count_;
+  };
+
+  typedef BasicGenerationEpoch<ChunkKey> GenerationEpoch;
+
+  /**
+   * @brief passed to generators w a `Generate(const ChunkIdentifier&, const CancelToken&)` overload.
+   * check Cancelled() every so often - if it's set, the chunk is no longer wanted, and returning nullptr skips caching it.
+   */
+  class CancelToken {
+  public:
+    // never cancelled
+    CancelToken() : epoch_(nullptr), key_(nullptr), task_epoch_(0), is_stale_(nullptr) {}
+
+    template <typename KeyType>
+    CancelToken(const BasicGenerationEpoch<KeyType>* epoch, const KeyType* key, uint64_t task_epoch)
+      : epoch_(epoch), key_(key), task_epoch_(task_epoch), is_stale_(&IsStale<KeyType>) {}
+
+    bool Cancelled() const {
+      return (epoch_ != nullptr && is_stale_(epoch_, key_, task_epoch_));
+    }
+
+  private:
+    // type erased, so generators take the same token whatever the pool is keyed by
+    template <typename KeyType>
+    static bool IsStale(const void* epoch, const void* key, uint64_t task_epoch) {
+      return static_cast<const BasicGenerationEpoch<KeyType>*>(epoch)->IsStale(*static_cast<const KeyType*>(key), task_epoch);
+    }
+
+    const void* epoch_;
+    const void* key_;
+    uint64_t task_epoch_;
+    bool (*is_stale_)(const void*, const void*, uint64_t);
+  };
+}
+
+#endif // GENERATION_EPOCH_H_
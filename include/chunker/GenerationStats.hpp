@@ -0,0 +1,59 @@
+#ifndef GENERATION_STATS_H_
+#define GENERATION_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace chunker {
+  /**
+   * @brief counts of what a pool's workers did w the chunks they picked up
+   */
+  struct GenerationStats {
+    // generated and cached
+    size_t generated;
+
+    // already in cache - nothing to do
+    size_t cache_hits;
+
+    // missed the cache, but read back from the disk tier
+    size_t disk_hits;
+
+    // stale before a worker got to them - never started
+    size_t dropped;
+
+    // stale part way through, and abandoned by the generator
+    size_t aborted;
+
+    // already being generated by another worker - attached to that instead
+    size_t deduped;
+
+    size_t Cancelled() const {
+      return dropped + aborted;
+    }
+  };
+
+  namespace impl {
+    // bumped by workers, read whenever
+    struct GenerationCounters {
+      std::atomic<size_t> generated { 0 };
+      std::atomic<size_t> cache_hits { 0 };
+      std::atomic<size_t> disk_hits { 0 };
+      std::atomic<size_t> dropped { 0 };
+      std::atomic<size_t> aborted { 0 };
+      std::atomic<size_t> deduped { 0 };
+
+      GenerationStats Snapshot() const {
+        return GenerationStats {
+          generated.load(std::memory_order_relaxed),
+          cache_hits.load(std::memory_order_relaxed),
+          disk_hits.load(std::memory_order_relaxed),
+          dropped.load(std::memory_order_relaxed),
+          aborted.load(std::memory_order_relaxed),
+          deduped.load(std::memory_order_relaxed)
+        };
+      }
+    };
+  }
+}
+
+#endif // GENERATION_STATS_H_
@@ -0,0 +1,137 @@
+#ifndef IN_FLIGHT_TABLE_H_
+#define IN_FLIGHT_TABLE_H_
+
+#include "chunker/ChunkKey.hpp"
+#include "chunker/GenerationEpoch.hpp"
+#include "chunker/util/Hash.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief keys currently being generated, shared by a pool's workers (single-flight).
+   *
+   * The first worker to Acquire a key owns its generation. Anyone else who picks up the same key while it's in flight
+   * attaches their callback to the owner's entry and moves on, instead of generating it a second time. The owner hands
+   * the finished chunk to every attached callback once it Releases the key.
+   *
+   * @tparam CallbackType - what requesters attach. called by the owner, on the owner's thread.
+   * @tparam KeyType - key chunks are queued by
+   */
+  template <typename CallbackType, typename KeyType = ChunkKey>
+  class InFlightTable {
+  public:
+    // a requester attached to someone else's generation
+    struct waiter {
+      uint64_t epoch;
+      CallbackType on_ready;
+
+      // a prefetch - should it have to be queued again, it goes back in the background
+      bool background;
+    };
+
+    typedef std::vector<waiter> WaiterList;
+
+    /**
+     * @brief claims key, or attaches to whoever already has it
+     *
+     * @param key - key about to be generated
+     * @param epoch - epoch the requester enqueued key in
+     * @param on_ready - attached if key is already in flight. may be empty.
+     * @param background - the requester is a prefetch, which nothing waits on
+     * @return true if the caller now owns key, and must Release (or Abort) it
+     * @return false if key was already in flight - on_ready will be called by its owner
+     */
+    bool Acquire(const KeyType& key, uint64_t epoch, const CallbackType& on_ready, bool background = false) {
+      shard& s = ShardFor(key);
+      std::lock_guard lock(s.lock);
+      auto res = s.entries.try_emplace(key);
+      if (res.second) {
+        return true;
+      }
+
+      // kept even w/o a callback - its epoch may keep the key alive if the owner is cancelled
+      res.first->second.push_back(waiter { epoch, on_ready, background });
+      return false;
+    }
+
+    /**
+     * @brief owner is done w key. later requesters will Acquire it themselves.
+     * @return WaiterList - everyone who attached while key was in flight
+     */
+    WaiterList Release(const KeyType& key) {
+      shard& s = ShardFor(key);
+      std::lock_guard lock(s.lock);
+      WaiterList res;
+      auto itr = s.entries.find(key);
+      if (itr != s.entries.end()) {
+        res = std::move(itr->second);
+        s.entries.erase(itr);
+      }
+
+      return res;
+    }
+
+    /**
+     * @brief owner's generation was cancelled. waiters enqueued in a later epoch may still want key, though.
+     *
+     * @param key - owned key
+     * @param epoch - epoch state, to check waiters against
+     * @param retry_epoch - output - newest epoch among the waiters who still want key
+     * @param stale - output - waiters who no longer want key. the owner should pass them nullptr.
+     * @return true if key is still wanted - the owner keeps it, and should generate again in retry_epoch
+     * @return false if not - key is released
+     */
+    bool Abort(const KeyType& key, const BasicGenerationEpoch<KeyType>& epoch, uint64_t* retry_epoch, WaiterList* stale) {
+      shard& s = ShardFor(key);
+      std::lock_guard lock(s.lock);
+      auto itr = s.entries.find(key);
+      if (itr == s.entries.end()) {
+        return false;
+      }
+
+      WaiterList& waiters = itr->second;
+      auto live_end = std::partition(waiters.begin(), waiters.end(), [&](const waiter& w) { return !epoch.IsStale(key, w.epoch); });
+      stale->insert(stale->end(), std::make_move_iterator(live_end), std::make_move_iterator(waiters.end()));
+      waiters.erase(live_end, waiters.end());
+      if (waiters.empty()) {
+        s.entries.erase(itr);
+        return false;
+      }
+
+      *retry_epoch = 0;
+      for (auto& w : waiters) {
+        *retry_epoch = std::max(*retry_epoch, w.epoch);
+      }
+
+      return true;
+    }
+
+  private:
+    static const size_t SHARD_COUNT = 16;
+
+    // own cache line per shard, like the executor's queues
+    struct alignas(64) shard {
+      std::mutex lock;
+      std::unordered_map<KeyType, WaiterList> entries;
+    };
+
+    // top bits of the re-mixed hash, as in ShardedLRUCache - each shard's map uses the low ones
+    shard& ShardFor(const KeyType& key) {
+      return shards_[static_cast<size_t>(util::HashMix64(static_cast<uint64_t>(key.Hash())) >> 32) & (SHARD_COUNT - 1)];
+    }
+
+    std::array<shard, SHARD_COUNT> shards_;
+  };
+}
+
+#endif // IN_FLIGHT_TABLE_H_
@@ -0,0 +1,456 @@
+#ifndef MULTI_VIEWER_CHUNK_MANAGER_H_
+#define MULTI_VIEWER_CHUNK_MANAGER_H_
+
+#include "chunker/traits/chunk_gen_type.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/ChunkPriority.hpp"
+
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief Serves a set of viewers from one pool and one cache.
+   *
+   * Viewers close enough to share a tree get the union of their trees - a node splits if any of them wants it split,
+   * so the finest LOD wins, and a chunk wanted by several viewers is requested once. Viewers too far apart to share
+   * get a tree of their own, still backed by the shared pool and cache - so cost follows the terrain covered,
+   * rather than the number of viewers.
+   *
+   * Each viewer sees the leaves of its tree within max_gen_distance of it.
+   */
+  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType, typename Cache = ChunkCache<ChunkType>>
+  class MultiViewerChunkManager {
+    typedef chunker::TypedChunkThreadPool<ChunkGenFactory, ChunkGenerator, ChunkType, Cache> PoolType;
+    static_assert(chunker::traits::chunk_gen_type<ChunkGenerator, ChunkType>::value);
+    static_assert(chunker::traits::chunk_gen_factory_type<ChunkGenFactory, ChunkGenerator>::value);
+
+    struct visible_chunk {
+      std::shared_ptr<ChunkType> chunk;
+
+      // false until the chunk has been picked up from the pool
+      bool ready;
+    };
+
+    typedef std::unordered_map<chunker::ChunkKey, visible_chunk> VisibleMap;
+
+    // one union tree, and the viewers sharing it. sits still once placed - viewers which wander off move to another
+    struct region {
+      region(long tree_size, size_t chunk_res) : gen(tree_size, chunk_res), tree(nullptr), offset(0, 0) {}
+
+      chunker::lod::LodTreeGenerator gen;
+
+      // retained by gen. nullptr until the first build
+      chunker::lod::lod_node* tree;
+      chunker::lod::LinearLodTree linear_tree;
+
+      // key for each leaf of linear_tree, in the same order
+      std::vector<chunker::ChunkKey> keys;
+
+      // bottom left corner of the tree
+      glm::ivec2 offset;
+
+      // viewers in this region, and their positions relative to offset
+      std::vector<size_t> viewers;
+      std::vector<glm::vec3> positions;
+    };
+
+   public:
+    /**
+     * @param chunk_factory - creates a generator per pool thread
+     * @param thread_count - the number of threads to use for chunk generation, shared by every viewer
+     * @param max_gen_distance - the max distance to generate tiles from, around each viewer
+     * @param min_chunk_size - min size, in units, of a given chunk
+     * @param cascade_factor - rate at which to decrease LOD as we back away from a viewer
+     * @param cache_budget - budget for cached chunks, in the cache's cost units (bytes by default, if the chunk has a ByteSize())
+     */
+    MultiViewerChunkManager(
+      std::shared_ptr<ChunkGenFactory> chunk_factory,
+      size_t thread_count,
+      double max_gen_distance,
+      size_t min_chunk_size,
+      double cascade_factor,
+      long lod_bias = 0,
+      size_t cache_budget = PoolType::DEFAULT_CACHE_BUDGET
+    ) : factory(chunk_factory),
+        gen_dist_(max_gen_distance),
+        // same tree size as ChunkManager - at least 4x the max gen distance
+        tree_size_(static_cast<long>(1) << static_cast<long>(ceil(log2(max_gen_distance)) + 2)),
+        min_chunk_size_(min_chunk_size),
+        chunk_res_(min_chunk_size_ << std::min(-lod_bias, 0L)),
+        cascade_factor_(cascade_factor),
+        hysteresis_(0.0),
+        parallel_levels_(0),
+        nearest_first_(false),
+        thread_pool_(thread_count, factory, cache_budget)
+    {}
+
+    /**
+     * @brief Moves every viewer. viewers are identified by their index in positions - viewers past the end are dropped.
+     *
+     * @param positions - one position per viewer
+     * @return true if no tree changed, and so no chunks were requested
+     * @return false otherwise
+     */
+    bool UpdateViewers(const std::vector<glm::vec3>& positions) {
+      CHUNKER_TRACE_SCOPE("tree", "update");
+      size_t region_count = regions_.size();
+      AssignRegions(positions);
+      bool changed = (regions_.size() != region_count);
+
+      for (auto& r : regions_) {
+        changed |= BuildRegion(*r);
+      }
+
+      // viewers move around inside their trees even when the trees don't change
+      viewer_keys_.resize(positions.size());
+      for (auto& r : regions_) {
+        CollectViewerKeys(*r);
+      }
+
+      if (!changed) {
+        return true;
+      }
+
+      UpdateChunks();
+
+      // visible chunks need to fit in cache until we've picked them up
+      thread_pool_.Reserve(visible_.size());
+      if (nearest_first_) {
+        NearestViewerPriority priority;
+        for (auto& position : positions) {
+          priority.viewers.push_back(ViewerDistancePriority { position.x, position.z });
+        }
+
+        thread_pool_.SetPriority(std::move(priority));
+      }
+
+      AdvanceEpoch();
+      FlushEnqueued();
+      return false;
+    }
+
+    /**
+     * @brief Keeps split nodes split a little past their threshold - see ChunkManager::SetHysteresis
+     */
+    void SetHysteresis(double hysteresis) {
+      hysteresis_ = hysteresis;
+      for (auto& r : regions_) {
+        r->gen.hysteresis = hysteresis;
+      }
+    }
+
+    /**
+     * @brief Splits tree construction across tbb tasks below the given number of levels. 0 builds serially.
+     */
+    void SetTreeParallelism(int levels) {
+      parallel_levels_ = levels;
+      for (auto& r : regions_) {
+        r->gen.parallel_levels = levels;
+      }
+    }
+
+    /**
+     * @brief Generates chunks nearest any viewer first, finer LODs first on ties. Otherwise chunks generate in tree order.
+     */
+    void SetNearestFirst(bool nearest_first) {
+      nearest_first_ = nearest_first;
+      if (!nearest_first_) {
+        thread_pool_.SetPriority(nullptr);
+      }
+    }
+
+    size_t GetViewerCount() const {
+      return viewer_keys_.size();
+    }
+
+    // number of trees - one per group of viewers close enough to share
+    size_t GetTreeCount() const {
+      return regions_.size();
+    }
+
+    // distinct chunks across every viewer
+    size_t GetChunkCount() const {
+      return visible_.size();
+    }
+
+    size_t GetVisibleCount(size_t viewer) const {
+      return viewer_keys_.at(viewer).size();
+    }
+
+    /**
+     * @brief cost of chunks currently held by the cache (bytes, w the default cache and a chunk w a ByteSize())
+     */
+    size_t GetCacheUsage() {
+      return thread_pool_.CacheUsage();
+    }
+
+    GenerationStats GetGenerationStats() const {
+      return thread_pool_.Stats();
+    }
+
+    /**
+     * @brief keeps chunks on disk in directory, behind the memory cache - see TypedChunkThreadPool::OpenDiskTier
+     */
+    void OpenDiskTier(const std::string& directory, size_t budget = PoolType::DEFAULT_DISK_BUDGET) {
+      thread_pool_.OpenDiskTier(directory, budget);
+    }
+
+    void wait() {
+      ResolvePending();
+    }
+
+    /**
+     * @brief calls func on each chunk visible to viewer. blocks until every visible chunk is ready.
+     *
+     * @param func - (const std::shared_ptr<ChunkType>&) -> void
+     */
+    template <typename Func>
+    void ForEachVisible(size_t viewer, Func&& func) {
+      ResolvePending();
+      for (auto& key : viewer_keys_.at(viewer)) {
+        func(visible_.at(key).chunk);
+      }
+    }
+
+   private:
+    static const long MAX_CHUNK_SIZE_FACTOR = 3;
+
+    // bottom left corner of a lone viewer's tree - same placement as ChunkManager::TreeOffset
+    glm::ivec2 TreeOffset(const glm::vec3& local_position) const {
+      long half_size = tree_size_ / 2;
+      return glm::ivec2(Nudge(local_position.x) - half_size, Nudge(local_position.z) - half_size);
+    }
+
+    // steps of tree_size / 8 toward coord, stopping within a step of it
+    long Nudge(float coord) const {
+      long nudge_factor = tree_size_ >> MAX_CHUNK_SIZE_FACTOR;
+      double steps = std::ceil(std::abs(static_cast<double>(coord)) / nudge_factor) - 1.0;
+      long res = static_cast<long>(std::max(steps, 0.0)) * nudge_factor;
+      return (coord < 0.0f ? -res : res);
+    }
+
+    // true if a viewer at position can share the tree at offset - ie: its whole gen distance lies inside it
+    bool Fits(const glm::ivec2& offset, const glm::vec3& position) const {
+      // trees are at least 4x the gen distance, so a quarter tree either side of center covers it
+      double quarter = static_cast<double>(tree_size_) / 4.0;
+      double center_x = offset.x + tree_size_ / 2;
+      double center_y = offset.y + tree_size_ / 2;
+      return (std::abs(position.x - center_x) <= quarter && std::abs(position.z - center_y) <= quarter);
+    }
+
+    // sorts viewers into regions - the first existing region each fits, or a new one. regions left empty are dropped.
+    void AssignRegions(const std::vector<glm::vec3>& positions) {
+      for (auto& r : regions_) {
+        r->viewers.clear();
+        r->positions.clear();
+      }
+
+      for (size_t i = 0; i < positions.size(); i++) {
+        const glm::vec3& position = positions[i];
+        region* target = nullptr;
+        for (auto& r : regions_) {
+          if (Fits(r->offset, position)) {
+            target = r.get();
+            break;
+          }
+        }
+
+        if (target == nullptr) {
+          regions_.push_back(std::make_unique<region>(tree_size_, chunk_res_));
+          target = regions_.back().get();
+          target->gen.cascade_factor = cascade_factor_;
+          target->gen.hysteresis = hysteresis_;
+          target->gen.parallel_levels = parallel_levels_;
+          target->offset = TreeOffset(position);
+        }
+
+        target->viewers.push_back(i);
+        target->positions.push_back(position - glm::vec3(target->offset.x, 0.0f, target->offset.y));
+      }
+
+      regions_.erase(std::remove_if(regions_.begin(), regions_.end(), [](const std::unique_ptr<region>& r) {
+        return r->viewers.empty();
+      }), regions_.end());
+    }
+
+    // rebuilds a region's tree. returns true if it changed
+    bool BuildRegion(region& r) {
+      CHUNKER_TRACE_SCOPE("tree", "build");
+      // tree is owned by the generator - dropped on the next call unless retained
+      chunker::lod::lod_node* tree = r.gen.CreateLodTree(r.positions, MAX_CHUNK_SIZE_FACTOR, r.tree);
+      scratch_tree_.Build(tree, static_cast<size_t>(tree_size_));
+      if (r.tree != nullptr && scratch_tree_ == r.linear_tree) {
+        return false;
+      }
+
+      r.gen.RetainTree();
+      r.tree = tree;
+      std::swap(r.linear_tree, scratch_tree_);
+
+      r.keys.clear();
+      for (uint64_t leaf : r.linear_tree.Leaves()) {
+        glm::ivec2 origin = r.linear_tree.LeafOrigin(leaf);
+        size_t size = r.linear_tree.LeafSize(leaf);
+        r.keys.emplace_back(chunker::ChunkIdentifier(r.offset.x + origin.x, r.offset.y + origin.y, origin.x, origin.y, size, min_chunk_size_, r.linear_tree));
+      }
+
+      return true;
+    }
+
+    void CollectViewerKeys(const region& r) {
+      for (size_t i = 0; i < r.viewers.size(); i++) {
+        glm::vec3 position = r.positions[i] + glm::vec3(r.offset.x, 0.0f, r.offset.y);
+        ViewerDistancePriority distance { position.x, position.z };
+        std::vector<chunker::ChunkKey>& keys = viewer_keys_[r.viewers[i]];
+        keys.clear();
+        for (auto& key : r.keys) {
+          if (distance(key).distance <= gen_dist_) {
+            keys.push_back(key);
+          }
+        }
+      }
+    }
+
+    // rebuilds the visible set from every region's keys. chunks already visible carry over
+    void UpdateChunks() {
+      next_visible_.clear();
+      next_visible_.reserve(visible_.size());
+      for (auto& r : regions_) {
+        for (auto& key : r->keys) {
+          if (next_visible_.count(key) != 0) {
+            // shared w another region
+            continue;
+          }
+
+          auto itr = visible_.find(key);
+          if (itr != visible_.end()) {
+            // moved over - whatever's left behind in visible_ is no longer wanted
+            next_visible_.insert(visible_.extract(itr));
+            continue;
+          }
+
+          next_visible_.emplace(key, visible_chunk { nullptr, false });
+          pending_.push_back(key);
+          enqueued_.push_back(key);
+        }
+      }
+
+      for (auto& entry : visible_) {
+        retired_.push_back(entry.first);
+      }
+
+      visible_.clear();
+      std::swap(visible_, next_visible_);
+    }
+
+    // picks up finished chunks for every pending key
+    void ResolvePending() {
+      CHUNKER_TRACE_SCOPE("manager", "resolve_pending");
+      while (!pending_.empty()) {
+        thread_pool_.Wait();
+
+        missed_.clear();
+        for (auto& key : pending_) {
+          auto itr = visible_.find(key);
+          if (itr == visible_.end() || itr->second.ready) {
+            // dropped from every tree, or duplicate
+            continue;
+          }
+
+          visible_chunk& entry = itr->second;
+          if (thread_pool_.FetchChunk(key, &entry.chunk)) {
+            entry.ready = true;
+          } else {
+            // evicted before we got to it - generate it again
+            enqueued_.push_back(key);
+            missed_.push_back(key);
+          }
+        }
+
+        std::swap(pending_, missed_);
+        FlushEnqueued();
+      }
+    }
+
+    // queued work from older trees is dropped, unless some viewer can still see it.
+    // only retires the keys UpdateChunks dropped - see ChunkManager::AdvanceEpoch
+    void AdvanceEpoch() {
+      if (thread_pool_.Empty()) {
+        thread_pool_.AdvanceEpoch(nullptr);
+        retired_.clear();
+        return;
+      }
+
+      if (thread_pool_.RetiredCount() + retired_.size() <= visible_.size()) {
+        thread_pool_.AdvanceEpoch(retired_);
+        retired_.clear();
+        return;
+      }
+
+      retired_.clear();
+      auto live = std::make_shared<GenerationEpoch::LiveSet>();
+      live->reserve(visible_.size());
+      for (auto& entry : visible_) {
+        live->insert(entry.first);
+      }
+
+      thread_pool_.AdvanceEpoch(std::move(live));
+    }
+
+    void FlushEnqueued() {
+      thread_pool_.EnqueueBulk(enqueued_);
+      enqueued_.clear();
+    }
+
+    std::shared_ptr<ChunkGenFactory> factory;
+    double gen_dist_;
+    long tree_size_;
+    size_t min_chunk_size_;
+    size_t chunk_res_;
+    double cascade_factor_;
+    double hysteresis_;
+    int parallel_levels_;
+    bool nearest_first_;
+
+    PoolType thread_pool_;
+
+    std::vector<std::unique_ptr<region>> regions_;
+
+    // scratch - holds the tree being built
+    chunker::lod::LinearLodTree scratch_tree_;
+
+    // chunks covering every tree - shared between regions where they overlap
+    VisibleMap visible_;
+    VisibleMap next_visible_;
+
+    // keys visible to each viewer
+    std::vector<std::vector<chunker::ChunkKey>> viewer_keys_;
+
+    // keys which have been enqueued, but not picked up yet
+    std::vector<chunker::ChunkKey> pending_;
+    std::vector<chunker::ChunkKey> missed_;
+
+    // keys waiting to be handed to the pool
+    std::vector<chunker::ChunkKey> enqueued_;
+
+    // keys no viewer sees any more, since the last AdvanceEpoch
+    std::vector<chunker::ChunkKey> retired_;
+  };
+}
+
+#endif // MULTI_VIEWER_CHUNK_MANAGER_H_
@@ -0,0 +1,251 @@
+#ifndef PIPELINE_METRICS_H_
+#define PIPELINE_METRICS_H_
+
+#include "chunker/GenerationStats.hpp"
+#include "chunker/util/LRUCache.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief latency counts in power of two buckets - bucket i holds samples in [2^i, 2^(i+1)) ns, and bucket 0 holds 0 too.
+   * the last bucket takes everything longer (~9 min and up).
+   */
+  struct LatencyHistogram {
+    static const int BUCKET_COUNT = 40;
+
+    std::array<uint64_t, BUCKET_COUNT> buckets;
+    uint64_t count;
+    uint64_t total_ns;
+
+    static int Bucket(uint64_t ns) {
+      int res = 0;
+      while (ns > 1 && res < BUCKET_COUNT - 1) {
+        ns >>= 1;
+        res++;
+      }
+
+      return res;
+    }
+
+    void Add(const LatencyHistogram& other) {
+      for (int i = 0; i < BUCKET_COUNT; i++) {
+        buckets[i] += other.buckets[i];
+      }
+
+      count += other.count;
+      total_ns += other.total_ns;
+    }
+
+    double MeanNs() const {
+      return (count == 0 ? 0.0 : static_cast<double>(total_ns) / count);
+    }
+
+    /**
+     * @param quantile - 0 to 1
+     * @return uint64_t - upper bound of the bucket holding quantile, in ns. 0 if empty.
+     */
+    uint64_t PercentileNs(double quantile) const {
+      if (count == 0) {
+        return 0;
+      }
+
+      uint64_t target = static_cast<uint64_t>(quantile * (count - 1));
+      uint64_t seen = 0;
+      for (int i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+          return (static_cast<uint64_t>(2) << i) - 1;
+        }
+      }
+
+      return UINT64_MAX;
+    }
+  };
+
+  /**
+   * @brief latencies of one chunk size - queued is enqueue to a worker picking the chunk up, running is pick up to done.
+   * running only counts chunks a worker actually made (generated or read back from disk), not cache hits.
+   */
+  struct LodLatency {
+    size_t size;
+    LatencyHistogram queued;
+    LatencyHistogram running;
+  };
+
+  // busy is time spent on tasks. idle is the rest of the worker's lifetime
+  struct WorkerTime {
+    uint64_t busy_ns;
+    uint64_t idle_ns;
+    uint64_t tasks;
+  };
+
+  /**
+   * @brief cache traffic through a pool - lookups from workers and from FetchChunk / GetChunk, and puts from workers
+   */
+  struct CacheStats {
+    uint64_t hits;
+    uint64_t misses;
+
+    // new entries
+    uint64_t inserts;
+
+    // puts which evicted to make room (CachePutResult REMOVE_LAST) - at least one entry each
+    uint64_t evictions;
+
+    // puts which replaced an entry under the same key
+    uint64_t overwrites;
+  };
+
+  /**
+   * @brief snapshot of a pool's metrics - see TypedChunkThreadPool::Metrics
+   */
+  struct PipelineMetrics {
+    GenerationStats generation;
+
+    // tasks waiting for a worker - prefetches apart
+    size_t queue_depth;
+    size_t prefetch_depth;
+
+    CacheStats cache;
+
+    // chunk sizes w any samples, smallest first
+    std::vector<LodLatency> lods;
+
+    // indexed by worker
+    std::vector<WorkerTime> workers;
+  };
+
+  /**
+   * @brief time spent per update building the lod tree, and working out what changed
+   */
+  struct TreeUpdateMetrics {
+    uint64_t updates;
+    LatencyHistogram build;
+    LatencyHistogram diff;
+  };
+
+  struct ChunkManagerMetrics {
+    PipelineMetrics pipeline;
+    TreeUpdateMetrics tree;
+  };
+
+  namespace impl {
+    inline int64_t NowNs() {
+      return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // for counters w a single writer - a plain load and store, w/o a locked add. readers on other threads see a recent value
+    inline void Bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+      counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // one writer at a time, any number of readers
+    struct AtomicHistogram {
+      std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> buckets {};
+      std::atomic<uint64_t> total_ns { 0 };
+
+      void Record(int64_t ns) {
+        uint64_t sample = static_cast<uint64_t>(ns < 0 ? 0 : ns);
+        Bump(buckets[LatencyHistogram::Bucket(sample)], 1);
+        Bump(total_ns, sample);
+      }
+
+      LatencyHistogram Snapshot() const {
+        LatencyHistogram res {};
+        for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+          res.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+          res.count += res.buckets[i];
+        }
+
+        res.total_ns = total_ns.load(std::memory_order_relaxed);
+        return res;
+      }
+    };
+
+    // histograms per chunk size, indexed by log2(size)
+    struct LodCounters {
+      static const int LEVEL_COUNT = 32;
+
+      std::array<AtomicHistogram, LEVEL_COUNT> queued;
+      std::array<AtomicHistogram, LEVEL_COUNT> running;
+
+      static int Level(size_t size) {
+        int res = 0;
+        while (size > 1 && res < LEVEL_COUNT - 1) {
+          size >>= 1;
+          res++;
+        }
+
+        return res;
+      }
+
+      // adds this worker's histograms to totals, indexed by level
+      void AddTo(std::array<LodLatency, LEVEL_COUNT>* totals) const {
+        for (int i = 0; i < LEVEL_COUNT; i++) {
+          (*totals)[i].queued.Add(queued[i].Snapshot());
+          (*totals)[i].running.Add(running[i].Snapshot());
+        }
+      }
+    };
+
+    // single writer, as AtomicHistogram
+    struct CacheCounters {
+      std::atomic<uint64_t> hits { 0 };
+      std::atomic<uint64_t> misses { 0 };
+      std::atomic<uint64_t> inserts { 0 };
+      std::atomic<uint64_t> evictions { 0 };
+      std::atomic<uint64_t> overwrites { 0 };
+
+      void RecordFetch(bool hit) {
+        Bump(hit ? hits : misses, 1);
+      }
+
+      void RecordPut(util::CachePutResult result) {
+        if (result == util::OVERWRITE) {
+          Bump(overwrites, 1);
+          return;
+        }
+
+        Bump(inserts, 1);
+        if (result == util::REMOVE_LAST) {
+          Bump(evictions, 1);
+        }
+      }
+
+      void AddTo(CacheStats* totals) const {
+        totals->hits += hits.load(std::memory_order_relaxed);
+        totals->misses += misses.load(std::memory_order_relaxed);
+        totals->inserts += inserts.load(std::memory_order_relaxed);
+        totals->evictions += evictions.load(std::memory_order_relaxed);
+        totals->overwrites += overwrites.load(std::memory_order_relaxed);
+      }
+    };
+
+    // everything one worker records - only that worker writes to it, so there's no contention between workers
+    struct WorkerCounters {
+      std::atomic<uint64_t> busy_ns { 0 };
+      std::atomic<uint64_t> tasks { 0 };
+      CacheCounters cache;
+      LodCounters lods;
+    };
+
+    // written by whoever updates the manager, read whenever
+    struct TreeUpdateCounters {
+      std::atomic<uint64_t> updates { 0 };
+      AtomicHistogram build;
+      AtomicHistogram diff;
+
+      TreeUpdateMetrics Snapshot() const {
+        return TreeUpdateMetrics { updates.load(std::memory_order_relaxed), build.Snapshot(), diff.Snapshot() };
+      }
+    };
+  }
+}
+
+#endif // PIPELINE_METRICS_H_
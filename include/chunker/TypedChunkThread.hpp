@@ -2,33 +2,112 @@
 #define TYPED_CHUNK_THREAD_H_
 
 #include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/DiskChunkStore.hpp"
+#include "chunker/GenerationEpoch.hpp"
+#include "chunker/GenerationStats.hpp"
+#include "chunker/InFlightTable.hpp"
+#include "chunker/PipelineMetrics.hpp"
+#include "chunker/util/LRUCache.hpp"
+#include "chunker/util/Trace.hpp"
+#include "chunker/traits/chunk_cost.hpp"
 #include "chunker/traits/chunk_gen_type.hpp"
-
-#include <tbb/concurrent_queue.h>
-
+#include "chunker/traits/chunk_serializer.hpp"
 
 #include "gog43/Logger.hpp"
 
-#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <memory>
-#include <mutex>
-#include <queue>
-#include <thread>
+#include <type_traits>
+#include <vector>
 
 namespace chunker {
-  template <typename ChunkGenerator, typename ChunkType>
+  // bytes, per traits::chunk_cost, if the chunk type reports its ByteSize - otherwise a chunk count
+  template <typename ChunkType>
+  using ChunkCacheCost = std::conditional_t<traits::has_byte_size<ChunkType>::value, traits::chunk_cost<std::shared_ptr<ChunkType>>, util::UnitCost>;
+
+  // default cache for finished chunks - budgeted per ChunkCacheCost.
+  // the cache's key type is what a pool queues by - ChunkKey, unless the chunks aren't 2D
+  template <typename ChunkType, typename KeyType = chunker::ChunkKey>
+  using ChunkCache = util::LRUCache<KeyType, std::shared_ptr<ChunkType>, ChunkCacheCost<ChunkType>>;
+
+  // (key, chunk) - chunk is nullptr if the key was cancelled before it was generated
+  template <typename ChunkType, typename KeyType = chunker::ChunkKey>
+  using ChunkReadyCallback = std::function<void(const KeyType&, const std::shared_ptr<ChunkType>&)>;
+
+  // a queued chunk, stamped w the epoch it was enqueued in
+  template <typename ChunkType, typename KeyType = chunker::ChunkKey>
+  struct chunk_task {
+    KeyType key;
+    uint64_t epoch;
+
+    // optional - called on the worker thread once the chunk is cached (or cancelled)
+    ChunkReadyCallback<ChunkType, KeyType> on_ready;
+
+    // impl::NowNs() when queued, for queue latency. 0 if unknown
+    int64_t enqueued_at = 0;
+
+    // prefetched - nothing waits on it
+    bool background = false;
+  };
+
+  // keys being generated right now, and who else is waiting on them
+  template <typename ChunkType, typename KeyType = chunker::ChunkKey>
+  using ChunkInFlightTable = InFlightTable<ChunkReadyCallback<ChunkType, KeyType>, KeyType>;
+
+  /**
+   * @brief per-worker generation state - owns one generator, and writes finished chunks to the shared cache.
+   * run by a TypedChunkThreadPool's executor thread, so generators are never shared between threads.
+   * a key already being generated by another worker is never generated twice - see InFlightTable.
+   */
+  template <typename ChunkGenerator, typename ChunkType, typename CacheType = ChunkCache<ChunkType>>
   class TypedChunkThread {
-    static_assert(chunker::traits::chunk_gen_type<ChunkGenerator, ChunkType>::value);
+    typedef typename CacheType::key_type KeyType;
+    typedef decltype(std::declval<const KeyType&>().Identifier()) IdentifierType;
+    typedef chunk_task<ChunkType, KeyType> TaskType;
+    typedef ChunkReadyCallback<ChunkType, KeyType> ReadyCallback;
+    typedef ChunkInFlightTable<ChunkType, KeyType> InFlightType;
+    typedef DiskChunkStore<ChunkType, traits::chunk_serializer<ChunkType>, KeyType> DiskTierType;
+    static_assert(chunker::traits::chunk_gen_type<ChunkGenerator, ChunkType, IdentifierType>::value);
 
     public:
+    // how a worker reaches back into its pool - see SetPoolHooks
+    struct PoolHooks {
+      // (background) - keeps the pool's Wait() blocked until release, as if the task were still running.
+      // background tasks only block waiting on everything, prefetches included
+      std::function<void(bool)> hold;
+      std::function<void(bool)> release;
+
+      // queues a task again. any thread
+      std::function<void(const TaskType&)> resubmit;
+    };
+
     TypedChunkThread(
       std::shared_ptr<ChunkGenerator> generator,
-      util::LRUCache<chunker::ChunkIdentifier, std::shared_ptr<ChunkType>>& cache,
-      tbb::concurrent_queue<chunker::ChunkIdentifier>& queue,
+      CacheType& cache,
+      InFlightType& in_flight,
+      const BasicGenerationEpoch<KeyType>& epoch,
+      impl::GenerationCounters& counters,
       size_t thread_id
-    ) : generator_(generator), chunk_cache_(cache), chunk_queue_(queue), thread_active_(true), thread_id_(thread_id) {
-      thread_ = std::thread(&TypedChunkThread::ThreadFunc, this);
-      running_job_ = false;
+    ) : generator_(generator), chunk_cache_(cache), in_flight_(in_flight), epoch_(epoch), counters_(counters), thread_id_(thread_id) {}
+
+    /**
+     * @brief adds a disk tier behind the cache - checked before generating, and written back to on eviction.
+     * only while no task is running. nullptr removes it.
+     */
+    void SetDiskTier(DiskTierType* disk) {
+      disk_ = disk;
+    }
+
+    /**
+     * @brief lets tasks finish off this worker's thread, and still be waited on - foreground tasks attached to a chunk
+     * another worker is generating (maybe a prefetch), and chunks read back by the disk tier's thread.
+     * set before any task runs. w/o hooks, attached tasks finish right away, and the disk tier isn't read.
+     */
+    void SetPoolHooks(PoolHooks hooks) {
+      hooks_ = std::move(hooks);
     }
 
     TypedChunkThread(const TypedChunkThread& other) = delete;
@@ -36,105 +115,234 @@ namespace chunker {
     TypedChunkThread operator=(const TypedChunkThread& other) = delete;
     TypedChunkThread operator=(TypedChunkThread&& other) = delete;
 
+    /**
+     * @brief generates the chunk for task, unless it's already cached, in flight elsewhere, or no longer wanted.
+     * then fires its callback, if any - along w those of anyone who attached while this worker generated it.
+     */
+    void Run(const TaskType& task) {
+      CHUNKER_TRACE_THREAD_NAME("chunk worker", thread_id_);
+      int64_t start = impl::NowNs();
+      int level = impl::LodCounters::Level(task.key.Size());
+      if (task.enqueued_at != 0) {
+        metrics_.lods.queued[level].Record(start - task.enqueued_at);
+        CHUNKER_TRACE_ASYNC("chunk", "queued", task.enqueued_at, start, util::KeyTraceArgs(task.key));
+      }
 
-    void Wait() {
-      std::unique_lock<std::mutex> lock(queue_lock_);
-      // notify cond - remove predicate so that it will wake when notified
-      // *always* try to pull once, then sleep again
-      cond_.notify_all();
-      wait_cond_.wait(lock, [&]{ return PredicateCondition(); });
-    }
+      bool made = RunTask(task);
 
-    bool PredicateCondition() {
-      return (chunk_queue_.empty() && !running_job_) || !thread_active_;
-    }
+      int64_t end = impl::NowNs();
+      if (made) {
+        metrics_.lods.running[level].Record(end - start);
+      }
 
-    void RefreshThread() {
-      cond_.notify_all();
-      wait_cond_.notify_all();
+      CHUNKER_TRACE_SPAN("chunk", "run", start, end, util::KeyTraceArgs(task.key));
+
+      impl::Bump(metrics_.busy_ns, static_cast<uint64_t>(end - start));
+      impl::Bump(metrics_.tasks, 1);
     }
 
-    ~TypedChunkThread() {
-      // threads arent cleaning up very nicely
-      thread_active_ = false;
-      cond_.notify_all();
-      thread_.join();
-      wait_cond_.notify_all();
+    // what this worker has recorded - read from any thread
+    const impl::WorkerCounters& Metrics() const {
+      return metrics_;
     }
 
     private:
-    std::shared_ptr<ChunkGenerator> gen;
+    // true if this worker made the chunk - generated it, or read it back from disk
+    bool RunTask(const TaskType& task) {
+      if (epoch_.IsStale(task.key, task.epoch)) {
+        counters_.dropped.fetch_add(1, std::memory_order_relaxed);
+        Notify(task.on_ready, task.key, nullptr);
+        return false;
+      }
+
+      std::shared_ptr<ChunkType> chunk;
+      bool hit = chunk_cache_.Fetch(task.key, &chunk);
+      metrics_.cache.RecordFetch(hit);
+      if (hit) {
+        counters_.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        Notify(task.on_ready, task.key, chunk);
+        return false;
+      }
+
+      if (!Acquire(task)) {
+        // the owner calls on_ready for us
+        counters_.deduped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+
+      bool made = true;
+
+      // an owner may have released this key between our miss and Acquire
+      if (chunk_cache_.Fetch(task.key, &chunk)) {
+        counters_.cache_hits.fetch_add(1, std::memory_order_relaxed);
+        made = false;
+      } else if (LoadFromDisk(task)) {
+        // the disk tier's thread finishes it - see FinishLoad
+        return false;
+      } else {
+        // nullptr if abandoned
+        chunk = Generate(task);
+        made = (chunk != nullptr);
+      }
+
+      Notify(task.on_ready, task.key, chunk);
+      for (auto& w : in_flight_.Release(task.key)) {
+        Notify(w.on_ready, task.key, chunk);
+      }
 
-    // thinking: we need a little bit more work to make this completely generic - worth it?
-    // (issue: two completely different libraries; might be worth specializing just for sampling behavior)
-    // ((sampling is taking the most time rn))
+      return made;
+    }
+
+    // true if this worker now owns task's key
+    bool Acquire(const TaskType& task) {
+      if (task.background || !hooks_.hold) {
+        return in_flight_.Acquire(task.key, task.epoch, task.on_ready, task.background);
+      }
 
-    void ThreadFunc() {
-      chunker::ChunkIdentifier next_chunk;
-      while (true) {
-        {
-          std::unique_lock<std::mutex> lock(queue_lock_);
-          // we acquire this lock - the queue isn't empty. we run a loop.
-          if (chunk_queue_.empty()) {
-            // notify waiters that thread is done
+      // held before attaching - the owner may hand over before we return
+      hooks_.hold(false);
+      const PoolHooks* hooks = &hooks_;
+      ReadyCallback on_ready = [on_ready = task.on_ready, hooks](const KeyType& key, const std::shared_ptr<ChunkType>& chunk) {
+        Notify(on_ready, key, chunk);
+        hooks->release(false);
+      };
+
+      if (in_flight_.Acquire(task.key, task.epoch, on_ready)) {
+        hooks_.release(false);
+        return true;
+      }
 
-            // def a few instabilities in the thread functionality
-            // - keep moving, but hunt for them as they appear
+      return false;
+    }
 
-            // (was: thread chunk + 444 before, consistently. no  idea what that corresponds to, tragically)
+    static void Notify(const ReadyCallback& on_ready, const KeyType& key, const std::shared_ptr<ChunkType>& chunk) {
+      if (on_ready) {
+        on_ready(key, chunk);
+      }
+    }
 
-            // alt1: add some 
-            wait_cond_.notify_all();
-            cond_.wait(lock);
+    // generates and caches task's key, which this worker owns. nullptr if cancelled, and no one else still wants it
+    std::shared_ptr<ChunkType> Generate(const TaskType& task) {
+      std::shared_ptr<ChunkType> chunk;
+      CHUNKER_TRACE_SCOPE_ARGS("chunk", "generate", util::KeyTraceArgs(task.key));
+      if constexpr (chunker::traits::chunk_gen_cancellable<ChunkGenerator, IdentifierType>::value) {
+        uint64_t epoch = task.epoch;
+        while (true) {
+          CancelToken token(&epoch_, &task.key, epoch);
+          chunk = generator_->Generate(task.key.Identifier(), token);
+          if (chunk != nullptr || !token.Cancelled()) {
+            break;
           }
 
-          if (!thread_active_) {
-            return;
+          counters_.aborted.fetch_add(1, std::memory_order_relaxed);
+
+          // someone who attached in a later epoch may still want it - if so, go again in theirs
+          stale_.clear();
+          bool retry = in_flight_.Abort(task.key, epoch_, &epoch, &stale_);
+          for (auto& w : stale_) {
+            Notify(w.on_ready, task.key, nullptr);
+          }
+
+          if (!retry) {
+            return nullptr;
           }
         }
+      } else {
+        chunk = generator_->Generate(task.key.Identifier());
+      }
 
-        // something in this thread func is causing a crash
-        // most likely: the chunk cache lol
+      CachePut(task.key, chunk);
+      counters_.generated.fetch_add(1, std::memory_order_relaxed);
+      return chunk;
+    }
 
-        // if false: re-runs
-        running_job_ = true;
-        if (chunk_queue_.try_pop(next_chunk)) {
-          std::shared_ptr<ChunkType> chunk;
-          if (!chunk_cache_.Fetch(next_chunk, &chunk)) {
-            // not cached
+    // true if task's key is on disk - read back on the disk tier's thread, and held until it lands, so we can move on
+    bool LoadFromDisk(const TaskType& task) {
+      if constexpr (chunker::traits::chunk_serializable<ChunkType>::value) {
+        if (disk_ == nullptr || !hooks_.hold) {
+          return false;
+        }
 
-            // i would assume the crash is appearing here... but there's nothing to confirm that
-            // print("generating...");
-            chunk = generator_->Generate(next_chunk);
-            chunk_cache_.Put(
-              next_chunk, chunk
-            );
-          } 
+        CHUNKER_TRACE_INSTANT("chunk", "disk_load", util::KeyTraceArgs(task.key));
+        hooks_.hold(task.background);
+        if (!disk_->LoadAsync(task.key, [this, task](const std::shared_ptr<ChunkType>& chunk) { FinishLoad(task, chunk); })) {
+          hooks_.release(task.background);
+          return false;
+        }
 
+        return true;
+      } else {
+        return false;
+      }
+    }
+
+    // runs on the disk tier's thread (or ours, if the chunk was still queued for writing). sticks to what's thread safe -
+    // metrics_ and the scratch lists belong to our thread
+    void FinishLoad(const TaskType& task, const std::shared_ptr<ChunkType>& chunk) {
+      if (chunk == nullptr) {
+        // unreadable, and dropped from the disk tier - hand the key and anyone attached back to the pool, to generate.
+        // attached prefetches stay in the background, so Wait() still doesn't block on them
+        for (auto& w : in_flight_.Release(task.key)) {
+          hooks_.resubmit(TaskType { task.key, w.epoch, w.on_ready, impl::NowNs(), w.background });
         }
 
-        // true while we're crunching a chunk.
-        running_job_ = false;
+        hooks_.resubmit(task);
+        hooks_.release(task.background);
+        return;
+      }
+
+      counters_.disk_hits.fetch_add(1, std::memory_order_relaxed);
+      typename CacheType::EvictList evicted;
+      chunk_cache_.Put(task.key, chunk, &evicted);
+      if (!evicted.empty()) {
+        disk_->WriteBack(evicted);
       }
+
+      Notify(task.on_ready, task.key, chunk);
+      for (auto& w : in_flight_.Release(task.key)) {
+        Notify(w.on_ready, task.key, chunk);
+      }
+
+      hooks_.release(task.background);
     }
 
-    util::LRUCache<chunker::ChunkIdentifier, std::shared_ptr<ChunkType>>& chunk_cache_;
+    // evicted chunks go to the disk tier, if there is one - queued here, written on its own thread
+    void CachePut(const KeyType& key, const std::shared_ptr<ChunkType>& chunk) {
+      CHUNKER_TRACE_SCOPE_ARGS("chunk", "cache_insert", util::KeyTraceArgs(key));
+      if constexpr (chunker::traits::chunk_serializable<ChunkType>::value) {
+        if (disk_ != nullptr) {
+          metrics_.cache.RecordPut(chunk_cache_.Put(key, chunk, &evicted_));
+          if (!evicted_.empty()) {
+            disk_->WriteBack(evicted_);
+          }
+
+          return;
+        }
+      }
+
+      std::shared_ptr<ChunkType>* no_output = nullptr;
+      metrics_.cache.RecordPut(chunk_cache_.Put(key, chunk, no_output));
+    }
 
-    std::mutex queue_lock_;
-    tbb::concurrent_queue<chunker::ChunkIdentifier>& chunk_queue_;
-    
     std::shared_ptr<ChunkGenerator> generator_;
+    CacheType& chunk_cache_;
+    InFlightType& in_flight_;
+
+    // optional second tier. owned by the pool
+    DiskTierType* disk_ = nullptr;
 
-    // condition variable indicating work to be done
-    std::condition_variable cond_;
+    // see SetPoolHooks
+    PoolHooks hooks_;
 
-    // condition variable notified when task complete
-    std::condition_variable wait_cond_;
+    // scratch for Generate and CachePut
+    typename InFlightType::WaiterList stale_;
+    typename CacheType::EvictList evicted_;
 
-    bool thread_active_;
+    const BasicGenerationEpoch<KeyType>& epoch_;
+    impl::GenerationCounters& counters_;
 
-    bool running_job_;
-    std::thread thread_;
+    // written only by this worker's thread
+    impl::WorkerCounters metrics_;
 
     size_t thread_id_;
   };
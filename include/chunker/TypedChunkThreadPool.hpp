@@ -3,105 +3,499 @@
 
 #include "chunker/util/LRUCache.hpp"
 #include "chunker/ChunkIdentifier.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/ChunkPriority.hpp"
+#include "chunker/DiskChunkStore.hpp"
+#include "chunker/GenerationEpoch.hpp"
+#include "chunker/GenerationStats.hpp"
+#include "chunker/PipelineMetrics.hpp"
 #include "chunker/TypedChunkThread.hpp"
+#include "chunker/util/CompletionQueue.hpp"
+#include "chunker/util/Trace.hpp"
+#include "chunker/util/WorkStealingExecutor.hpp"
 
 #include "gog43/Logger.hpp"
 
 // tba: chunker needs its own gog copy jej
 
-#include <tbb/concurrent_queue.h>
-
-// reuse this???
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace chunker {
-  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType>
+  /**
+   * @tparam Cache - cache type for finished chunks. LRUCache, or ShardedLRUCache when many threads hit the cache.
+   * The default is budgeted in bytes if the chunk type has a ByteSize() - see traits::chunk_cost - and in chunks otherwise.
+   * Caches w util::UnitCost are budgeted in chunks.
+   * Chunks are queued by the cache's key type - ChunkKey by default, VolumeChunkKey for volume chunks.
+   */
+  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType, typename Cache = ChunkCache<ChunkType>>
   class TypedChunkThreadPool {
     public:
-    typedef util::LRUCache<chunker::ChunkIdentifier, std::shared_ptr<ChunkType>> CacheType;
+    typedef Cache CacheType;
+    typedef TypedChunkThread<ChunkGenerator, ChunkType, CacheType> ThreadType;
+    typedef typename CacheType::key_type KeyType;
+
+    // what generators are handed - ChunkIdentifier w the default key
+    typedef decltype(std::declval<const KeyType&>().Identifier()) IdentifierType;
+    typedef BasicGenerationEpoch<KeyType> EpochType;
+
+    // (key) -> priority. lower runs sooner
+    typedef std::function<ChunkPriority(const KeyType&)> PriorityFunc;
+
+    typedef ChunkReadyCallback<ChunkType, KeyType> ReadyCallback;
+
+    // finished (key, chunk) pairs, handed from workers to whoever drains the queue
+    typedef util::CompletionQueue<std::pair<KeyType, std::shared_ptr<ChunkType>>> ReadyQueue;
+
+    // 256MiB for byte-costed caches, 1024 chunks for entry-counted ones
+    static constexpr size_t DEFAULT_CACHE_BUDGET = (CacheType::COUNTS_ENTRIES ? 1024 : (static_cast<size_t>(256) << 20));
+
+    // bytes on disk, for OpenDiskTier
+    static constexpr size_t DEFAULT_DISK_BUDGET = DiskChunkStore<ChunkType, traits::chunk_serializer<ChunkType>, KeyType>::DEFAULT_BUDGET;
+
+    /**
+     * @param max_threads - number of generator threads
+     * @param factory - creates a generator per thread
+     * @param cache_budget - budget for finished chunks, in the cache's cost units
+     */
     TypedChunkThreadPool(
       size_t max_threads,
-      std::shared_ptr<ChunkGenFactory> factory
-    ) : chunk_cache(1024), chunk_queue() {
-      this->threads = max_threads;
-      this->thread_list = new TypedChunkThread<ChunkGenerator, ChunkType>*[threads];
-      for (int i = 0; i < threads; i++) {
-
-        thread_list[i] = new TypedChunkThread<ChunkGenerator, ChunkType>(
-          factory->Create(),
-          chunk_cache,
-          chunk_queue,
-          i
-        );
+      std::shared_ptr<ChunkGenFactory> factory,
+      size_t cache_budget = DEFAULT_CACHE_BUDGET
+    ) : chunk_cache(cache_budget),
+        created_at_(impl::NowNs()),
+        workers_(CreateWorkers(max_threads, factory, chunk_cache, in_flight_, epoch_, counters_)),
+        executor_(workers_.size(), [this](size_t worker, TaskType& task) { workers_[worker]->Run(task); }) {
+      typename ThreadType::PoolHooks hooks {
+        [this](bool background) { executor_.Hold(background); },
+        [this](bool background) { executor_.Release(background); },
+        [this](const TaskType& task) { Resubmit(task); }
+      };
+
+      for (auto& worker : workers_) {
+        worker->SetPoolHooks(hooks);
       }
     }
 
-    void Reserve(size_t cache_size) {
-      chunk_cache.Reserve(cache_size);
+    // w a disk tier open, finishes queued chunks, then writes everything still cached to it. otherwise queued chunks are dropped
+    ~TypedChunkThreadPool() {
+      if (disk_ != nullptr) {
+        FlushDiskTier();
+      }
     }
 
-    void Enqueue(const chunker::ChunkIdentifier& identifier) {
-      // try to refresh ID in cache
-      chunk_queue.emplace(identifier);
+    /**
+     * @brief opens an on-disk tier behind the cache, in directory - see DiskChunkStore.
+     * chunks evicted from memory are written back to it, and it's checked before generating. reads happen on the tier's
+     * own thread, so a worker moves on to its next chunk while one loads - Wait() still covers them. chunks left there
+     * by an earlier run are picked up. waits for queued chunks first.
+     *
+     * @param directory - created if it doesn't exist
+     * @param budget - bytes of chunk files to keep. least recently used files are deleted past it
+     */
+    void OpenDiskTier(const std::string& directory, size_t budget = DEFAULT_DISK_BUDGET) {
+      static_assert(traits::chunk_serializable<ChunkType>::value, "disk tier needs a traits::chunk_serializer for the chunk type");
+      executor_.WaitAll();
+      disk_ = std::make_unique<DiskTierType>(directory, budget);
+      for (auto& worker : workers_) {
+        worker->SetDiskTier(disk_.get());
+      }
     }
 
-    void Wake() {
-      for (size_t i = 0; i < threads; i++) {
-        thread_list[i]->RefreshThread();
+    /**
+     * @brief writes every cached chunk to the disk tier, and blocks until the writes land.
+     * waits for queued chunks first. no-op w/o a disk tier.
+     */
+    void FlushDiskTier() {
+      if constexpr (traits::chunk_serializable<ChunkType>::value) {
+        if (disk_ == nullptr) {
+          return;
+        }
+
+        executor_.WaitAll();
+        typename DiskTierType::ChunkList chunks;
+        for (auto itr = chunk_cache.begin(); itr != chunk_cache.end(); itr++) {
+          chunks.emplace_back(itr.Key(), *itr);
+        }
+
+        disk_->WriteBack(chunks);
+        disk_->Flush();
       }
     }
 
-    void Wait() {
-      // won't work anymore? neh it'll wait until all threads are done processing chunks
-      for (size_t i = 0; i < threads; i++) {
-        thread_list[i]->Wait();
+    // chunks on disk, or queued to be written. 0 w/o a disk tier
+    size_t DiskTierSize() {
+      if constexpr (traits::chunk_serializable<ChunkType>::value) {
+        return (disk_ == nullptr ? 0 : disk_->Size());
+      } else {
+        return 0;
+      }
+    }
+
+    /**
+     * @brief ensures the cache can hold `chunk_count` chunks at once - the cache keeps at least that many, going over
+     * budget if it has to. replaces the last reservation, so once what's wanted shrinks, the cache falls back under budget.
+     * byte-budgeted caches can't know what chunks cost before they're generated, so this is always a chunk count.
+     */
+    void Reserve(size_t chunk_count) {
+      chunk_cache.ReserveEntries(chunk_count);
+    }
+
+    // cache budget, in cost units
+    size_t CacheBudget() {
+      return chunk_cache.Capacity();
+    }
+
+    // cost of everything currently cached
+    size_t CacheUsage() {
+      return chunk_cache.Usage();
+    }
+
+    // highest cache usage seen so far
+    size_t CacheHighWaterMark() {
+      return chunk_cache.HighWaterMark();
+    }
+
+    /**
+     * @brief sets how queued chunks are ordered. an empty func runs them in enqueue order.
+     * not thread safe w Enqueue - call it from the thread which enqueues.
+     */
+    void SetPriority(PriorityFunc priority) {
+      priority_ = priority;
+    }
+
+    /**
+     * @brief orders queued chunks by distance from the viewer, finest first on ties
+     */
+    void SetViewer(const glm::vec3& position) {
+      priority_ = ViewerDistancePriority { position.x, position.z };
+    }
+
+    /**
+     * @brief re-scores chunks still queued w the current priority func - chunks queued before a SetPriority otherwise
+     * keep the priority they were queued w. no-op w/o a priority func.
+     */
+    void Reprioritize() {
+      if (!priority_) {
+        return;
       }
+
+      executor_.Reprioritize([this](const TaskType& task) {
+        return priority_(task.key);
+      });
+    }
+
+    void Enqueue(const IdentifierType& identifier) {
+      Enqueue(KeyType(identifier));
+    }
+
+    // workers pick keys up as soon as they're enqueued
+    void Enqueue(const KeyType& key) {
+      Submit(TaskType { key, epoch_.Current(), nullptr, impl::NowNs() });
+    }
+
+    void Enqueue(const IdentifierType& identifier, ReadyCallback on_ready) {
+      Enqueue(KeyType(identifier), std::move(on_ready));
+    }
+
+    /**
+     * @brief enqueues key, and calls on_ready from the worker thread once its chunk is cached.
+     * on_ready receives nullptr if the key is cancelled by a later epoch. see PushTo for handing chunks back to another thread.
+     */
+    void Enqueue(const KeyType& key, ReadyCallback on_ready) {
+      Submit(TaskType { key, epoch_.Current(), std::move(on_ready), impl::NowNs() });
+    }
+
+    // ahead of anything less urgent, regardless of the priority func
+    void Enqueue(const KeyType& key, const ChunkPriority& priority) {
+      CHUNKER_TRACE_INSTANT("pool", "enqueue", util::KeyTraceArgs(key));
+      epoch_.Revive(key);
+      executor_.Submit(TaskType { key, epoch_.Current(), nullptr, impl::NowNs() }, priority);
     }
 
+    std::future<std::shared_ptr<ChunkType>> EnqueueFuture(const IdentifierType& identifier) {
+      return EnqueueFuture(KeyType(identifier));
+    }
+
+    /**
+     * @brief enqueues key
+     * @return std::future<std::shared_ptr<ChunkType>> - ready once the chunk is cached. holds nullptr if the key is cancelled.
+     */
+    std::future<std::shared_ptr<ChunkType>> EnqueueFuture(const KeyType& key) {
+      auto promise = std::make_shared<std::promise<std::shared_ptr<ChunkType>>>();
+      std::future<std::shared_ptr<ChunkType>> res = promise->get_future();
+      Enqueue(key, [promise](const KeyType&, const std::shared_ptr<ChunkType>& chunk) {
+        promise->set_value(chunk);
+      });
+
+      return res;
+    }
+
+    /**
+     * @return ReadyCallback - pushes each finished (key, chunk) onto queue, for another thread to drain
+     */
+    static ReadyCallback PushTo(ReadyQueue& queue) {
+      return [&queue](const KeyType& key, const std::shared_ptr<ChunkType>& chunk) {
+        queue.Push(std::make_pair(key, chunk));
+      };
+    }
+
+    /**
+     * @brief enqueues a batch of keys - by priority if one is set, otherwise spread evenly across workers
+     *
+     * @param keys - keys to generate
+     * @param on_ready - optional, called for each key as in Enqueue
+     */
+    void EnqueueBulk(const std::vector<KeyType>& keys, const ReadyCallback& on_ready = nullptr) {
+      CHUNKER_TRACE_SCOPE_ARGS("pool", "enqueue_bulk", util::CountTraceArgs(keys.size()));
+      uint64_t epoch = epoch_.Current();
+      int64_t now = impl::NowNs();
+      tasks_.clear();
+      for (auto& key : keys) {
+        epoch_.Revive(key);
+        tasks_.push_back(TaskType { key, epoch, on_ready, now });
+      }
+
+      if (!priority_) {
+        executor_.SubmitBulk(tasks_.begin(), tasks_.end());
+        return;
+      }
+
+      priorities_.clear();
+      for (auto& key : keys) {
+        priorities_.push_back(priority_(key));
+      }
+
+      executor_.SubmitBulk(tasks_.begin(), tasks_.end(), priorities_.begin());
+    }
+
+    /**
+     * @brief enqueues keys behind everything else - workers only get to them when there's nothing more urgent.
+     * Wait() doesn't wait for them, unless an enqueued chunk attaches to one in flight.
+     * they're stamped w the current epoch, so a later epoch can drop them like any other.
+     */
+    void Prefetch(const std::vector<KeyType>& keys) {
+      CHUNKER_TRACE_SCOPE_ARGS("pool", "prefetch", util::CountTraceArgs(keys.size()));
+      uint64_t epoch = epoch_.Current();
+      int64_t now = impl::NowNs();
+      tasks_.clear();
+      for (auto& key : keys) {
+        epoch_.Revive(key);
+        tasks_.push_back(TaskType { key, epoch, nullptr, now, true });
+      }
+
+      executor_.SubmitBackground(tasks_.begin(), tasks_.end());
+    }
+
+    /**
+     * @brief starts a new generation epoch. chunks queued in older epochs are dropped, unless they're in live.
+     *
+     * @param live - keys from older epochs which are still wanted. nullptr drops everything older.
+     * @return uint64_t - the new epoch
+     */
+    uint64_t AdvanceEpoch(std::shared_ptr<const typename EpochType::LiveSet> live) {
+      return epoch_.Advance(std::move(live));
+    }
+
+    /**
+     * @brief starts a new generation epoch, dropping only chunks queued for the retired keys. O(retired).
+     * keys enqueued again later are revived.
+     *
+     * @param retired - keys no longer wanted
+     * @return uint64_t - the new epoch
+     */
+    uint64_t AdvanceEpoch(const typename EpochType::RetiredList& retired) {
+      return epoch_.Retire(retired);
+    }
+
+    // keys retired since the last full AdvanceEpoch
+    size_t RetiredCount() const {
+      return epoch_.RetiredCount();
+    }
+
+    /**
+     * @brief counts of generated, cached, deduped and cancelled chunks, since construction
+     */
+    GenerationStats Stats() const {
+      return counters_.Snapshot();
+    }
+
+    /**
+     * @brief snapshot of queue depth, per-lod latencies, per-worker busy time and cache traffic, since construction.
+     * every counter is a relaxed atomic, so this never blocks workers - but counters may be a few tasks apart.
+     */
+    PipelineMetrics Metrics() const {
+      PipelineMetrics res;
+      res.generation = counters_.Snapshot();
+
+      // background count is bumped after the shared one - clamp, in case we land between the two
+      size_t queued = executor_.Queued();
+      res.prefetch_depth = std::min(executor_.BackgroundQueued(), queued);
+      res.queue_depth = queued - res.prefetch_depth;
+
+      // workers each keep their own counters - sum them up
+      res.cache = CacheStats { fetch_hits_.load(std::memory_order_relaxed), fetch_misses_.load(std::memory_order_relaxed), 0, 0, 0 };
+      std::array<LodLatency, impl::LodCounters::LEVEL_COUNT> lods {};
+      uint64_t lifetime = static_cast<uint64_t>(impl::NowNs() - created_at_);
+      for (auto& worker : workers_) {
+        const impl::WorkerCounters& counters = worker->Metrics();
+        counters.cache.AddTo(&res.cache);
+        counters.lods.AddTo(&lods);
+
+        uint64_t busy = counters.busy_ns.load(std::memory_order_relaxed);
+        uint64_t tasks = counters.tasks.load(std::memory_order_relaxed);
+        res.workers.push_back(WorkerTime { busy, (lifetime > busy ? lifetime - busy : 0), tasks });
+      }
+
+      for (int i = 0; i < impl::LodCounters::LEVEL_COUNT; i++) {
+        if (lods[i].queued.count != 0 || lods[i].running.count != 0) {
+          lods[i].size = static_cast<size_t>(1) << i;
+          res.lods.push_back(lods[i]);
+        }
+      }
+
+      return res;
+    }
+
+    /**
+     * @brief blocks until every enqueued chunk is cached - prefetched chunks aside, unless an enqueued chunk is waiting on one
+     */
+    void Wait() {
+      CHUNKER_TRACE_SCOPE("pool", "wait");
+      executor_.Wait();
+    }
+
+    // true once nothing is queued or running, prefetches included
     bool Empty() {
-      return chunk_queue.empty();
+      return (executor_.Pending() == 0);
     }
 
-    typename util::LRUCache<chunker::ChunkIdentifier, std::shared_ptr<ChunkType>>::iterator BoundedIterator(size_t chunk_count) {
+    typename CacheType::iterator BoundedIterator(size_t chunk_count) {
 
       // not thread safe - any scenario in which we'd read this while the chunk is active??
       return chunk_cache.begin_bounded(chunk_count);
     }
 
-    typename util::LRUCache<chunker::ChunkIdentifier, std::shared_ptr<ChunkType>>::iterator End() {
+    typename CacheType::iterator End() {
       return chunk_cache.end();
     }
 
-    std::shared_ptr<ChunkType> GetChunk(const chunker::ChunkIdentifier& chunk) {
+    // true if key is cached. doesn't touch its lru position
+    bool HasChunk(const KeyType& key) {
+      return chunk_cache.Has(key);
+    }
+
+    std::shared_ptr<ChunkType> GetChunk(const IdentifierType& chunk) {
+      return GetChunk(KeyType(chunk));
+    }
+
+    std::shared_ptr<ChunkType> GetChunk(const KeyType& chunk) {
       std::shared_ptr<ChunkType> out;
-      bool found = chunk_cache.Fetch(chunk, &out);
+      RecordFetch(chunk_cache.Fetch(chunk, &out));
       return out;
     }
 
+    /**
+     * @brief fetches a chunk from cache
+     * 
+     * @param chunk - id of chunk
+     * @param output - output param for chunk
+     * @return true if the chunk was cached
+     * @return false otherwise
+     */
+    bool FetchChunk(const IdentifierType& chunk, std::shared_ptr<ChunkType>* output) {
+      return FetchChunk(KeyType(chunk), output);
+    }
+
+    bool FetchChunk(const KeyType& chunk, std::shared_ptr<ChunkType>* output) {
+      bool res = chunk_cache.Fetch(chunk, output);
+      RecordFetch(res);
+      return res;
+    }
+
     TypedChunkThreadPool(const TypedChunkThreadPool& other) = delete;
     TypedChunkThreadPool(TypedChunkThreadPool&& other) = delete;
     TypedChunkThreadPool operator=(const TypedChunkThreadPool& other) = delete;
     TypedChunkThreadPool operator=(TypedChunkThreadPool&& other) = delete;
 
-    ~TypedChunkThreadPool() {
-      for (int i = 0; i < threads; i++) {
-        delete thread_list[i];
+    private:
+    typedef chunk_task<ChunkType, KeyType> TaskType;
+    typedef DiskChunkStore<ChunkType, traits::chunk_serializer<ChunkType>, KeyType> DiskTierType;
+
+    void Submit(TaskType task) {
+      CHUNKER_TRACE_INSTANT("pool", "enqueue", util::KeyTraceArgs(task.key));
+      epoch_.Revive(task.key);
+      if (priority_) {
+        ChunkPriority priority = priority_(task.key);
+        executor_.Submit(std::move(task), priority);
+      } else {
+        executor_.Submit(std::move(task));
       }
+    }
 
-      delete thread_list;
+    // a task handed back by a worker, from any thread - skips the priority func, which only the enqueueing thread may call
+    void Resubmit(const TaskType& task) {
+      if (task.background) {
+        executor_.SubmitBackground(&task, &task + 1);
+      } else {
+        executor_.Submit(task);
+      }
+    }
+
+    void RecordFetch(bool hit) {
+      (hit ? fetch_hits_ : fetch_misses_).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static std::vector<std::unique_ptr<ThreadType>> CreateWorkers(
+      size_t max_threads,
+      std::shared_ptr<ChunkGenFactory>& factory,
+      CacheType& cache,
+      ChunkInFlightTable<ChunkType, KeyType>& in_flight,
+      const EpochType& epoch,
+      impl::GenerationCounters& counters
+    ) {
+      std::vector<std::unique_ptr<ThreadType>> res;
+      for (size_t i = 0; i < std::max(max_threads, static_cast<size_t>(1)); i++) {
+        res.push_back(std::make_unique<ThreadType>(factory->Create(), cache, in_flight, epoch, counters, i));
+      }
+
+      return res;
     }
 
-    private:
-    size_t threads;
-    // with this approach: threads need to pull work from a common queue st work isn't over-shared
-    // how can we re-implement inactive threads?
-    // - call some func on a wait cond telling them to sleep (FOREVER)
-    // - once re-activated: re-awaken :3
-
-    size_t active_threads;
-    TypedChunkThread<ChunkGenerator, ChunkType>** thread_list;
     CacheType chunk_cache;
+    ChunkInFlightTable<ChunkType, KeyType> in_flight_;
+    EpochType epoch_;
+    impl::GenerationCounters counters_;
+
+    // lookups from FetchChunk / GetChunk - any thread may call those, unlike workers' own counters
+    std::atomic<uint64_t> fetch_hits_ { 0 };
+    std::atomic<uint64_t> fetch_misses_ { 0 };
+
+    // impl::NowNs() at construction - workers are idle whenever they aren't busy since then
+    int64_t created_at_;
+
+    // optional - see OpenDiskTier
+    std::unique_ptr<DiskTierType> disk_;
+
+    // one per executor thread - indexed by worker
+    std::vector<std::unique_ptr<ThreadType>> workers_;
+
+    PriorityFunc priority_;
+
+    // scratch for EnqueueBulk
+    std::vector<TaskType> tasks_;
+    std::vector<ChunkPriority> priorities_;
 
-    tbb::concurrent_queue<ChunkIdentifier> chunk_queue;
+    // last, so its threads are joined before the workers and cache go away
+    util::WorkStealingExecutor<TaskType, ChunkPriority> executor_;
   };
 }
 
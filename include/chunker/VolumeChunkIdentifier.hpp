@@ -0,0 +1,103 @@
+#ifndef VOLUME_CHUNK_IDENTIFIER_H_
+#define VOLUME_CHUNK_IDENTIFIER_H_
+
+#include "chunker/lod/LinearLodOctree.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace chunker {
+  /**
+   * @brief sizes of the 26 chunks around a volume chunk - 6 across faces, 12 across edges, 8 across corners.
+   * all powers of two, and never smaller than the chunk itself (like ChunkNeighbors).
+   */
+  struct VolumeChunkNeighbors {
+    // indexed by Index(dx, dy, dz). the center slot is unused, and left at zero
+    std::array<size_t, 27> sizes;
+
+    VolumeChunkNeighbors() : sizes() {}
+
+    /**
+     * @param dx, dy, dz - offset to the neighbor, each -1, 0 or 1
+     */
+    static int Index(int dx, int dy, int dz) {
+      return (dx + 1) + 3 * (dy + 1) + 9 * (dz + 1);
+    }
+
+    size_t At(int dx, int dy, int dz) const {
+      return sizes[Index(dx, dy, dz)];
+    }
+
+    // 1 for faces, 2 for edges, 3 for corners
+    static int SharedAxes(int dx, int dy, int dz) {
+      return (dx != 0) + (dy != 0) + (dz != 0);
+    }
+
+    bool operator==(const VolumeChunkNeighbors& rhs) const {
+      return sizes == rhs.sizes;
+    }
+  };
+
+  /**
+   * @brief identifies a cube of a volume - the 3D counterpart to ChunkIdentifier, for chunks from an LOD octree.
+   * y is up.
+   */
+  struct VolumeChunkIdentifier {
+    long x;
+    long y;
+    long z;
+
+    size_t size;
+    size_t chunk_res;
+
+    VolumeChunkNeighbors neighbors;
+
+    VolumeChunkIdentifier() : x(0), y(0), z(0), size(0), chunk_res(0), neighbors() {}
+
+    // neighbors already resolved
+    VolumeChunkIdentifier(long x, long y, long z, size_t chunk_size, size_t chunk_res, const VolumeChunkNeighbors& neighbors)
+      : x(x), y(y), z(z), size(chunk_size), chunk_res(chunk_res), neighbors(neighbors) {}
+
+    /**
+     * @brief samples neighbor sizes from tree, just past each face, edge and corner
+     *
+     * @param x, y, z - world space origin
+     * @param tree_origin - origin in tree space
+     */
+    VolumeChunkIdentifier(long x, long y, long z, const glm::ivec3& tree_origin, size_t chunk_size, size_t chunk_res, const lod::LinearLodOctree& tree)
+      : x(x), y(y), z(z), size(chunk_size), chunk_res(chunk_res), neighbors() {
+      // per axis: just before the near face, the middle, just past the far face
+      float half_size = static_cast<float>(chunk_size / 2);
+      glm::vec3 near_corner = glm::vec3(tree_origin) - 0.5f;
+      glm::vec3 far_corner = glm::vec3(tree_origin) + static_cast<float>(chunk_size) + 0.5f;
+      glm::vec3 center = glm::vec3(tree_origin) + half_size;
+      glm::vec3 samples[3] = { near_corner, center, far_corner };
+
+      for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+          for (int dx = -1; dx <= 1; dx++) {
+            if (dx == 0 && dy == 0 && dz == 0) {
+              continue;
+            }
+
+            glm::vec3 sample(samples[dx + 1].x, samples[dy + 1].y, samples[dz + 1].z);
+            neighbors.sizes[VolumeChunkNeighbors::Index(dx, dy, dz)] = std::max(tree.GetChunkSize(sample), chunk_size);
+          }
+        }
+      }
+    }
+
+    size_t GetStepSize() const {
+      return (size / chunk_res);
+    }
+
+    bool operator==(const VolumeChunkIdentifier& rhs) const {
+      return (rhs.x == x && rhs.y == y && rhs.z == z && rhs.size == size && rhs.chunk_res == chunk_res && rhs.neighbors == neighbors);
+    }
+  };
+}
+
+#endif // VOLUME_CHUNK_IDENTIFIER_H_
@@ -0,0 +1,204 @@
+#ifndef VOLUME_CHUNK_KEY_H_
+#define VOLUME_CHUNK_KEY_H_
+
+#include "chunker/VolumeChunkIdentifier.hpp"
+#include "chunker/util/DyadicScale.hpp"
+#include "chunker/util/Hash.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace chunker {
+  /**
+   * @brief Packed form of a VolumeChunkIdentifier, w a hash computed once on construction - what volume pools queue and cache by.
+   *
+   * As w ChunkKey, sizes are powers of two and stored as log2s: one byte per neighbor, plus size and chunk_res.
+   * Round-trips losslessly through Identifier(). Identifiers are checked as ChunkKey checks them - a size, chunk_res or
+   * neighbor size which isn't zero or a power of two throws. Use TryCreate to check without throwing.
+   */
+  class VolumeChunkKey {
+  public:
+    VolumeChunkKey() : VolumeChunkKey(VolumeChunkIdentifier()) {}
+
+    /**
+     * @brief throws std::invalid_argument if identifier can't be packed losslessly
+     */
+    explicit VolumeChunkKey(const VolumeChunkIdentifier& identifier) : x_(0), y_(0), z_(0), neighbors_(), size_(0), chunk_res_(0), hash_(0) {
+      if (!Init(identifier)) {
+        throw std::invalid_argument("VolumeChunkKey: size, chunk_res and neighbor sizes must be zero or powers of two");
+      }
+    }
+
+    /**
+     * @return false if identifier can't be packed losslessly. output is untouched then
+     */
+    static bool TryCreate(const VolumeChunkIdentifier& identifier, VolumeChunkKey* output) {
+      VolumeChunkKey res;
+      if (!res.Init(identifier)) {
+        return false;
+      }
+
+      *output = res;
+      return true;
+    }
+
+    /**
+     * @return VolumeChunkIdentifier - the identifier this key was created from
+     */
+    VolumeChunkIdentifier Identifier() const {
+      VolumeChunkIdentifier res;
+      res.x = static_cast<long>(x_);
+      res.y = static_cast<long>(y_);
+      res.z = static_cast<long>(z_);
+      res.size = UnpackLog2(size_);
+      res.chunk_res = UnpackLog2(chunk_res_);
+      for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+        res.neighbors.sizes[SlotIndex(i)] = UnpackLog2(neighbors_[i]);
+      }
+
+      return res;
+    }
+
+    operator VolumeChunkIdentifier() const {
+      return Identifier();
+    }
+
+    long X() const { return static_cast<long>(x_); }
+    long Y() const { return static_cast<long>(y_); }
+    long Z() const { return static_cast<long>(z_); }
+    size_t Size() const { return UnpackLog2(size_); }
+
+    size_t Hash() const {
+      return static_cast<size_t>(hash_);
+    }
+
+    bool operator==(const VolumeChunkKey& rhs) const {
+      return (hash_ == rhs.hash_ && x_ == rhs.x_ && y_ == rhs.y_ && z_ == rhs.z_ && size_ == rhs.size_ && chunk_res_ == rhs.chunk_res_
+        && std::memcmp(neighbors_, rhs.neighbors_, sizeof(neighbors_)) == 0);
+    }
+
+    bool operator!=(const VolumeChunkKey& rhs) const {
+      return !(*this == rhs);
+    }
+
+    // bytes written by Pack - everything but the hash
+    static const size_t PACKED_SIZE = 52;
+
+    /**
+     * @brief writes this key's fields to output, in host byte order - see ChunkKey::Pack
+     * @param output - at least PACKED_SIZE bytes
+     */
+    void Pack(uint8_t* output) const {
+      std::memcpy(output, &x_, sizeof(x_));
+      std::memcpy(output + 8, &y_, sizeof(y_));
+      std::memcpy(output + 16, &z_, sizeof(z_));
+      std::memcpy(output + 24, neighbors_, sizeof(neighbors_));
+      output[50] = size_;
+      output[51] = chunk_res_;
+    }
+
+    /**
+     * @brief inverse of Pack
+     * @param data - PACKED_SIZE bytes
+     */
+    static VolumeChunkKey Unpack(const uint8_t* data) {
+      VolumeChunkKey res;
+      std::memcpy(&res.x_, data, sizeof(res.x_));
+      std::memcpy(&res.y_, data + 8, sizeof(res.y_));
+      std::memcpy(&res.z_, data + 16, sizeof(res.z_));
+      std::memcpy(res.neighbors_, data + 24, sizeof(res.neighbors_));
+      res.size_ = data[50];
+      res.chunk_res_ = data[51];
+      res.hash_ = res.ComputeHash();
+      return res;
+    }
+
+  private:
+    static const int NEIGHBOR_COUNT = 26;
+
+    // log2 code for zero
+    static const uint8_t LOG2_ZERO = 0xFF;
+
+    // neighbor i -> slot in VolumeChunkNeighbors::sizes, skipping the center (13)
+    static int SlotIndex(int i) {
+      return (i < 13 ? i : i + 1);
+    }
+
+    // false leaves this key half written
+    bool Init(const VolumeChunkIdentifier& identifier) {
+      if (!PackLog2(identifier.size, &size_) || !PackLog2(identifier.chunk_res, &chunk_res_)) {
+        return false;
+      }
+
+      for (int i = 0; i < NEIGHBOR_COUNT; i++) {
+        if (!PackLog2(identifier.neighbors.sizes[SlotIndex(i)], &neighbors_[i])) {
+          return false;
+        }
+      }
+
+      x_ = identifier.x;
+      y_ = identifier.y;
+      z_ = identifier.z;
+      hash_ = ComputeHash();
+      return true;
+    }
+
+    // false unless value is zero or a power of two - anything else wouldn't round-trip
+    static bool PackLog2(uint64_t value, uint8_t* code) {
+      if (value == 0) {
+        *code = LOG2_ZERO;
+        return true;
+      }
+
+      if (!util::impl::IsPowerOfTwo(value)) {
+        return false;
+      }
+
+      *code = static_cast<uint8_t>(util::impl::Log2PowerOfTwo(value));
+      return true;
+    }
+
+    // masked, so codes from a bad Unpack never shift past 63
+    static size_t UnpackLog2(uint8_t code) {
+      return (code == LOG2_ZERO ? 0 : static_cast<size_t>(1) << (code & 63));
+    }
+
+    uint32_t ComputeHash() const {
+      uint64_t res = util::HashMix64(static_cast<uint64_t>(x_));
+      res = util::HashCombine(res, static_cast<uint64_t>(y_));
+      res = util::HashCombine(res, static_cast<uint64_t>(z_));
+      for (size_t i = 0; i < sizeof(neighbors_); i += 8) {
+        uint64_t packed = 0;
+        std::memcpy(&packed, neighbors_ + i, std::min(sizeof(packed), sizeof(neighbors_) - i));
+        res = util::HashCombine(res, packed);
+      }
+
+      res = util::HashCombine(res, (static_cast<uint64_t>(size_) << 8) | chunk_res_);
+      return static_cast<uint32_t>(res ^ (res >> 32));
+    }
+
+    int64_t x_;
+    int64_t y_;
+    int64_t z_;
+    uint8_t neighbors_[NEIGHBOR_COUNT];
+    uint8_t size_;
+    uint8_t chunk_res_;
+    uint32_t hash_;
+  };
+
+  static_assert(sizeof(VolumeChunkKey) == 56);
+}
+
+namespace std {
+  template<>
+  struct hash<chunker::VolumeChunkKey> {
+    size_t operator()(const chunker::VolumeChunkKey& key) const {
+      return key.Hash();
+    }
+  };
+}
+
+#endif // VOLUME_CHUNK_KEY_H_
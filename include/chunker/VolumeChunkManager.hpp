@@ -0,0 +1,343 @@
+#ifndef VOLUME_CHUNK_MANAGER_H_
+#define VOLUME_CHUNK_MANAGER_H_
+
+#include "chunker/traits/chunk_gen_type.hpp"
+#include "chunker/lod/LodOctreeGenerator.hpp"
+#include "chunker/lod/LinearLodOctree.hpp"
+#include "chunker/ChunkPriority.hpp"
+#include "chunker/VolumeChunkIdentifier.hpp"
+#include "chunker/VolumeChunkKey.hpp"
+
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace chunker {
+  /**
+   * @brief ChunkManager for volumes - chunks are cubes from an LOD octree, so detail falls off w height as well as across.
+   * Generators take a VolumeChunkIdentifier. Runs on the same pool, keyed by VolumeChunkKey.
+   *
+   * tba: no hysteresis, prefetch or streaming yet
+   */
+  template <typename ChunkGenFactory, typename ChunkGenerator, typename ChunkType, typename Cache = ChunkCache<ChunkType, VolumeChunkKey>>
+  class VolumeChunkManager {
+    typedef chunker::TypedChunkThreadPool<ChunkGenFactory, ChunkGenerator, ChunkType, Cache> PoolType;
+    static_assert(chunker::traits::chunk_gen_type<ChunkGenerator, ChunkType, VolumeChunkIdentifier>::value);
+    static_assert(chunker::traits::chunk_gen_factory_type<ChunkGenFactory, ChunkGenerator>::value);
+
+    struct visible_chunk {
+      chunker::VolumeChunkKey key;
+      std::shared_ptr<ChunkType> chunk;
+
+      // false until the chunk has been picked up from the pool
+      bool ready;
+    };
+
+    typedef std::unordered_map<uint64_t, visible_chunk> VisibleMap;
+   public:
+    /**
+     * @brief iterates over the chunks covering the current tree
+     */
+    class iterator {
+     public:
+      using iterator_category = std::forward_iterator_tag;
+      using difference_type = std::ptrdiff_t;
+      using value_type = std::shared_ptr<ChunkType>;
+      using reference = std::shared_ptr<ChunkType>&;
+      using pointer = std::shared_ptr<ChunkType>*;
+
+      iterator(typename VisibleMap::iterator itr) : itr_(itr) {}
+
+      iterator& operator++() {
+        ++itr_;
+        return *this;
+      }
+
+      iterator operator++(int) {
+        iterator stop(*this);
+        ++itr_;
+        return stop;
+      }
+
+      reference operator*() {
+        return itr_->second.chunk;
+      }
+
+      pointer operator->() {
+        return &itr_->second.chunk;
+      }
+
+      bool operator==(const iterator& other) const {
+        return itr_ == other.itr_;
+      }
+
+      bool operator!=(const iterator& other) const {
+        return !(itr_ == other.itr_);
+      }
+
+     private:
+      typename VisibleMap::iterator itr_;
+    };
+
+    /**
+     * @brief Construct a new Volume Chunk Manager object - see ChunkManager
+     *
+     * @param max_gen_distance - the max distance to generate chunks from, in any direction
+     */
+    VolumeChunkManager(
+      std::shared_ptr<ChunkGenFactory> chunk_factory,
+      size_t thread_count,
+      double max_gen_distance,
+      size_t min_chunk_size,
+      double cascade_factor,
+      size_t cache_budget = PoolType::DEFAULT_CACHE_BUDGET
+    ) : factory(chunk_factory),
+        gen_dist_(max_gen_distance),
+        // ensure tree size is at least 4x the max gen distance
+        tree_size_(static_cast<long>(1) << static_cast<long>(ceil(log2(max_gen_distance)) + 2)),
+        min_chunk_size_(min_chunk_size),
+        has_tree_(false),
+        last_offset_(0, 0, 0),
+        tree_gen_(tree_size_, min_chunk_size_),
+        thread_pool_(thread_count, factory, cache_budget),
+        nearest_first_(false)
+    {
+      tree_gen_.cascade_factor = cascade_factor;
+    }
+
+    /**
+     * @return true if nothing visible changed
+     */
+    bool UpdateChunkData(const glm::vec3& local_position) {
+      glm::vec3 relative_pos;
+      glm::ivec3 offset = TreeOffset(local_position, &relative_pos);
+      CHUNKER_TRACE_SCOPE("tree", "update");
+      {
+        CHUNKER_TRACE_SCOPE("tree", "build");
+        tree_gen_.CreateLodTree(relative_pos, MAX_CHUNK_SIZE_FACTOR, &tree_);
+      }
+
+      if (has_tree_ && offset == last_offset_ && tree_ == last_tree_) {
+        return true;
+      }
+
+      UpdateChunks(offset);
+
+      thread_pool_.Reserve(visible_.size());
+      if (nearest_first_) {
+        thread_pool_.SetPriority(VolumeDistancePriority { local_position.x, local_position.y, local_position.z });
+      }
+
+      AdvanceEpoch();
+      thread_pool_.EnqueueBulk(enqueued_);
+      enqueued_.clear();
+
+      has_tree_ = true;
+      last_offset_ = offset;
+      std::swap(tree_, last_tree_);
+      return false;
+    }
+
+    /**
+     * @brief Generates chunks nearest the viewer first, in 3D. Otherwise chunks generate in tree order.
+     */
+    void SetNearestFirst(bool nearest_first) {
+      nearest_first_ = nearest_first;
+      if (!nearest_first_) {
+        thread_pool_.SetPriority(nullptr);
+      }
+    }
+
+    size_t GetChunkCount() {
+      return visible_.size();
+    }
+
+    GenerationStats GetGenerationStats() const {
+      return thread_pool_.Stats();
+    }
+
+    /**
+     * @brief keeps chunks on disk in directory, behind the memory cache - see TypedChunkThreadPool::OpenDiskTier
+     */
+    void OpenDiskTier(const std::string& directory, size_t budget = PoolType::DEFAULT_DISK_BUDGET) {
+      thread_pool_.OpenDiskTier(directory, budget);
+    }
+
+    void wait() {
+      ResolvePending();
+    }
+
+    /**
+     * @brief iterates over the chunks covering the current tree. blocks until all of them are ready.
+     */
+    iterator begin() {
+      ResolvePending();
+      return iterator(visible_.begin());
+    }
+
+    iterator end() {
+      ResolvePending();
+      return iterator(visible_.end());
+    }
+
+   private:
+    static const long MAX_CHUNK_SIZE_FACTOR = 3;
+
+    // as ChunkManager::TreeOffset, w y nudged as well
+    glm::ivec3 TreeOffset(const glm::vec3& local_position, glm::vec3* relative_pos) const {
+      long nudge_factor = tree_size_ >> MAX_CHUNK_SIZE_FACTOR;
+      long half_size = tree_size_ / 2;
+      glm::ivec3 offset(0, 0, 0);
+      for (int axis = 0; axis < 3; axis++) {
+        // nudges which keep the viewer within nudge_factor of the tree's center
+        long steps = 0;
+        if (local_position[axis] > nudge_factor) {
+          steps = static_cast<long>(ceil(local_position[axis] / nudge_factor)) - 1;
+        } else if (local_position[axis] < -nudge_factor) {
+          steps = static_cast<long>(floor(local_position[axis] / nudge_factor)) + 1;
+        }
+
+        offset[axis] = static_cast<int>(steps * nudge_factor - half_size);
+        (*relative_pos)[axis] = local_position[axis] - static_cast<float>(offset[axis]);
+      }
+
+      return offset;
+    }
+
+    // rebuilds the visible set from tree_, carrying over chunks whose keys didn't change
+    void UpdateChunks(const glm::ivec3 offset) {
+      next_visible_.clear();
+      next_visible_.reserve(tree_.LeafCount());
+      pending_.clear();
+      for (uint64_t leaf : tree_.Leaves()) {
+        glm::ivec3 origin = tree_.LeafOrigin(leaf);
+        size_t size = tree_.LeafSize(leaf);
+        chunker::VolumeChunkKey key(chunker::VolumeChunkIdentifier(
+          offset.x + origin.x, offset.y + origin.y, offset.z + origin.z, origin, size, min_chunk_size_, tree_
+        ));
+
+        // leaves are only comparable against the last tree if it sat at the same offset - keys catch the rest
+        auto itr = visible_.find(leaf);
+        if (itr != visible_.end() && itr->second.key == key) {
+          // moved over - whatever's left behind in visible_ is no longer wanted
+          auto node = next_visible_.insert(visible_.extract(itr));
+          if (!node.position->second.ready) {
+            pending_.push_back(leaf);
+          }
+
+          continue;
+        }
+
+        visible_chunk& entry = next_visible_[leaf];
+        entry.key = key;
+        entry.chunk = nullptr;
+        entry.ready = false;
+        pending_.push_back(leaf);
+        enqueued_.push_back(key);
+      }
+
+      for (auto& entry : visible_) {
+        retired_.push_back(entry.second.key);
+      }
+
+      visible_.clear();
+      std::swap(visible_, next_visible_);
+    }
+
+    // picks up finished chunks for every pending leaf
+    void ResolvePending() {
+      CHUNKER_TRACE_SCOPE("manager", "resolve_pending");
+      while (!pending_.empty()) {
+        thread_pool_.Wait();
+
+        missed_.clear();
+        for (uint64_t leaf : pending_) {
+          visible_chunk& entry = visible_.at(leaf);
+          if (entry.ready) {
+            continue;
+          }
+
+          if (thread_pool_.FetchChunk(entry.key, &entry.chunk)) {
+            entry.ready = true;
+          } else {
+            // evicted before we got to it - generate it again
+            enqueued_.push_back(entry.key);
+            missed_.push_back(leaf);
+          }
+        }
+
+        std::swap(pending_, missed_);
+        thread_pool_.EnqueueBulk(enqueued_);
+        enqueued_.clear();
+      }
+    }
+
+    // queued work from older trees is dropped, unless it's still visible.
+    // only retires the keys UpdateChunks dropped - see ChunkManager::AdvanceEpoch
+    void AdvanceEpoch() {
+      if (thread_pool_.Empty()) {
+        thread_pool_.AdvanceEpoch(nullptr);
+        retired_.clear();
+        return;
+      }
+
+      if (thread_pool_.RetiredCount() + retired_.size() <= visible_.size()) {
+        thread_pool_.AdvanceEpoch(retired_);
+        retired_.clear();
+        return;
+      }
+
+      retired_.clear();
+
+      auto live = std::make_shared<typename PoolType::EpochType::LiveSet>();
+      live->reserve(visible_.size());
+      for (auto& entry : visible_) {
+        live->insert(entry.second.key);
+      }
+
+      thread_pool_.AdvanceEpoch(std::move(live));
+    }
+
+    std::shared_ptr<ChunkGenFactory> factory;
+    double gen_dist_;
+    long tree_size_;
+    size_t min_chunk_size_;
+
+    bool has_tree_;
+    chunker::lod::LinearLodOctree last_tree_;
+    glm::ivec3 last_offset_;
+
+    // scratch - holds the tree being built
+    chunker::lod::LinearLodOctree tree_;
+    chunker::lod::LodOctreeGenerator tree_gen_;
+
+    PoolType thread_pool_;
+    bool nearest_first_;
+
+    // chunks covering the current tree, keyed by packed leaf
+    VisibleMap visible_;
+    VisibleMap next_visible_;
+
+    // leaves whose chunks have been enqueued, but not picked up yet
+    std::vector<uint64_t> pending_;
+    std::vector<uint64_t> missed_;
+
+    // keys waiting to be handed to the pool
+    std::vector<chunker::VolumeChunkKey> enqueued_;
+
+    // keys of leaves dropped from the tree, since the last AdvanceEpoch
+    std::vector<chunker::VolumeChunkKey> retired_;
+  };
+}
+
+#endif // VOLUME_CHUNK_MANAGER_H_
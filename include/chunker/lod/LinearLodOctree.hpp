@@ -0,0 +1,167 @@
+#ifndef LINEAR_LOD_OCTREE_H_
+#define LINEAR_LOD_OCTREE_H_
+
+#include "chunker/util/Morton.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace chunker {
+  namespace lod {
+    /**
+     * @brief Flat lod octree - the volumetric counterpart to LinearLodTree. A sorted array of leaves, keyed by morton code and depth.
+     *
+     * Each leaf is packed into a single u64: the 3D morton code of its bottom-left-back cell on a (2^MAX_DEPTH)^3 grid
+     * in the high bits, and its depth in the low 8 bits. Built straight from LodOctreeGenerator - there's no pointer form.
+     *
+     * Axes match world space: x and z across, y up.
+     */
+    class LinearLodOctree {
+    public:
+      // deepest level we can represent. cells at this depth make up the morton grid
+      static const int MAX_DEPTH = 16;
+
+      LinearLodOctree() : tree_res_(0), cell_scale_(0.0), leaves_() {}
+
+      /**
+       * @brief fetches the depth of the leaf covering a sample point
+       *
+       * @param sample_point - point in the tree, from its bottom left back corner
+       * @return int - depth of leaf, or -1 if this tree is empty
+       */
+      int GetLeafDepth(const glm::vec3& sample_point) const {
+        if (leaves_.empty()) {
+          return -1;
+        }
+
+        return LeafDepth(leaves_[FindLeaf(sample_point)]);
+      }
+
+      /**
+       * @brief fetches the size of the chunk covering a sample point. points outside the tree clamp to its edge.
+       */
+      size_t GetChunkSize(const glm::vec3& sample_point) const {
+        int depth = GetLeafDepth(sample_point);
+        return (depth < 0 ? tree_res_ * 2 : tree_res_ >> depth);
+      }
+
+      /**
+       * @return size_t index of the leaf covering sample_point. tree must be non-empty.
+       */
+      size_t FindLeaf(const glm::vec3& sample_point) const {
+        uint64_t code = util::MortonEncode3(SampleToCell(sample_point.x), SampleToCell(sample_point.y), SampleToCell(sample_point.z));
+        uint64_t key = (code << DEPTH_BITS) | DEPTH_MASK;
+
+        // largest leaf whose code is <= ours - the first leaf always starts at the origin, so there's always one
+        auto itr = std::upper_bound(leaves_.begin(), leaves_.end(), key);
+        return static_cast<size_t>(itr - leaves_.begin()) - 1;
+      }
+
+      // leaf accessors
+
+      size_t LeafCount() const { return leaves_.size(); }
+
+      const std::vector<uint64_t>& Leaves() const { return leaves_; }
+
+      size_t TreeRes() const { return tree_res_; }
+
+      static int LeafDepth(uint64_t leaf) {
+        return static_cast<int>(leaf & DEPTH_MASK);
+      }
+
+      static uint64_t LeafCode(uint64_t leaf) {
+        return leaf >> DEPTH_BITS;
+      }
+
+      /**
+       * @return size_t - size of leaf, in tree units
+       */
+      size_t LeafSize(uint64_t leaf) const {
+        return tree_res_ >> LeafDepth(leaf);
+      }
+
+      /**
+       * @return glm::ivec3 - bottom left back corner of leaf, in tree units
+       */
+      glm::ivec3 LeafOrigin(uint64_t leaf) const {
+        uint64_t code = LeafCode(leaf);
+        return glm::ivec3(CellToTree(util::MortonDecodeX3(code)), CellToTree(util::MortonDecodeY3(code)), CellToTree(util::MortonDecodeZ3(code)));
+      }
+
+      /**
+       * @return uint64_t - packed leaf for a node at the given origin (tree units) and depth
+       */
+      uint64_t MakeLeaf(const glm::ivec3& origin, int depth) const {
+        return PackLeaf(TreeToCell(origin.x), TreeToCell(origin.y), TreeToCell(origin.z), depth);
+      }
+
+      /**
+       * @return true if leaf is one of this tree's leaves
+       */
+      bool ContainsLeaf(uint64_t leaf) const {
+        return std::binary_search(leaves_.begin(), leaves_.end(), leaf);
+      }
+
+      bool operator==(const LinearLodOctree& rhs) const {
+        return (tree_res_ == rhs.tree_res_ && leaves_ == rhs.leaves_);
+      }
+
+      bool operator!=(const LinearLodOctree& rhs) const {
+        return !(*this == rhs);
+      }
+
+    private:
+      // builds leaves_ directly
+      friend class LodOctreeGenerator;
+
+      static const int DEPTH_BITS = 8;
+      static const uint64_t DEPTH_MASK = (1 << DEPTH_BITS) - 1;
+      static const uint32_t GRID_RES = (1 << MAX_DEPTH);
+
+      static uint64_t PackLeaf(uint32_t cell_x, uint32_t cell_y, uint32_t cell_z, int depth) {
+        return (util::MortonEncode3(cell_x, cell_y, cell_z) << DEPTH_BITS) | static_cast<uint64_t>(depth);
+      }
+
+      // clears the tree, ready for leaves to be appended in morton order
+      void Reset(size_t tree_res) {
+        tree_res_ = tree_res;
+        cell_scale_ = static_cast<double>(GRID_RES) / tree_res;
+        leaves_.clear();
+      }
+
+      int CellToTree(uint32_t cell) const {
+        return static_cast<int>((static_cast<uint64_t>(cell) * tree_res_) >> MAX_DEPTH);
+      }
+
+      uint32_t TreeToCell(int coord) const {
+        return static_cast<uint32_t>((static_cast<uint64_t>(coord) << MAX_DEPTH) / tree_res_);
+      }
+
+      // maps a sample coordinate onto the morton grid - boundaries fall into the lower cell, as in LinearLodTree
+      uint32_t SampleToCell(float coord) const {
+        double scaled = static_cast<double>(coord) * cell_scale_;
+        if (!(scaled > 0.0)) {
+          return 0;
+        }
+
+        if (scaled >= GRID_RES) {
+          return GRID_RES - 1;
+        }
+
+        uint32_t cell = static_cast<uint32_t>(scaled);
+        return (static_cast<double>(cell) == scaled ? cell - 1 : cell);
+      }
+
+      size_t tree_res_;
+
+      // grid cells per tree unit
+      double cell_scale_;
+      std::vector<uint64_t> leaves_;
+    };
+  }
+}
+
+#endif // LINEAR_LOD_OCTREE_H_
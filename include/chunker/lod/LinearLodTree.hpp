@@ -0,0 +1,235 @@
+#ifndef LINEAR_LOD_TREE_H_
+#define LINEAR_LOD_TREE_H_
+
+#include "chunker/lod/lod_node.hpp"
+#include "chunker/util/DyadicScale.hpp"
+#include "chunker/util/Morton.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace chunker {
+  namespace lod {
+    /**
+     * @brief Leaf-level difference between two linear trees. All lists are sorted.
+     */
+    struct LodTreeDiff {
+      // leaves present in the new tree, but not the old one
+      std::vector<uint64_t> added;
+
+      // leaves present in the old tree, but not the new one
+      std::vector<uint64_t> removed;
+
+      // leaves present in both trees which border an added leaf - their neighbor lods may have changed
+      std::vector<uint64_t> touched;
+
+      void Clear() {
+        added.clear();
+        removed.clear();
+        touched.clear();
+      }
+    };
+
+    /**
+     * @brief Flat representation of an lod quadtree - a sorted array of leaves, keyed by morton code and depth.
+     *
+     * Each leaf is packed into a single u64: the morton code of its bottom-left cell on a
+     * (2^MAX_DEPTH)^2 grid in the high bits, and its depth in the low 8 bits.
+     * Leaves of a quadtree cover contiguous ranges of the morton curve, so point lookups are a
+     * binary search over the leaf array rather than a walk from the root. A small coarse-grid index
+     * bounds that search to the handful of leaves overlapping one coarse cell.
+     */
+    class LinearLodTree {
+    public:
+      // deepest level we can represent. cells at this depth make up the morton grid
+      static const int MAX_DEPTH = 16;
+
+      LinearLodTree() : tree_res_(0), cell_scale_(0.0), leaves_(), coarse_index_() {}
+
+      /**
+       * @brief Creates a new linear tree from a pointer tree
+       *
+       * @param tree - root node
+       * @param tree_res - resolution of input tree
+       */
+      LinearLodTree(const lod_node* tree, size_t tree_res);
+
+      /**
+       * @brief Rebuilds this linear tree from a pointer tree, reusing storage.
+       *
+       * @param tree - root node
+       * @param tree_res - resolution of input tree
+       */
+      void Build(const lod_node* tree, size_t tree_res);
+
+      /**
+       * @brief fetches the depth of the leaf covering a sample point. matches the traversal done by lod_node::GetChunkSize.
+       *
+       * @param sample_point - point on the tree we wish to sample. -> +, ^ + - from bottom left
+       * @return int - depth of leaf, or -1 if this tree is empty
+       */
+      int GetLeafDepth(const glm::vec2& sample_point) const {
+        if (leaves_.empty()) {
+          return -1;
+        }
+
+        return LeafDepth(leaves_[FindLeaf(sample_point)]);
+      }
+
+      /**
+       * @brief fetches the size of a chunk, based on a sample point. equivalent to lod_node::GetChunkSize.
+       */
+      size_t GetChunkSize(const glm::vec2& sample_point) const {
+        int depth = GetLeafDepth(sample_point);
+        return (depth < 0 ? tree_res_ * 2 : tree_res_ >> depth);
+      }
+
+      /**
+       * @brief fetches the sample step of a chunk, based on a sample point. equivalent to lod_node::GetChunkStep.
+       */
+      util::DyadicScale GetChunkStep(const util::DyadicScale& step_size, const glm::vec2& sample_point) const {
+        int depth = GetLeafDepth(sample_point);
+        return (depth < 0 ? step_size * 2 : step_size / util::DyadicScale::FromExponent(depth));
+      }
+
+      /**
+       * @return size_t index of the leaf covering sample_point. tree must be non-empty.
+       */
+      size_t FindLeaf(const glm::vec2& sample_point) const {
+        uint32_t code = util::MortonEncode2(SampleToCell(sample_point.x), SampleToCell(sample_point.y));
+        uint64_t key = (static_cast<uint64_t>(code) << DEPTH_BITS) | DEPTH_MASK;
+
+        // the coarse index narrows the search down to the leaves overlapping one coarse cell - usually one or two
+        uint32_t coarse = code >> INDEX_SHIFT;
+        const uint64_t* base = leaves_.data() + coarse_index_[coarse];
+        size_t count = coarse_index_[coarse + 1] - coarse_index_[coarse] + 1;
+
+        // find the largest leaf whose code is <= our code.
+        // branchless - first candidate always contains the start of the coarse cell, so it's always <= our code
+        while (count > 1) {
+          size_t half = count / 2;
+          base = (base[half] <= key ? base + half : base);
+          count -= half;
+        }
+
+        return static_cast<size_t>(base - leaves_.data());
+      }
+
+      // leaf accessors
+
+      size_t LeafCount() const { return leaves_.size(); }
+
+      const std::vector<uint64_t>& Leaves() const { return leaves_; }
+
+      size_t TreeRes() const { return tree_res_; }
+
+      static int LeafDepth(uint64_t leaf) {
+        return static_cast<int>(leaf & DEPTH_MASK);
+      }
+
+      static uint32_t LeafCode(uint64_t leaf) {
+        return static_cast<uint32_t>(leaf >> DEPTH_BITS);
+      }
+
+      /**
+       * @return size_t - size of leaf, in tree units
+       */
+      size_t LeafSize(uint64_t leaf) const {
+        return tree_res_ >> LeafDepth(leaf);
+      }
+
+      /**
+       * @return glm::ivec2 - bottom left corner of leaf, in tree units
+       */
+      glm::ivec2 LeafOrigin(uint64_t leaf) const {
+        uint32_t code = LeafCode(leaf);
+        return glm::ivec2(
+          static_cast<int>((static_cast<uint64_t>(util::MortonDecodeX2(code)) * tree_res_) >> MAX_DEPTH),
+          static_cast<int>((static_cast<uint64_t>(util::MortonDecodeY2(code)) * tree_res_) >> MAX_DEPTH)
+        );
+      }
+
+      /**
+       * @return uint64_t - packed leaf for a node at the given origin (tree units) and depth
+       */
+      uint64_t MakeLeaf(const glm::ivec2& origin, int depth) const {
+        uint32_t cell_x = static_cast<uint32_t>((static_cast<uint64_t>(origin.x) << MAX_DEPTH) / tree_res_);
+        uint32_t cell_y = static_cast<uint32_t>((static_cast<uint64_t>(origin.y) << MAX_DEPTH) / tree_res_);
+        return (static_cast<uint64_t>(util::MortonEncode2(cell_x, cell_y)) << DEPTH_BITS) | static_cast<uint64_t>(depth);
+      }
+
+      /**
+       * @return true if leaf is one of this tree's leaves
+       */
+      bool ContainsLeaf(uint64_t leaf) const {
+        return std::binary_search(leaves_.begin(), leaves_.end(), leaf);
+      }
+
+      /**
+       * @brief Computes the leaves which changed between two trees.
+       *        Cost is a linear merge over both leaf arrays, plus a perimeter walk around each added leaf.
+       *
+       * @param old_tree - previous tree
+       * @param new_tree - current tree. must have the same resolution as old_tree.
+       * @param diff - output param
+       */
+      static void Diff(const LinearLodTree& old_tree, const LinearLodTree& new_tree, LodTreeDiff* diff);
+
+      bool operator==(const LinearLodTree& rhs) const {
+        // index is derived from leaves - no need to compare it
+        return (tree_res_ == rhs.tree_res_ && leaves_ == rhs.leaves_);
+      }
+
+      bool operator!=(const LinearLodTree& rhs) const {
+        return !(*this == rhs);
+      }
+
+    private:
+      static const int DEPTH_BITS = 8;
+      static const uint64_t DEPTH_MASK = (1 << DEPTH_BITS) - 1;
+      static const uint32_t GRID_RES = (1 << MAX_DEPTH);
+
+      // coarse lookup grid is (2^INDEX_DEPTH)^2 cells
+      static const int INDEX_DEPTH = 5;
+      static const int INDEX_SHIFT = 2 * (MAX_DEPTH - INDEX_DEPTH);
+
+      // maps a sample coordinate onto the morton grid.
+      // points on a boundary fall into the lower cell, and points outside the tree clamp to its edge (same as GetChunkSize)
+      uint32_t SampleToCell(float coord) const {
+        // ceil(scaled) - 1, without going through libm
+        double scaled = static_cast<double>(coord) * cell_scale_;
+        if (!(scaled > 0.0)) {
+          return 0;
+        }
+
+        if (scaled >= GRID_RES) {
+          return GRID_RES - 1;
+        }
+
+        uint32_t cell = static_cast<uint32_t>(scaled);
+        return (static_cast<double>(cell) == scaled ? cell - 1 : cell);
+      }
+
+      void Build_recurse(const lod_node* node, uint32_t cell_x, uint32_t cell_y, int depth);
+      void BuildIndex();
+
+      // appends leaves of this tree which border leaf (edges + corners) and are also present in other
+      void CollectBorder(uint64_t leaf, const LinearLodTree& other, std::vector<uint64_t>* output) const;
+
+      size_t tree_res_;
+
+      // grid cells per tree unit
+      double cell_scale_;
+      std::vector<uint64_t> leaves_;
+
+      // for each coarse cell (in morton order), index of the leaf containing its first grid cell.
+      // one extra entry at the end, pointing to the last leaf
+      std::vector<uint32_t> coarse_index_;
+    };
+  }
+}
+
+#endif // LINEAR_LOD_TREE_H_
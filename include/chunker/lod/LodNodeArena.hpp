@@ -0,0 +1,79 @@
+#ifndef LOD_NODE_ARENA_H_
+#define LOD_NODE_ARENA_H_
+
+#include "chunker/lod/lod_node.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace chunker {
+  namespace lod {
+    /**
+     * @brief Bump allocator for lod nodes. Nodes are carved out of fixed-size blocks,
+     *        which are kept around between resets so that steady-state tree builds don't hit the heap.
+     */
+    class LodNodeArena {
+    public:
+      // nodes per block
+      static const size_t BLOCK_SIZE = 512;
+
+      LodNodeArena();
+
+      LodNodeArena(const LodNodeArena& other) = delete;
+      LodNodeArena(LodNodeArena&& other) = delete;
+      LodNodeArena& operator=(const LodNodeArena& other) = delete;
+      LodNodeArena& operator=(LodNodeArena&& other) = delete;
+
+      /**
+       * @brief allocates a new node with no children. valid until the next call to Reset.
+       */
+      lod_node* Alloc() {
+        if (next_ == end_) {
+          NextBlock();
+        }
+
+        lod_node* node = next_++;
+        node->bl = nullptr;
+        node->br = nullptr;
+        node->tl = nullptr;
+        node->tr = nullptr;
+        size_++;
+        return node;
+      }
+
+      /**
+       * @brief releases all nodes allocated from this arena. O(1) - blocks are retained for reuse.
+       */
+      void Reset() {
+        block_index_ = 0;
+        next_ = nullptr;
+        end_ = nullptr;
+        size_ = 0;
+      }
+
+      /**
+       * @return size_t number of nodes handed out since last reset
+       */
+      size_t Size() const { return size_; }
+
+      /**
+       * @return size_t number of blocks this arena has allocated from the heap
+       */
+      size_t BlockCount() const { return blocks_.size(); }
+
+      ~LodNodeArena();
+    private:
+      void NextBlock();
+
+      std::vector<lod_node*> blocks_;
+
+      // number of blocks currently in use
+      size_t block_index_;
+      lod_node* next_;
+      lod_node* end_;
+      size_t size_;
+    };
+  }
+}
+
+#endif // LOD_NODE_ARENA_H_
@@ -0,0 +1,63 @@
+#ifndef LOD_OCTREE_GENERATOR_H_
+#define LOD_OCTREE_GENERATOR_H_
+
+#include "chunker/lod/LinearLodOctree.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace chunker {
+  namespace lod {
+    /**
+     * @brief Generates an LOD octree for a volume at an arbitrary location - LodTreeGenerator, w height taken into account.
+     *
+     * Nodes split on the same cascading thresholds, but measured in 3D - so only the slabs near the viewer's height
+     * get fine detail, and the air above / rock below stay coarse. Leaves are written straight into a LinearLodOctree.
+     */
+    class LodOctreeGenerator {
+    public:
+      LodOctreeGenerator(int size, int chunk_res)
+       : cascade_factor(0.0),
+         size_(size),
+         chunk_res_(chunk_res)
+      {}
+
+      LodOctreeGenerator(const LodOctreeGenerator& other) = delete;
+      LodOctreeGenerator& operator=(const LodOctreeGenerator& other) = delete;
+
+      /**
+       * @param local_position - viewer position, relative to the bottom left back corner of the tree
+       * @param force_divide - levels to split regardless of distance
+       * @param output - rebuilt in place, reusing its storage
+       */
+      void CreateLodTree(const glm::vec3& local_position, int force_divide, LinearLodOctree* output) const;
+
+      // distance cap for min subdivision level
+      // other cascades are handled internally
+      double cascade_factor;
+
+    private:
+      const int size_;
+      const int chunk_res_;
+
+      bool ShouldSplit(int x, int y, int z, int node_size, double cascade_threshold, const glm::vec3& local_position, int force_divide) const;
+
+      // children are visited in morton order, so leaves come out sorted
+      void CreateLodTree_recurse(
+        int x,
+        int y,
+        int z,
+        int node_size,
+        int depth,
+        double cascade_threshold,
+        const glm::vec3& local_position,
+        int force_divide,
+        LinearLodOctree* output
+      ) const;
+    };
+  }
+}
+
+#endif // LOD_OCTREE_GENERATOR_H_
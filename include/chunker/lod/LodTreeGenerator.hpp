@@ -4,38 +4,122 @@
 #define CASCADE_MUL_FACTOR 2
 
 #include "chunker/lod/lod_node.hpp"
+#include "chunker/lod/LodNodeArena.hpp"
 
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <vector>
 
 namespace chunker {
   namespace lod {
     /**
      * @brief Generates an LOD quadtree for a terrain object at an arbitrary location
+     * 
+     * Trees are owned by the generator, and allocated from a pair of arenas.
+     * A tree returned from CreateLodTree stays valid until the next CreateLodTree call,
+     * unless it is kept with RetainTree - in which case it stays valid until another tree is retained.
+     * Do not pass generated trees to lod_node::lod_node_free.
+     *
+     * Given the previous tree, nodes which were split there stay split until the viewer moves past
+     * their threshold * (1 + hysteresis) - so a viewer hovering on a cascade boundary doesn't flip the tree every update.
      */
     class LodTreeGenerator {
     public:
       LodTreeGenerator(int size, int chunk_res)
-       : size_(size),
-         chunk_res_(chunk_res)
+       : hysteresis(0.0),
+         parallel_levels(0),
+         parallel_min_nodes(DEFAULT_PARALLEL_MIN_NODES),
+         size_(size),
+         chunk_res_(chunk_res),
+         retained_(0),
+         last_node_count_(0)
       {}
 
-
+      LodTreeGenerator(const LodTreeGenerator& other) = delete;
+      LodTreeGenerator& operator=(const LodTreeGenerator& other) = delete;
 
       lod_node* CreateLodTree(const glm::vec3& local_position);
       lod_node* CreateLodTree(const glm::vec3& local_position, int force_divide);
-      lod_node* CreateLodTree(const glm::vec3& local_position, int force_divide, int size, int chunk_size, double cascade_factor, int lod_bias);
+
+      /**
+       * @param previous - last tree built at the same position, for hysteresis. must be the retained tree, or one not owned by this generator.
+       *                   nullptr splits on the bare thresholds.
+       */
+      lod_node* CreateLodTree(const glm::vec3& local_position, int force_divide, const lod_node* previous);
+      lod_node* CreateLodTree(const glm::vec3& local_position, int force_divide, int size, int chunk_size, double cascade_factor, int lod_bias, const lod_node* previous = nullptr);
+
+      /**
+       * @brief Builds the union of the trees for several viewers - a node splits if any viewer wants it split, so the finest LOD wins.
+       *
+       * @param local_positions - viewer positions. must not be empty.
+       */
+      lod_node* CreateLodTree(const std::vector<glm::vec3>& local_positions, int force_divide, const lod_node* previous = nullptr);
+
+      /**
+       * @brief Keeps the most recently created tree alive across subsequent CreateLodTree calls.
+       *        The previously retained tree is released.
+       */
+      void RetainTree();
 
       // distance cap for min subdivision level
       // other cascades are handled internally
       double cascade_factor;
 
+      // fraction past a split node's threshold the viewer has to move before it merges again. 0 merges right at the threshold.
+      // only applies when a previous tree is passed in
+      double hysteresis;
+
+      // number of levels built on the calling thread before the remaining subtrees are split across tbb tasks.
+      // 0 builds the whole tree serially. the resulting tree is identical either way.
+      int parallel_levels;
+
+      // w parallel_levels set, builds still run serially until a tree comes out w at least this many nodes -
+      // below that, forking tasks costs more than it saves. 0 always splits.
+      size_t parallel_min_nodes;
+
+      // ~11ns a node serially, vs ~10us to fork and join tasks - past this, the fork is under 10% of the build
+      static const size_t DEFAULT_PARALLEL_MIN_NODES = 8192;
+
+      /**
+       * @return size_t number of nodes in the last tree built
+       */
+      size_t LastNodeCount() const { return last_node_count_; }
+
       // max number of chunk subdivisions to perform
     private:
+      // subtree whose construction has been deferred to a task
+      struct subtree_job {
+        int x;
+        int y;
+        int node_size;
+        double cascade_threshold;
+        lod_node* root;
+        const lod_node* previous;
+        int force_divide;
+      };
+
       const int size_;
       const int chunk_res_;
-      void CreateLodTree_recurse(int x, int y, int node_size, int chunk_res, double cascade_threshold, const glm::vec3& local_position, lod_node* root, int force_divide);
+
+      // double buffered - one arena holds the retained tree, the other holds scratch trees
+      LodNodeArena arenas_[2];
+      int retained_;
+
+      // per-task arenas for parallel builds, double buffered alongside arenas_
+      std::vector<std::unique_ptr<LodNodeArena>> task_arenas_[2];
+      std::vector<subtree_job> jobs_;
+
+      // sizes up the next build, for parallel_min_nodes
+      size_t last_node_count_;
+
+      lod_node* CreateLodTree_impl(const glm::vec3* local_positions, size_t position_count, int force_divide, int size, int chunk_size, double cascade_factor, int lod_bias, const lod_node* previous);
+
+      bool ShouldSplit(int x, int y, int node_size, int chunk_res, double cascade_threshold, const glm::vec3* local_positions, size_t position_count, const lod_node* previous, int force_divide) const;
+      void CreateLodTree_recurse(int x, int y, int node_size, int chunk_res, double cascade_threshold, const glm::vec3* local_positions, size_t position_count, lod_node* root, const lod_node* previous, int force_divide, LodNodeArena& arena);
+
+      // builds the top levels of a tree, queueing up subtree_jobs below them
+      void CreateLodTree_split(int x, int y, int node_size, int chunk_res, double cascade_threshold, const glm::vec3* local_positions, size_t position_count, lod_node* root, const lod_node* previous, int force_divide, int levels, LodNodeArena& arena);
     };
   }
 }
@@ -0,0 +1,111 @@
+#ifndef LOD_NEIGHBORHOOD_H_
+#define LOD_NEIGHBORHOOD_H_
+
+#include "chunker/lod/lod_node.hpp"
+
+#include <cstddef>
+
+namespace chunker {
+  namespace lod {
+    /**
+     * @brief 3x3 block of nodes surrounding a node during a top-down walk, indexed [x][y] w center at [1][1].
+     *
+     * Each entry is either the neighbor at the same depth as the center, or the coarser leaf covering that spot.
+     * Entries outside the tree are null.
+     */
+    struct lod_neighborhood {
+      const lod_node* nodes[3][3];
+      int depths[3][3];
+
+      /**
+       * @brief creates the neighborhood of a tree's root node
+       */
+      static lod_neighborhood Root(const lod_node* root) {
+        lod_neighborhood res;
+        for (int x = 0; x < 3; x++) {
+          for (int y = 0; y < 3; y++) {
+            res.nodes[x][y] = nullptr;
+            res.depths[x][y] = 0;
+          }
+        }
+
+        res.nodes[1][1] = root;
+        return res;
+      }
+
+      /**
+       * @brief creates the neighborhood of one of the center node's children
+       *
+       * @param child_x - 0 for left children, 1 for right
+       * @param child_y - 0 for bottom children, 1 for top
+       */
+      lod_neighborhood Descend(int child_x, int child_y) const {
+        lod_neighborhood res;
+        for (int x = 0; x < 3; x++) {
+          // position relative to our bottom-left child, in child units (-1 to 2)
+          int pos_x = child_x + x - 1;
+          int parent_x = (pos_x < 0 ? 0 : (pos_x > 1 ? 2 : 1));
+          int sub_x = pos_x & 1;
+          for (int y = 0; y < 3; y++) {
+            int pos_y = child_y + y - 1;
+            int parent_y = (pos_y < 0 ? 0 : (pos_y > 1 ? 2 : 1));
+            int sub_y = pos_y & 1;
+
+            const lod_node* node = nodes[parent_x][parent_y];
+            int depth = depths[parent_x][parent_y];
+            if (node != nullptr && node->tl != nullptr) {
+              // same depth as us, and subdivided - step down into it
+              node = Child(node, sub_x, sub_y);
+              depth++;
+            }
+
+            res.nodes[x][y] = node;
+            res.depths[x][y] = depth;
+          }
+        }
+
+        return res;
+      }
+
+      /**
+       * @brief fetches the size of the chunk next to the (leaf) center node, the same way a ChunkIdentifier samples it.
+       *        finer neighbors report the center's size, and samples which fall off the tree clamp back onto it.
+       *
+       * @param dx - -1, 0 or 1
+       * @param dy - -1, 0 or 1
+       * @param tree_x - center node's x offset within the tree
+       * @param tree_y - center node's y offset within the tree
+       * @param node_size - size of center node
+       * @param tree_res - resolution of tree
+       */
+      size_t GetNeighborSize(int dx, int dy, long tree_x, long tree_y, size_t node_size, size_t tree_res) const {
+        if ((dx < 0 && tree_x <= 0) || (dx > 0 && tree_x + static_cast<long>(node_size) >= static_cast<long>(tree_res))) {
+          dx = 0;
+        }
+
+        if ((dy < 0 && tree_y <= 0) || (dy > 0 && tree_y + static_cast<long>(node_size) >= static_cast<long>(tree_res))) {
+          dy = 0;
+        }
+
+        const lod_node* node = nodes[dx + 1][dy + 1];
+        if ((dx == 0 && dy == 0) || node == nullptr || node->tl != nullptr) {
+          return node_size;
+        }
+
+        size_t neighbor_size = tree_res >> depths[dx + 1][dy + 1];
+        return (neighbor_size > node_size ? neighbor_size : node_size);
+      }
+
+    private:
+      static const lod_node* Child(const lod_node* node, int sub_x, int sub_y) {
+        if (sub_y == 0) {
+          return (sub_x == 0 ? node->bl : node->br);
+        }
+
+        return (sub_x == 0 ? node->tl : node->tr);
+      }
+    };
+  }
+}
+
+#endif // LOD_NEIGHBORHOOD_H_
@@ -3,7 +3,7 @@
 
 #include <glm/glm.hpp>
 
-#include "chunker/util/Fraction.hpp"
+#include "chunker/util/DyadicScale.hpp"
 
 namespace chunker {
   namespace lod {
@@ -38,7 +38,13 @@ namespace chunker {
        */
       static size_t GetChunkSize(const lod_node* node, size_t tree_res, const glm::vec2& sample_point);
       
-      static util::Fraction GetChunkStep(const lod_node* node, const util::Fraction& step_size, size_t tree_res, const glm::vec2& sample_point);
+      /**
+       * @brief fetches the sample step of a chunk, based on a sample point.
+       *
+       * @param step_size - step size of the root node
+       * @return util::DyadicScale - step of specified chunk
+       */
+      static util::DyadicScale GetChunkStep(const lod_node* node, const util::DyadicScale& step_size, size_t tree_res, const glm::vec2& sample_point);
 
       /**
        * @brief Compares two lod trees for equality
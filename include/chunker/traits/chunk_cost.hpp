@@ -0,0 +1,49 @@
+#ifndef CHUNK_COST_H_
+#define CHUNK_COST_H_
+// cost, in bytes, of holding a chunk in cache
+// chunk types report their own size w a `size_t ByteSize() const` member. sizeof misses anything the chunk owns
+// on the heap - so there's no fallback, and chunk types w/o ByteSize are cached by count instead (see ChunkCache)
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace chunker {
+  namespace traits {
+    namespace impl_ {
+      struct byte_size_impl {
+        template <typename ChunkType,
+        typename ByteSize = decltype(static_cast<size_t>(std::declval<const ChunkType&>().ByteSize()))>
+        static std::true_type test(int);
+
+        template <typename ChunkType, typename...>
+        static std::false_type test(...);
+      };
+    }
+
+    template <typename ChunkType>
+    struct has_byte_size : decltype(impl_::byte_size_impl::test<ChunkType>(0)) {};
+
+    /**
+     * @brief default cost functor for byte-budgeted caches. ChunkType needs a ByteSize() member
+     */
+    template <typename ChunkType>
+    struct chunk_cost {
+      size_t operator()(const ChunkType& chunk) const {
+        static_assert(has_byte_size<ChunkType>::value,
+          "chunk_cost needs `size_t ByteSize() const` on the chunk type - otherwise pass the cache an explicit cost functor, or use util::UnitCost");
+        return static_cast<size_t>(chunk.ByteSize());
+      }
+    };
+
+    // cached chunks are shared - charge for the pointee
+    template <typename ChunkType>
+    struct chunk_cost<std::shared_ptr<ChunkType>> {
+      size_t operator()(const std::shared_ptr<ChunkType>& chunk) const {
+        return (chunk == nullptr ? sizeof(chunk) : chunk_cost<ChunkType>()(*chunk));
+      }
+    };
+  }
+}
+
+#endif // CHUNK_COST_H_
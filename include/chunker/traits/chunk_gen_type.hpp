@@ -4,6 +4,7 @@
 // return desired type
 
 #include "chunker/ChunkIdentifier.hpp"
+#include "chunker/GenerationEpoch.hpp"
 
 #include <memory>
 #include <type_traits>
@@ -12,11 +13,21 @@ namespace chunker {
   namespace traits {
     namespace impl_ {
       struct chunk_gen_type_impl {
-        template <typename ChunkGenerator, typename ReturnType,
-        typename Generate = std::is_same<ReturnType, decltype(std::declval<ChunkGenerator&>().Generate(chunker::ChunkIdentifier()))>>
+        template <typename ChunkGenerator, typename ReturnType, typename IdentifierType,
+        typename Generate = std::is_same<ReturnType, decltype(std::declval<ChunkGenerator&>().Generate(std::declval<const IdentifierType&>()))>>
         static std::true_type test(int);
 
-        template <typename ChunkGenerator, typename ReturnType, typename...>
+        template <typename ChunkGenerator, typename ReturnType, typename IdentifierType, typename...>
+        static std::false_type test(...);
+      };
+
+      // generators may take a cancel token as a second param
+      struct chunk_gen_cancellable_impl {
+        template <typename ChunkGenerator, typename IdentifierType,
+        typename Generate = decltype(std::declval<ChunkGenerator&>().Generate(std::declval<const IdentifierType&>(), std::declval<const chunker::CancelToken&>()))>
+        static std::true_type test(int);
+
+        template <typename ChunkGenerator, typename IdentifierType, typename...>
         static std::false_type test(...);
       };
 
@@ -30,8 +41,14 @@ namespace chunker {
       };
     }
 
-    template <typename ChunkGenerator, typename ReturnType>
-    struct chunk_gen_type : decltype(impl_::chunk_gen_type_impl::test<ChunkGenerator, ReturnType>(0)) {};
+    // IdentifierType - what the generator is handed. VolumeChunkIdentifier for volume chunks
+    template <typename ChunkGenerator, typename IdentifierType = chunker::ChunkIdentifier>
+    struct chunk_gen_cancellable : decltype(impl_::chunk_gen_cancellable_impl::test<ChunkGenerator, IdentifierType>(0)) {};
+
+    template <typename ChunkGenerator, typename ReturnType, typename IdentifierType = chunker::ChunkIdentifier>
+    struct chunk_gen_type : std::bool_constant<
+      decltype(impl_::chunk_gen_type_impl::test<ChunkGenerator, ReturnType, IdentifierType>(0))::value || chunk_gen_cancellable<ChunkGenerator, IdentifierType>::value
+    > {};
 
     template <typename ChunkGenFactory, typename ChunkGenerator>
     struct chunk_gen_factory_type : decltype(impl_::chunk_gen_factory_type_impl::test<ChunkGenFactory, ChunkGenerator>(0)) {};
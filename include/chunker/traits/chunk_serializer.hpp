@@ -0,0 +1,66 @@
+#ifndef CHUNK_SERIALIZER_H_
+#define CHUNK_SERIALIZER_H_
+// turns chunks into bytes and back, for the on-disk cache tier
+// chunk types opt in w a pair of members:
+//   void Serialize(std::vector<uint8_t>& output) const - appends the chunk's bytes to output
+//   static std::shared_ptr<ChunkType> Deserialize(const uint8_t* data, size_t size) - nullptr if data is bad
+// or, for types which can't be touched, by specializing chunk_serializer<ChunkType> w the same two as static functions
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace chunker {
+  namespace traits {
+    namespace impl_ {
+      struct serialize_members_impl {
+        template <typename ChunkType,
+        typename Serialize = decltype(std::declval<const ChunkType&>().Serialize(std::declval<std::vector<uint8_t>&>())),
+        typename Deserialize = std::enable_if_t<std::is_convertible_v<
+          decltype(ChunkType::Deserialize(std::declval<const uint8_t*>(), std::declval<size_t>())),
+          std::shared_ptr<ChunkType>
+        >>>
+        static std::true_type test(int);
+
+        template <typename ChunkType, typename...>
+        static std::false_type test(...);
+      };
+
+      struct serializer_impl {
+        template <typename ChunkType, typename Serializer,
+        typename Serialize = decltype(Serializer::Serialize(std::declval<const ChunkType&>(), std::declval<std::vector<uint8_t>&>())),
+        typename Deserialize = decltype(Serializer::Deserialize(std::declval<const uint8_t*>(), std::declval<size_t>()))>
+        static std::true_type test(int);
+
+        template <typename ChunkType, typename Serializer, typename...>
+        static std::false_type test(...);
+      };
+    }
+
+    template <typename ChunkType>
+    struct has_serialize_members : decltype(impl_::serialize_members_impl::test<ChunkType>(0)) {};
+
+    // empty unless ChunkType has the members above - specialize to opt other types in
+    template <typename ChunkType, typename = void>
+    struct chunk_serializer {};
+
+    template <typename ChunkType>
+    struct chunk_serializer<ChunkType, std::enable_if_t<has_serialize_members<ChunkType>::value>> {
+      static void Serialize(const ChunkType& chunk, std::vector<uint8_t>& output) {
+        chunk.Serialize(output);
+      }
+
+      static std::shared_ptr<ChunkType> Deserialize(const uint8_t* data, size_t size) {
+        return ChunkType::Deserialize(data, size);
+      }
+    };
+
+    // true if chunk_serializer<ChunkType> has both functions - ie. ChunkType can go in the disk tier
+    template <typename ChunkType>
+    struct chunk_serializable : decltype(impl_::serializer_impl::test<ChunkType, chunk_serializer<ChunkType>>(0)) {};
+  }
+}
+
+#endif // CHUNK_SERIALIZER_H_
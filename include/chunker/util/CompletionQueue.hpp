@@ -0,0 +1,56 @@
+#ifndef COMPLETION_QUEUE_H_
+#define COMPLETION_QUEUE_H_
+
+#include <tbb/concurrent_queue.h>
+
+#include <cstddef>
+#include <utility>
+
+namespace chunker {
+  namespace util {
+    /**
+     * @brief multi-producer queue of finished work - workers push, one consumer (usually the main thread) drains.
+     * pushes never block on the consumer.
+     *
+     * @tparam ItemType - type of completed item
+     */
+    template <typename ItemType>
+    class CompletionQueue {
+    public:
+      void Push(ItemType item) {
+        queue_.push(std::move(item));
+      }
+
+      bool TryPop(ItemType* output) {
+        return queue_.try_pop(*output);
+      }
+
+      /**
+       * @brief pops everything queued so far, passing each item to func
+       *
+       * @param func - (ItemType&) -> void
+       * @return size_t - number of items drained
+       */
+      template <typename Func>
+      size_t Drain(Func&& func) {
+        size_t res = 0;
+        ItemType item;
+        while (queue_.try_pop(item)) {
+          func(item);
+          res++;
+        }
+
+        return res;
+      }
+
+      bool Empty() const {
+        return queue_.empty();
+      }
+
+    private:
+      tbb::concurrent_queue<ItemType> queue_;
+    };
+  }
+}
+
+#endif // COMPLETION_QUEUE_H_
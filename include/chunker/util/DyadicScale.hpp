@@ -0,0 +1,319 @@
+#ifndef DYADIC_SCALE_H_
+#define DYADIC_SCALE_H_
+
+#include "chunker/util/Fraction.hpp"
+#include "chunker/util/Hash.hpp"
+
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace chunker {
+  namespace util {
+    namespace impl {
+      inline bool IsPowerOfTwo(uint64_t v) {
+        return (v != 0 && (v & (v - 1)) == 0);
+      }
+
+      // log2 of a power of two. callers check IsPowerOfTwo first
+      inline int Log2PowerOfTwo(uint64_t v) {
+        assert(IsPowerOfTwo(v));
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(v);
+#else
+        int res = 0;
+        while (v > 1) {
+          v >>= 1;
+          res++;
+        }
+
+        return res;
+#endif
+      }
+    }
+
+    /**
+     * @brief An exact, non-negative power of two (or zero), stored as its base-2 exponent.
+     *
+     * Tree and chunk sizes are all powers of two, so every scale, step and neighbor size the library produces is too.
+     * Multiplying, dividing and comparing are integer ops on the exponent - no gcd, and no products which can overflow.
+     *
+     * This is narrower than Fraction - there's no base, so scales like 3 or 1/3 can't be represented. Every conversion
+     * is explicit, and checked in release builds too: constructors throw std::invalid_argument on anything else, and the
+     * TryFrom factories return false. Exponents are kept within +-MAX_EXPONENT, so every value round-trips through a Fraction.
+     *
+     * Converts (explicitly) to Fraction and float/double where a general ratio is needed - ie. for addition, which isn't
+     * closed over powers of two.
+     */
+    class DyadicScale {
+    public:
+      // largest exponent we can round-trip through a Fraction
+      static const int MAX_EXPONENT = 62;
+
+      DyadicScale() : exponent_(0) {}
+
+      /**
+       * @brief Creates a scale from an integer. Throws std::invalid_argument unless value is zero or a power of two.
+       */
+      template <typename Integral, std::enable_if_t<std::is_integral_v<Integral>, bool> = true>
+      explicit DyadicScale(Integral value) {
+        if (!TryFrom(value, this)) {
+          throw std::invalid_argument("DyadicScale: not zero or a power of two");
+        }
+      }
+
+      /**
+       * @brief Creates a scale of numerator / denominator. Throws std::invalid_argument unless both are powers of two
+       * (or numerator is zero).
+       */
+      DyadicScale(long numerator, long denominator) {
+        if (!TryFrom(numerator, denominator, this)) {
+          throw std::invalid_argument("DyadicScale: not zero or a ratio of powers of two");
+        }
+      }
+
+      /**
+       * @brief Creates a scale from a fraction. Throws std::invalid_argument unless it's a power of two, or zero.
+       */
+      explicit DyadicScale(const Fraction& fraction) : DyadicScale(fraction.numerator, fraction.denominator) {}
+
+      /**
+       * @return false if value isn't zero or a power of two. output is untouched then
+       */
+      template <typename Integral, std::enable_if_t<std::is_integral_v<Integral>, bool> = true>
+      static bool TryFrom(Integral value, DyadicScale* output) {
+        if (value == 0) {
+          output->exponent_ = ZERO_EXPONENT;
+          return true;
+        }
+
+        if (value < 0 || !impl::IsPowerOfTwo(static_cast<uint64_t>(value))) {
+          return false;
+        }
+
+        return TryFromExponent(impl::Log2PowerOfTwo(static_cast<uint64_t>(value)), output);
+      }
+
+      /**
+       * @return false unless numerator / denominator is zero or a power of two - both powers of two, or numerator zero
+       */
+      static bool TryFrom(long numerator, long denominator, DyadicScale* output) {
+        if (denominator <= 0 || !impl::IsPowerOfTwo(static_cast<uint64_t>(denominator))) {
+          return false;
+        }
+
+        DyadicScale res;
+        if (!TryFrom(numerator, &res)) {
+          return false;
+        }
+
+        if (!res.IsZero() && !TryFromExponent(res.exponent_ - impl::Log2PowerOfTwo(static_cast<uint64_t>(denominator)), &res)) {
+          return false;
+        }
+
+        *output = res;
+        return true;
+      }
+
+      static bool TryFrom(const Fraction& fraction, DyadicScale* output) {
+        return TryFrom(fraction.numerator, fraction.denominator, output);
+      }
+
+      /**
+       * @return false if exponent is out of range
+       */
+      static bool TryFromExponent(int exponent, DyadicScale* output) {
+        if (exponent > MAX_EXPONENT || exponent < -MAX_EXPONENT) {
+          return false;
+        }
+
+        output->exponent_ = exponent;
+        return true;
+      }
+
+      /**
+       * @return DyadicScale - 2^exponent. throws std::out_of_range past +-MAX_EXPONENT
+       */
+      static DyadicScale FromExponent(int exponent) {
+        DyadicScale res;
+        if (!TryFromExponent(exponent, &res)) {
+          throw std::out_of_range("DyadicScale: exponent out of range");
+        }
+
+        return res;
+      }
+
+      static DyadicScale Zero() {
+        DyadicScale res;
+        res.exponent_ = ZERO_EXPONENT;
+        return res;
+      }
+
+      bool IsZero() const {
+        return exponent_ == ZERO_EXPONENT;
+      }
+
+      /**
+       * @return int - base 2 exponent of this scale. undefined if zero.
+       */
+      int Exponent() const {
+        assert(!IsZero());
+        return exponent_;
+      }
+
+      double AsDouble() const {
+        if (IsZero()) {
+          return 0.0;
+        }
+
+        double res = 1.0;
+        double mul = (exponent_ < 0 ? 0.5 : 2.0);
+        for (int i = (exponent_ < 0 ? -exponent_ : exponent_); i > 0; i--) {
+          res *= mul;
+        }
+
+        return res;
+      }
+
+      float AsFloat() const {
+        return static_cast<float>(AsDouble());
+      }
+
+      Fraction AsFraction() const {
+        if (IsZero()) {
+          return Fraction(0);
+        }
+
+        Fraction res;
+        if (exponent_ < 0) {
+          res.denominator = static_cast<long>(1) << -exponent_;
+        } else {
+          res.numerator = static_cast<long>(1) << exponent_;
+        }
+
+        return res;
+      }
+
+      /**
+       * @brief Scales an integer by this value, truncating toward zero. ie. chunk_res -> chunk size
+       */
+      long Apply(long value) const {
+        if (IsZero()) {
+          return 0;
+        }
+
+        if (exponent_ >= 0) {
+          return value * (static_cast<long>(1) << exponent_);
+        }
+
+        // truncate, same as a Fraction -> integer cast
+        long mag = (value < 0 ? -value : value) >> -exponent_;
+        return (value < 0 ? -mag : mag);
+      }
+
+      bool operator==(const DyadicScale& rhs) const {
+        return exponent_ == rhs.exponent_;
+      }
+
+      bool operator!=(const DyadicScale& rhs) const {
+        return exponent_ != rhs.exponent_;
+      }
+
+      // zero's exponent is below every other exponent, so ordering falls out of the exponents
+      bool operator<(const DyadicScale& rhs) const {
+        return exponent_ < rhs.exponent_;
+      }
+
+      bool operator>(const DyadicScale& rhs) const {
+        return exponent_ > rhs.exponent_;
+      }
+
+      bool operator<=(const DyadicScale& rhs) const {
+        return exponent_ <= rhs.exponent_;
+      }
+
+      bool operator>=(const DyadicScale& rhs) const {
+        return exponent_ >= rhs.exponent_;
+      }
+
+      DyadicScale operator*(const DyadicScale& rhs) const {
+        if (IsZero() || rhs.IsZero()) {
+          return Zero();
+        }
+
+        return FromExponent(exponent_ + rhs.exponent_);
+      }
+
+      // throws std::domain_error on a zero divisor
+      DyadicScale operator/(const DyadicScale& rhs) const {
+        if (rhs.IsZero()) {
+          throw std::domain_error("DyadicScale: divide by zero");
+        }
+
+        if (IsZero()) {
+          return Zero();
+        }
+
+        return FromExponent(exponent_ - rhs.exponent_);
+      }
+
+      template <typename Integral, std::enable_if_t<std::is_integral_v<Integral>, bool> = true>
+      DyadicScale operator*(Integral rhs) const {
+        return *this * DyadicScale(rhs);
+      }
+
+      template <typename Integral, std::enable_if_t<std::is_integral_v<Integral>, bool> = true>
+      DyadicScale operator/(Integral rhs) const {
+        return *this / DyadicScale(rhs);
+      }
+
+      DyadicScale& operator*=(const DyadicScale& rhs) {
+        return (*this = *this * rhs);
+      }
+
+      DyadicScale& operator/=(const DyadicScale& rhs) {
+        return (*this = *this / rhs);
+      }
+
+      explicit operator Fraction() const {
+        return AsFraction();
+      }
+
+      // integers truncate, as Fraction's conversion does
+      template <typename ArithmeticType, std::enable_if_t<std::is_arithmetic_v<ArithmeticType>, bool> = true>
+      explicit operator ArithmeticType() const {
+        if constexpr (std::is_integral_v<ArithmeticType>) {
+          return static_cast<ArithmeticType>(Apply(1));
+        } else {
+          return static_cast<ArithmeticType>(AsDouble());
+        }
+      }
+
+      explicit operator std::string() const {
+        return static_cast<std::string>(AsFraction());
+      }
+
+    private:
+      static const int ZERO_EXPONENT = INT_MIN;
+
+      int exponent_;
+    };
+  }
+}
+
+namespace std {
+  template <>
+  struct hash<chunker::util::DyadicScale> {
+    // mixed - the exponents in use are a handful of small ints, which would all land in a table's first few buckets
+    size_t operator()(const chunker::util::DyadicScale& scale) const {
+      int64_t exponent = (scale.IsZero() ? INT_MIN : scale.Exponent());
+      return static_cast<size_t>(chunker::util::HashMix64(static_cast<uint64_t>(exponent)));
+    }
+  };
+}
+
+#endif // DYADIC_SCALE_H_
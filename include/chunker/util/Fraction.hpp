@@ -1,6 +1,8 @@
 #ifndef FRACTION_H_
 #define FRACTION_H_
 
+#include "chunker/util/Hash.hpp"
+
 #include <algorithm>
 #include <numeric>
 #include <string>
@@ -131,9 +133,12 @@ namespace chunker {
 namespace std {
   template <>
   struct hash<chunker::util::Fraction> {
-    std::hash<long> int_hash;
     size_t operator()(const chunker::util::Fraction& fraction) const {
-      return int_hash(fraction.numerator) ^ int_hash(fraction.denominator);
+      // xor would map n/d and d/n (and every n/n) together
+      return static_cast<size_t>(chunker::util::HashCombine(
+        chunker::util::HashMix64(static_cast<uint64_t>(fraction.numerator)),
+        static_cast<uint64_t>(fraction.denominator)
+      ));
     }
   };
 }
@@ -0,0 +1,29 @@
+#ifndef CHUNKER_HASH_H_
+#define CHUNKER_HASH_H_
+
+#include <cstdint>
+
+namespace chunker {
+  namespace util {
+    /**
+     * @brief splitmix64 finalizer - every input bit affects every output bit
+     */
+    inline uint64_t HashMix64(uint64_t v) {
+      v ^= v >> 30;
+      v *= 0xBF58476D1CE4E5B9ull;
+      v ^= v >> 27;
+      v *= 0x94D049BB133111EBull;
+      v ^= v >> 31;
+      return v;
+    }
+
+    /**
+     * @brief folds value into seed. order dependent, so permuted fields hash differently.
+     */
+    inline uint64_t HashCombine(uint64_t seed, uint64_t value) {
+      return HashMix64(seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2)));
+    }
+  }
+}
+
+#endif // CHUNKER_HASH_H_
@@ -1,13 +1,19 @@
 #ifndef LRU_CACHE_H_
 #define LRU_CACHE_H_
 
+#include <algorithm>
 #include <cassert>
-#include <list>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <mutex>
-#include <unordered_map>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
-#include "chunker/util/HashList.hpp"
+#include "chunker/util/Hash.hpp"
 #include "chunker/util/impl/LRUCacheIterator.hpp"
+#include "chunker/util/impl/LRUCacheSlot.hpp"
 
 namespace chunker {
   namespace util {
@@ -23,111 +29,181 @@ namespace chunker {
       SUCCESS
     };
 
+    /**
+     * @brief cost functor which charges one unit per entry - capacity is an entry count
+     */
+    struct UnitCost {
+      template <typename ValueType>
+      size_t operator()(const ValueType&) const {
+        return 1;
+      }
+    };
+
     /**
      * @brief LRU cache impl - thread safe on calls not returning iterator impl.
-     * 
+     *
+     * Entries (key, value and intrusive list links) live in one slab, so there's no per-entry allocation.
+     * An open-addressing index maps keys to slab slots - each call hashes its key once.
+     *
+     * Capacity is a budget in cost units: each value is charged CostFunc(value) when it's put, and least recently used
+     * entries are evicted until usage fits the budget again. The most recent put is always kept, even if it alone is over budget.
+     * ReserveEntries sets a floor on the entry count - the budget is overrun rather than evict below it, until the floor drops again.
+     *
      * @tparam KeyType - type for key
      * @tparam ValueType - type for value
+     * @tparam CostFunc - functor (const ValueType&) -> size_t. defaults to one unit per entry.
      */
-    template <typename KeyType, typename ValueType>
+    template <typename KeyType, typename ValueType, typename CostFunc = UnitCost>
     class LRUCache {
+      typedef impl::LRUCacheSlot<KeyType, ValueType> SlotType;
     public:
+      typedef KeyType key_type;
       typedef impl::LRUCacheIterator<KeyType, ValueType> iterator;
-      
-      LRUCache(int capacity) : capacity_(capacity) {}
+      typedef std::vector<std::pair<KeyType, ValueType>> EvictList;
+
+      // true if capacity is an entry count
+      static constexpr bool COUNTS_ENTRIES = std::is_same_v<CostFunc, UnitCost>;
+
+      LRUCache(size_t capacity, CostFunc cost = CostFunc())
+        : cost_(cost), capacity_(capacity), min_entries_(0), usage_(0), high_water_(0), size_(0), front_(impl::LRU_NIL), back_(impl::LRU_NIL), free_(impl::LRU_NIL) {
+        GrowIndex(COUNTS_ENTRIES ? capacity : 0);
+      }
+
       bool Fetch(const KeyType& key, ValueType* output) {
         std::lock_guard lock(cache_mutex);
-        if (key_cache.Contains(key)) {
-          key_cache.PushFront(key);
-          if (output != nullptr) {
-            *output = value_cache.at(key);
-          }
-          return true;
+        uint32_t slot = Find(key, Hash(key));
+        if (slot == impl::LRU_NIL) {
+          return false;
         }
 
-        return false;
+        MoveToFront(slot);
+        if (output != nullptr) {
+          *output = slab_[slot].value;
+        }
+
+        return true;
       }
 
       bool Has(const KeyType& key) {
         std::lock_guard lock(cache_mutex);
-        return (key_cache.Contains(key));
+        return (Find(key, Hash(key)) != impl::LRU_NIL);
       }
 
       bool Refresh(const KeyType& key) {
+        return Fetch(key, nullptr);
+      }
+
+      // true if key was cached
+      bool Erase(const KeyType& key) {
         std::lock_guard lock(cache_mutex);
-        if (Has(key)) {
-          Fetch(key, nullptr);
-          return true;
+        uint32_t slot = Find(key, Hash(key));
+        if (slot == impl::LRU_NIL) {
+          return false;
         }
 
-        return false;
+        Evict(slot);
+        return true;
       }
 
       /**
        * @brief ensure cache has capacity for specified items
-       * 
-       * @param new_capacity 
+       *
+       * @param new_capacity - in cost units
        */
-      void Reserve(int new_capacity) {
+      void Reserve(size_t new_capacity) {
         std::lock_guard lock(cache_mutex);
         if (capacity_ < new_capacity) {
           capacity_ = new_capacity;
+          if constexpr (COUNTS_ENTRIES) {
+            GrowIndex(new_capacity);
+          }
         }
       }
 
-      int Capacity() {
+      /**
+       * @brief never evict down past entry_count entries, whatever they cost. replaces the last floor - once it drops,
+       * later puts evict back down to the budget
+       */
+      void ReserveEntries(size_t entry_count) {
+        std::lock_guard lock(cache_mutex);
+        min_entries_ = entry_count;
+        GrowIndex(entry_count);
+      }
+
+      /**
+       * @return size_t - budget, in cost units
+       */
+      size_t Capacity() {
         std::lock_guard lock(cache_mutex);
         return capacity_;
       }
 
+      /**
+       * @return size_t - cost of everything currently cached
+       */
+      size_t Usage() {
+        std::lock_guard lock(cache_mutex);
+        return usage_;
+      }
+
+      /**
+       * @return size_t - highest usage seen since construction
+       */
+      size_t HighWaterMark() {
+        std::lock_guard lock(cache_mutex);
+        return high_water_;
+      }
+
+      /**
+       * @return size_t - number of cached entries
+       */
+      size_t Size() {
+        std::lock_guard lock(cache_mutex);
+        return size_;
+      }
+
       // put, ignore result
       void Put(const KeyType& key, const ValueType& value) {
         std::lock_guard lock(cache_mutex);
-        CachePutResult __ = Put(key, value, nullptr);
+        PutLocked(key, value, nullptr, [](uint32_t) {});
       }
 
-      // output receives booted out value
+      // output receives the overwritten value, or the least recent value booted out
       CachePutResult Put(const KeyType& key, const ValueType& value, ValueType* output) {
         std::lock_guard lock(cache_mutex);
-        CachePutResult res = SUCCESS;
-        key_cache.PushFront(key);
-        auto itr = value_cache.find(key);
-        if (itr != value_cache.end()) {
-          if (output != nullptr) {
-            *output = itr->second;
+        bool first = true;
+        return PutLocked(key, value, output, [&](uint32_t slot) {
+          if (output != nullptr && first) {
+            *output = slab_[slot].value;
           }
-          res = OVERWRITE;
-        } else if (key_cache.Size() > capacity_) {
-          KeyType key_last; 
-
-          // might want to clean this up later
-          // whatever :3
-          bool key_available = key_cache.PopBack(&key_last);
-          assert(key_available);
-          assert(value_cache.find(key_last) != value_cache.end());
-          if (output != nullptr) {
-            *output = value_cache.at(key_last);
-          }
-          res = REMOVE_LAST;
-        }
 
-        value_cache.insert_or_assign(key, value);
-        return res;
+          first = false;
+        });
+      }
+
+      // evicted receives every entry booted out to make room, least recent first
+      CachePutResult Put(const KeyType& key, const ValueType& value, EvictList* evicted) {
+        std::lock_guard lock(cache_mutex);
+        return PutLocked(key, value, nullptr, [&](uint32_t slot) {
+          if (evicted != nullptr) {
+            evicted->emplace_back(slab_[slot].key, slab_[slot].value);
+          }
+        });
       }
 
       /**
        * @brief Creates an iterator at start of cache. NOT THREAD SAFE.
-       * 
-       * @return impl::LRUCacheIterator<KeyType, ValueType> 
+       *
+       * @return impl::LRUCacheIterator<KeyType, ValueType>
        */
       impl::LRUCacheIterator<KeyType, ValueType> begin() {
-        return impl::LRUCacheIterator<KeyType, ValueType>(key_cache.begin(), &value_cache);
+        return impl::LRUCacheIterator<KeyType, ValueType>(front_, &slab_);
       }
 
       /**
        * @brief Creates an iterator at emd of cache. NOT THREAD SAFE.
-       * 
-       * @return impl::LRUCacheIterator<KeyType, ValueType> 
+       *
+       * @return impl::LRUCacheIterator<KeyType, ValueType>
        */
       impl::LRUCacheIterator<KeyType, ValueType> end() {
         return impl::LRUCacheIterator<KeyType, ValueType>();
@@ -136,20 +212,217 @@ namespace chunker {
 
       /**
        * @brief Creates an iterator at begin of cache, which is bounded by a pre-specified length. NOT THREAD SAFE.
-       * 
-       * @return impl::LRUCacheIterator<KeyType, ValueType> 
+       *
+       * @return impl::LRUCacheIterator<KeyType, ValueType>
        */
       impl::LRUCacheIterator<KeyType, ValueType> begin_bounded(int max_length) {
-        return impl::LRUCacheIterator<KeyType, ValueType>(key_cache.begin(), &value_cache, max_length);
+        return impl::LRUCacheIterator<KeyType, ValueType>(front_, &slab_, max_length);
       }
 
     private:
-      HashList<KeyType> key_cache;
-      std::unordered_map<KeyType, ValueType> value_cache;
-      int capacity_;
-      std::recursive_mutex cache_mutex;
-    };     
+      // index cells hold a slab slot + its hash, so probes rarely touch the slab
+      struct index_cell {
+        uint32_t slot;
+        uint32_t hash;
+      };
+
+      // OnEvict: (slot) -> void, called on each evicted slot before it's released
+      template <typename OnEvict>
+      CachePutResult PutLocked(const KeyType& key, const ValueType& value, ValueType* replaced, OnEvict on_evict) {
+        uint32_t hash = Hash(key);
+        uint32_t slot = Find(key, hash);
+        size_t cost = cost_(value);
+        CachePutResult res = SUCCESS;
+        if (slot != impl::LRU_NIL) {
+          if (replaced != nullptr) {
+            *replaced = slab_[slot].value;
+          }
+
+          usage_ = usage_ - slab_[slot].cost + cost;
+          slab_[slot].value = value;
+          slab_[slot].cost = cost;
+          MoveToFront(slot);
+          res = OVERWRITE;
+        } else {
+          slot = AllocSlot();
+          SlotType& entry = slab_[slot];
+          entry.key = key;
+          entry.value = value;
+          entry.hash = hash;
+          entry.cost = cost;
+          InsertIndex(slot);
+          LinkFront(slot);
+          usage_ += cost;
+          size_++;
+        }
+
+        high_water_ = std::max(high_water_, usage_);
+
+        // never evict the entry we just put, or past the reserved floor
+        while (usage_ > capacity_ && size_ > min_entries_ && back_ != slot) {
+          uint32_t victim = back_;
+          on_evict(victim);
+          Evict(victim);
+          if (res == SUCCESS) {
+            res = REMOVE_LAST;
+          }
+        }
+
+        return res;
+      }
+
+      void Evict(uint32_t slot) {
+        SlotType& entry = slab_[slot];
+        EraseIndex(slot);
+        Unlink(slot);
+        usage_ -= entry.cost;
+        size_--;
+
+        // release the value now, rather than whenever the slot is reused
+        entry.value = ValueType();
+        entry.next = free_;
+        free_ = slot;
+      }
+
+      uint32_t AllocSlot() {
+        if (free_ != impl::LRU_NIL) {
+          uint32_t slot = free_;
+          free_ = slab_[slot].next;
+          return slot;
+        }
+
+        slab_.emplace_back();
+        if (slab_.size() * 2 > index_.size()) {
+          GrowIndex(slab_.size());
+        }
+
+        return static_cast<uint32_t>(slab_.size() - 1);
+      }
+
+      uint32_t Hash(const KeyType& key) const {
+        uint64_t hash = HashMix64(static_cast<uint64_t>(hasher_(key)));
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+      }
+
+      // slab slot holding key, or LRU_NIL
+      uint32_t Find(const KeyType& key, uint32_t hash) const {
+        size_t mask = index_.size() - 1;
+        for (size_t cell = hash & mask; index_[cell].slot != impl::LRU_NIL; cell = (cell + 1) & mask) {
+          if (index_[cell].hash == hash && slab_[index_[cell].slot].key == key) {
+            return index_[cell].slot;
+          }
+        }
+
+        return impl::LRU_NIL;
+      }
+
+      void InsertIndex(uint32_t slot) {
+        size_t mask = index_.size() - 1;
+        size_t cell = slab_[slot].hash & mask;
+        while (index_[cell].slot != impl::LRU_NIL) {
+          cell = (cell + 1) & mask;
+        }
+
+        index_[cell].slot = slot;
+        index_[cell].hash = slab_[slot].hash;
+      }
+
+      // linear probing w backward-shift deletion - no tombstones
+      void EraseIndex(uint32_t slot) {
+        size_t mask = index_.size() - 1;
+        size_t cell = slab_[slot].hash & mask;
+        while (index_[cell].slot != slot) {
+          cell = (cell + 1) & mask;
+        }
+
+        size_t next = (cell + 1) & mask;
+        while (index_[next].slot != impl::LRU_NIL) {
+          // distance of the next entry from its home cell, vs distance from the hole
+          size_t home = index_[next].hash & mask;
+          if (((next - home) & mask) >= ((next - cell) & mask)) {
+            index_[cell] = index_[next];
+            cell = next;
+          }
+
+          next = (next + 1) & mask;
+        }
+
+        index_[cell].slot = impl::LRU_NIL;
+      }
+
+      // sizes the index for `entries` entries, keeping it at most half full
+      void GrowIndex(size_t entries) {
+        size_t cells = 16;
+        while (cells < entries * 2) {
+          cells <<= 1;
+        }
+
+        if (cells <= index_.size()) {
+          return;
+        }
+
+        index_.assign(cells, index_cell { impl::LRU_NIL, 0 });
+        for (uint32_t slot = front_; slot != impl::LRU_NIL; slot = slab_[slot].next) {
+          InsertIndex(slot);
+        }
+
+        slab_.reserve(entries);
+      }
+
+      void Unlink(uint32_t slot) {
+        SlotType& entry = slab_[slot];
+        if (entry.prev != impl::LRU_NIL) {
+          slab_[entry.prev].next = entry.next;
+        } else {
+          front_ = entry.next;
+        }
+
+        if (entry.next != impl::LRU_NIL) {
+          slab_[entry.next].prev = entry.prev;
+        } else {
+          back_ = entry.prev;
+        }
+      }
+
+      void LinkFront(uint32_t slot) {
+        SlotType& entry = slab_[slot];
+        entry.prev = impl::LRU_NIL;
+        entry.next = front_;
+        if (front_ != impl::LRU_NIL) {
+          slab_[front_].prev = slot;
+        } else {
+          back_ = slot;
+        }
+
+        front_ = slot;
+      }
+
+      void MoveToFront(uint32_t slot) {
+        if (slot != front_) {
+          Unlink(slot);
+          LinkFront(slot);
+        }
+      }
+
+      std::vector<SlotType> slab_;
+      std::vector<index_cell> index_;
+      std::hash<KeyType> hasher_;
+      CostFunc cost_;
+
+      size_t capacity_;
+      size_t min_entries_;
+      size_t usage_;
+      size_t high_water_;
+      size_t size_;
+
+      // most / least recently used slots, and head of the free list (linked through next)
+      uint32_t front_;
+      uint32_t back_;
+      uint32_t free_;
+
+      std::mutex cache_mutex;
+    };
   }
 }
 
-#endif // LRU_CACHE_H_
\ No newline at end of file
+#endif // LRU_CACHE_H_
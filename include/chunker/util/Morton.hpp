@@ -0,0 +1,86 @@
+#ifndef MORTON_H_
+#define MORTON_H_
+
+#include <cstdint>
+
+namespace chunker {
+  namespace util {
+    namespace impl {
+      // spreads the low 16 bits of v out to the even bits
+      inline uint32_t MortonSpread2(uint32_t v) {
+        v &= 0x0000FFFF;
+        v = (v | (v << 8)) & 0x00FF00FF;
+        v = (v | (v << 4)) & 0x0F0F0F0F;
+        v = (v | (v << 2)) & 0x33333333;
+        v = (v | (v << 1)) & 0x55555555;
+        return v;
+      }
+
+      // inverse of MortonSpread2
+      inline uint32_t MortonCompact2(uint32_t v) {
+        v &= 0x55555555;
+        v = (v | (v >> 1)) & 0x33333333;
+        v = (v | (v >> 2)) & 0x0F0F0F0F;
+        v = (v | (v >> 4)) & 0x00FF00FF;
+        v = (v | (v >> 8)) & 0x0000FFFF;
+        return v;
+      }
+
+      // spreads the low 16 bits of v out to every third bit
+      inline uint64_t MortonSpread3(uint64_t v) {
+        v &= 0x000000000000FFFFull;
+        v = (v | (v << 16)) & 0x00000000FF0000FFull;
+        v = (v | (v << 8)) & 0x000000F00F00F00Full;
+        v = (v | (v << 4)) & 0x00000C30C30C30C3ull;
+        v = (v | (v << 2)) & 0x0000249249249249ull;
+        return v;
+      }
+
+      // inverse of MortonSpread3
+      inline uint32_t MortonCompact3(uint64_t v) {
+        v &= 0x0000249249249249ull;
+        v = (v | (v >> 2)) & 0x00000C30C30C30C3ull;
+        v = (v | (v >> 4)) & 0x000000F00F00F00Full;
+        v = (v | (v >> 8)) & 0x00000000FF0000FFull;
+        v = (v | (v >> 16)) & 0x000000000000FFFFull;
+        return static_cast<uint32_t>(v);
+      }
+    }
+
+    /**
+     * @brief interleaves two 16 bit coords into a 32 bit morton code. x occupies the even bits.
+     */
+    inline uint32_t MortonEncode2(uint32_t x, uint32_t y) {
+      return impl::MortonSpread2(x) | (impl::MortonSpread2(y) << 1);
+    }
+
+    inline uint32_t MortonDecodeX2(uint32_t code) {
+      return impl::MortonCompact2(code);
+    }
+
+    inline uint32_t MortonDecodeY2(uint32_t code) {
+      return impl::MortonCompact2(code >> 1);
+    }
+
+    /**
+     * @brief interleaves three 16 bit coords into a 48 bit morton code. x occupies bits 0, 3, 6...
+     */
+    inline uint64_t MortonEncode3(uint32_t x, uint32_t y, uint32_t z) {
+      return impl::MortonSpread3(x) | (impl::MortonSpread3(y) << 1) | (impl::MortonSpread3(z) << 2);
+    }
+
+    inline uint32_t MortonDecodeX3(uint64_t code) {
+      return impl::MortonCompact3(code);
+    }
+
+    inline uint32_t MortonDecodeY3(uint64_t code) {
+      return impl::MortonCompact3(code >> 1);
+    }
+
+    inline uint32_t MortonDecodeZ3(uint64_t code) {
+      return impl::MortonCompact3(code >> 2);
+    }
+  }
+}
+
+#endif // MORTON_H_
@@ -0,0 +1,178 @@
+#ifndef SHARDED_LRU_CACHE_H_
+#define SHARDED_LRU_CACHE_H_
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include "chunker/util/Hash.hpp"
+#include "chunker/util/LRUCache.hpp"
+#include "chunker/util/impl/ShardedLRUCacheIterator.hpp"
+
+namespace chunker {
+  namespace util {
+    /**
+     * @brief LRU cache split into independent shards, each w its own lock and LRU order - thread safe on calls not returning an iterator.
+     *
+     * Keys are routed to a shard by the top bits of their (re-mixed) hash, so threads touching different keys rarely contend.
+     * Eviction is per shard - capacity is best effort. Each shard is sized so that a uniformly hashed working set of
+     * `capacity` keys fits, but the cache as a whole isn't strictly LRU. With a cost functor, the same split applies to the budget.
+     *
+     * @tparam KeyType - type for key
+     * @tparam ValueType - type for value
+     * @tparam ShardCount - number of shards. must be a power of two.
+     * @tparam CostFunc - per-shard cost functor, see LRUCache
+     */
+    template <typename KeyType, typename ValueType, size_t ShardCount = 16, typename CostFunc = UnitCost>
+    class ShardedLRUCache {
+      static_assert(ShardCount > 0 && (ShardCount & (ShardCount - 1)) == 0, "shard count must be a power of two");
+      typedef LRUCache<KeyType, ValueType, CostFunc> ShardType;
+    public:
+      typedef KeyType key_type;
+      typedef impl::ShardedLRUCacheIterator<ShardType> iterator;
+      typedef typename ShardType::EvictList EvictList;
+
+      static constexpr bool COUNTS_ENTRIES = ShardType::COUNTS_ENTRIES;
+
+      ShardedLRUCache(size_t capacity, CostFunc cost = CostFunc()) : capacity_(capacity) {
+        for (auto& shard : shards_) {
+          shard = std::make_unique<ShardType>(ShardCapacity(capacity), cost);
+        }
+      }
+
+      bool Fetch(const KeyType& key, ValueType* output) {
+        return Shard(key).Fetch(key, output);
+      }
+
+      bool Has(const KeyType& key) {
+        return Shard(key).Has(key);
+      }
+
+      bool Refresh(const KeyType& key) {
+        return Shard(key).Refresh(key);
+      }
+
+      /**
+       * @brief ensure cache has capacity for specified items
+       *
+       * @param new_capacity - in cost units
+       */
+      void Reserve(size_t new_capacity) {
+        std::lock_guard lock(capacity_mutex_);
+        if (capacity_ < new_capacity) {
+          capacity_ = new_capacity;
+          for (auto& shard : shards_) {
+            shard->Reserve(ShardCapacity(new_capacity));
+          }
+        }
+      }
+
+      /**
+       * @brief never evict down past entry_count entries, whatever they cost - split across shards like capacity
+       */
+      void ReserveEntries(size_t entry_count) {
+        for (auto& shard : shards_) {
+          shard->ReserveEntries(ShardCapacity(entry_count));
+        }
+      }
+
+      size_t Capacity() {
+        std::lock_guard lock(capacity_mutex_);
+        return capacity_;
+      }
+
+      // summed over shards - each shard is read in turn, so this is approximate while other threads put
+      size_t Usage() {
+        size_t res = 0;
+        for (auto& shard : shards_) {
+          res += shard->Usage();
+        }
+
+        return res;
+      }
+
+      // sum of per-shard high water marks - an upper bound on the cache's own peak
+      size_t HighWaterMark() {
+        size_t res = 0;
+        for (auto& shard : shards_) {
+          res += shard->HighWaterMark();
+        }
+
+        return res;
+      }
+
+      size_t Size() {
+        size_t res = 0;
+        for (auto& shard : shards_) {
+          res += shard->Size();
+        }
+
+        return res;
+      }
+
+      // put, ignore result
+      void Put(const KeyType& key, const ValueType& value) {
+        Shard(key).Put(key, value);
+      }
+
+      // output receives booted out value
+      CachePutResult Put(const KeyType& key, const ValueType& value, ValueType* output) {
+        return Shard(key).Put(key, value, output);
+      }
+
+      // evicted receives every entry booted out of the key's shard
+      CachePutResult Put(const KeyType& key, const ValueType& value, EvictList* evicted) {
+        return Shard(key).Put(key, value, evicted);
+      }
+
+      /**
+       * @brief Creates an iterator over every shard. Shards are visited in turn, so order is only LRU within a shard. NOT THREAD SAFE.
+       */
+      iterator begin() {
+        return iterator(shards_.data(), ShardCount, SIZE_MAX);
+      }
+
+      /**
+       * @brief Creates an iterator at end of cache. NOT THREAD SAFE.
+       */
+      iterator end() {
+        return iterator();
+      }
+
+      /**
+       * @brief Creates an iterator at begin of cache, which is bounded by a pre-specified length. NOT THREAD SAFE.
+       */
+      iterator begin_bounded(int max_length) {
+        return iterator(shards_.data(), ShardCount, max_length);
+      }
+
+      static constexpr size_t Shards() {
+        return ShardCount;
+      }
+
+    private:
+      ShardType& Shard(const KeyType& key) {
+        // re-mix - plenty of std::hash impls are the identity, and the shard's own table uses the low bits
+        uint64_t hash = HashMix64(static_cast<uint64_t>(hasher_(key)));
+        return *shards_[static_cast<size_t>(hash >> 32) & (ShardCount - 1)];
+      }
+
+      // even split, plus headroom for ~3 std devs of imbalance
+      static size_t ShardCapacity(size_t capacity) {
+        double per_shard = static_cast<double>(capacity) / ShardCount;
+        return static_cast<size_t>(std::ceil(per_shard + 3.0 * std::sqrt(per_shard))) + 1;
+      }
+
+      std::array<std::unique_ptr<ShardType>, ShardCount> shards_;
+      std::hash<KeyType> hasher_;
+
+      size_t capacity_;
+      std::mutex capacity_mutex_;
+    };
+  }
+}
+
+#endif // SHARDED_LRU_CACHE_H_
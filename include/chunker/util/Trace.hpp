@@ -0,0 +1,374 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// tracing is compiled out unless CHUNKER_ENABLE_TRACE is defined - the CHUNKER_TRACE_* macros expand to nothing,
+// and their arguments are never evaluated. the recorder itself is always there, so dumping never needs an #ifdef
+// (it just writes an empty trace).
+
+namespace chunker {
+  namespace util {
+#ifdef CHUNKER_ENABLE_TRACE
+    constexpr bool TRACE_ENABLED = true;
+#else
+    constexpr bool TRACE_ENABLED = false;
+#endif
+
+    // up to four named integer args. names are string literals, shared by every event of a kind
+    struct TraceArgs {
+      const char* const* names = nullptr;
+      int64_t values[4] = {};
+      int count = 0;
+    };
+
+    struct TraceEvent {
+      // string literals - never copied
+      const char* category;
+      const char* name;
+
+      // steady clock, ns
+      int64_t start_ns;
+      int64_t duration_ns;
+
+      TraceArgs args;
+
+      // 'X' span on the recording thread, 'i' instant, 'b' async span - may start before it's recorded, on another thread
+      char phase;
+    };
+
+    /**
+     * @brief one thread's events - a ring, so the oldest are overwritten once it's full.
+     * only its own thread writes to it. the lock is there for dumps, so it's uncontended otherwise.
+     */
+    class TraceBuffer {
+      public:
+      TraceBuffer(uint32_t id, size_t capacity) : id_(id), events_(std::max(capacity, static_cast<size_t>(1))) {}
+
+      void Push(const TraceEvent& event) {
+        std::lock_guard<std::mutex> lock(lock_);
+        events_[written_ % events_.size()] = event;
+        written_++;
+      }
+
+      // only the first name sticks - cheap to call on every task
+      void SetName(const char* name, size_t index) {
+        if (named_) {
+          return;
+        }
+
+        std::lock_guard<std::mutex> lock(lock_);
+        name_ = std::string(name) + " " + std::to_string(index);
+        named_ = true;
+      }
+
+      /**
+       * @brief copies events out, oldest first
+       * @return uint64_t - events overwritten since the last Clear
+       */
+      uint64_t Copy(std::vector<TraceEvent>* output, std::string* name) const {
+        std::lock_guard<std::mutex> lock(lock_);
+        size_t kept = static_cast<size_t>(std::min<uint64_t>(written_, events_.size()));
+        for (uint64_t i = written_ - kept; i < written_; i++) {
+          output->push_back(events_[i % events_.size()]);
+        }
+
+        *name = name_;
+        return written_ - kept;
+      }
+
+      void Clear() {
+        std::lock_guard<std::mutex> lock(lock_);
+        written_ = 0;
+      }
+
+      uint32_t Id() const {
+        return id_;
+      }
+
+      private:
+      uint32_t id_;
+      mutable std::mutex lock_;
+      std::vector<TraceEvent> events_;
+      uint64_t written_ = 0;
+
+      // only touched by the owning thread outside of the lock
+      bool named_ = false;
+      std::string name_;
+    };
+
+    /**
+     * @brief collects every thread's trace buffer, and writes them out in the chrome trace event format -
+     * open the dump in chrome://tracing or ui.perfetto.dev
+     */
+    class TraceRecorder {
+      public:
+      static TraceRecorder& Instance() {
+        static TraceRecorder recorder;
+        return recorder;
+      }
+
+      static int64_t Now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      }
+
+      /**
+       * @brief events kept per thread, before the oldest are overwritten. only for threads which haven't recorded anything yet
+       */
+      void SetCapacity(size_t events) {
+        std::lock_guard<std::mutex> lock(lock_);
+        capacity_ = events;
+      }
+
+      void Record(const TraceEvent& event) {
+        ThreadBuffer().Push(event);
+      }
+
+      // names this thread in the dump, as "name index"
+      void NameThread(const char* name, size_t index) {
+        ThreadBuffer().SetName(name, index);
+      }
+
+      // drops everything recorded so far. threads keep their buffers
+      void Clear() {
+        std::lock_guard<std::mutex> lock(lock_);
+        for (auto& buffer : buffers_) {
+          buffer->Clear();
+        }
+      }
+
+      /**
+       * @brief writes every buffer as a chrome trace json object. safe while other threads are still recording
+       */
+      void WriteChromeJson(std::ostream& output) const {
+        std::vector<std::shared_ptr<TraceBuffer>> buffers;
+        {
+          std::lock_guard<std::mutex> lock(lock_);
+          buffers = buffers_;
+        }
+
+        std::vector<TraceEvent> events;
+        std::string name;
+        uint64_t dropped = 0;
+        uint64_t async_id = 0;
+        bool first = true;
+        output << "{\"traceEvents\":[";
+        for (auto& buffer : buffers) {
+          events.clear();
+          dropped += buffer->Copy(&events, &name);
+          if (!name.empty()) {
+            output << (first ? "\n" : ",\n");
+            output << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->Id() << ",\"args\":{\"name\":";
+            WriteString(output, name.c_str());
+            output << "}}";
+            first = false;
+          }
+
+          for (auto& event : events) {
+            if (event.phase == 'b') {
+              // begin and end share an id, so the viewer can pair them up
+              async_id++;
+              WriteEvent(output, event, 'b', event.start_ns, buffer->Id(), async_id, &first);
+              WriteEvent(output, event, 'e', event.start_ns + event.duration_ns, buffer->Id(), async_id, &first);
+            } else {
+              WriteEvent(output, event, event.phase, event.start_ns, buffer->Id(), 0, &first);
+            }
+          }
+        }
+
+        output << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_events\":" << dropped << "}}\n";
+      }
+
+      /**
+       * @return true if path was written
+       */
+      bool Dump(const std::string& path) const {
+        std::ofstream output(path);
+        if (!output) {
+          return false;
+        }
+
+        WriteChromeJson(output);
+        return static_cast<bool>(output);
+      }
+
+      private:
+      TraceRecorder() : origin_ns_(Now()) {}
+
+      TraceBuffer& ThreadBuffer() {
+        // shared w buffers_, so a thread's events outlive it until they're dumped
+        thread_local std::shared_ptr<TraceBuffer> buffer;
+        if (buffer == nullptr) {
+          std::lock_guard<std::mutex> lock(lock_);
+          buffer = std::make_shared<TraceBuffer>(static_cast<uint32_t>(buffers_.size() + 1), capacity_);
+          buffers_.push_back(buffer);
+        }
+
+        return *buffer;
+      }
+
+      void WriteEvent(std::ostream& output, const TraceEvent& event, char phase, int64_t at_ns, uint32_t tid, uint64_t id, bool* first) const {
+        // chrome wants microseconds
+        char time[64];
+        output << (*first ? "\n" : ",\n");
+        *first = false;
+
+        output << "{\"ph\":\"" << phase << "\",\"cat\":";
+        WriteString(output, event.category);
+        output << ",\"name\":";
+        WriteString(output, event.name);
+        std::snprintf(time, sizeof(time), "%.3f", static_cast<double>(at_ns - origin_ns_) / 1000.0);
+        output << ",\"ts\":" << time << ",\"pid\":1,\"tid\":" << tid;
+        if (phase == 'X') {
+          std::snprintf(time, sizeof(time), "%.3f", static_cast<double>(event.duration_ns) / 1000.0);
+          output << ",\"dur\":" << time;
+        } else if (phase == 'i') {
+          // thread scoped
+          output << ",\"s\":\"t\"";
+        } else {
+          output << ",\"id\":" << id;
+        }
+
+        if (event.args.count > 0 && phase != 'e') {
+          output << ",\"args\":{";
+          for (int i = 0; i < event.args.count; i++) {
+            output << (i == 0 ? "" : ",");
+            WriteString(output, event.args.names[i]);
+            output << ":" << event.args.values[i];
+          }
+
+          output << "}";
+        }
+
+        output << "}";
+      }
+
+      static void WriteString(std::ostream& output, const char* value) {
+        output << '"';
+        for (const char* c = value; *c != '\0'; c++) {
+          if (*c == '"' || *c == '\\') {
+            output << '\\';
+          }
+
+          output << *c;
+        }
+
+        output << '"';
+      }
+
+      int64_t origin_ns_;
+
+      mutable std::mutex lock_;
+      std::vector<std::shared_ptr<TraceBuffer>> buffers_;
+      size_t capacity_ = 16384;
+    };
+
+    /**
+     * @brief records a span from construction to destruction, on this thread
+     */
+    class TraceScope {
+      public:
+      TraceScope(const char* category, const char* name, const TraceArgs& args = TraceArgs()) :
+        category_(category), name_(name), args_(args), start_(TraceRecorder::Now()) {}
+
+      ~TraceScope() {
+        TraceRecorder::Instance().Record(TraceEvent { category_, name_, start_, TraceRecorder::Now() - start_, args_, 'X' });
+      }
+
+      TraceScope(const TraceScope& other) = delete;
+      TraceScope& operator=(const TraceScope& other) = delete;
+
+      private:
+      const char* category_;
+      const char* name_;
+      TraceArgs args_;
+      int64_t start_;
+    };
+
+    namespace impl_ {
+      template <typename KeyType, typename = void>
+      struct has_z : std::false_type {};
+
+      template <typename KeyType>
+      struct has_z<KeyType, std::void_t<decltype(std::declval<const KeyType&>().Z())>> : std::true_type {};
+    }
+
+    // position and size of a chunk key - x, y, size for 2D keys, x, y, z, size for volume keys
+    template <typename KeyType>
+    TraceArgs KeyTraceArgs(const KeyType& key) {
+      TraceArgs res;
+      if constexpr (impl_::has_z<KeyType>::value) {
+        static const char* const NAMES[] = { "x", "y", "z", "size" };
+        res.names = NAMES;
+        res.values[0] = key.X();
+        res.values[1] = key.Y();
+        res.values[2] = key.Z();
+        res.values[3] = static_cast<int64_t>(key.Size());
+        res.count = 4;
+      } else {
+        static const char* const NAMES[] = { "x", "y", "size" };
+        res.names = NAMES;
+        res.values[0] = key.X();
+        res.values[1] = key.Y();
+        res.values[2] = static_cast<int64_t>(key.Size());
+        res.count = 3;
+      }
+
+      return res;
+    }
+
+    inline TraceArgs CountTraceArgs(size_t count) {
+      static const char* const NAMES[] = { "count" };
+      TraceArgs res;
+      res.names = NAMES;
+      res.values[0] = static_cast<int64_t>(count);
+      res.count = 1;
+      return res;
+    }
+  }
+}
+
+#define CHUNKER_TRACE_CONCAT_IMPL(a, b) a##b
+#define CHUNKER_TRACE_CONCAT(a, b) CHUNKER_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef CHUNKER_ENABLE_TRACE
+// span covering the rest of the enclosing block
+#define CHUNKER_TRACE_SCOPE(category, name) \
+  ::chunker::util::TraceScope CHUNKER_TRACE_CONCAT(chunker_trace_scope_, __LINE__)(category, name)
+#define CHUNKER_TRACE_SCOPE_ARGS(category, name, args) \
+  ::chunker::util::TraceScope CHUNKER_TRACE_CONCAT(chunker_trace_scope_, __LINE__)(category, name, args)
+
+// span between two timestamps already taken (TraceRecorder::Now / steady clock ns) - no extra clock reads
+#define CHUNKER_TRACE_SPAN(category, name, start_ns, end_ns, args) \
+  ::chunker::util::TraceRecorder::Instance().Record(::chunker::util::TraceEvent { category, name, (start_ns), (end_ns) - (start_ns), args, 'X' })
+
+// as CHUNKER_TRACE_SPAN, but on its own track - for spans which don't nest, like time spent queued
+#define CHUNKER_TRACE_ASYNC(category, name, start_ns, end_ns, args) \
+  ::chunker::util::TraceRecorder::Instance().Record(::chunker::util::TraceEvent { category, name, (start_ns), (end_ns) - (start_ns), args, 'b' })
+
+#define CHUNKER_TRACE_INSTANT(category, name, args) \
+  ::chunker::util::TraceRecorder::Instance().Record(::chunker::util::TraceEvent { category, name, ::chunker::util::TraceRecorder::Now(), 0, args, 'i' })
+
+#define CHUNKER_TRACE_THREAD_NAME(name, index) \
+  ::chunker::util::TraceRecorder::Instance().NameThread(name, index)
+#else
+#define CHUNKER_TRACE_SCOPE(category, name) ((void)0)
+#define CHUNKER_TRACE_SCOPE_ARGS(category, name, args) ((void)0)
+#define CHUNKER_TRACE_SPAN(category, name, start_ns, end_ns, args) ((void)0)
+#define CHUNKER_TRACE_ASYNC(category, name, start_ns, end_ns, args) ((void)0)
+#define CHUNKER_TRACE_INSTANT(category, name, args) ((void)0)
+#define CHUNKER_TRACE_THREAD_NAME(name, index) ((void)0)
+#endif
+
+#endif // TRACE_H_
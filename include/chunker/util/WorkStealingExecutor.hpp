@@ -0,0 +1,473 @@
+#ifndef WORK_STEALING_EXECUTOR_H_
+#define WORK_STEALING_EXECUTOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace chunker {
+  namespace util {
+    /**
+     * @brief fixed pool of workers, each w its own task deque.
+     *
+     * Submitted tasks are spread across the worker deques. A worker pops from the front of its own deque, and once that's
+     * empty, steals half of another worker's deque from the back. Idle workers spin briefly before parking on a shared
+     * condvar, so back-to-back batches don't pay a full wakeup.
+     *
+     * Tasks submitted w a priority skip the deques, and go into one shared heap instead. Workers always drain that heap
+     * first, most urgent (lowest) priority first, so prioritized work is strictly ordered across every worker - at the cost
+     * of one more lock, which is fine for chunk-sized tasks.
+     *
+     * Background tasks sit in one more shared queue, behind everything else - workers only pick them up when there's
+     * nothing else to do, and Wait() doesn't wait on them. For speculative work, like prefetching.
+     *
+     * Wait() blocks on a single latch - the count of submitted tasks which haven't finished yet.
+     *
+     * @tparam TaskType - copyable task. cheap to move, ideally.
+     * @tparam PriorityType - ordered w operator<. lower runs sooner.
+     */
+    template <typename TaskType, typename PriorityType = double>
+    class WorkStealingExecutor {
+    public:
+      // (worker index, task) - runs on the worker's thread
+      typedef std::function<void(size_t, TaskType&)> HandlerType;
+
+      /**
+       * @param worker_count - number of worker threads. at least one.
+       * @param handler - run for each task
+       */
+      WorkStealingExecutor(size_t worker_count, HandlerType handler)
+        : handler_(std::move(handler)), queued_(0), prioritized_(0), backgrounded_(0), pending_(0), background_pending_(0),
+          sleeping_(0), next_queue_(0), next_seq_(0), stop_(false) {
+        worker_count = std::max(worker_count, static_cast<size_t>(1));
+        for (size_t i = 0; i < worker_count; i++) {
+          queues_.push_back(std::make_unique<worker_queue>());
+        }
+
+        for (size_t i = 0; i < worker_count; i++) {
+          threads_.emplace_back(&WorkStealingExecutor::WorkerFunc, this, i);
+        }
+      }
+
+      WorkStealingExecutor(const WorkStealingExecutor& other) = delete;
+      WorkStealingExecutor(WorkStealingExecutor&& other) = delete;
+      WorkStealingExecutor& operator=(const WorkStealingExecutor& other) = delete;
+      WorkStealingExecutor& operator=(WorkStealingExecutor&& other) = delete;
+
+      // tasks still queued are dropped - call Wait() first to finish them
+      ~WorkStealingExecutor() {
+        {
+          std::lock_guard lock(sleep_mutex_);
+          stop_.store(true);
+        }
+
+        sleep_cond_.notify_all();
+        for (auto& thread : threads_) {
+          thread.join();
+        }
+      }
+
+      void Submit(const TaskType& task) {
+        pending_.fetch_add(1);
+        queued_.fetch_add(1);
+        worker_queue& queue = *queues_[next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+        {
+          std::lock_guard lock(queue.lock);
+          queue.tasks.push_back(task);
+        }
+
+        WakeWorkers(1);
+      }
+
+      /**
+       * @brief submits a range of tasks, split into contiguous blocks - one per worker.
+       * takes each worker's lock once, and wakes sleepers once.
+       */
+      template <typename Iter>
+      void SubmitBulk(Iter begin, Iter end) {
+        size_t count = static_cast<size_t>(std::distance(begin, end));
+        if (count == 0) {
+          return;
+        }
+
+        pending_.fetch_add(count);
+        queued_.fetch_add(count);
+        size_t worker_count = queues_.size();
+        size_t first = next_queue_.fetch_add(1, std::memory_order_relaxed);
+        size_t block = (count + worker_count - 1) / worker_count;
+        for (size_t i = 0; i < worker_count && begin != end; i++) {
+          size_t len = std::min(block, static_cast<size_t>(std::distance(begin, end)));
+          Iter block_end = std::next(begin, len);
+          worker_queue& queue = *queues_[(first + i) % worker_count];
+          {
+            std::lock_guard lock(queue.lock);
+            queue.tasks.insert(queue.tasks.end(), begin, block_end);
+          }
+
+          begin = block_end;
+        }
+
+        WakeWorkers(count);
+      }
+
+      /**
+       * @brief submits a task ahead of every unprioritized one, and behind any w a lower priority
+       */
+      void Submit(const TaskType& task, const PriorityType& priority) {
+        pending_.fetch_add(1);
+        queued_.fetch_add(1);
+        {
+          std::lock_guard lock(heap_lock_);
+          PushHeap(task, priority);
+        }
+
+        WakeWorkers(1);
+      }
+
+      /**
+       * @brief submits a range of tasks, w priorities read off a parallel range. takes the heap lock once.
+       */
+      template <typename Iter, typename PriorityIter>
+      void SubmitBulk(Iter begin, Iter end, PriorityIter priorities) {
+        size_t count = static_cast<size_t>(std::distance(begin, end));
+        if (count == 0) {
+          return;
+        }
+
+        pending_.fetch_add(count);
+        queued_.fetch_add(count);
+        {
+          std::lock_guard lock(heap_lock_);
+          for (; begin != end; ++begin, ++priorities) {
+            PushHeap(*begin, *priorities);
+          }
+        }
+
+        WakeWorkers(count);
+      }
+
+      /**
+       * @brief re-scores every task still waiting in the priority heap, and reorders it. for when what's urgent has
+       * changed since the tasks were submitted. ties keep submission order.
+       *
+       * @param priority_of - (const TaskType&) -> PriorityType
+       */
+      template <typename Func>
+      void Reprioritize(Func&& priority_of) {
+        std::lock_guard lock(heap_lock_);
+        for (auto& entry : heap_) {
+          entry.priority = priority_of(static_cast<const TaskType&>(entry.task));
+        }
+
+        std::make_heap(heap_.begin(), heap_.end(), heap_order());
+      }
+
+      /**
+       * @brief submits a range of tasks behind everything else. they only run once workers are otherwise idle.
+       */
+      template <typename Iter>
+      void SubmitBackground(Iter begin, Iter end) {
+        size_t count = static_cast<size_t>(std::distance(begin, end));
+        if (count == 0) {
+          return;
+        }
+
+        background_pending_.fetch_add(count);
+        queued_.fetch_add(count);
+        {
+          std::lock_guard lock(background_lock_);
+          background_.insert(background_.end(), begin, end);
+          backgrounded_.fetch_add(count);
+        }
+
+        WakeWorkers(count);
+      }
+
+      /**
+       * @brief keeps Wait() blocked until a matching Release(), as if one more task were pending - WaitAll() only, if background.
+       * for handlers which hand the rest of their task to something else - call it before the handler returns.
+       */
+      void Hold(bool background = false) {
+        (background ? background_pending_ : pending_).fetch_add(1);
+      }
+
+      /**
+       * @brief undoes a Hold(). any thread.
+       */
+      void Release(bool background = false) {
+        Finish(background ? background_pending_ : pending_);
+      }
+
+      /**
+       * @brief blocks until every task submitted so far has finished - background tasks aside
+       */
+      void Wait() {
+        if (pending_.load() == 0) {
+          return;
+        }
+
+        std::unique_lock lock(done_mutex_);
+        done_cond_.wait(lock, [&] { return pending_.load() == 0; });
+      }
+
+      /**
+       * @brief blocks until every task submitted so far has finished, background tasks included
+       */
+      void WaitAll() {
+        if (pending_.load() == 0 && background_pending_.load() == 0) {
+          return;
+        }
+
+        std::unique_lock lock(done_mutex_);
+        done_cond_.wait(lock, [&] { return pending_.load() == 0 && background_pending_.load() == 0; });
+      }
+
+      /**
+       * @return size_t - tasks submitted but not yet finished, background tasks included
+       */
+      size_t Pending() const {
+        return pending_.load() + background_pending_.load();
+      }
+
+      /**
+       * @return size_t - tasks waiting for a worker, background tasks included
+       */
+      size_t Queued() const {
+        return queued_.load();
+      }
+
+      /**
+       * @return size_t - background tasks waiting for a worker
+       */
+      size_t BackgroundQueued() const {
+        return backgrounded_.load();
+      }
+
+      size_t WorkerCount() const {
+        return queues_.size();
+      }
+
+    private:
+      // own cache line, so neighbouring workers' locks don't false share
+      struct alignas(64) worker_queue {
+        std::mutex lock;
+        std::deque<TaskType> tasks;
+
+        // scratch for Steal - only ever touched by the worker which owns this queue
+        std::vector<TaskType> stolen;
+      };
+
+      // seq keeps equal priorities in submission order
+      struct heap_entry {
+        PriorityType priority;
+        uint64_t seq;
+        TaskType task;
+      };
+
+      // std heaps are max-heaps - "less" here means runs later
+      struct heap_order {
+        bool operator()(const heap_entry& a, const heap_entry& b) const {
+          if (b.priority < a.priority) {
+            return true;
+          }
+
+          if (a.priority < b.priority) {
+            return false;
+          }
+
+          return (a.seq > b.seq);
+        }
+      };
+
+      // rounds of failed steals before parking
+      static const int SPIN_ROUNDS = 64;
+
+      // call w heap_lock_ held
+      void PushHeap(const TaskType& task, const PriorityType& priority) {
+        heap_.push_back(heap_entry { priority, next_seq_++, task });
+        std::push_heap(heap_.begin(), heap_.end(), heap_order());
+        prioritized_.fetch_add(1);
+      }
+
+      bool PopHeap(TaskType& output) {
+        if (prioritized_.load() == 0) {
+          return false;
+        }
+
+        std::lock_guard lock(heap_lock_);
+        if (heap_.empty()) {
+          return false;
+        }
+
+        std::pop_heap(heap_.begin(), heap_.end(), heap_order());
+        output = std::move(heap_.back().task);
+        heap_.pop_back();
+        prioritized_.fetch_sub(1);
+        return true;
+      }
+
+      void WakeWorkers(size_t count) {
+        if (sleeping_.load() == 0) {
+          return;
+        }
+
+        // lock pairs w the sleep predicate, so a worker going to sleep can't miss this
+        {
+          std::lock_guard lock(sleep_mutex_);
+        }
+
+        if (count == 1) {
+          sleep_cond_.notify_one();
+        } else {
+          sleep_cond_.notify_all();
+        }
+      }
+
+      bool PopBackground(TaskType& output) {
+        if (backgrounded_.load() == 0) {
+          return false;
+        }
+
+        std::lock_guard lock(background_lock_);
+        if (background_.empty()) {
+          return false;
+        }
+
+        output = std::move(background_.front());
+        background_.pop_front();
+        backgrounded_.fetch_sub(1);
+        return true;
+      }
+
+      bool PopOwn(size_t index, TaskType& output) {
+        worker_queue& queue = *queues_[index];
+        std::lock_guard lock(queue.lock);
+        if (queue.tasks.empty()) {
+          return false;
+        }
+
+        output = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+      }
+
+      // takes the back half of the first non-empty victim - one task to run, the rest onto our own deque.
+      // stolen tasks pass through our own scratch buffer, so a steal doesn't allocate once it's warmed up
+      bool Steal(size_t index, TaskType& output) {
+        size_t worker_count = queues_.size();
+        worker_queue& own = *queues_[index];
+        std::vector<TaskType>& stolen = own.stolen;
+        for (size_t i = 1; i < worker_count; i++) {
+          worker_queue& victim = *queues_[(index + i) % worker_count];
+          {
+            std::lock_guard lock(victim.lock);
+            size_t count = (victim.tasks.size() + 1) / 2;
+            if (count == 0) {
+              continue;
+            }
+
+            auto start = victim.tasks.end() - static_cast<std::ptrdiff_t>(count);
+            stolen.assign(std::make_move_iterator(start), std::make_move_iterator(victim.tasks.end()));
+            victim.tasks.erase(start, victim.tasks.end());
+          }
+
+          output = std::move(stolen.front());
+          if (stolen.size() > 1) {
+            std::lock_guard lock(own.lock);
+            own.tasks.insert(own.tasks.end(), std::make_move_iterator(stolen.begin() + 1), std::make_move_iterator(stolen.end()));
+          }
+
+          stolen.clear();
+          return true;
+        }
+
+        return false;
+      }
+
+      void Finish(std::atomic<size_t>& latch) {
+        if (latch.fetch_sub(1) == 1) {
+          std::lock_guard lock(done_mutex_);
+          done_cond_.notify_all();
+        }
+      }
+
+      void WorkerFunc(size_t index) {
+        TaskType task;
+        int idle_rounds = 0;
+        while (!stop_.load()) {
+          if (queued_.load() > 0 && (PopHeap(task) || PopOwn(index, task) || Steal(index, task))) {
+            idle_rounds = 0;
+            queued_.fetch_sub(1);
+            handler_(index, task);
+            Finish(pending_);
+            continue;
+          }
+
+          // nothing more urgent anywhere
+          if (queued_.load() > 0 && PopBackground(task)) {
+            idle_rounds = 0;
+            queued_.fetch_sub(1);
+            handler_(index, task);
+            Finish(background_pending_);
+            continue;
+          }
+
+          if (++idle_rounds < SPIN_ROUNDS) {
+            std::this_thread::yield();
+            continue;
+          }
+
+          std::unique_lock lock(sleep_mutex_);
+          sleeping_.fetch_add(1);
+          sleep_cond_.wait(lock, [&] { return queued_.load() > 0 || stop_.load(); });
+          sleeping_.fetch_sub(1);
+          idle_rounds = 0;
+        }
+      }
+
+      HandlerType handler_;
+
+      std::vector<std::unique_ptr<worker_queue>> queues_;
+      std::vector<std::thread> threads_;
+
+      // tasks sitting in a deque or the heap. bumped before the push, so it never undercounts
+      std::atomic<size_t> queued_;
+
+      // prioritized tasks, in a heap shared by every worker
+      std::mutex heap_lock_;
+      std::vector<heap_entry> heap_;
+      std::atomic<size_t> prioritized_;
+
+      // run only when everything else is empty
+      std::mutex background_lock_;
+      std::deque<TaskType> background_;
+      std::atomic<size_t> backgrounded_;
+
+      // tasks submitted but not finished - the Wait() latch. background tasks are counted separately
+      std::atomic<size_t> pending_;
+      std::atomic<size_t> background_pending_;
+
+      std::atomic<size_t> sleeping_;
+      std::atomic<size_t> next_queue_;
+      uint64_t next_seq_;
+
+      std::mutex sleep_mutex_;
+      std::condition_variable sleep_cond_;
+      std::atomic<bool> stop_;
+
+      std::mutex done_mutex_;
+      std::condition_variable done_cond_;
+    };
+  }
+}
+
+#endif // WORK_STEALING_EXECUTOR_H_
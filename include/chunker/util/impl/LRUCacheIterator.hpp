@@ -1,7 +1,12 @@
 #ifndef LRU_CACHE_ITERATOR_H_
 #define LRU_CACHE_ITERATOR_H_
 
-#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "chunker/util/impl/LRUCacheSlot.hpp"
 
 namespace chunker {
   namespace util {
@@ -16,72 +21,58 @@ namespace chunker {
         using reference = ValueType&;
         using pointer = ValueType*;
 
-        // create hash list iterator
-        LRUCacheIterator(HashListIterator<KeyType> itr, std::unordered_map<KeyType, ValueType>* cache) : LRUCacheIterator(itr, cache, SIZE_MAX) {}
-
-        LRUCacheIterator(HashListIterator<KeyType> itr, std::unordered_map<KeyType, ValueType>* cache, size_t length) : key_itr(itr), value_cache(cache), max_(length), ind(0) {}
+        typedef std::vector<LRUCacheSlot<KeyType, ValueType>> SlabType;
 
-        LRUCacheIterator(const LRUCacheIterator<KeyType, ValueType>& other) : key_itr(other.key_itr), value_cache(other.value_cache), max_(other.max_), ind(other.ind) {}
-        LRUCacheIterator(LRUCacheIterator<KeyType, ValueType>&& other) : key_itr(other.key_itr), value_cache(other.value_cache), max_(other.max_), ind(other.ind) {}
+        // walks the LRU list starting at slot
+        LRUCacheIterator(uint32_t slot, SlabType* slab) : LRUCacheIterator(slot, slab, SIZE_MAX) {}
 
-        LRUCacheIterator<KeyType, ValueType>& operator=(const LRUCacheIterator<KeyType, ValueType>& other) {
-          key_itr = other.key_itr;
-          value_cache = other.value_cache;
-          max_ = other.max_;
-          ind = other.ind;
-
-          return *this;
-        }
-
-        LRUCacheIterator<KeyType, ValueType>& operator=(LRUCacheIterator<KeyType, ValueType>&& other) {
-          key_itr = other.key_itr;
-          value_cache = other.value_cache;
-          max_ = other.max_;
-          ind = other.ind;
-        }
+        LRUCacheIterator(uint32_t slot, SlabType* slab, size_t length) : slot_(slot), slab_(slab), max_(length), ind(0) {}
 
-        LRUCacheIterator() : key_itr(), value_cache(nullptr), max_(0), ind(SIZE_MAX) {}
+        LRUCacheIterator() : slot_(LRU_NIL), slab_(nullptr), max_(0), ind(SIZE_MAX) {}
 
         LRUCacheIterator<KeyType, ValueType>& operator++() {
-          key_itr++;
-          ind++; 
+          slot_ = (*slab_)[slot_].next;
+          ind++;
           return *this;
         }
 
         LRUCacheIterator<KeyType, ValueType> operator++(int) {
           auto stop = LRUCacheIterator<KeyType, ValueType>(*this);
-          key_itr++;
-          ind++;
+          ++(*this);
           return stop;
         }
 
         LRUCacheIterator<KeyType, ValueType>& operator--() {
-          key_itr--;
+          slot_ = (*slab_)[slot_].prev;
           ind--;
           return *this;
         }
 
         LRUCacheIterator<KeyType, ValueType> operator--(int) {
           auto stop = LRUCacheIterator<KeyType, ValueType>(*this);
-          key_itr--;
-          ind--;
+          --(*this);
           return stop;
         }
 
         reference operator*() {
-          return value_cache->at(*key_itr);
+          return (*slab_)[slot_].value;
         }
 
         pointer operator->() {
-          return &value_cache->at(*key_itr);
+          return &(*slab_)[slot_].value;
+        }
+
+        // key of the current entry
+        const KeyType& Key() const {
+          return (*slab_)[slot_].key;
         }
 
         bool operator==(const LRUCacheIterator<KeyType, ValueType>& other) const {
-          if (ind >= max_ && other.ind >= other.max_) {
+          if (Done() && other.Done()) {
             return true;
           }
 
-          return (key_itr == other.key_itr);
+          return (slot_ == other.slot_);
         }
 
         bool operator!=(const LRUCacheIterator<KeyType, ValueType >& other) const {
@@ -89,8 +80,12 @@ namespace chunker {
         }
 
       private:
-        HashListIterator<KeyType> key_itr;
-        std::unordered_map<KeyType, ValueType>* value_cache;
+        bool Done() const {
+          return (slot_ == LRU_NIL || ind >= max_);
+        }
+
+        uint32_t slot_;
+        SlabType* slab_;
         size_t max_;
         size_t ind;
       };
@@ -98,4 +93,4 @@ namespace chunker {
   }
 }
 
-#endif // LRU_CACHE_ITERATOR_H_
\ No newline at end of file
+#endif // LRU_CACHE_ITERATOR_H_
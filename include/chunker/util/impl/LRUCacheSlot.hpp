@@ -0,0 +1,33 @@
+#ifndef LRU_CACHE_SLOT_H_
+#define LRU_CACHE_SLOT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace chunker {
+  namespace util {
+    namespace impl {
+      // marks a missing link / empty index cell
+      static const uint32_t LRU_NIL = UINT32_MAX;
+
+      // one cache entry - key, value and intrusive LRU links, stored contiguously in a slab
+      template <typename KeyType, typename ValueType>
+      struct LRUCacheSlot {
+        KeyType key;
+        ValueType value;
+
+        // slab indices of the next more / less recently used slots
+        uint32_t prev;
+        uint32_t next;
+
+        // mixed hash of key - lets the index move entries without rehashing
+        uint32_t hash;
+
+        // charged against the cache's budget when this slot was put
+        size_t cost;
+      };
+    }
+  }
+}
+
+#endif // LRU_CACHE_SLOT_H_
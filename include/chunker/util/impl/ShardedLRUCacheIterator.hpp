@@ -0,0 +1,98 @@
+#ifndef SHARDED_LRU_CACHE_ITERATOR_H_
+#define SHARDED_LRU_CACHE_ITERATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+
+namespace chunker {
+  namespace util {
+    namespace impl {
+      /**
+       * @brief walks each shard of a sharded cache in turn, most recent first within a shard
+       *
+       * @tparam ShardType - cache type of a single shard
+       */
+      template <typename ShardType>
+      class ShardedLRUCacheIterator {
+      public:
+        typedef typename ShardType::iterator shard_iterator;
+
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type = std::ptrdiff_t;
+
+        using value_type = typename shard_iterator::value_type;
+        using reference = typename shard_iterator::reference;
+        using pointer = typename shard_iterator::pointer;
+
+        ShardedLRUCacheIterator(const std::unique_ptr<ShardType>* shards, size_t shard_count, size_t length)
+          : shards_(shards), shard_count_(shard_count), shard_(0), itr_(shards[0]->begin()), max_(length), ind_(0) {
+          SkipEmpty();
+        }
+
+        ShardedLRUCacheIterator() : shards_(nullptr), shard_count_(0), shard_(0), itr_(), max_(0), ind_(SIZE_MAX) {}
+
+        ShardedLRUCacheIterator<ShardType>& operator++() {
+          ++itr_;
+          ++ind_;
+          SkipEmpty();
+          return *this;
+        }
+
+        ShardedLRUCacheIterator<ShardType> operator++(int) {
+          auto stop = ShardedLRUCacheIterator<ShardType>(*this);
+          ++(*this);
+          return stop;
+        }
+
+        reference operator*() {
+          return *itr_;
+        }
+
+        pointer operator->() {
+          return itr_.operator->();
+        }
+
+        decltype(auto) Key() const {
+          return itr_.Key();
+        }
+
+        bool operator==(const ShardedLRUCacheIterator<ShardType>& other) const {
+          if (Done() && other.Done()) {
+            return true;
+          }
+
+          return (shards_ == other.shards_ && shard_ == other.shard_ && itr_ == other.itr_);
+        }
+
+        bool operator!=(const ShardedLRUCacheIterator<ShardType>& other) const {
+          return !(*this == other);
+        }
+
+      private:
+        bool Done() const {
+          return (shard_ >= shard_count_ || ind_ >= max_);
+        }
+
+        // steps over exhausted shards
+        void SkipEmpty() {
+          while (shard_ < shard_count_ && itr_ == shards_[shard_]->end()) {
+            if (++shard_ < shard_count_) {
+              itr_ = shards_[shard_]->begin();
+            }
+          }
+        }
+
+        const std::unique_ptr<ShardType>* shards_;
+        size_t shard_count_;
+        size_t shard_;
+        shard_iterator itr_;
+        size_t max_;
+        size_t ind_;
+      };
+    }
+  }
+}
+
+#endif // SHARDED_LRU_CACHE_ITERATOR_H_
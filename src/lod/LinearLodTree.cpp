@@ -0,0 +1,143 @@
+#include "chunker/lod/LinearLodTree.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace chunker {
+  namespace lod {
+    LinearLodTree::LinearLodTree(const lod_node* tree, size_t tree_res) : LinearLodTree() {
+      Build(tree, tree_res);
+    }
+
+    void LinearLodTree::Build(const lod_node* tree, size_t tree_res) {
+      tree_res_ = tree_res;
+      cell_scale_ = static_cast<double>(GRID_RES) / tree_res;
+      leaves_.clear();
+      if (tree != nullptr) {
+        Build_recurse(tree, 0, 0, 0);
+      }
+
+      BuildIndex();
+    }
+
+    void LinearLodTree::BuildIndex() {
+      const size_t coarse_cells = static_cast<size_t>(1) << (2 * INDEX_DEPTH);
+      coarse_index_.resize(coarse_cells + 1);
+      if (leaves_.empty()) {
+        std::fill(coarse_index_.begin(), coarse_index_.end(), 0);
+        return;
+      }
+
+      // leaves and coarse cells are both in morton order - walk them together
+      uint32_t leaf = 0;
+      for (size_t cell = 0; cell < coarse_cells; cell++) {
+        uint64_t cell_code = static_cast<uint64_t>(cell) << INDEX_SHIFT;
+        while (leaf + 1 < leaves_.size() && LeafCode(leaves_[leaf + 1]) <= cell_code) {
+          leaf++;
+        }
+
+        coarse_index_[cell] = leaf;
+      }
+
+      coarse_index_[coarse_cells] = static_cast<uint32_t>(leaves_.size() - 1);
+    }
+
+    void LinearLodTree::Diff(const LinearLodTree& old_tree, const LinearLodTree& new_tree, LodTreeDiff* diff) {
+      assert(old_tree.tree_res_ == new_tree.tree_res_);
+      diff->Clear();
+
+      // both leaf arrays are sorted - merge them
+      const std::vector<uint64_t>& old_leaves = old_tree.leaves_;
+      const std::vector<uint64_t>& new_leaves = new_tree.leaves_;
+      size_t i = 0;
+      size_t j = 0;
+      while (i < old_leaves.size() && j < new_leaves.size()) {
+        if (old_leaves[i] == new_leaves[j]) {
+          i++;
+          j++;
+        } else if (old_leaves[i] < new_leaves[j]) {
+          diff->removed.push_back(old_leaves[i++]);
+        } else {
+          diff->added.push_back(new_leaves[j++]);
+        }
+      }
+
+      diff->removed.insert(diff->removed.end(), old_leaves.begin() + i, old_leaves.end());
+      diff->added.insert(diff->added.end(), new_leaves.begin() + j, new_leaves.end());
+
+      // added and removed leaves cover the same area, so any leaf whose neighbors changed borders an added leaf
+      for (uint64_t leaf : diff->added) {
+        new_tree.CollectBorder(leaf, old_tree, &diff->touched);
+      }
+
+      std::sort(diff->touched.begin(), diff->touched.end());
+      diff->touched.erase(std::unique(diff->touched.begin(), diff->touched.end()), diff->touched.end());
+    }
+
+    void LinearLodTree::CollectBorder(uint64_t leaf, const LinearLodTree& other, std::vector<uint64_t>* output) const {
+      glm::ivec2 origin = LeafOrigin(leaf);
+      float size = static_cast<float>(LeafSize(leaf));
+      float tree_res = static_cast<float>(tree_res_);
+
+      float near_x = origin.x - 0.5f;
+      float near_y = origin.y - 0.5f;
+      float far_x = origin.x + size + 0.5f;
+      float far_y = origin.y + size + 0.5f;
+
+      bool has_left = (near_x > 0.0f);
+      bool has_right = (far_x < tree_res);
+      bool has_down = (near_y > 0.0f);
+      bool has_up = (far_y < tree_res);
+
+      auto visit = [&](const glm::vec2& sample) -> size_t {
+        size_t index = FindLeaf(sample);
+        uint64_t neighbor = leaves_[index];
+        if (other.ContainsLeaf(neighbor)) {
+          output->push_back(neighbor);
+        }
+
+        return index;
+      };
+
+      // walk each edge, hopping from neighbor to neighbor
+      auto walk = [&](bool vertical, float fixed, float start, float end) {
+        float pos = start + 0.5f;
+        while (pos < end) {
+          size_t index = visit(vertical ? glm::vec2(fixed, pos) : glm::vec2(pos, fixed));
+          glm::ivec2 neighbor_origin = LeafOrigin(leaves_[index]);
+          float neighbor_end = static_cast<float>((vertical ? neighbor_origin.y : neighbor_origin.x) + LeafSize(leaves_[index]));
+          pos = neighbor_end + 0.5f;
+        }
+      };
+
+      float start_x = static_cast<float>(origin.x);
+      float start_y = static_cast<float>(origin.y);
+      if (has_down)  { walk(false, near_y, start_x, start_x + size); }
+      if (has_up)    { walk(false, far_y,  start_x, start_x + size); }
+      if (has_left)  { walk(true,  near_x, start_y, start_y + size); }
+      if (has_right) { walk(true,  far_x,  start_y, start_y + size); }
+
+      // corners
+      if (has_down && has_left)  { visit(glm::vec2(near_x, near_y)); }
+      if (has_down && has_right) { visit(glm::vec2(far_x, near_y)); }
+      if (has_up && has_left)    { visit(glm::vec2(near_x, far_y)); }
+      if (has_up && has_right)   { visit(glm::vec2(far_x, far_y)); }
+    }
+
+    void LinearLodTree::Build_recurse(const lod_node* node, uint32_t cell_x, uint32_t cell_y, int depth) {
+      if (node->tl == nullptr) {
+        leaves_.push_back((static_cast<uint64_t>(util::MortonEncode2(cell_x, cell_y)) << DEPTH_BITS) | static_cast<uint64_t>(depth));
+        return;
+      }
+
+      assert(depth < MAX_DEPTH);
+      uint32_t half = 1u << (MAX_DEPTH - depth - 1);
+
+      // bl, br, tl, tr is morton order - leaves come out sorted
+      Build_recurse(node->bl, cell_x,        cell_y,        depth + 1);
+      Build_recurse(node->br, cell_x + half, cell_y,        depth + 1);
+      Build_recurse(node->tl, cell_x,        cell_y + half, depth + 1);
+      Build_recurse(node->tr, cell_x + half, cell_y + half, depth + 1);
+    }
+  }
+}
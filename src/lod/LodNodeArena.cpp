@@ -0,0 +1,22 @@
+#include "chunker/lod/LodNodeArena.hpp"
+
+namespace chunker {
+  namespace lod {
+    LodNodeArena::LodNodeArena() : blocks_(), block_index_(0), next_(nullptr), end_(nullptr), size_(0) {}
+
+    void LodNodeArena::NextBlock() {
+      if (block_index_ >= blocks_.size()) {
+        blocks_.push_back(new lod_node[BLOCK_SIZE]);
+      }
+
+      next_ = blocks_[block_index_++];
+      end_ = next_ + BLOCK_SIZE;
+    }
+
+    LodNodeArena::~LodNodeArena() {
+      for (lod_node* block : blocks_) {
+        delete[] block;
+      }
+    }
+  }
+}
@@ -0,0 +1,82 @@
+#include "chunker/lod/LodOctreeGenerator.hpp"
+
+#include <cassert>
+
+namespace chunker {
+  namespace lod {
+    void LodOctreeGenerator::CreateLodTree(const glm::vec3& local_position, int force_divide, LinearLodOctree* output) const {
+      assert(((size_) & (size_ - 1)) == 0);
+      assert(((chunk_res_) & (chunk_res_ - 1)) == 0);
+      output->Reset(static_cast<size_t>(size_));
+
+      // same cascade scaling as LodTreeGenerator
+      double cascade_real = cascade_factor / CASCADE_MUL_FACTOR;
+      size_t cascade_mul = size_;
+      while (cascade_mul > static_cast<size_t>(chunk_res_)) {
+        cascade_real *= CASCADE_MUL_FACTOR;
+        cascade_mul >>= 1;
+      }
+
+      CreateLodTree_recurse(0, 0, 0, size_, 0, cascade_real, local_position, force_divide, output);
+    }
+
+    bool LodOctreeGenerator::ShouldSplit(
+      int x,
+      int y,
+      int z,
+      int node_size,
+      double cascade_threshold,
+      const glm::vec3& local_position,
+      int force_divide) const
+    {
+      // no longer descend
+      if (node_size <= chunk_res_) {
+        return false;
+      }
+
+      if (force_divide > 0) {
+        return true;
+      }
+
+      glm::vec3 node_min(static_cast<float>(x), static_cast<float>(y), static_cast<float>(z));
+      glm::vec3 closest_point = glm::clamp(local_position, node_min, node_min + static_cast<float>(node_size));
+      return (glm::length(closest_point - local_position) <= cascade_threshold);
+    }
+
+    void LodOctreeGenerator::CreateLodTree_recurse(
+      int x,
+      int y,
+      int z,
+      int node_size,
+      int depth,
+      double cascade_threshold,
+      const glm::vec3& local_position,
+      int force_divide,
+      LinearLodOctree* output) const
+    {
+      if (!ShouldSplit(x, y, z, node_size, cascade_threshold, local_position, force_divide)) {
+        output->leaves_.push_back(output->MakeLeaf(glm::ivec3(x, y, z), depth));
+        return;
+      }
+
+      assert(depth < LinearLodOctree::MAX_DEPTH);
+      double new_cascade_threshold = cascade_threshold / CASCADE_MUL_FACTOR;
+      int half = node_size / 2;
+
+      // x in the low bit, then y, then z - morton order
+      for (int child = 0; child < 8; child++) {
+        CreateLodTree_recurse(
+          x + (child & 1) * half,
+          y + ((child >> 1) & 1) * half,
+          z + ((child >> 2) & 1) * half,
+          half,
+          depth + 1,
+          new_cascade_threshold,
+          local_position,
+          force_divide - 1,
+          output
+        );
+      }
+    }
+  }
+}
@@ -1,5 +1,7 @@
 #include "chunker/lod/LodTreeGenerator.hpp"
 
+#include <tbb/parallel_for.h>
+
 namespace chunker {
   namespace lod {
     lod_node* LodTreeGenerator::CreateLodTree(const glm::vec3& local_position) {
@@ -9,14 +11,40 @@ namespace chunker {
     lod_node* LodTreeGenerator::CreateLodTree(const glm::vec3& local_position, int force_divide) {
       return CreateLodTree(local_position, force_divide, size_, chunk_res_, cascade_factor, 0);
     }
-    
+
+    lod_node* LodTreeGenerator::CreateLodTree(const glm::vec3& local_position, int force_divide, const lod_node* previous) {
+      return CreateLodTree(local_position, force_divide, size_, chunk_res_, cascade_factor, 0, previous);
+    }
+
+    lod_node* LodTreeGenerator::CreateLodTree(const glm::vec3& local_position, int force_divide, int size, int chunk_size, double cascade_factor, int lod_bias, const lod_node* previous) {
+      return CreateLodTree_impl(&local_position, 1, force_divide, size, chunk_size, cascade_factor, lod_bias, previous);
+    }
+
+    lod_node* LodTreeGenerator::CreateLodTree(const std::vector<glm::vec3>& local_positions, int force_divide, const lod_node* previous) {
+      assert(!local_positions.empty());
+      return CreateLodTree_impl(local_positions.data(), local_positions.size(), force_divide, size_, chunk_res_, cascade_factor, 0, previous);
+    }
+
     // add lod
-    lod_node* LodTreeGenerator::CreateLodTree(const glm::vec3& local_position, int force_divide, int size, int chunk_size, double cascade_factor, int lod_bias) {
+    lod_node* LodTreeGenerator::CreateLodTree_impl(
+      const glm::vec3* local_positions,
+      size_t position_count,
+      int force_divide,
+      int size,
+      int chunk_size,
+      double cascade_factor,
+      int lod_bias,
+      const lod_node* previous)
+    {
       assert(((size) & (size - 1)) == 0);
       assert(((chunk_size) & (chunk_size - 1)) == 0);
       assert(chunk_size > 1);
       assert(size > 1);
-      auto* node = lod_node::lod_node_alloc();
+      // reuse the arena which isn't holding onto the retained tree
+      LodNodeArena& arena = arenas_[retained_ ^ 1];
+      arena.Reset();
+
+      auto* node = arena.Alloc();
       double cascade_real = cascade_factor / CASCADE_MUL_FACTOR;
 
       // handle lod bias
@@ -42,66 +70,215 @@ namespace chunker {
         cascade_mul >>= 1;
       }
 
-      CreateLodTree_recurse(
+      // the last tree is a good guess at how big this one is - small trees aren't worth forking for
+      if (parallel_levels <= 0 || last_node_count_ < parallel_min_nodes) {
+        CreateLodTree_recurse(
+          0,
+          0,
+          size,
+          eff_chunk_size,
+          cascade_real,
+          local_positions,
+          position_count,
+          node,
+          previous,
+          force_divide,
+          arena
+        );
+
+        last_node_count_ = arena.Size();
+        return node;
+      }
+
+      // build the top of the tree on this thread, then fan the subtrees below it out to tasks
+      jobs_.clear();
+      CreateLodTree_split(
         0,
         0,
         size,
         eff_chunk_size,
         cascade_real,
-        local_position,
+        local_positions,
+        position_count,
         node,
-        force_divide
+        previous,
+        force_divide,
+        parallel_levels,
+        arena
       );
 
+      // each task gets its own arena - double buffered alongside the main one
+      auto& task_arenas = task_arenas_[retained_ ^ 1];
+      while (task_arenas.size() < jobs_.size()) {
+        task_arenas.push_back(std::make_unique<LodNodeArena>());
+      }
+
+      tbb::parallel_for(static_cast<size_t>(0), jobs_.size(), [&](size_t i) {
+        const subtree_job& job = jobs_[i];
+        LodNodeArena& task_arena = *task_arenas[i];
+        task_arena.Reset();
+        CreateLodTree_recurse(
+          job.x,
+          job.y,
+          job.node_size,
+          eff_chunk_size,
+          job.cascade_threshold,
+          local_positions,
+          position_count,
+          job.root,
+          job.previous,
+          job.force_divide,
+          task_arena
+        );
+      });
+
+      last_node_count_ = arena.Size();
+      for (size_t i = 0; i < jobs_.size(); i++) {
+        last_node_count_ += task_arenas[i]->Size();
+      }
+
       return node;
     }
 
-     void LodTreeGenerator::CreateLodTree_recurse(
-      int x, 
+    void LodTreeGenerator::RetainTree() {
+      retained_ ^= 1;
+    }
+
+    bool LodTreeGenerator::ShouldSplit(
+      int x,
       int y,
       int node_size,
       int chunk_size,
       double cascade_threshold,
-      const glm::vec3& local_position,
-      lod_node* root,
-      int force_divide) 
+      const glm::vec3* local_positions,
+      size_t position_count,
+      const lod_node* previous,
+      int force_divide) const
     {
       // no longer descend
       if (node_size <= chunk_size) {
-        return;
+        return false;
       }
 
 
-      float dist_to_chunk;
+      // use force_divide to require node to split
+      if (force_divide > 0) {
+        return true;
+      }
+
+      // nodes split last time hold on until we're past the hysteresis band
+      double threshold = cascade_threshold;
+      if (previous != nullptr && previous->tl != nullptr) {
+        threshold *= (1.0 + hysteresis);
+      }
+
       float x_f = static_cast<float>(x);
       float y_f = static_cast<float>(y);
 
-      // side note: we need to map z to height :(
-      if (local_position.x < x || local_position.x > x + node_size || local_position.z < y || local_position.z > y + node_size) {
-        glm::vec3 closest_point(glm::clamp(local_position.x, x_f, x_f + node_size), local_position.y, glm::clamp(local_position.z, y_f, y_f + node_size));
-        dist_to_chunk = glm::length(closest_point - local_position);
-      } else {
-        // ignore z
-        dist_to_chunk = 0.0;
+      // any one viewer close enough splits the node
+      for (size_t i = 0; i < position_count; i++) {
+        const glm::vec3& local_position = local_positions[i];
+        float dist_to_chunk;
+
+        // side note: we need to map z to height :(
+        if (local_position.x < x || local_position.x > x + node_size || local_position.z < y || local_position.z > y + node_size) {
+          glm::vec3 closest_point(glm::clamp(local_position.x, x_f, x_f + node_size), local_position.y, glm::clamp(local_position.z, y_f, y_f + node_size));
+          dist_to_chunk = glm::length(closest_point - local_position);
+        } else {
+          // ignore z
+          dist_to_chunk = 0.0;
+        }
+
+        if (dist_to_chunk <= threshold) {
+          return true;
+        }
       }
 
-      // use force_divide to require node to split
-      if (dist_to_chunk > cascade_threshold && force_divide <= 0) {
+      return false;
+    }
+
+    void LodTreeGenerator::CreateLodTree_recurse(
+      int x, 
+      int y,
+      int node_size,
+      int chunk_size,
+      double cascade_threshold,
+      const glm::vec3* local_positions,
+      size_t position_count,
+      lod_node* root,
+      const lod_node* previous,
+      int force_divide,
+      LodNodeArena& arena) 
+    {
+      if (!ShouldSplit(x, y, node_size, chunk_size, cascade_threshold, local_positions, position_count, previous, force_divide)) {
+        return;
+      }
+
+      root->bl = arena.Alloc();
+      root->br = arena.Alloc();
+      root->tl = arena.Alloc();
+      root->tr = arena.Alloc();
+
+      double new_cascade_threshold = cascade_threshold / CASCADE_MUL_FACTOR;
+      int new_node_size = node_size / 2;
+
+      // walk the previous tree alongside - nothing below a leaf of it was split
+      bool had_children = (previous != nullptr && previous->tl != nullptr);
+      const lod_node* prev_bl = (had_children ? previous->bl : nullptr);
+      const lod_node* prev_br = (had_children ? previous->br : nullptr);
+      const lod_node* prev_tl = (had_children ? previous->tl : nullptr);
+      const lod_node* prev_tr = (had_children ? previous->tr : nullptr);
+
+      CreateLodTree_recurse(x,                 y,                 new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->bl, prev_bl, force_divide - 1, arena);
+      CreateLodTree_recurse(x + new_node_size, y,                 new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->br, prev_br, force_divide - 1, arena);
+      CreateLodTree_recurse(x,                 y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->tl, prev_tl, force_divide - 1, arena);
+      CreateLodTree_recurse(x + new_node_size, y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->tr, prev_tr, force_divide - 1, arena);
+    }
+
+    void LodTreeGenerator::CreateLodTree_split(
+      int x,
+      int y,
+      int node_size,
+      int chunk_size,
+      double cascade_threshold,
+      const glm::vec3* local_positions,
+      size_t position_count,
+      lod_node* root,
+      const lod_node* previous,
+      int force_divide,
+      int levels,
+      LodNodeArena& arena)
+    {
+      if (levels <= 0) {
+        // hand the rest of this subtree off to a task
+        subtree_job job = { x, y, node_size, cascade_threshold, root, previous, force_divide };
+        jobs_.push_back(job);
         return;
       }
 
-      root->bl = lod_node::lod_node_alloc();
-      root->br = lod_node::lod_node_alloc();
-      root->tl = lod_node::lod_node_alloc();
-      root->tr = lod_node::lod_node_alloc();
+      if (!ShouldSplit(x, y, node_size, chunk_size, cascade_threshold, local_positions, position_count, previous, force_divide)) {
+        return;
+      }
+
+      root->bl = arena.Alloc();
+      root->br = arena.Alloc();
+      root->tl = arena.Alloc();
+      root->tr = arena.Alloc();
 
       double new_cascade_threshold = cascade_threshold / CASCADE_MUL_FACTOR;
       int new_node_size = node_size / 2;
 
-      CreateLodTree_recurse(x,                 y,                 new_node_size, chunk_size, new_cascade_threshold, local_position, root->bl, force_divide - 1);
-      CreateLodTree_recurse(x + new_node_size, y,                 new_node_size, chunk_size, new_cascade_threshold, local_position, root->br, force_divide - 1);
-      CreateLodTree_recurse(x,                 y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_position, root->tl, force_divide - 1);
-      CreateLodTree_recurse(x + new_node_size, y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_position, root->tr, force_divide - 1);
+      // walk the previous tree alongside - nothing below a leaf of it was split
+      bool had_children = (previous != nullptr && previous->tl != nullptr);
+      const lod_node* prev_bl = (had_children ? previous->bl : nullptr);
+      const lod_node* prev_br = (had_children ? previous->br : nullptr);
+      const lod_node* prev_tl = (had_children ? previous->tl : nullptr);
+      const lod_node* prev_tr = (had_children ? previous->tr : nullptr);
+
+      CreateLodTree_split(x,                 y,                 new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->bl, prev_bl, force_divide - 1, levels - 1, arena);
+      CreateLodTree_split(x + new_node_size, y,                 new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->br, prev_br, force_divide - 1, levels - 1, arena);
+      CreateLodTree_split(x,                 y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->tl, prev_tl, force_divide - 1, levels - 1, arena);
+      CreateLodTree_split(x + new_node_size, y + new_node_size, new_node_size, chunk_size, new_cascade_threshold, local_positions, position_count, root->tr, prev_tr, force_divide - 1, levels - 1, arena);
     }
   }
-}
\ No newline at end of file
+}
@@ -40,14 +40,14 @@ namespace chunker {
       return GetChunkSize(*node_ptr, tree_res / 2, sub_sample_point);
     }
 
-    Fraction lod_node::GetChunkStep(const lod_node* node, const util::Fraction& step_size, size_t tree_res, const glm::vec2& sample_point) {
+    util::DyadicScale lod_node::GetChunkStep(const lod_node* node, const util::DyadicScale& step_size, size_t tree_res, const glm::vec2& sample_point) {
       glm::vec2 sub_sample_point = sample_point;
 
       if (node == nullptr) {
         return step_size * 2;
       }
 
-      util::Fraction half_step = step_size / 2;
+      util::DyadicScale half_step = step_size / 2;
       size_t half_res = tree_res / 2;
       const lod_node** node_ptr = reinterpret_cast<const lod_node**>(const_cast<lod_node*>(node));
       if (sample_point.y > half_res) {
@@ -0,0 +1,161 @@
+#include "test.hpp"
+
+#include "chunker/AsyncChunkManager.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  // chunks on this row block until the gate opens
+  const long BLOCK_Y = -(1L << 20);
+
+  struct strip_chunk {
+    long x;
+  };
+
+  // count chunks in a row, 16 apart
+  struct strip_job {
+    long x;
+    long count;
+    bool blocked;
+  };
+
+  struct strip_chunker {
+    std::vector<ChunkIdentifier> Chunk(strip_job& job) {
+      std::vector<ChunkIdentifier> res;
+      for (long i = 0; i < job.count; i++) {
+        res.push_back(ChunkIdentifier(job.x + i * 16, (job.blocked ? BLOCK_Y : 0), 16, 16, ChunkNeighbors()));
+      }
+
+      return res;
+    }
+
+    // chunk positions, in the order Chunk handed them out
+    std::vector<long> Stitch(strip_job&, const std::vector<std::shared_ptr<strip_chunk>>& chunks) {
+      std::vector<long> res;
+      for (auto& chunk : chunks) {
+        res.push_back(chunk->x);
+      }
+
+      return res;
+    }
+  };
+
+  struct gate_state {
+    std::atomic<bool> open { true };
+    std::atomic<int> blocked { 0 };
+  };
+
+  struct strip_gen {
+    std::shared_ptr<gate_state> gate;
+
+    std::shared_ptr<strip_chunk> Generate(const ChunkIdentifier& identifier) {
+      if (identifier.y == BLOCK_Y) {
+        gate->blocked++;
+        while (!gate->open.load()) {
+          std::this_thread::yield();
+        }
+      }
+
+      return std::make_shared<strip_chunk>(strip_chunk { identifier.x });
+    }
+  };
+
+  struct strip_factory {
+    typedef strip_gen gen_type;
+    typedef strip_chunker chunker_type;
+    typedef strip_chunk chunk_type;
+    typedef strip_job job_type;
+
+    std::shared_ptr<gate_state> gate = std::make_shared<gate_state>();
+
+    std::shared_ptr<strip_gen> Create() {
+      return std::make_shared<strip_gen>(strip_gen { gate });
+    }
+  };
+
+  typedef AsyncChunkManager<strip_factory> Manager;
+
+  std::vector<long> Expected(const strip_job& job) {
+    std::vector<long> res;
+    for (long i = 0; i < job.count; i++) {
+      res.push_back(job.x + i * 16);
+    }
+
+    return res;
+  }
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+}
+
+// futures become ready on their own - the dispatcher runs w/o anyone calling wait(). overlapping jobs each get every chunk
+CHUNKER_TEST(async_chunk_manager_delivers_without_wait) {
+  Manager manager(strip_chunker(), std::make_shared<strip_factory>(), 2);
+
+  std::vector<strip_job> jobs;
+  std::vector<std::future<std::vector<long>>> results;
+  for (long i = 0; i < 24; i++) {
+    jobs.push_back(strip_job { i * 48, 1 + i % 7, false });
+    results.push_back(manager.Enqueue(jobs.back()));
+  }
+
+  bool all_ready = true;
+  bool all_match = true;
+  for (size_t i = 0; i < results.size(); i++) {
+    bool ready = (results[i].wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+    all_ready = all_ready && ready;
+    all_match = all_match && ready && results[i].get() == Expected(jobs[i]);
+  }
+
+  CHUNKER_CHECK(all_ready);
+  CHUNKER_CHECK(all_match);
+
+  // and later, once the dispatcher's been idle
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  std::future<std::vector<long>> late = manager.Enqueue(strip_job { 16, 3, false });
+  CHUNKER_CHECK(late.wait_for(std::chrono::seconds(2)) == std::future_status::ready);
+  CHUNKER_CHECK(late.get() == Expected(strip_job { 16, 3, false }));
+}
+
+// a job stuck on a slow chunk doesn't hold up the jobs queued behind it
+CHUNKER_TEST(async_chunk_manager_runs_jobs_concurrently) {
+  auto factory = std::make_shared<strip_factory>();
+  Manager manager(strip_chunker(), factory, 2);
+
+  factory->gate->open = false;
+  std::future<std::vector<long>> stuck = manager.Enqueue(strip_job { 0, 1, true });
+  CHUNKER_CHECK(WaitFor([&] { return factory->gate->blocked.load() == 1; }));
+
+  std::future<std::vector<long>> behind = manager.Enqueue(strip_job { 64, 4, false });
+  bool overtook = (behind.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(overtook);
+  CHUNKER_CHECK(stuck.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout);
+
+  factory->gate->open = true;
+  CHUNKER_CHECK(stuck.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(stuck.get() == std::vector<long> { 0 });
+  if (overtook) {
+    CHUNKER_CHECK(behind.get() == Expected(strip_job { 64, 4, false }));
+  }
+
+  manager.wait();
+}
@@ -0,0 +1,194 @@
+#include "test.hpp"
+
+#include "chunker/AsyncChunkManager.hpp"
+#include "chunker/ChunkKey.hpp"
+#include "chunker/VolumeChunkKey.hpp"
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  ChunkIdentifier MakeIdentifier(long x, long y, size_t size, size_t chunk_res, int exponent) {
+    ChunkNeighbors neighbors;
+    util::DyadicScale* scales[] = { &neighbors.l, &neighbors.r, &neighbors.u, &neighbors.d, &neighbors.tl, &neighbors.tr, &neighbors.bl, &neighbors.br };
+    for (int i = 0; i < 8; i++) {
+      *scales[i] = (i == 7 ? util::DyadicScale::Zero() : util::DyadicScale::FromExponent(exponent + i - 4));
+    }
+
+    ChunkIdentifier res(x, y, size, chunk_res, neighbors);
+    res.scale = util::DyadicScale::FromExponent(-exponent);
+    return res;
+  }
+
+  VolumeChunkIdentifier MakeVolumeIdentifier(long x, size_t size, size_t chunk_res) {
+    VolumeChunkNeighbors neighbors;
+    for (int i = 0; i < 27; i++) {
+      neighbors.sizes[i] = (i == 13 ? 0 : size << (i % 4));
+    }
+
+    return VolumeChunkIdentifier(x, -x, x * 3, size, chunk_res, neighbors);
+  }
+
+  struct key_chunk {
+    long x;
+  };
+
+  struct key_job {
+    size_t size;
+  };
+
+  struct key_chunker {
+    std::vector<ChunkIdentifier> Chunk(key_job& job) {
+      return { MakeIdentifier(0, 0, 16, 16, 0), MakeIdentifier(16, 0, job.size, 16, 0) };
+    }
+
+    long Stitch(key_job&, const std::vector<std::shared_ptr<key_chunk>>& chunks) {
+      long res = 0;
+      for (auto& chunk : chunks) {
+        res += chunk->x;
+      }
+
+      return res;
+    }
+  };
+
+  struct key_gen {
+    std::shared_ptr<key_chunk> Generate(const ChunkIdentifier& identifier) {
+      return std::make_shared<key_chunk>(key_chunk { identifier.x });
+    }
+  };
+
+  struct key_factory {
+    typedef key_gen gen_type;
+    typedef key_chunker chunker_type;
+    typedef key_chunk chunk_type;
+    typedef key_job job_type;
+
+    std::shared_ptr<key_gen> Create() {
+      return std::make_shared<key_gen>();
+    }
+  };
+}
+
+CHUNKER_TEST(chunk_key_round_trips) {
+  for (int size_log = 0; size_log < 63; size_log += 3) {
+    for (int exponent = -40; exponent <= 40; exponent += 8) {
+      size_t size = static_cast<size_t>(1) << size_log;
+      ChunkIdentifier identifier = MakeIdentifier(-12345678901L, 987654321L, size, 32, exponent);
+      identifier.sample_dims = glm::u64vec2(size, 0);
+
+      ChunkKey key(identifier);
+      CHUNKER_CHECK(key.Identifier() == identifier);
+      CHUNKER_CHECK(key.Size() == size);
+
+      uint8_t packed[ChunkKey::PACKED_SIZE];
+      key.Pack(packed);
+      ChunkKey unpacked = ChunkKey::Unpack(packed);
+      CHUNKER_CHECK(unpacked == key);
+      CHUNKER_CHECK(unpacked.Hash() == key.Hash());
+      CHUNKER_CHECK(unpacked.Identifier() == identifier);
+    }
+  }
+
+  ChunkIdentifier empty;
+  CHUNKER_CHECK(ChunkKey(empty).Identifier() == empty);
+}
+
+CHUNKER_TEST(chunk_key_rejects_non_power_of_two) {
+  ChunkKey output(MakeIdentifier(1, 2, 64, 16, 0));
+  ChunkKey before = output;
+
+  // these used to pack to the key of a different chunk - 33 as 1, 48 as 16
+  CHUNKER_CHECK(!ChunkKey::TryCreate(MakeIdentifier(0, 0, 33, 16, 0), &output));
+  CHUNKER_CHECK(!ChunkKey::TryCreate(MakeIdentifier(0, 0, 16, 48, 0), &output));
+
+  ChunkIdentifier dims = MakeIdentifier(0, 0, 16, 16, 0);
+  dims.sample_dims.y = 17;
+  CHUNKER_CHECK(!ChunkKey::TryCreate(dims, &output));
+
+  // 2^63 would alias zero
+  CHUNKER_CHECK(!ChunkKey::TryCreate(MakeIdentifier(0, 0, static_cast<size_t>(1) << 63, 16, 0), &output));
+  CHUNKER_CHECK(output == before);
+
+  bool threw = false;
+  try {
+    ChunkKey key(MakeIdentifier(0, 0, 48, 16, 0));
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+
+  CHUNKER_CHECK(threw);
+  CHUNKER_CHECK(ChunkKey::TryCreate(MakeIdentifier(0, 0, 32, 16, 0), &output));
+  CHUNKER_CHECK(output.Size() == 32);
+}
+
+CHUNKER_TEST(async_chunk_manager_fails_unpackable_jobs) {
+  AsyncChunkManager<key_factory> manager(key_chunker(), std::make_shared<key_factory>(), 2);
+  std::future<long> bad = manager.Enqueue(key_job { 48 });
+  std::future<long> good = manager.Enqueue(key_job { 16 });
+
+  bool threw = false;
+  try {
+    bad.get();
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+
+  CHUNKER_CHECK(threw);
+  CHUNKER_CHECK(good.get() == 16);
+  manager.wait();
+}
+
+CHUNKER_TEST(volume_chunk_key_round_trips) {
+  for (int size_log = 0; size_log < 60; size_log += 3) {
+    size_t size = static_cast<size_t>(1) << size_log;
+    VolumeChunkIdentifier identifier = MakeVolumeIdentifier(-98765432101L, size, 16);
+    VolumeChunkKey key(identifier);
+    CHUNKER_CHECK(key.Identifier() == identifier);
+    CHUNKER_CHECK(key.Size() == size);
+
+    uint8_t packed[VolumeChunkKey::PACKED_SIZE];
+    key.Pack(packed);
+    VolumeChunkKey unpacked = VolumeChunkKey::Unpack(packed);
+    CHUNKER_CHECK(unpacked == key);
+    CHUNKER_CHECK(unpacked.Hash() == key.Hash());
+  }
+
+  VolumeChunkIdentifier empty;
+  CHUNKER_CHECK(VolumeChunkKey(empty).Identifier() == empty);
+}
+
+CHUNKER_TEST(volume_chunk_key_rejects_non_power_of_two) {
+  VolumeChunkKey output(MakeVolumeIdentifier(1, 64, 16));
+  VolumeChunkKey before = output;
+
+  CHUNKER_CHECK(!VolumeChunkKey::TryCreate(MakeVolumeIdentifier(0, 48, 16), &output));
+  CHUNKER_CHECK(!VolumeChunkKey::TryCreate(MakeVolumeIdentifier(0, 32, 12), &output));
+
+  VolumeChunkIdentifier neighbor = MakeVolumeIdentifier(0, 32, 16);
+  neighbor.neighbors.sizes[VolumeChunkNeighbors::Index(1, 1, 1)] = 96;
+  CHUNKER_CHECK(!VolumeChunkKey::TryCreate(neighbor, &output));
+  CHUNKER_CHECK(output == before);
+
+  bool threw = false;
+  try {
+    VolumeChunkKey key(neighbor);
+  } catch (const std::invalid_argument&) {
+    threw = true;
+  }
+
+  CHUNKER_CHECK(threw);
+  CHUNKER_CHECK(VolumeChunkKey::TryCreate(MakeVolumeIdentifier(0, 32, 16), &output));
+  CHUNKER_CHECK(output.Size() == 32);
+
+  // a corrupt packed key still unpacks to some identifier, rather than shifting past 63
+  uint8_t packed[VolumeChunkKey::PACKED_SIZE];
+  output.Pack(packed);
+  packed[50] = 200;
+  CHUNKER_CHECK(VolumeChunkKey::Unpack(packed).Size() == (static_cast<size_t>(1) << (200 & 63)));
+}
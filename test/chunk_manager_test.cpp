@@ -0,0 +1,208 @@
+#include "test.hpp"
+
+#include "chunker/ChunkManager.hpp"
+#include "chunker/MultiViewerChunkManager.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  struct test_chunk {
+    ChunkIdentifier id;
+
+    size_t ByteSize() const {
+      return sizeof(test_chunk);
+    }
+  };
+
+  struct test_gen {
+    std::shared_ptr<test_chunk> Generate(const ChunkIdentifier& identifier) {
+      return std::make_shared<test_chunk>(test_chunk { identifier });
+    }
+  };
+
+  struct test_factory {
+    std::shared_ptr<test_gen> Create() {
+      return std::make_shared<test_gen>();
+    }
+  };
+
+  typedef ChunkManager<test_factory, test_gen, test_chunk> Manager;
+  typedef MultiViewerChunkManager<test_factory, test_gen, test_chunk> MultiManager;
+
+  // every visible identifier, neighbors included
+  std::set<std::vector<long>> Identifiers(Manager& manager) {
+    std::set<std::vector<long>> res;
+    for (auto& chunk : manager) {
+      const ChunkIdentifier& id = chunk->id;
+      const ChunkNeighbors& n = id.neighbors;
+      res.insert({ id.x, id.y, static_cast<long>(id.size),
+        static_cast<long>(n.l), static_cast<long>(n.r), static_cast<long>(n.u), static_cast<long>(n.d),
+        static_cast<long>(n.tl), static_cast<long>(n.tr), static_cast<long>(n.bl), static_cast<long>(n.br) });
+    }
+
+    return res;
+  }
+
+  // every chunk one viewer sees
+  std::vector<ChunkIdentifier> Visible(MultiManager& manager, size_t viewer) {
+    std::vector<ChunkIdentifier> res;
+    manager.ForEachVisible(viewer, [&](const std::shared_ptr<test_chunk>& chunk) {
+      res.push_back(chunk->id);
+    });
+
+    return res;
+  }
+
+  // size of the chunk covering point, or 0 if none does
+  size_t CoveringSize(const std::vector<ChunkIdentifier>& chunks, float x, float y) {
+    for (auto& id : chunks) {
+      float size = static_cast<float>(id.size);
+      if (id.x <= x && x < id.x + size && id.y <= y && y < id.y + size) {
+        return id.size;
+      }
+    }
+
+    return 0;
+  }
+}
+
+// begin()/end() still hand out chunk shared_ptrs, as they did when they iterated the cache
+static_assert(std::is_same<std::iterator_traits<Manager::iterator>::value_type, std::shared_ptr<test_chunk>>::value);
+static_assert(std::is_same<decltype(*std::declval<Manager::iterator&>()), std::shared_ptr<test_chunk>&>::value);
+
+// a manager patched from tree diffs sees the same chunks as one built from scratch at each position
+CHUNKER_TEST(chunk_manager_incremental_matches_fresh) {
+  auto factory = std::make_shared<test_factory>();
+  Manager incremental(factory, 2, 700.0, 16, 2.0);
+  float x = 10.0f;
+  float z = -30.0f;
+  for (int i = 0; i < 60; i++) {
+    x += static_cast<float>(i % 7) * 3.1f - 5.0f;
+    z += static_cast<float>(i % 5) * 4.3f - 3.0f;
+    if (i % 20 == 19) {
+      // far enough to recenter
+      x += 900.0f;
+    }
+
+    incremental.UpdateChunkData(glm::vec3(x, 0.0f, z));
+    if (i % 4 == 0) {
+      Manager fresh(factory, 1, 700.0, 16, 2.0);
+      fresh.UpdateChunkData(glm::vec3(x, 0.0f, z));
+      std::set<std::vector<long>> expected = Identifiers(fresh);
+      CHUNKER_CHECK(Identifiers(incremental) == expected);
+      CHUNKER_CHECK(expected.size() == incremental.GetChunkCount());
+    }
+  }
+}
+
+// iterating hands out every visible chunk, all of them ready
+CHUNKER_TEST(chunk_manager_iterates_visible_set) {
+  auto factory = std::make_shared<test_factory>();
+  Manager manager(factory, 2, 300.0, 16, 2.0);
+  manager.UpdateChunkData(glm::vec3(5.0f, 0.0f, 5.0f));
+
+  size_t count = 0;
+  bool all_ready = true;
+  for (auto itr = manager.begin(); itr != manager.end(); ++itr) {
+    all_ready &= (*itr != nullptr);
+    count++;
+  }
+
+  CHUNKER_CHECK(count == manager.GetChunkCount());
+  CHUNKER_CHECK(count > 0);
+  CHUNKER_CHECK(all_ready);
+}
+
+// streaming callers never call begin() - what's pending shouldn't grow w every update
+CHUNKER_TEST(chunk_manager_streaming_keeps_pending_bounded) {
+  auto factory = std::make_shared<test_factory>();
+  Manager manager(factory, 2, 700.0, 16, 2.0);
+  manager.SetStreaming(true);
+
+  bool bounded = true;
+  float x = 0.0f;
+  for (int i = 0; i < 300; i++) {
+    // back and forth over a few cascade boundaries, so leaves keep getting added
+    x += (i % 40 < 20 ? 6.0f : -6.0f);
+    manager.UpdateChunkData(glm::vec3(x, 0.0f, 0.0f));
+    manager.PollReady([](const std::shared_ptr<test_chunk>&) {});
+    bounded = bounded && manager.GetPendingCount() <= 2 * manager.GetChunkCount();
+  }
+
+  CHUNKER_CHECK(bounded);
+
+  // whatever's left still resolves
+  size_t count = 0;
+  bool all_ready = true;
+  for (auto itr = manager.begin(); itr != manager.end(); ++itr) {
+    all_ready &= (*itr != nullptr);
+    count++;
+  }
+
+  CHUNKER_CHECK(all_ready);
+  CHUNKER_CHECK(count == manager.GetChunkCount());
+  CHUNKER_CHECK(manager.GetPendingCount() == 0);
+}
+
+// two viewers sharing a tree - each sees its whole neighborhood covered, at least as finely as it would alone
+CHUNKER_TEST(multi_viewer_union_covers_each_neighborhood) {
+  const double gen_dist = 700.0;
+  std::vector<glm::vec3> viewers = { glm::vec3(100.0f, 0.0f, -50.0f), glm::vec3(260.0f, 0.0f, 120.0f) };
+
+  auto factory = std::make_shared<test_factory>();
+  MultiManager manager(factory, 2, gen_dist, 16, 2.0);
+  manager.UpdateViewers(viewers);
+  CHUNKER_CHECK(manager.GetTreeCount() == 1);
+
+  std::set<std::vector<long>> distinct;
+  size_t visible_total = 0;
+  for (size_t viewer = 0; viewer < viewers.size(); viewer++) {
+    MultiManager alone(factory, 1, gen_dist, 16, 2.0);
+    alone.UpdateViewers({ viewers[viewer] });
+    std::vector<ChunkIdentifier> expected = Visible(alone, 0);
+    std::vector<ChunkIdentifier> shared = Visible(manager, viewer);
+    visible_total += shared.size();
+    for (auto& id : shared) {
+      distinct.insert({ id.x, id.y, static_cast<long>(id.size) });
+    }
+
+    bool covered = true;
+    bool as_fine = true;
+    bool finer_somewhere = false;
+    const glm::vec3& center = viewers[viewer];
+    for (float dx = -gen_dist; dx <= gen_dist; dx += 8.0f) {
+      for (float dy = -gen_dist; dy <= gen_dist; dy += 8.0f) {
+        if (std::sqrt(dx * dx + dy * dy) > gen_dist) {
+          continue;
+        }
+
+        float x = center.x + dx + 0.5f;
+        float y = center.z + dy + 0.5f;
+        size_t size = CoveringSize(shared, x, y);
+        size_t alone_size = CoveringSize(expected, x, y);
+        covered = covered && size != 0;
+        as_fine = as_fine && size <= alone_size;
+        finer_somewhere = finer_somewhere || size < alone_size;
+      }
+    }
+
+    CHUNKER_CHECK(covered);
+    CHUNKER_CHECK(as_fine);
+    CHUNKER_CHECK(finer_somewhere);
+  }
+
+  // chunks both viewers see are only requested once
+  CHUNKER_CHECK(distinct.size() < visible_total);
+  CHUNKER_CHECK(manager.GetGenerationStats().generated == manager.GetChunkCount());
+}
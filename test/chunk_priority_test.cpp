@@ -0,0 +1,339 @@
+#include "test.hpp"
+
+#include "chunker/ChunkManager.hpp"
+#include "chunker/ChunkPriority.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  struct order_chunk {
+    long x;
+  };
+
+  // parked chunks sit here - nothing else does
+  const long PARK_Y = -(1L << 20);
+
+  // records the order chunks are generated in. parked chunks block until the gate opens instead -
+  // enqueue one first, and the worker sits on it while the rest queue up behind
+  struct order_state {
+    std::mutex lock;
+    std::vector<ChunkIdentifier> generated;
+    std::atomic<bool> open { true };
+    std::atomic<int> blocked { 0 };
+
+    std::vector<ChunkIdentifier> Take() {
+      std::lock_guard guard(lock);
+      std::vector<ChunkIdentifier> res;
+      res.swap(generated);
+      return res;
+    }
+  };
+
+  struct order_gen {
+    std::shared_ptr<order_state> state;
+
+    std::shared_ptr<order_chunk> Generate(const ChunkIdentifier& identifier) {
+      if (identifier.y == PARK_Y) {
+        state->blocked++;
+        while (!state->open.load()) {
+          std::this_thread::yield();
+        }
+      } else {
+        std::lock_guard guard(state->lock);
+        state->generated.push_back(identifier);
+      }
+
+      return std::make_shared<order_chunk>(order_chunk { identifier.x });
+    }
+  };
+
+  struct order_factory {
+    std::shared_ptr<order_state> state = std::make_shared<order_state>();
+
+    std::shared_ptr<order_gen> Create() {
+      return std::make_shared<order_gen>(order_gen { state });
+    }
+  };
+
+  typedef TypedChunkThreadPool<order_factory, order_gen, order_chunk> Pool;
+  typedef ChunkManager<order_factory, order_gen, order_chunk> Manager;
+
+  ChunkKey MakeKey(long x, long y, size_t size) {
+    return ChunkKey(ChunkIdentifier(x, y, size, size, ChunkNeighbors()));
+  }
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+
+  // parks the pool's only worker on a blocking chunk, so everything enqueued next queues up behind it
+  void Park(Pool& pool, order_state& state, long x) {
+    state.open = false;
+    int blocked = state.blocked.load();
+    pool.Enqueue(MakeKey(x, PARK_Y, 16));
+    WaitFor([&] { return state.blocked.load() == blocked + 1; });
+  }
+
+  bool SortedBy(const std::vector<ChunkIdentifier>& order, const ViewerDistancePriority& priority) {
+    for (size_t i = 1; i < order.size(); i++) {
+      if (priority(ChunkKey(order[i])) < priority(ChunkKey(order[i - 1]))) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
+
+// chunks queued up at once run nearest the viewer first, and in enqueue order w/o a priority
+CHUNKER_TEST(pool_generates_nearest_first) {
+  auto factory = std::make_shared<order_factory>();
+  Pool pool(1, factory);
+
+  // mixed distances and sizes, shuffled
+  std::vector<ChunkKey> keys;
+  for (long i = 0; i < 8; i++) {
+    for (long j = 0; j < 8; j++) {
+      keys.push_back(MakeKey(i * 64, j * 64, (i + j) % 2 == 0 ? 64 : 32));
+    }
+  }
+
+  std::shuffle(keys.begin(), keys.end(), std::mt19937(3));
+
+  ViewerDistancePriority viewer { 200.0, 150.0 };
+  pool.SetViewer(glm::vec3(200.0f, 0.0f, 150.0f));
+  Park(pool, *factory->state, 0);
+  pool.EnqueueBulk(keys);
+  factory->state->open = true;
+  pool.Wait();
+
+  std::vector<ChunkIdentifier> order = factory->state->Take();
+  CHUNKER_CHECK(order.size() == keys.size());
+  CHUNKER_CHECK(SortedBy(order, viewer));
+
+  // no priority - first in, first out
+  for (auto& key : keys) {
+    key = MakeKey(key.X() + 1024, key.Y(), key.Size());
+  }
+
+  pool.SetPriority(nullptr);
+  Park(pool, *factory->state, 16);
+  pool.EnqueueBulk(keys);
+  factory->state->open = true;
+  pool.Wait();
+
+  order = factory->state->Take();
+  bool fifo = (order.size() == keys.size());
+  for (size_t i = 0; fifo && i < order.size(); i++) {
+    fifo = (ChunkKey(order[i]) == keys[i]);
+  }
+
+  CHUNKER_CHECK(fifo);
+}
+
+// turning nearest first back off leaves chunks in the order the tree hands them out, as if it was never on
+CHUNKER_TEST(chunk_manager_nearest_first_toggles) {
+  glm::vec3 start(5.0f, 0.0f, 5.0f);
+  glm::vec3 moved(260.0f, 0.0f, -90.0f);
+
+  auto tree_factory = std::make_shared<order_factory>();
+  Manager tree_order(tree_factory, 1, 700.0, 16, 2.0);
+  tree_order.UpdateChunkData(start);
+  tree_order.wait();
+  tree_factory->state->Take();
+  tree_order.UpdateChunkData(moved);
+  tree_order.wait();
+  std::vector<ChunkIdentifier> expected = tree_factory->state->Take();
+
+  auto nearest_factory = std::make_shared<order_factory>();
+  Manager nearest(nearest_factory, 1, 700.0, 16, 2.0);
+  nearest.SetNearestFirst(true);
+  nearest.UpdateChunkData(start);
+  nearest.wait();
+  nearest_factory->state->Take();
+  nearest.UpdateChunkData(moved);
+  nearest.wait();
+  std::vector<ChunkIdentifier> sorted = nearest_factory->state->Take();
+
+  auto toggled_factory = std::make_shared<order_factory>();
+  Manager toggled(toggled_factory, 1, 700.0, 16, 2.0);
+  toggled.SetNearestFirst(true);
+  toggled.UpdateChunkData(start);
+  toggled.wait();
+  toggled_factory->state->Take();
+  toggled.SetNearestFirst(false);
+  toggled.UpdateChunkData(moved);
+  toggled.wait();
+  std::vector<ChunkIdentifier> order = toggled_factory->state->Take();
+
+  ViewerDistancePriority viewer { moved.x, moved.z };
+  CHUNKER_CHECK(expected.size() > 8);
+  CHUNKER_CHECK(SortedBy(sorted, viewer));
+  CHUNKER_CHECK(!SortedBy(expected, viewer));
+
+  bool same = (order.size() == expected.size());
+  for (size_t i = 0; same && i < order.size(); i++) {
+    same = (ChunkKey(order[i]) == ChunkKey(expected[i]));
+  }
+
+  CHUNKER_CHECK(same);
+}
+
+// facing +x - everything in the view cone generates before anything behind the viewer, nearest first
+// within each. w/o nearest first, too - the cone stands on its own
+CHUNKER_TEST(chunk_manager_view_cone_first) {
+  glm::vec3 position(5.0f, 0.0f, 5.0f);
+  glm::vec3 forward(1.0f, 0.0f, 0.0f);
+
+  auto factory = std::make_shared<order_factory>();
+  Manager manager(factory, 1, 700.0, 16, 2.0);
+  manager.SetNearestFirst(true);
+  manager.SetNearestFirst(false);
+  manager.UpdateChunkDataFacing(position, forward);
+  manager.wait();
+  std::vector<ChunkIdentifier> order = factory->state->Take();
+
+  ViewConePriority cone = ViewConePriority::Facing(position.x, position.z, forward.x, forward.z, 0.8, 0.0);
+  size_t in_view = 0;
+  while (in_view < order.size() && cone.InView(ChunkKey(order[in_view]))) {
+    in_view++;
+  }
+
+  // what's left is all out of view, and some of it is behind
+  bool rest_out_of_view = true;
+  size_t behind = 0;
+  for (size_t i = in_view; i < order.size(); i++) {
+    rest_out_of_view = rest_out_of_view && !cone.InView(ChunkKey(order[i]));
+    behind += (static_cast<float>(order[i].x + static_cast<long>(order[i].size)) < position.x ? 1 : 0);
+  }
+
+  CHUNKER_CHECK(order.size() == manager.GetChunkCount());
+  CHUNKER_CHECK(in_view > 0);
+  CHUNKER_CHECK(rest_out_of_view);
+  CHUNKER_CHECK(behind > 0);
+
+  std::vector<ChunkIdentifier> front(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(in_view));
+  std::vector<ChunkIdentifier> back(order.begin() + static_cast<std::ptrdiff_t>(in_view), order.end());
+  CHUNKER_CHECK(SortedBy(front, cone.distance));
+  CHUNKER_CHECK(SortedBy(back, cone.distance));
+}
+
+// prefetches queue behind enqueued chunks, and Wait() doesn't wait on them - even one stuck on a worker
+CHUNKER_TEST(pool_prefetch_runs_behind_and_skips_wait) {
+  auto factory = std::make_shared<order_factory>();
+  Pool pool(1, factory);
+
+  factory->state->open = false;
+  pool.Prefetch({ MakeKey(0, PARK_Y, 16) });
+  CHUNKER_CHECK(WaitFor([&] { return factory->state->blocked.load() == 1; }));
+
+  std::vector<ChunkKey> prefetched;
+  std::vector<ChunkKey> visible;
+  for (long i = 0; i < 16; i++) {
+    prefetched.push_back(MakeKey(i * 16, 0, 16));
+    visible.push_back(MakeKey(i * 16, 256, 16));
+  }
+
+  pool.Prefetch(prefetched);
+  std::future<void> waited = std::async(std::launch::async, [&] { pool.Wait(); });
+  bool skipped = (waited.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(!pool.Empty());
+  CHUNKER_CHECK(skipped);
+  if (!skipped) {
+    // unstick it, rather than hang
+    factory->state->open = true;
+    return;
+  }
+
+  pool.EnqueueBulk(visible);
+  factory->state->open = true;
+  pool.Wait();
+  for (auto& key : visible) {
+    CHUNKER_CHECK(pool.HasChunk(key));
+  }
+
+  CHUNKER_CHECK(WaitFor([&] { return pool.Empty(); }));
+  for (auto& key : prefetched) {
+    CHUNKER_CHECK(pool.HasChunk(key));
+  }
+
+  // every visible chunk went ahead of every prefetch
+  std::vector<ChunkIdentifier> order = factory->state->Take();
+  bool visible_first = (order.size() == visible.size() + prefetched.size());
+  for (size_t i = 0; visible_first && i < order.size(); i++) {
+    visible_first = ((order[i].y == 256) == (i < visible.size()));
+  }
+
+  CHUNKER_CHECK(visible_first);
+}
+
+// chunks around the predicted position are cached before the viewer gets there - arriving generates nothing new
+CHUNKER_TEST(chunk_manager_prefetch_caches_ahead) {
+  glm::vec3 start(5.0f, 0.0f, 5.0f);
+  glm::vec3 velocity(120.0f, 0.0f, 40.0f);
+  glm::vec3 predicted = start + velocity;
+
+  // what a viewer at the predicted position sees
+  auto fresh_factory = std::make_shared<order_factory>();
+  Manager fresh(fresh_factory, 1, 700.0, 16, 2.0);
+  fresh.UpdateChunkData(predicted);
+  fresh.wait();
+  std::vector<ChunkIdentifier> ahead = fresh_factory->state->Take();
+
+  auto factory = std::make_shared<order_factory>();
+  Manager manager(factory, 1, 700.0, 16, 2.0);
+  manager.SetPrefetch(1.0, 4096);
+  manager.UpdateChunkData(start, velocity);
+  manager.wait();
+
+  std::vector<ChunkIdentifier> generated;
+  bool all_prefetched = WaitFor([&] {
+    std::vector<ChunkIdentifier> taken = factory->state->Take();
+    generated.insert(generated.end(), taken.begin(), taken.end());
+    for (auto& identifier : ahead) {
+      bool found = false;
+      for (auto& other : generated) {
+        found = found || (ChunkKey(other) == ChunkKey(identifier));
+      }
+
+      if (!found) {
+        return false;
+      }
+    }
+
+    return true;
+  });
+
+  CHUNKER_CHECK(ahead.size() > 8);
+  CHUNKER_CHECK(all_prefetched);
+
+  manager.UpdateChunkData(predicted);
+  manager.wait();
+  CHUNKER_CHECK(manager.GetChunkCount() == ahead.size());
+  CHUNKER_CHECK(factory->state->Take().empty());
+}
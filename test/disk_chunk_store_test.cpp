@@ -0,0 +1,361 @@
+#include "test.hpp"
+
+#include "chunker/DiskChunkStore.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  struct disk_chunk {
+    long x;
+    std::vector<uint8_t> payload;
+
+    size_t ByteSize() const {
+      return sizeof(disk_chunk) + payload.size();
+    }
+
+    void Serialize(std::vector<uint8_t>& output) const {
+      size_t offset = output.size();
+      output.resize(offset + sizeof(x));
+      std::memcpy(output.data() + offset, &x, sizeof(x));
+      output.insert(output.end(), payload.begin(), payload.end());
+    }
+
+    static std::shared_ptr<disk_chunk> Deserialize(const uint8_t* data, size_t size) {
+      if (size < sizeof(long)) {
+        return nullptr;
+      }
+
+      auto res = std::make_shared<disk_chunk>();
+      std::memcpy(&res->x, data, sizeof(long));
+      res->payload.assign(data + sizeof(long), data + size);
+      return res;
+    }
+  };
+
+  typedef DiskChunkStore<disk_chunk> Store;
+
+  struct disk_gen {
+    std::shared_ptr<std::atomic<int>> generated;
+
+    std::shared_ptr<disk_chunk> Generate(const ChunkIdentifier& identifier) {
+      (*generated)++;
+      return MakeChunk(identifier.x);
+    }
+
+    static std::shared_ptr<disk_chunk> MakeChunk(long x) {
+      return std::make_shared<disk_chunk>(disk_chunk { x, std::vector<uint8_t>(100, static_cast<uint8_t>(x)) });
+    }
+  };
+
+  struct disk_factory {
+    std::shared_ptr<std::atomic<int>> generated = std::make_shared<std::atomic<int>>(0);
+
+    std::shared_ptr<disk_gen> Create() {
+      return std::make_shared<disk_gen>(disk_gen { generated });
+    }
+  };
+
+  typedef TypedChunkThreadPool<disk_factory, disk_gen, disk_chunk> Pool;
+
+  // reads stall until the test lets them go, then fail - as a corrupt file would
+  struct stalled_read {
+    static std::atomic<bool> stall;
+    static std::atomic<int> started;
+  };
+
+  std::atomic<bool> stalled_read::stall { false };
+  std::atomic<int> stalled_read::started { 0 };
+
+  struct stalled_chunk {
+    long x;
+
+    void Serialize(std::vector<uint8_t>& output) const {
+      size_t offset = output.size();
+      output.resize(offset + sizeof(x));
+      std::memcpy(output.data() + offset, &x, sizeof(x));
+    }
+
+    static std::shared_ptr<stalled_chunk> Deserialize(const uint8_t*, size_t) {
+      stalled_read::started++;
+      while (stalled_read::stall.load()) {
+        std::this_thread::yield();
+      }
+
+      return nullptr;
+    }
+  };
+
+  // blocks every generation until the gate opens
+  struct stalled_gen {
+    std::shared_ptr<std::atomic<bool>> open;
+
+    std::shared_ptr<stalled_chunk> Generate(const ChunkIdentifier& identifier) {
+      while (!open->load()) {
+        std::this_thread::yield();
+      }
+
+      return std::make_shared<stalled_chunk>(stalled_chunk { identifier.x });
+    }
+  };
+
+  struct stalled_factory {
+    std::shared_ptr<std::atomic<bool>> open = std::make_shared<std::atomic<bool>>(false);
+
+    std::shared_ptr<stalled_gen> Create() {
+      return std::make_shared<stalled_gen>(stalled_gen { open });
+    }
+  };
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+
+  ChunkKey MakeKey(long x) {
+    return ChunkKey(ChunkIdentifier(x, 0, 16, 16, ChunkNeighbors()));
+  }
+
+  // emptied on construction and destruction
+  struct temp_directory {
+    std::filesystem::path path;
+
+    explicit temp_directory(const std::string& name) : path(std::filesystem::temp_directory_path() / name) {
+      std::filesystem::remove_all(path);
+    }
+
+    ~temp_directory() {
+      std::error_code err;
+      std::filesystem::remove_all(path, err);
+    }
+
+    size_t FileCount() const {
+      size_t res = 0;
+      for (auto itr = std::filesystem::directory_iterator(path); itr != std::filesystem::directory_iterator(); itr++) {
+        res++;
+      }
+
+      return res;
+    }
+  };
+
+  // where the store keeps key - its packed bytes in hex
+  std::filesystem::path FilePath(const std::filesystem::path& directory, const ChunkKey& key) {
+    static const char* HEX = "0123456789abcdef";
+    uint8_t packed[ChunkKey::PACKED_SIZE];
+    key.Pack(packed);
+
+    std::string name;
+    for (uint8_t byte : packed) {
+      name.push_back(HEX[byte >> 4]);
+      name.push_back(HEX[byte & 0xF]);
+    }
+
+    return directory / (name + ".chunk");
+  }
+
+  void Write(Store& store, long x) {
+    Store::ChunkList chunks { { MakeKey(x), disk_gen::MakeChunk(x) } };
+    store.WriteBack(chunks);
+    store.Flush();
+  }
+
+  bool Matches(const std::shared_ptr<disk_chunk>& chunk, long x) {
+    return (chunk != nullptr && chunk->x == x && chunk->payload == disk_gen::MakeChunk(x)->payload);
+  }
+}
+
+CHUNKER_TEST(disk_chunk_store_reloads_written_chunks) {
+  temp_directory dir("chunker_test_disk_reload");
+  {
+    Store store(dir.path.string());
+    for (long x = 0; x < 8; x++) {
+      Write(store, x * 16);
+    }
+
+    CHUNKER_CHECK(store.Size() == 8);
+    CHUNKER_CHECK(store.Written() == 8);
+
+    std::shared_ptr<disk_chunk> chunk;
+    CHUNKER_CHECK(store.Load(MakeKey(32), &chunk));
+    CHUNKER_CHECK(Matches(chunk, 32));
+    CHUNKER_CHECK(!store.Load(MakeKey(1024), &chunk));
+  }
+
+  // a new store picks up what the last one left
+  Store store(dir.path.string());
+  CHUNKER_CHECK(store.Size() == 8);
+  CHUNKER_CHECK(store.Usage() > 8 * 100);
+
+  bool all_match = true;
+  for (long x = 0; x < 8; x++) {
+    std::shared_ptr<disk_chunk> chunk;
+    all_match = all_match && store.Load(MakeKey(x * 16), &chunk) && Matches(chunk, x * 16);
+  }
+
+  CHUNKER_CHECK(all_match);
+
+  // read back on the store's thread
+  std::shared_ptr<disk_chunk> loaded;
+  CHUNKER_CHECK(store.LoadAsync(MakeKey(48), [&](const std::shared_ptr<disk_chunk>& chunk) { loaded = chunk; }));
+  CHUNKER_CHECK(!store.LoadAsync(MakeKey(1024), [](const std::shared_ptr<disk_chunk>&) {}));
+  store.Flush();
+  CHUNKER_CHECK(Matches(loaded, 48));
+}
+
+CHUNKER_TEST(disk_chunk_store_evicts_past_budget) {
+  temp_directory dir("chunker_test_disk_budget");
+  size_t file_size = 0;
+  {
+    Store probe(dir.path.string());
+    Write(probe, 0);
+    file_size = probe.Usage();
+  }
+
+  std::filesystem::remove_all(dir.path);
+
+  // room for three files
+  Store store(dir.path.string(), file_size * 3);
+  for (long x = 0; x < 3; x++) {
+    Write(store, x * 16);
+  }
+
+  // loading 0 makes 16 the least recently used
+  std::shared_ptr<disk_chunk> chunk;
+  CHUNKER_CHECK(store.Load(MakeKey(0), &chunk));
+  Write(store, 48);
+  Write(store, 64);
+
+  CHUNKER_CHECK(store.Size() == 3);
+  CHUNKER_CHECK(store.Usage() <= store.Budget());
+  CHUNKER_CHECK(store.Evicted() == 2);
+  CHUNKER_CHECK(store.Has(MakeKey(0)));
+  CHUNKER_CHECK(!store.Has(MakeKey(16)));
+  CHUNKER_CHECK(!store.Has(MakeKey(32)));
+  CHUNKER_CHECK(dir.FileCount() == 3);
+
+  // a smaller budget on restart keeps the newest
+  Store smaller(dir.path.string(), file_size);
+  CHUNKER_CHECK(smaller.Size() == 1);
+  CHUNKER_CHECK(dir.FileCount() == 1);
+}
+
+CHUNKER_TEST(disk_chunk_store_drops_corrupt_files) {
+  temp_directory dir("chunker_test_disk_corrupt");
+  Store store(dir.path.string());
+  Write(store, 0);
+  Write(store, 16);
+
+  for (auto itr = std::filesystem::directory_iterator(dir.path); itr != std::filesystem::directory_iterator(); itr++) {
+    std::ofstream(itr->path(), std::ios::binary | std::ios::trunc) << "junk";
+  }
+
+  std::shared_ptr<disk_chunk> loaded = disk_gen::MakeChunk(1);
+  CHUNKER_CHECK(store.LoadAsync(MakeKey(0), [&](const std::shared_ptr<disk_chunk>& chunk) { loaded = chunk; }));
+  store.Flush();
+  CHUNKER_CHECK(loaded == nullptr);
+  CHUNKER_CHECK(!store.Has(MakeKey(0)));
+
+  std::shared_ptr<disk_chunk> chunk;
+  CHUNKER_CHECK(!store.Load(MakeKey(16), &chunk));
+  CHUNKER_CHECK(store.Size() == 0);
+  CHUNKER_CHECK(dir.FileCount() == 0);
+}
+
+// chunks evicted from memory come back from disk, off the workers' threads - and Wait() still covers them
+CHUNKER_TEST(pool_reads_disk_tier_back) {
+  temp_directory dir("chunker_test_disk_pool");
+  std::vector<ChunkKey> keys;
+  for (long x = 0; x < 64; x++) {
+    keys.push_back(MakeKey(x * 16));
+  }
+
+  auto factory = std::make_shared<disk_factory>();
+  {
+    // room for a few chunks in memory - the rest go to disk
+    Pool pool(2, factory, 8 * 200);
+    pool.OpenDiskTier(dir.path.string());
+    pool.EnqueueBulk(keys);
+    pool.Wait();
+    CHUNKER_CHECK(factory->generated->load() == 64);
+  }
+
+  Pool pool(2, factory, 128 * 200);
+  pool.OpenDiskTier(dir.path.string());
+  CHUNKER_CHECK(pool.DiskTierSize() == 64);
+
+  // one unreadable file - generated again instead
+  std::ofstream(FilePath(dir.path, keys[5]), std::ios::binary | std::ios::trunc) << "junk";
+
+  pool.EnqueueBulk(keys);
+  pool.Wait();
+
+  GenerationStats stats = pool.Stats();
+  CHUNKER_CHECK(stats.disk_hits == 63);
+  CHUNKER_CHECK(factory->generated->load() == 65);
+
+  bool all_match = true;
+  for (auto& key : keys) {
+    std::shared_ptr<disk_chunk> chunk;
+    all_match = all_match && pool.FetchChunk(key, &chunk) && Matches(chunk, key.X());
+  }
+
+  CHUNKER_CHECK(all_match);
+}
+
+// a prefetch attached to another prefetch's disk read, which fails - both are generated again, still in the background
+CHUNKER_TEST(pool_failed_disk_read_keeps_prefetch_in_background) {
+  temp_directory dir("chunker_test_disk_prefetch");
+  ChunkKey key = MakeKey(16);
+  {
+    DiskChunkStore<stalled_chunk> store(dir.path.string());
+    DiskChunkStore<stalled_chunk>::ChunkList chunks { { key, std::make_shared<stalled_chunk>(stalled_chunk { 16 }) } };
+    store.WriteBack(chunks);
+    store.Flush();
+  }
+
+  auto factory = std::make_shared<stalled_factory>();
+  TypedChunkThreadPool<stalled_factory, stalled_gen, stalled_chunk> pool(2, factory);
+  pool.OpenDiskTier(dir.path.string());
+  CHUNKER_CHECK(pool.DiskTierSize() == 1);
+
+  stalled_read::stall = true;
+  pool.Prefetch({ key });
+  CHUNKER_CHECK(WaitFor([&] { return stalled_read::started.load() == 1; }));
+  pool.Prefetch({ key });
+  CHUNKER_CHECK(WaitFor([&] { return pool.Stats().deduped == 1; }));
+
+  // the read fails, and both go back to be generated - one blocks behind the gate, the other attaches to it
+  stalled_read::stall = false;
+  CHUNKER_CHECK(WaitFor([&] { return pool.Stats().deduped == 2; }));
+
+  std::future<void> waited = std::async(std::launch::async, [&] { pool.Wait(); });
+  CHUNKER_CHECK(waited.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+
+  factory->open->store(true);
+  waited.get();
+  pool.FlushDiskTier();
+  CHUNKER_CHECK(pool.HasChunk(key));
+}
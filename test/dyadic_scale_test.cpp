@@ -0,0 +1,114 @@
+#include "test.hpp"
+
+#include "chunker/ChunkIdentifier.hpp"
+#include "chunker/util/DyadicScale.hpp"
+#include "chunker/util/Fraction.hpp"
+
+#include <array>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+
+using namespace chunker::util;
+
+// nothing converts to or from a scale implicitly
+static_assert(!std::is_convertible_v<int, DyadicScale>, "int -> DyadicScale should be explicit");
+static_assert(!std::is_convertible_v<size_t, DyadicScale>, "size_t -> DyadicScale should be explicit");
+static_assert(!std::is_convertible_v<Fraction, DyadicScale>, "Fraction -> DyadicScale should be explicit");
+static_assert(!std::is_convertible_v<DyadicScale, Fraction>, "DyadicScale -> Fraction should be explicit");
+static_assert(!std::is_convertible_v<DyadicScale, double>, "DyadicScale -> double should be explicit");
+static_assert(!std::is_convertible_v<DyadicScale, long>, "DyadicScale -> long should be explicit");
+
+namespace {
+  template <typename Func>
+  bool Throws(Func func) {
+    try {
+      func();
+    } catch (const std::exception&) {
+      return true;
+    }
+
+    return false;
+  }
+}
+
+CHUNKER_TEST(dyadic_scale_round_trips) {
+  for (int exponent = -DyadicScale::MAX_EXPONENT; exponent <= DyadicScale::MAX_EXPONENT; exponent++) {
+    DyadicScale scale = DyadicScale::FromExponent(exponent);
+    DyadicScale from_fraction;
+    CHUNKER_CHECK(DyadicScale::TryFrom(scale.AsFraction(), &from_fraction));
+    CHUNKER_CHECK(from_fraction == scale);
+    CHUNKER_CHECK(from_fraction.Exponent() == exponent);
+  }
+
+  CHUNKER_CHECK(DyadicScale(0).IsZero());
+  CHUNKER_CHECK(DyadicScale(0, 16).IsZero());
+  CHUNKER_CHECK(DyadicScale(4096, 16) == DyadicScale(256));
+  CHUNKER_CHECK(DyadicScale(1, 4).Exponent() == -2);
+  CHUNKER_CHECK(DyadicScale(Fraction(8, 32)) == DyadicScale(1, 4));
+  CHUNKER_CHECK(static_cast<long>(DyadicScale(64)) == 64);
+  CHUNKER_CHECK(static_cast<double>(DyadicScale(1, 8)) == 0.125);
+  CHUNKER_CHECK(DyadicScale(1, 4) * 8 == DyadicScale(2));
+}
+
+CHUNKER_TEST(dyadic_scale_rejects_non_dyadic) {
+  DyadicScale output = DyadicScale::FromExponent(5);
+
+  CHUNKER_CHECK(!DyadicScale::TryFrom(3, &output));
+  CHUNKER_CHECK(!DyadicScale::TryFrom(48, &output));
+  CHUNKER_CHECK(!DyadicScale::TryFrom(-4, &output));
+  CHUNKER_CHECK(!DyadicScale::TryFrom(1L, 3L, &output));
+  CHUNKER_CHECK(!DyadicScale::TryFrom(Fraction(1, 3), &output));
+  CHUNKER_CHECK(!DyadicScale::TryFrom(1L, 0L, &output));
+  CHUNKER_CHECK(!DyadicScale::TryFromExponent(DyadicScale::MAX_EXPONENT + 1, &output));
+
+  // failures leave output alone
+  CHUNKER_CHECK(output.Exponent() == 5);
+
+  CHUNKER_CHECK(Throws([] { DyadicScale(3); }));
+  CHUNKER_CHECK(Throws([] { DyadicScale(48); }));
+  CHUNKER_CHECK(Throws([] { DyadicScale(1, 3); }));
+  CHUNKER_CHECK(Throws([] { DyadicScale(Fraction(2, 3)); }));
+  CHUNKER_CHECK(Throws([] { DyadicScale::FromExponent(DyadicScale::MAX_EXPONENT + 1); }));
+  CHUNKER_CHECK(Throws([] { return DyadicScale(4) / DyadicScale::Zero(); }));
+  CHUNKER_CHECK(Throws([] { return DyadicScale(4) * 3; }));
+}
+
+// small exponents - the only ones in use - spread over the low bits, not just the bottom few buckets
+CHUNKER_TEST(dyadic_scale_hash_spreads) {
+  std::hash<DyadicScale> hasher;
+  std::set<size_t> low_bits;
+  std::set<size_t> hashes;
+  for (int exponent = -8; exponent < 8; exponent++) {
+    size_t hash = hasher(DyadicScale::FromExponent(exponent));
+    hashes.insert(hash);
+    low_bits.insert(hash & 0xFF);
+  }
+
+  hashes.insert(hasher(DyadicScale::Zero()));
+  CHUNKER_CHECK(hashes.size() == 17);
+  CHUNKER_CHECK(low_bits.size() >= 14);
+  CHUNKER_CHECK(hasher(DyadicScale(1, 4)) == hasher(DyadicScale::FromExponent(-2)));
+}
+
+// identifiers and neighbors read and write as Fractions, as they did before their fields were DyadicScales
+CHUNKER_TEST(dyadic_scale_fraction_accessors) {
+  std::array<Fraction, 8> sizes = { Fraction(16), Fraction(32), Fraction(0), Fraction(1, 2), Fraction(64), Fraction(16), Fraction(16), Fraction(8, 4) };
+  chunker::ChunkNeighbors neighbors = chunker::ChunkNeighbors::FromFractions(sizes);
+  CHUNKER_CHECK(neighbors.r == DyadicScale(32));
+  CHUNKER_CHECK(neighbors.u.IsZero());
+  CHUNKER_CHECK(neighbors.br == DyadicScale(2));
+  CHUNKER_CHECK(neighbors.AsFractions() == sizes);
+
+  sizes[5] = Fraction(24);
+  CHUNKER_CHECK(Throws([&] { chunker::ChunkNeighbors::FromFractions(sizes); }));
+
+  chunker::ChunkIdentifier identifier;
+  CHUNKER_CHECK(identifier.ScaleFraction() == Fraction(1));
+  identifier.SetScale(Fraction(2, 8));
+  CHUNKER_CHECK(identifier.scale == DyadicScale(1, 4));
+  CHUNKER_CHECK(identifier.ScaleFraction() == Fraction(1, 4));
+  CHUNKER_CHECK(Throws([&] { identifier.SetScale(Fraction(1, 3)); }));
+  CHUNKER_CHECK(identifier.scale == DyadicScale(1, 4));
+}
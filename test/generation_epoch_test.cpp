@@ -0,0 +1,140 @@
+#include "test.hpp"
+
+#include "chunker/GenerationEpoch.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  ChunkKey MakeKey(long x) {
+    return ChunkKey(ChunkIdentifier(x, 0, 16, 16, ChunkNeighbors()));
+  }
+
+  struct gated_chunk {
+    long x;
+  };
+
+  // blocks every generation until the gate opens
+  struct gated_state {
+    std::atomic<bool> open { false };
+    std::atomic<int> started { 0 };
+  };
+
+  struct gated_gen {
+    std::shared_ptr<gated_state> state;
+
+    std::shared_ptr<gated_chunk> Generate(const ChunkIdentifier& identifier) {
+      state->started++;
+      while (!state->open.load()) {
+        std::this_thread::yield();
+      }
+
+      return std::make_shared<gated_chunk>(gated_chunk { identifier.x });
+    }
+  };
+
+  struct gated_factory {
+    std::shared_ptr<gated_state> state = std::make_shared<gated_state>();
+
+    std::shared_ptr<gated_gen> Create() {
+      return std::make_shared<gated_gen>(gated_gen { state });
+    }
+  };
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+}
+
+CHUNKER_TEST(generation_epoch_retires_only_listed_keys) {
+  GenerationEpoch epoch;
+  ChunkKey a = MakeKey(0);
+  ChunkKey b = MakeKey(16);
+
+  uint64_t queued = epoch.Current();
+  CHUNKER_CHECK(epoch.Retire({ a }) == queued + 1);
+  CHUNKER_CHECK(epoch.RetiredCount() == 1);
+  CHUNKER_CHECK(epoch.IsStale(a, queued));
+  CHUNKER_CHECK(!epoch.IsStale(b, queued));
+
+  // queued after it was retired - still wanted
+  CHUNKER_CHECK(!epoch.IsStale(a, epoch.Current()));
+  epoch.Retire({});
+  CHUNKER_CHECK(!epoch.IsStale(a, queued + 1));
+
+  // wanted again - older chunks stay live
+  epoch.Revive(a);
+  CHUNKER_CHECK(epoch.RetiredCount() == 0);
+  CHUNKER_CHECK(!epoch.IsStale(a, queued));
+}
+
+CHUNKER_TEST(generation_epoch_advance_replaces_retired) {
+  GenerationEpoch epoch;
+  ChunkKey a = MakeKey(0);
+  ChunkKey b = MakeKey(16);
+
+  uint64_t queued = epoch.Current();
+  epoch.Retire({ a });
+
+  // the live set covers everything retired before it
+  auto live = std::make_shared<GenerationEpoch::LiveSet>();
+  live->insert(a);
+  epoch.Advance(live);
+  CHUNKER_CHECK(epoch.RetiredCount() == 0);
+  CHUNKER_CHECK(!epoch.IsStale(a, queued));
+  CHUNKER_CHECK(epoch.IsStale(b, queued));
+
+  // retiring on top of a live set
+  uint64_t after = epoch.Current();
+  epoch.Retire({ a });
+  CHUNKER_CHECK(epoch.IsStale(a, queued));
+  CHUNKER_CHECK(epoch.IsStale(a, after));
+  CHUNKER_CHECK(!epoch.IsStale(b, after));
+
+  epoch.Advance(nullptr);
+  CHUNKER_CHECK(epoch.IsStale(b, after));
+  CHUNKER_CHECK(!epoch.IsStale(b, epoch.Current()));
+}
+
+// one worker, stuck on the first key - retired keys behind it are dropped, the rest generate
+CHUNKER_TEST(pool_drops_retired_keys) {
+  auto factory = std::make_shared<gated_factory>();
+  TypedChunkThreadPool<gated_factory, gated_gen, gated_chunk> pool(1, factory);
+
+  pool.Enqueue(MakeKey(0).Identifier());
+  CHUNKER_CHECK(WaitFor([&] { return factory->state->started.load() == 1; }));
+
+  std::vector<ChunkKey> queued { MakeKey(16), MakeKey(32), MakeKey(48) };
+  pool.EnqueueBulk(queued);
+  pool.AdvanceEpoch({ MakeKey(16), MakeKey(48) });
+
+  // 48 is wanted again before a worker gets to it
+  pool.Enqueue(MakeKey(48).Identifier());
+
+  factory->state->open = true;
+  pool.Wait();
+
+  GenerationStats stats = pool.Stats();
+  CHUNKER_CHECK(stats.dropped == 1);
+  CHUNKER_CHECK(!pool.HasChunk(MakeKey(16)));
+  CHUNKER_CHECK(pool.HasChunk(MakeKey(0)));
+  CHUNKER_CHECK(pool.HasChunk(MakeKey(32)));
+  CHUNKER_CHECK(pool.HasChunk(MakeKey(48)));
+}
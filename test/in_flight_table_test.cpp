@@ -0,0 +1,178 @@
+#include "test.hpp"
+
+#include "chunker/InFlightTable.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  typedef InFlightTable<std::function<void(int)>> Table;
+
+  ChunkKey MakeKey(long x) {
+    return ChunkKey(ChunkIdentifier(x, 0, 16, 16, ChunkNeighbors()));
+  }
+
+  struct gated_chunk {
+    long x;
+  };
+
+  // blocks every generation until the gate opens
+  struct gated_state {
+    std::atomic<bool> open { false };
+    std::atomic<int> started { 0 };
+  };
+
+  struct gated_gen {
+    std::shared_ptr<gated_state> state;
+
+    std::shared_ptr<gated_chunk> Generate(const ChunkIdentifier& identifier) {
+      state->started++;
+      while (!state->open.load()) {
+        std::this_thread::yield();
+      }
+
+      return std::make_shared<gated_chunk>(gated_chunk { identifier.x });
+    }
+  };
+
+  struct gated_factory {
+    std::shared_ptr<gated_state> state = std::make_shared<gated_state>();
+
+    std::shared_ptr<gated_gen> Create() {
+      return std::make_shared<gated_gen>(gated_gen { state });
+    }
+  };
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+}
+
+CHUNKER_TEST(in_flight_table_dedupes) {
+  Table table;
+  ChunkKey key = MakeKey(0);
+  int calls = 0;
+  auto on_ready = [&](int value) { calls += value; };
+
+  CHUNKER_CHECK(table.Acquire(key, 1, nullptr));
+  CHUNKER_CHECK(!table.Acquire(key, 1, on_ready));
+  CHUNKER_CHECK(!table.Acquire(key, 2, on_ready));
+
+  // other keys aren't affected
+  CHUNKER_CHECK(table.Acquire(MakeKey(16), 1, nullptr));
+
+  Table::WaiterList waiters = table.Release(key);
+  CHUNKER_CHECK(waiters.size() == 2);
+  for (auto& w : waiters) {
+    w.on_ready(1);
+  }
+
+  CHUNKER_CHECK(calls == 2);
+
+  // released - the next requester owns it
+  CHUNKER_CHECK(table.Acquire(key, 3, nullptr));
+  CHUNKER_CHECK(table.Release(key).empty());
+}
+
+CHUNKER_TEST(in_flight_table_abort_keeps_live_waiters) {
+  Table table;
+  GenerationEpoch epoch;
+  ChunkKey key = MakeKey(0);
+
+  // owner + a waiter in epoch 1, another waiter in epoch 2
+  epoch.Advance(nullptr);
+  CHUNKER_CHECK(table.Acquire(key, 1, nullptr));
+  CHUNKER_CHECK(!table.Acquire(key, 1, nullptr));
+  epoch.Advance(nullptr);
+  CHUNKER_CHECK(!table.Acquire(key, 2, nullptr));
+
+  // epoch 1 is stale, epoch 2 is current - owner keeps the key, and retries in epoch 2
+  uint64_t retry_epoch = 0;
+  Table::WaiterList stale;
+  CHUNKER_CHECK(table.Abort(key, epoch, &retry_epoch, &stale));
+  CHUNKER_CHECK(retry_epoch == 2);
+  CHUNKER_CHECK(stale.size() == 1 && stale[0].epoch == 1);
+  CHUNKER_CHECK(!table.Acquire(MakeKey(0), 2, nullptr));
+
+  // a live set keeps older waiters wanted too
+  auto live = std::make_shared<GenerationEpoch::LiveSet>();
+  live->insert(key);
+  epoch.Advance(live);
+  stale.clear();
+  CHUNKER_CHECK(table.Abort(key, epoch, &retry_epoch, &stale));
+  CHUNKER_CHECK(stale.empty());
+
+  // nobody wants it any more - released
+  epoch.Advance(nullptr);
+  CHUNKER_CHECK(!table.Abort(key, epoch, &retry_epoch, &stale));
+  CHUNKER_CHECK(stale.size() == 2);
+  CHUNKER_CHECK(table.Acquire(key, 4, nullptr));
+
+  // aborting a key nobody holds is a no-op
+  CHUNKER_CHECK(!table.Abort(MakeKey(32), epoch, &retry_epoch, &stale));
+}
+
+// two workers pick up the same key - one generates, the other attaches
+CHUNKER_TEST(pool_dedupes_in_flight_chunks) {
+  auto factory = std::make_shared<gated_factory>();
+  TypedChunkThreadPool<gated_factory, gated_gen, gated_chunk> pool(2, factory);
+  ChunkKey key = MakeKey(48);
+
+  std::atomic<int> ready { 0 };
+  std::vector<std::shared_ptr<gated_chunk>> chunks(2);
+  pool.Enqueue(key, [&](const ChunkKey&, const std::shared_ptr<gated_chunk>& chunk) { chunks[0] = chunk; ready++; });
+  CHUNKER_CHECK(WaitFor([&] { return factory->state->started.load() == 1; }));
+
+  pool.Enqueue(key, [&](const ChunkKey&, const std::shared_ptr<gated_chunk>& chunk) { chunks[1] = chunk; ready++; });
+  CHUNKER_CHECK(WaitFor([&] { return pool.Stats().deduped == 1; }));
+
+  factory->state->open = true;
+  pool.Wait();
+
+  GenerationStats stats = pool.Stats();
+  CHUNKER_CHECK(ready.load() == 2);
+  CHUNKER_CHECK(stats.generated == 1);
+  CHUNKER_CHECK(factory->state->started.load() == 1);
+  CHUNKER_CHECK(chunks[0] != nullptr && chunks[0] == chunks[1]);
+}
+
+// a foreground chunk attached to a prefetch in flight - Wait() covers it, rather than returning before it's cached
+CHUNKER_TEST(pool_waits_on_attached_prefetch) {
+  auto factory = std::make_shared<gated_factory>();
+  TypedChunkThreadPool<gated_factory, gated_gen, gated_chunk> pool(2, factory);
+  ChunkKey key = MakeKey(64);
+
+  pool.Prefetch({ key });
+  CHUNKER_CHECK(WaitFor([&] { return factory->state->started.load() == 1; }));
+
+  pool.Enqueue(key);
+  CHUNKER_CHECK(WaitFor([&] { return pool.Stats().deduped == 1; }));
+
+  std::future<void> waited = std::async(std::launch::async, [&] { pool.Wait(); });
+  CHUNKER_CHECK(waited.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+  factory->state->open = true;
+  waited.get();
+  CHUNKER_CHECK(pool.HasChunk(key));
+  CHUNKER_CHECK(pool.Stats().generated == 1);
+}
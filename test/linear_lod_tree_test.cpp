@@ -0,0 +1,147 @@
+#include "test.hpp"
+
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+#include "chunker/util/DyadicScale.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace chunker::lod;
+
+namespace {
+  const int TREE_SIZE = 1024;
+  const int MIN_CHUNK_SIZE = 16;
+
+  // closed rects touch - shared edge or corner counts
+  bool Borders(const LinearLodTree& tree, uint64_t a, uint64_t b) {
+    glm::ivec2 a_origin = tree.LeafOrigin(a);
+    glm::ivec2 b_origin = tree.LeafOrigin(b);
+    long a_size = static_cast<long>(tree.LeafSize(a));
+    long b_size = static_cast<long>(tree.LeafSize(b));
+    return (a_origin.x <= b_origin.x + b_size && b_origin.x <= a_origin.x + a_size
+      && a_origin.y <= b_origin.y + b_size && b_origin.y <= a_origin.y + a_size);
+  }
+
+  // what Diff should come up w, the slow way
+  LodTreeDiff BruteForceDiff(const LinearLodTree& old_tree, const LinearLodTree& new_tree) {
+    LodTreeDiff res;
+    for (uint64_t leaf : new_tree.Leaves()) {
+      if (!old_tree.ContainsLeaf(leaf)) {
+        res.added.push_back(leaf);
+      }
+    }
+
+    for (uint64_t leaf : old_tree.Leaves()) {
+      if (!new_tree.ContainsLeaf(leaf)) {
+        res.removed.push_back(leaf);
+      }
+    }
+
+    for (uint64_t leaf : new_tree.Leaves()) {
+      if (!old_tree.ContainsLeaf(leaf)) {
+        continue;
+      }
+
+      for (uint64_t added : res.added) {
+        if (Borders(new_tree, leaf, added)) {
+          res.touched.push_back(leaf);
+          break;
+        }
+      }
+    }
+
+    return res;
+  }
+}
+
+// diff between trees along a walk matches a brute force diff - including touched leaves along the tree's edges
+CHUNKER_TEST(linear_lod_tree_diff_matches_brute_force) {
+  for (double cascade_factor : { 1.0, 2.0, 4.0 }) {
+    LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+    gen.cascade_factor = cascade_factor;
+
+    LinearLodTree last;
+    LinearLodTree current;
+    glm::vec3 position(TREE_SIZE * 0.5f, 0.0f, TREE_SIZE * 0.5f);
+    for (int i = 0; i < 64; i++) {
+      // jittery walk, w a few big jumps - some steps change nothing, some change most of the tree
+      position.x += static_cast<float>((i * 37) % 23) - 11.0f + (i % 16 == 15 ? 300.0f : 0.0f);
+      position.z += static_cast<float>((i * 53) % 19) - 9.0f;
+      position.x = std::min(std::max(position.x, 1.0f), TREE_SIZE - 1.0f);
+      position.z = std::min(std::max(position.z, 1.0f), TREE_SIZE - 1.0f);
+      current.Build(gen.CreateLodTree(position, 3), TREE_SIZE);
+      if (i > 0) {
+        LodTreeDiff diff;
+        LinearLodTree::Diff(last, current, &diff);
+        LodTreeDiff expected = BruteForceDiff(last, current);
+        CHUNKER_CHECK(diff.added == expected.added);
+        CHUNKER_CHECK(diff.removed == expected.removed);
+        CHUNKER_CHECK(diff.touched == expected.touched);
+      }
+
+      std::swap(last, current);
+    }
+  }
+}
+
+// identical trees diff to nothing
+CHUNKER_TEST(linear_lod_tree_diff_identical) {
+  LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  gen.cascade_factor = 2.0;
+  LinearLodTree a(gen.CreateLodTree(glm::vec3(300.0f, 0.0f, 700.0f), 3), TREE_SIZE);
+  LinearLodTree b(gen.CreateLodTree(glm::vec3(300.0f, 0.0f, 700.0f), 3), TREE_SIZE);
+
+  LodTreeDiff diff;
+  LinearLodTree::Diff(a, b, &diff);
+  CHUNKER_CHECK(a == b);
+  CHUNKER_CHECK(diff.added.empty());
+  CHUNKER_CHECK(diff.removed.empty());
+  CHUNKER_CHECK(diff.touched.empty());
+}
+
+// size and step lookups agree w walking the lod_node tree - across a grid, on every cell boundary, and just past the tree's edges
+CHUNKER_TEST(linear_lod_tree_lookups_match_nodes) {
+  // offsets around each grid line - boundaries go to the lower cell, so both sides matter
+  const float nudges[] = { -0.5f, -0.25f, 0.0f, 0.25f, 0.5f };
+  std::vector<float> coords;
+  for (int line = 0; line <= TREE_SIZE; line += MIN_CHUNK_SIZE / 2) {
+    for (float nudge : nudges) {
+      coords.push_back(static_cast<float>(line) + nudge);
+    }
+  }
+
+  // off the tree entirely
+  for (float outside : { -40.0f, -3.0f, TREE_SIZE + 3.0f, TREE_SIZE + 40.0f }) {
+    coords.push_back(outside);
+  }
+
+  chunker::util::DyadicScale base_step(TREE_SIZE, MIN_CHUNK_SIZE);
+  LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  for (double cascade_factor : { 1.0, 2.0, 4.0 }) {
+    gen.cascade_factor = cascade_factor;
+    for (glm::vec3 position : { glm::vec3(512.0f, 0.0f, 512.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1000.0f, 0.0f, 37.0f), glm::vec3(-600.0f, 0.0f, 300.0f) }) {
+      for (int force_divide : { 0, 3 }) {
+        const lod_node* nodes = gen.CreateLodTree(position, force_divide);
+        LinearLodTree tree(nodes, TREE_SIZE);
+
+        size_t size_mismatches = 0;
+        size_t step_mismatches = 0;
+        for (float x : coords) {
+          for (float y : coords) {
+            glm::vec2 sample(x, y);
+            size_t size = lod_node::GetChunkSize(nodes, TREE_SIZE, sample);
+            size_mismatches += (tree.GetChunkSize(sample) != size ? 1 : 0);
+            step_mismatches += (tree.GetChunkStep(base_step, sample) != lod_node::GetChunkStep(nodes, base_step, TREE_SIZE, sample) ? 1 : 0);
+          }
+        }
+
+        CHUNKER_CHECK(size_mismatches == 0);
+        CHUNKER_CHECK(step_mismatches == 0);
+      }
+    }
+  }
+}
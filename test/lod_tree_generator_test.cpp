@@ -0,0 +1,324 @@
+#include "test.hpp"
+
+#include "chunker/lod/LinearLodTree.hpp"
+#include "chunker/lod/LodNodeArena.hpp"
+#include "chunker/lod/LodTreeGenerator.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace chunker::lod;
+
+namespace {
+  const int TREE_SIZE = 4096;
+  const int MIN_CHUNK_SIZE = 16;
+  const int FORCE_DIVIDE = 3;
+
+  LinearLodTree FreshTree(float x, float z) {
+    LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+    gen.cascade_factor = 2.0;
+    return LinearLodTree(gen.CreateLodTree(glm::vec3(x, 0.0f, z), FORCE_DIVIDE), TREE_SIZE);
+  }
+
+  // builds trees from the last one, as ChunkManager does
+  struct hysteresis_walk {
+    LodTreeGenerator gen;
+    const lod_node* last = nullptr;
+
+    explicit hysteresis_walk(double hysteresis) : gen(TREE_SIZE, MIN_CHUNK_SIZE) {
+      gen.cascade_factor = 2.0;
+      gen.hysteresis = hysteresis;
+    }
+
+    LinearLodTree Step(float x, float z) {
+      lod_node* tree = gen.CreateLodTree(glm::vec3(x, 0.0f, z), FORCE_DIVIDE, last);
+      gen.RetainTree();
+      last = tree;
+      return LinearLodTree(tree, TREE_SIZE);
+    }
+  };
+
+  // true if every leaf of fine sits inside a leaf of coarse - fine splits everything coarse does, maybe more
+  bool AtLeastAsFine(const LinearLodTree& fine, const LinearLodTree& coarse) {
+    for (uint64_t leaf : fine.Leaves()) {
+      glm::ivec2 origin = fine.LeafOrigin(leaf);
+      long size = static_cast<long>(fine.LeafSize(leaf));
+      bool covered = false;
+      for (uint64_t outer : coarse.Leaves()) {
+        glm::ivec2 outer_origin = coarse.LeafOrigin(outer);
+        long outer_size = static_cast<long>(coarse.LeafSize(outer));
+        if (outer_origin.x <= origin.x && outer_origin.y <= origin.y
+          && origin.x + size <= outer_origin.x + outer_size && origin.y + size <= outer_origin.y + outer_size) {
+          covered = true;
+          break;
+        }
+      }
+
+      if (!covered) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // every node reachable from tree
+  void CollectNodes(const lod_node* tree, std::set<const lod_node*>* output) {
+    if (tree == nullptr) {
+      return;
+    }
+
+    output->insert(tree);
+    for (const lod_node* child : { tree->tl, tree->tr, tree->bl, tree->br }) {
+      CollectNodes(child, output);
+    }
+  }
+}
+
+// a viewer jittering across a split threshold - by as little as a float allows
+CHUNKER_TEST(hysteresis_holds_at_threshold_boundary) {
+  const float z = 2100.0f;
+
+  // walk until the bare tree changes, then bisect down to neighboring floats on either side of the threshold
+  float lo = 2000.0f;
+  LinearLodTree lo_tree = FreshTree(lo, z);
+  float hi = lo;
+  while (FreshTree(hi, z) == lo_tree) {
+    lo = hi;
+    hi += 1.0f;
+  }
+
+  while (true) {
+    float mid = lo + (hi - lo) * 0.5f;
+    if (mid == lo || mid == hi) {
+      break;
+    }
+
+    (FreshTree(mid, z) == lo_tree ? lo : hi) = mid;
+  }
+
+  CHUNKER_CHECK(FreshTree(lo, z) != FreshTree(hi, z));
+
+  for (double hysteresis : { 0.0, 0.1, 0.5 }) {
+    hysteresis_walk walk(hysteresis);
+    LinearLodTree last = walk.Step(lo, z);
+    int flips = 0;
+    bool fine_enough = true;
+    for (int i = 1; i < 100; i++) {
+      float x = (i % 2 == 0 ? lo : hi);
+      LinearLodTree tree = walk.Step(x, z);
+      flips += (tree != last ? 1 : 0);
+      fine_enough = fine_enough && AtLeastAsFine(tree, FreshTree(x, z));
+      last = tree;
+    }
+
+    if (hysteresis == 0.0) {
+      // on the boundary - w/o hysteresis, every step flips
+      CHUNKER_CHECK(flips == 99);
+    } else {
+      // splits once, at most, then holds
+      CHUNKER_CHECK(flips <= 1);
+    }
+
+    CHUNKER_CHECK(fine_enough);
+  }
+}
+
+// hysteresis only ever keeps nodes split - never coarser than the bare thresholds, and the same tree w/o it
+CHUNKER_TEST(hysteresis_never_coarser_than_thresholds) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> jitter(-6.0f, 6.0f);
+  hysteresis_walk none(0.0);
+  hysteresis_walk some(0.3);
+
+  bool same_without = true;
+  bool fine_enough = true;
+  int flips_none = 0;
+  int flips_some = 0;
+  LinearLodTree last_none;
+  LinearLodTree last_some;
+  for (int i = 0; i < 400; i++) {
+    float x = 2000.0f + static_cast<float>(i / 40) * 37.0f + jitter(rng);
+    float z = 2100.0f + static_cast<float>(i / 40) * 23.0f + jitter(rng);
+    LinearLodTree fresh = FreshTree(x, z);
+    LinearLodTree tree_none = none.Step(x, z);
+    LinearLodTree tree_some = some.Step(x, z);
+
+    same_without = same_without && (tree_none == fresh);
+    fine_enough = fine_enough && AtLeastAsFine(tree_some, fresh);
+    if (i != 0) {
+      flips_none += (tree_none != last_none ? 1 : 0);
+      flips_some += (tree_some != last_some ? 1 : 0);
+    }
+
+    last_none = tree_none;
+    last_some = tree_some;
+  }
+
+  CHUNKER_CHECK(same_without);
+  CHUNKER_CHECK(fine_enough);
+  CHUNKER_CHECK(flips_some < flips_none);
+}
+
+// splitting the build across tasks leaves the tree exactly as a serial build would have it
+CHUNKER_TEST(parallel_tree_matches_serial) {
+  LodTreeGenerator serial(TREE_SIZE, MIN_CHUNK_SIZE);
+  serial.cascade_factor = 2.0;
+
+  bool same_nodes = true;
+  bool same_leaves = true;
+  bool same_count = true;
+  for (int levels : { 1, 2, 4 }) {
+    // split into tbb tasks below levels, whatever the tree's size
+    LodTreeGenerator parallel(TREE_SIZE, MIN_CHUNK_SIZE);
+    parallel.cascade_factor = 2.0;
+    parallel.parallel_levels = levels;
+    parallel.parallel_min_nodes = 0;
+    for (int force_divide : { 0, 2, 3, 5 }) {
+      for (glm::vec3 position : { glm::vec3(2048.0f, 0.0f, 2048.0f), glm::vec3(1.0f, 0.0f, 4090.0f), glm::vec3(1500.5f, 0.0f, 2700.25f), glm::vec3(3071.0f, 0.0f, 1024.0f) }) {
+        lod_node* expected = serial.CreateLodTree(position, force_divide);
+        lod_node* tree = parallel.CreateLodTree(position, force_divide);
+        same_nodes = same_nodes && lod_node::CompareTrees(expected, tree);
+        same_leaves = same_leaves && (LinearLodTree(expected, TREE_SIZE) == LinearLodTree(tree, TREE_SIZE));
+        same_count = same_count && parallel.LastNodeCount() == serial.LastNodeCount() && parallel.LastNodeCount() > 1;
+      }
+    }
+  }
+
+  CHUNKER_CHECK(same_nodes);
+  CHUNKER_CHECK(same_leaves);
+  CHUNKER_CHECK(same_count);
+}
+
+// reset hands back the same blocks - no new heap blocks, and every node comes out w/o children, whatever it held before
+CHUNKER_TEST(lod_node_arena_recycles_blocks) {
+  const size_t count = 3 * LodNodeArena::BLOCK_SIZE + 7;
+  LodNodeArena arena;
+  std::set<lod_node*> first;
+  for (size_t i = 0; i < count; i++) {
+    lod_node* node = arena.Alloc();
+    first.insert(node);
+
+    // leave junk behind for the next round
+    node->tl = node;
+    node->br = node;
+  }
+
+  CHUNKER_CHECK(first.size() == count);
+  CHUNKER_CHECK(arena.Size() == count);
+  CHUNKER_CHECK(arena.BlockCount() == 4);
+
+  arena.Reset();
+  CHUNKER_CHECK(arena.Size() == 0);
+
+  std::set<lod_node*> second;
+  bool no_children = true;
+  for (size_t i = 0; i < count; i++) {
+    lod_node* node = arena.Alloc();
+    second.insert(node);
+    no_children = no_children && node->tl == nullptr && node->tr == nullptr && node->bl == nullptr && node->br == nullptr;
+  }
+
+  CHUNKER_CHECK(no_children);
+  CHUNKER_CHECK(second == first);
+  CHUNKER_CHECK(arena.BlockCount() == 4);
+}
+
+// a generator reusing its arenas along a walk builds the same trees as a fresh one at each stop. a retained tree
+// outlives the next two builds intact - neither build writes into it, or hands out its nodes
+CHUNKER_TEST(lod_tree_generator_reuse_matches_fresh) {
+  for (int levels : { 0, 2 }) {
+    LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+    gen.cascade_factor = 2.0;
+    gen.parallel_levels = levels;
+    gen.parallel_min_nodes = 0;
+
+    const lod_node* retained = nullptr;
+    LinearLodTree retained_snapshot;
+    bool matches_fresh = true;
+    bool retained_intact = true;
+    bool disjoint = true;
+    glm::vec3 position(2048.0f, 0.0f, 2048.0f);
+    for (int i = 0; i < 48; i++) {
+      // wanders, w the odd jump across the tree
+      position.x += static_cast<float>((i * 37) % 29) * 9.0f - 120.0f + (i % 12 == 11 ? 1500.0f : 0.0f);
+      position.z += static_cast<float>((i * 53) % 23) * 11.0f - 110.0f;
+      position.x = std::fmod(position.x + TREE_SIZE, static_cast<float>(TREE_SIZE));
+      position.z = std::fmod(position.z + TREE_SIZE, static_cast<float>(TREE_SIZE));
+
+      lod_node* tree = gen.CreateLodTree(position, FORCE_DIVIDE, retained);
+
+      LodTreeGenerator fresh(TREE_SIZE, MIN_CHUNK_SIZE);
+      fresh.cascade_factor = 2.0;
+      matches_fresh = matches_fresh && lod_node::CompareTrees(fresh.CreateLodTree(position, FORCE_DIVIDE), tree);
+
+      if (retained != nullptr) {
+        std::set<const lod_node*> retained_nodes;
+        std::set<const lod_node*> tree_nodes;
+        CollectNodes(retained, &retained_nodes);
+        CollectNodes(tree, &tree_nodes);
+        for (const lod_node* node : tree_nodes) {
+          disjoint = disjoint && retained_nodes.count(node) == 0;
+        }
+
+        retained_intact = retained_intact && (LinearLodTree(retained, TREE_SIZE) == retained_snapshot);
+      }
+
+      // retain every third tree - the two builds in between both run while it's held
+      if (i % 3 == 0) {
+        gen.RetainTree();
+        retained = tree;
+        retained_snapshot = LinearLodTree(tree, TREE_SIZE);
+      }
+    }
+
+    CHUNKER_CHECK(matches_fresh);
+    CHUNKER_CHECK(retained_intact);
+    CHUNKER_CHECK(disjoint);
+  }
+}
+
+// a tree for several viewers splits wherever any of them would on its own - at every point, its leaf is the finest of theirs
+CHUNKER_TEST(union_tree_is_finest_of_each_viewer) {
+  LodTreeGenerator gen(TREE_SIZE, MIN_CHUNK_SIZE);
+  gen.cascade_factor = 2.0;
+
+  std::vector<std::vector<glm::vec3>> viewer_sets = {
+    { glm::vec3(1000.0f, 0.0f, 1200.0f), glm::vec3(1300.0f, 0.0f, 900.0f) },
+    { glm::vec3(2048.0f, 0.0f, 2048.0f), glm::vec3(2050.0f, 0.0f, 2047.0f) },
+    { glm::vec3(100.0f, 0.0f, 4000.0f), glm::vec3(3900.0f, 0.0f, 300.0f), glm::vec3(2000.0f, 0.0f, 2100.0f) }
+  };
+
+  bool finest = true;
+  bool differs = false;
+  for (auto& viewers : viewer_sets) {
+    LinearLodTree tree(gen.CreateLodTree(viewers, FORCE_DIVIDE), TREE_SIZE);
+    std::vector<LinearLodTree> singles;
+    for (auto& viewer : viewers) {
+      singles.emplace_back(gen.CreateLodTree(viewer, FORCE_DIVIDE), TREE_SIZE);
+    }
+
+    for (float x = 4.5f; x < TREE_SIZE; x += 24.0f) {
+      for (float y = 4.5f; y < TREE_SIZE; y += 24.0f) {
+        glm::vec2 sample(x, y);
+        size_t expected = SIZE_MAX;
+        for (auto& single : singles) {
+          expected = std::min(expected, single.GetChunkSize(sample));
+        }
+
+        size_t size = tree.GetChunkSize(sample);
+        finest = finest && size == expected;
+        differs = differs || size != singles[0].GetChunkSize(sample);
+      }
+    }
+  }
+
+  CHUNKER_CHECK(finest);
+  CHUNKER_CHECK(differs);
+}
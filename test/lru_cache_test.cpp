@@ -0,0 +1,258 @@
+#include "test.hpp"
+
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/LRUCache.hpp"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  // few distinct hashes - every key lands in one of a handful of long probe runs
+  struct collide_key {
+    uint32_t value;
+
+    bool operator==(const collide_key& rhs) const {
+      return value == rhs.value;
+    }
+  };
+}
+
+namespace std {
+  template <>
+  struct hash<collide_key> {
+    size_t operator()(const collide_key& key) const {
+      return key.value % 3;
+    }
+  };
+}
+
+namespace {
+  // cost is the value itself
+  struct value_cost {
+    size_t operator()(size_t value) const {
+      return value;
+    }
+  };
+
+  // what LRUCache should do, w a list. entries are (key, (value, cost))
+  template <typename KeyType>
+  class ModelLRU {
+  public:
+    explicit ModelLRU(size_t capacity) : capacity_(capacity), usage_(0) {}
+
+    bool Fetch(const KeyType& key, size_t* output) {
+      auto itr = Find(key);
+      if (itr == order_.end()) {
+        return false;
+      }
+
+      order_.splice(order_.begin(), order_, itr);
+      *output = itr->second.first;
+      return true;
+    }
+
+    // returns evicted keys, least recent first
+    std::vector<KeyType> Put(const KeyType& key, size_t value, size_t cost) {
+      auto itr = Find(key);
+      if (itr != order_.end()) {
+        usage_ -= itr->second.second;
+        order_.erase(itr);
+      }
+
+      order_.emplace_front(key, std::make_pair(value, cost));
+      usage_ += cost;
+
+      std::vector<KeyType> evicted;
+      while (usage_ > capacity_ && order_.size() > 1) {
+        evicted.push_back(order_.back().first);
+        usage_ -= order_.back().second.second;
+        order_.pop_back();
+      }
+
+      return evicted;
+    }
+
+    size_t Usage() const { return usage_; }
+    size_t Size() const { return order_.size(); }
+
+  private:
+    typename std::list<std::pair<KeyType, std::pair<size_t, size_t>>>::iterator Find(const KeyType& key) {
+      for (auto itr = order_.begin(); itr != order_.end(); itr++) {
+        if (itr->first == key) {
+          return itr;
+        }
+      }
+
+      return order_.end();
+    }
+
+    std::list<std::pair<KeyType, std::pair<size_t, size_t>>> order_;
+    size_t capacity_;
+    size_t usage_;
+  };
+
+  struct sized_chunk {
+    size_t bytes;
+
+    size_t ByteSize() const {
+      return bytes;
+    }
+  };
+
+  struct plain_chunk {
+    long x;
+  };
+
+  struct sized_gen {
+    std::shared_ptr<sized_chunk> Generate(const ChunkIdentifier&) {
+      return std::make_shared<sized_chunk>(sized_chunk { 1000 });
+    }
+  };
+
+  struct sized_factory {
+    std::shared_ptr<sized_gen> Create() {
+      return std::make_shared<sized_gen>();
+    }
+  };
+}
+
+// chunks w/o a ByteSize are counted, rather than charged a sizeof which misses what they own
+static_assert(ChunkCache<plain_chunk>::COUNTS_ENTRIES, "chunk w/o ByteSize should be cached by count");
+static_assert(!ChunkCache<sized_chunk>::COUNTS_ENTRIES, "chunk w ByteSize should be cached by bytes");
+
+// randomized puts + fetches over colliding keys, so evictions keep punching holes in long probe runs
+CHUNKER_TEST(lru_cache_backward_shift_matches_model) {
+  const size_t capacity = 40;
+  util::LRUCache<collide_key, size_t> cache(capacity);
+  ModelLRU<collide_key> model(capacity);
+
+  uint32_t seed = 12345;
+  bool ok = true;
+  for (int i = 0; i < 20000; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    collide_key key { (seed >> 8) % 97 };
+    if ((seed & 3) == 0) {
+      size_t expected = 0;
+      size_t found = 0;
+      bool model_hit = model.Fetch(key, &expected);
+      bool hit = cache.Fetch(key, &found);
+      ok = ok && (hit == model_hit) && (!hit || found == expected);
+    } else {
+      cache.Put(key, i);
+      model.Put(key, i, 1);
+    }
+  }
+
+  CHUNKER_CHECK(ok);
+  CHUNKER_CHECK(cache.Size() == model.Size());
+
+  // every key still cached is reachable, and nothing else is
+  size_t reachable = 0;
+  for (uint32_t value = 0; value < 97; value++) {
+    reachable += (cache.Has(collide_key { value }) ? 1 : 0);
+  }
+
+  CHUNKER_CHECK(reachable == cache.Size());
+}
+
+CHUNKER_TEST(lru_cache_budget_evicts_least_recent) {
+  util::LRUCache<int, size_t, value_cost> cache(100);
+  ModelLRU<int> model(100);
+
+  uint32_t seed = 777;
+  bool ok = true;
+  for (int i = 0; i < 5000; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    int key = static_cast<int>((seed >> 8) % 50);
+    size_t cost = 1 + (seed >> 20) % 30;
+    if ((seed & 7) == 0) {
+      size_t expected = 0;
+      size_t found = 0;
+      ok = ok && (cache.Fetch(key, &found) == model.Fetch(key, &expected)) && found == expected;
+      continue;
+    }
+
+    util::LRUCache<int, size_t, value_cost>::EvictList evicted;
+    cache.Put(key, cost, &evicted);
+    std::vector<int> expected = model.Put(key, cost, cost);
+    ok = ok && evicted.size() == expected.size();
+    for (size_t e = 0; ok && e < evicted.size(); e++) {
+      ok = (evicted[e].first == expected[e]);
+    }
+
+    ok = ok && cache.Usage() == model.Usage() && cache.Usage() <= 100;
+  }
+
+  CHUNKER_CHECK(ok);
+  CHUNKER_CHECK(cache.HighWaterMark() <= 100 + 30);
+
+  // a put over the whole budget is still kept, alone
+  cache.Put(1000, 500);
+  CHUNKER_CHECK(cache.Has(1000));
+  CHUNKER_CHECK(cache.Size() == 1);
+  CHUNKER_CHECK(cache.Usage() == 500);
+
+  size_t replaced = 0;
+  CHUNKER_CHECK(cache.Put(1000, 20, &replaced) == util::OVERWRITE);
+  CHUNKER_CHECK(replaced == 500);
+  CHUNKER_CHECK(cache.Usage() == 20);
+
+  // the entry floor wins over the budget
+  cache.ReserveEntries(8);
+  for (int key = 0; key < 8; key++) {
+    cache.Put(key, 50);
+  }
+
+  CHUNKER_CHECK(cache.Size() == 8);
+  CHUNKER_CHECK(cache.Usage() == 400);
+  cache.Put(8, 50);
+  CHUNKER_CHECK(cache.Size() == 8);
+  CHUNKER_CHECK(!cache.Has(0));
+
+  // a lower floor hands the budget back - the next put evicts down to it
+  cache.ReserveEntries(1);
+  cache.Put(9, 50);
+  CHUNKER_CHECK(cache.Size() == 2);
+  CHUNKER_CHECK(cache.Usage() == 100);
+}
+
+CHUNKER_TEST(pool_reserve_keeps_chunks_past_byte_budget) {
+  TypedChunkThreadPool<sized_factory, sized_gen, sized_chunk> pool(2, std::make_shared<sized_factory>(), 4000);
+  for (long i = 0; i < 4; i++) {
+    pool.Enqueue(ChunkIdentifier(i * 16, 0, 16, 16, ChunkNeighbors()));
+  }
+
+  pool.Wait();
+  CHUNKER_CHECK(pool.CacheUsage() == 4000);
+
+  // budget stays put - the cache just won't evict below 20 chunks while they're reserved
+  pool.Reserve(20);
+
+  for (long i = 4; i < 20; i++) {
+    pool.Enqueue(ChunkIdentifier(i * 16, 0, 16, 16, ChunkNeighbors()));
+  }
+
+  pool.Wait();
+  bool all_cached = true;
+  for (long i = 0; i < 20; i++) {
+    all_cached = all_cached && pool.HasChunk(ChunkKey(ChunkIdentifier(i * 16, 0, 16, 16, ChunkNeighbors())));
+  }
+
+  CHUNKER_CHECK(all_cached);
+  CHUNKER_CHECK(pool.CacheUsage() == 20000);
+
+  // a smaller reservation later on lets the cache fall back under budget
+  pool.Reserve(1);
+  pool.Enqueue(ChunkIdentifier(20 * 16, 0, 16, 16, ChunkNeighbors()));
+  pool.Wait();
+  CHUNKER_CHECK(pool.CacheUsage() <= pool.CacheBudget());
+  CHUNKER_CHECK(pool.CacheUsage() == 4000);
+  CHUNKER_CHECK(pool.HasChunk(ChunkKey(ChunkIdentifier(20 * 16, 0, 16, 16, ChunkNeighbors()))));
+}
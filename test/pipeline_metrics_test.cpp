@@ -0,0 +1,155 @@
+#include "test.hpp"
+
+#include "chunker/ChunkManager.hpp"
+#include "chunker/PipelineMetrics.hpp"
+#include "chunker/TypedChunkThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  // no ByteSize - the cache counts chunks
+  struct count_chunk {
+    long x;
+  };
+
+  struct count_gen {
+    std::shared_ptr<count_chunk> Generate(const ChunkIdentifier& identifier) {
+      return std::make_shared<count_chunk>(count_chunk { identifier.x });
+    }
+  };
+
+  struct count_factory {
+    std::shared_ptr<count_gen> Create() {
+      return std::make_shared<count_gen>();
+    }
+  };
+
+  typedef TypedChunkThreadPool<count_factory, count_gen, count_chunk> Pool;
+  typedef ChunkManager<count_factory, count_gen, count_chunk> Manager;
+
+  // count keys of one size, in a row
+  std::vector<ChunkKey> Row(long y, size_t size, long count) {
+    std::vector<ChunkKey> res;
+    for (long i = 0; i < count; i++) {
+      res.push_back(ChunkKey(ChunkIdentifier(i * static_cast<long>(size), y, size, size, ChunkNeighbors())));
+    }
+
+    return res;
+  }
+
+  const LodLatency* FindLod(const PipelineMetrics& metrics, size_t size) {
+    for (auto& lod : metrics.lods) {
+      if (lod.size == size) {
+        return &lod;
+      }
+    }
+
+    return nullptr;
+  }
+
+  uint64_t WorkerTasks(const PipelineMetrics& metrics) {
+    uint64_t res = 0;
+    for (auto& worker : metrics.workers) {
+      res += worker.tasks;
+    }
+
+    return res;
+  }
+}
+
+// counters add up to exactly what a scripted workload did - generations, hits, evictions and per-lod samples
+CHUNKER_TEST(pipeline_metrics_match_workload) {
+  // room for 40 chunks
+  Pool pool(2, std::make_shared<count_factory>(), 40);
+  std::vector<ChunkKey> small = Row(0, 16, 16);
+  std::vector<ChunkKey> large = Row(1024, 32, 16);
+
+  // 32 new chunks, at two sizes
+  pool.EnqueueBulk(small);
+  pool.EnqueueBulk(large);
+  pool.Wait();
+
+  PipelineMetrics metrics = pool.Metrics();
+  const LodLatency* lod_16 = FindLod(metrics, 16);
+  const LodLatency* lod_32 = FindLod(metrics, 32);
+  CHUNKER_CHECK(metrics.generation.generated == 32);
+  CHUNKER_CHECK(metrics.generation.cache_hits == 0);
+  CHUNKER_CHECK(metrics.generation.Cancelled() == 0);
+  CHUNKER_CHECK(metrics.cache.misses == 32);
+  CHUNKER_CHECK(metrics.cache.hits == 0);
+  CHUNKER_CHECK(metrics.cache.inserts == 32);
+  CHUNKER_CHECK(metrics.cache.evictions == 0);
+  CHUNKER_CHECK(metrics.queue_depth == 0);
+  CHUNKER_CHECK(metrics.prefetch_depth == 0);
+  CHUNKER_CHECK(metrics.lods.size() == 2);
+  CHUNKER_CHECK(lod_16 != nullptr && lod_16->queued.count == 16 && lod_16->running.count == 16);
+  CHUNKER_CHECK(lod_32 != nullptr && lod_32->queued.count == 16 && lod_32->running.count == 16);
+  CHUNKER_CHECK(metrics.workers.size() == 2);
+  CHUNKER_CHECK(WorkerTasks(metrics) == 32);
+
+  // the same 32 again - all cache hits, which queue but don't run
+  pool.EnqueueBulk(small);
+  pool.EnqueueBulk(large);
+  pool.Wait();
+
+  metrics = pool.Metrics();
+  lod_16 = FindLod(metrics, 16);
+  CHUNKER_CHECK(metrics.generation.generated == 32);
+  CHUNKER_CHECK(metrics.generation.cache_hits == 32);
+  CHUNKER_CHECK(metrics.cache.hits == 32);
+  CHUNKER_CHECK(metrics.cache.misses == 32);
+  CHUNKER_CHECK(metrics.cache.inserts == 32);
+  CHUNKER_CHECK(lod_16 != nullptr && lod_16->queued.count == 32 && lod_16->running.count == 16);
+  CHUNKER_CHECK(WorkerTasks(metrics) == 64);
+
+  // lookups from outside count too - 10 cached, 5 not
+  for (int i = 0; i < 10; i++) {
+    pool.GetChunk(small[i]);
+  }
+
+  for (auto& key : Row(-1024, 16, 5)) {
+    pool.GetChunk(key);
+  }
+
+  metrics = pool.Metrics();
+  CHUNKER_CHECK(metrics.cache.hits == 42);
+  CHUNKER_CHECK(metrics.cache.misses == 37);
+
+  // 16 more - 48 won't fit in 40, so the last 8 puts each evict one
+  pool.EnqueueBulk(Row(2048, 64, 16));
+  pool.Wait();
+
+  metrics = pool.Metrics();
+  CHUNKER_CHECK(metrics.generation.generated == 48);
+  CHUNKER_CHECK(metrics.cache.inserts == 48);
+  CHUNKER_CHECK(metrics.cache.evictions == 8);
+  CHUNKER_CHECK(metrics.cache.overwrites == 0);
+  CHUNKER_CHECK(metrics.lods.size() == 3);
+  CHUNKER_CHECK(pool.CacheUsage() == 40);
+  CHUNKER_CHECK(WorkerTasks(metrics) == 80);
+}
+
+// one tree build and one diff per update, whether or not the tree changed
+CHUNKER_TEST(chunk_manager_metrics_count_updates) {
+  Manager manager(std::make_shared<count_factory>(), 2, 700.0, 16, 2.0);
+  const float steps[] = { 5.0f, 5.0f, 40.0f, 300.0f, 300.0f, 2000.0f };
+  for (float x : steps) {
+    manager.UpdateChunkData(glm::vec3(x, 0.0f, 5.0f));
+    manager.wait();
+  }
+
+  ChunkManagerMetrics metrics = manager.GetMetrics();
+  CHUNKER_CHECK(metrics.tree.updates == 6);
+  CHUNKER_CHECK(metrics.tree.build.count == 6);
+  CHUNKER_CHECK(metrics.tree.diff.count == 6);
+  CHUNKER_CHECK(metrics.pipeline.generation.generated == metrics.pipeline.cache.inserts);
+  CHUNKER_CHECK(metrics.pipeline.generation.generated >= manager.GetChunkCount());
+  CHUNKER_CHECK(WorkerTasks(metrics.pipeline) == metrics.pipeline.generation.generated + metrics.pipeline.generation.cache_hits
+    + metrics.pipeline.generation.deduped + metrics.pipeline.generation.Cancelled());
+}
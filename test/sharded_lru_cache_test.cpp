@@ -0,0 +1,177 @@
+#include "test.hpp"
+
+#include "chunker/util/Hash.hpp"
+#include "chunker/util/ShardedLRUCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  // cost is the value itself
+  struct value_cost {
+    size_t operator()(size_t value) const {
+      return value;
+    }
+  };
+
+  typedef util::ShardedLRUCache<size_t, size_t> Cache;
+  typedef util::ShardedLRUCache<size_t, size_t, 16, value_cost> CostCache;
+
+  // what each shard should hold, given the whole cache's capacity
+  size_t ExpectedShardCapacity(size_t capacity, size_t shards) {
+    double per_shard = static_cast<double>(capacity) / shards;
+    return static_cast<size_t>(std::ceil(per_shard + 3.0 * std::sqrt(per_shard))) + 1;
+  }
+
+  // the first count keys routed to shard, the way the cache routes them
+  std::vector<size_t> KeysInShard(size_t shard, size_t shards, size_t count) {
+    std::vector<size_t> res;
+    for (size_t key = 0; res.size() < count; key++) {
+      uint64_t hash = util::HashMix64(static_cast<uint64_t>(std::hash<size_t>()(key)));
+      if ((static_cast<size_t>(hash >> 32) & (shards - 1)) == shard) {
+        res.push_back(key);
+      }
+    }
+
+    return res;
+  }
+
+  // visits from itr to end, counting each key
+  template <typename Iter>
+  std::map<size_t, int> Visits(Iter itr, Iter end) {
+    std::map<size_t, int> res;
+    for (; itr != end; ++itr) {
+      res[itr.Key()]++;
+    }
+
+    return res;
+  }
+}
+
+// a working set of `capacity` uniformly hashed keys fits, even though each shard evicts on its own
+CHUNKER_TEST(sharded_lru_cache_holds_capacity_keys) {
+  for (size_t capacity : { 64, 256, 1000, 4096, 20000 }) {
+    Cache cache(capacity);
+    for (size_t key = 0; key < capacity; key++) {
+      cache.Put(key * 7919, key);
+    }
+
+    bool all_cached = true;
+    for (size_t key = 0; key < capacity; key++) {
+      size_t value = 0;
+      all_cached = all_cached && cache.Fetch(key * 7919, &value) && value == key;
+    }
+
+    CHUNKER_CHECK(all_cached);
+    CHUNKER_CHECK(cache.Size() == capacity);
+    CHUNKER_CHECK(cache.Capacity() == capacity);
+  }
+}
+
+// each shard holds ceil(c/N + 3*sqrt(c/N)) + 1 - one past that evicts the shard's least recent key, and only that
+CHUNKER_TEST(sharded_lru_cache_shard_capacity) {
+  for (size_t capacity : { 1, 16, 100, 1000 }) {
+    size_t per_shard = ExpectedShardCapacity(capacity, Cache::Shards());
+    std::vector<size_t> keys = KeysInShard(3, Cache::Shards(), per_shard + 1);
+
+    Cache cache(capacity);
+    for (size_t i = 0; i < per_shard; i++) {
+      cache.Put(keys[i], i);
+    }
+
+    CHUNKER_CHECK(cache.Size() == per_shard);
+
+    Cache::EvictList evicted;
+    CHUNKER_CHECK(cache.Put(keys[per_shard], per_shard, &evicted) == util::REMOVE_LAST);
+    CHUNKER_CHECK(evicted.size() == 1);
+    CHUNKER_CHECK(!evicted.empty() && evicted[0].first == keys[0] && evicted[0].second == 0);
+    CHUNKER_CHECK(cache.Size() == per_shard);
+    CHUNKER_CHECK(!cache.Has(keys[0]));
+
+    // overwriting evicts nothing
+    evicted.clear();
+    CHUNKER_CHECK(cache.Put(keys[per_shard], 5, &evicted) == util::OVERWRITE);
+    CHUNKER_CHECK(evicted.empty());
+  }
+}
+
+// begin() visits every entry exactly once, across shards. begin_bounded stops after max_length
+CHUNKER_TEST(sharded_lru_cache_iterates_every_entry) {
+  Cache cache(1000);
+  for (size_t count : { 0, 1, 37, 500 }) {
+    for (size_t key = 0; key < count; key++) {
+      cache.Put(key, key * 2);
+    }
+
+    std::map<size_t, int> visits = Visits(cache.begin(), cache.end());
+    bool once = (visits.size() == count);
+    for (auto& visit : visits) {
+      once = once && visit.first < count && visit.second == 1;
+    }
+
+    CHUNKER_CHECK(once);
+
+    // values come along w their keys
+    bool values_match = true;
+    for (auto itr = cache.begin(); itr != cache.end(); ++itr) {
+      values_match = values_match && (*itr == itr.Key() * 2);
+    }
+
+    CHUNKER_CHECK(values_match);
+
+    for (size_t bound : { static_cast<size_t>(0), count / 2, count, count + 5 }) {
+      std::map<size_t, int> bounded = Visits(cache.begin_bounded(static_cast<int>(bound)), cache.end());
+      bool distinct = true;
+      for (auto& visit : bounded) {
+        distinct = distinct && visit.second == 1;
+      }
+
+      CHUNKER_CHECK(distinct);
+      CHUNKER_CHECK(bounded.size() == std::min(bound, count));
+    }
+  }
+}
+
+// ReserveEntries reaches every shard, split like capacity - and lowering it lets each shard evict back to budget
+CHUNKER_TEST(sharded_lru_cache_reserve_entries) {
+  // 21 cost units per shard - two entries of cost 10
+  CostCache cache(160);
+  std::vector<size_t> keys = KeysInShard(5, CostCache::Shards(), 16);
+  size_t floor = ExpectedShardCapacity(64, CostCache::Shards());
+  CHUNKER_CHECK(floor == 11);
+
+  cache.ReserveEntries(64);
+  for (size_t i = 0; i < floor; i++) {
+    cache.Put(keys[i], 10);
+  }
+
+  CHUNKER_CHECK(cache.Size() == floor);
+  CHUNKER_CHECK(cache.Usage() == floor * 10);
+
+  // past the floor, back to evicting - down to the floor, not the budget
+  cache.Put(keys[floor], 10);
+  CHUNKER_CHECK(cache.Size() == floor);
+  CHUNKER_CHECK(!cache.Has(keys[0]));
+
+  // every shard got the floor, not just the one we filled
+  std::vector<size_t> other = KeysInShard(12, CostCache::Shards(), floor + 1);
+  for (size_t i = 0; i < floor; i++) {
+    cache.Put(other[i], 10);
+  }
+
+  CHUNKER_CHECK(cache.Size() == 2 * floor);
+
+  // a floor of 0 still rounds up to one entry per shard - the next put evicts each back under budget
+  cache.ReserveEntries(0);
+  cache.Put(keys[floor + 1], 10);
+  cache.Put(other[floor], 10);
+  CHUNKER_CHECK(cache.Size() == 4);
+  CHUNKER_CHECK(cache.Usage() == 40);
+}
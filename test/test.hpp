@@ -0,0 +1,55 @@
+#ifndef CHUNKER_TEST_H_
+#define CHUNKER_TEST_H_
+
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// tiny self-contained test harness, in the same vein as bench/bench.hpp - no external deps
+// tests register themselves w CHUNKER_TEST, and report failures through CHUNKER_CHECK
+
+namespace chunker {
+  namespace test {
+    class TestState {
+    public:
+      /**
+       * @brief records a failed check. returns ok, so checks can gate the rest of a test
+       */
+      bool Check(bool ok, const char* expr, const char* file, int line) {
+        checks_++;
+        if (!ok) {
+          failures_++;
+          std::fprintf(stderr, "  %s:%d: check failed: %s\n", file, line, expr);
+        }
+
+        return ok;
+      }
+
+      size_t Checks() const { return checks_; }
+      size_t Failures() const { return failures_; }
+    private:
+      size_t checks_ = 0;
+      size_t failures_ = 0;
+    };
+
+    typedef void (*TestFunc)(TestState&);
+
+    std::vector<std::pair<std::string, TestFunc>>& TestRegistry();
+
+    struct TestRegistrar {
+      TestRegistrar(const char* name, TestFunc func) {
+        TestRegistry().push_back(std::make_pair(std::string(name), func));
+      }
+    };
+  }
+}
+
+#define CHUNKER_TEST(name) \
+  static void name(::chunker::test::TestState& state); \
+  static ::chunker::test::TestRegistrar name##_registrar(#name, name); \
+  static void name(::chunker::test::TestState& state)
+
+#define CHUNKER_CHECK(expr) state.Check(static_cast<bool>(expr), #expr, __FILE__, __LINE__)
+
+#endif // CHUNKER_TEST_H_
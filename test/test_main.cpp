@@ -0,0 +1,43 @@
+#include "test.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace chunker {
+  namespace test {
+    std::vector<std::pair<std::string, TestFunc>>& TestRegistry() {
+      static std::vector<std::pair<std::string, TestFunc>> registry;
+      return registry;
+    }
+  }
+}
+
+// usage: chunker_test [filter]
+// runs every test whose name contains filter. exits nonzero if any check failed.
+int main(int argc, char** argv) {
+  using namespace chunker::test;
+  const char* filter = (argc > 1 ? argv[1] : nullptr);
+
+  size_t run = 0;
+  size_t failed = 0;
+  for (auto& test : TestRegistry()) {
+    if (filter != nullptr && std::strstr(test.first.c_str(), filter) == nullptr) {
+      continue;
+    }
+
+    TestState state;
+    test.second(state);
+    run++;
+    if (state.Failures() != 0) {
+      failed++;
+    }
+
+    std::printf("%-48s %s (%zu checks)\n", test.first.c_str(), (state.Failures() == 0 ? "ok" : "FAILED"), state.Checks());
+  }
+
+  std::printf("%zu tests, %zu failed\n", run, failed);
+  return (failed == 0 ? 0 : 1);
+}
@@ -0,0 +1,89 @@
+// the default build - off here even under `scons trace=1`, so this file always sees the macros compiled out. the pool's
+// instantiated w types of its own, so it can't pick up the traced copy from trace_test.cpp
+#undef CHUNKER_ENABLE_TRACE
+
+#include "test.hpp"
+
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace chunker;
+
+static_assert(!util::TRACE_ENABLED, "tracing should be off in this file");
+
+namespace {
+  struct untraced_chunk {
+    long x;
+  };
+
+  struct untraced_gen {
+    std::shared_ptr<untraced_chunk> Generate(const ChunkIdentifier& identifier) {
+      return std::make_shared<untraced_chunk>(untraced_chunk { identifier.x });
+    }
+  };
+
+  struct untraced_factory {
+    std::shared_ptr<untraced_gen> Create() {
+      return std::make_shared<untraced_gen>();
+    }
+  };
+
+  typedef TypedChunkThreadPool<untraced_factory, untraced_gen, untraced_chunk> Pool;
+
+  int evaluated = 0;
+
+  int64_t Touch() {
+    evaluated++;
+    return 0;
+  }
+
+  // anything in the dump but thread names - those stick around from threads named in traced builds
+  bool HasEvents(const std::string& dump) {
+    return dump.find("\"ph\":\"X\"") != std::string::npos || dump.find("\"ph\":\"i\"") != std::string::npos
+      || dump.find("\"ph\":\"b\"") != std::string::npos;
+  }
+}
+
+// w/o CHUNKER_ENABLE_TRACE the macros are no-ops - their args go unevaluated, and a whole pool workload records nothing
+CHUNKER_TEST(trace_compiled_out) {
+  util::TraceRecorder::Instance().Clear();
+  {
+    CHUNKER_TRACE_SCOPE("test", "scope");
+    CHUNKER_TRACE_SCOPE_ARGS("test", "scope_args", util::CountTraceArgs(Touch()));
+    CHUNKER_TRACE_SPAN("test", "span", Touch(), Touch(), util::CountTraceArgs(Touch()));
+    CHUNKER_TRACE_ASYNC("test", "async", Touch(), Touch(), util::CountTraceArgs(Touch()));
+    CHUNKER_TRACE_INSTANT("test", "instant", util::CountTraceArgs(Touch()));
+    CHUNKER_TRACE_THREAD_NAME("test", Touch());
+  }
+
+  CHUNKER_CHECK(evaluated == 0);
+
+  // and it would have counted them
+  Touch();
+  CHUNKER_CHECK(evaluated == 1);
+
+  {
+    Pool pool(2, std::make_shared<untraced_factory>(), 64);
+    std::vector<ChunkKey> keys;
+    for (long i = 0; i < 8; i++) {
+      keys.push_back(ChunkKey(ChunkIdentifier(i * 16, 0, 16, 16, ChunkNeighbors())));
+    }
+
+    pool.EnqueueBulk(keys);
+    pool.Wait();
+  }
+
+  std::ostringstream output;
+  util::TraceRecorder::Instance().WriteChromeJson(output);
+  CHUNKER_CHECK(!HasEvents(output.str()));
+
+  // still a valid, empty trace
+  CHUNKER_CHECK(output.str().compare(0, 16, "{\"traceEvents\":[") == 0);
+  CHUNKER_CHECK(output.str().find("\"dropped_events\":0}") != std::string::npos);
+}
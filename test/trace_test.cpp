@@ -0,0 +1,349 @@
+// the tracing half of the pool only exists w CHUNKER_ENABLE_TRACE - turned on here whatever the build says. the
+// pool's instantiated w types of its own, so nothing traced leaks into the other tests
+#ifndef CHUNKER_ENABLE_TRACE
+#define CHUNKER_ENABLE_TRACE
+#endif
+
+#include "test.hpp"
+
+#include "chunker/TypedChunkThreadPool.hpp"
+#include "chunker/util/Trace.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace chunker;
+
+static_assert(util::TRACE_ENABLED, "tracing should be on in this file");
+
+namespace {
+  struct traced_chunk {
+    long x;
+  };
+
+  struct traced_gen {
+    std::shared_ptr<traced_chunk> Generate(const ChunkIdentifier& identifier) {
+      return std::make_shared<traced_chunk>(traced_chunk { identifier.x });
+    }
+  };
+
+  struct traced_factory {
+    std::shared_ptr<traced_gen> Create() {
+      return std::make_shared<traced_gen>();
+    }
+  };
+
+  typedef TypedChunkThreadPool<traced_factory, traced_gen, traced_chunk> Pool;
+
+  // just enough json to check the dump - objects keep their members in order, numbers keep their text
+  struct json_value {
+    enum Kind { NONE, OBJECT, ARRAY, STRING, NUMBER, LITERAL } kind = NONE;
+    std::string text;
+    std::vector<std::pair<std::string, json_value>> members;
+    std::vector<json_value> items;
+
+    const json_value* Get(const std::string& name) const {
+      for (auto& member : members) {
+        if (member.first == name) {
+          return &member.second;
+        }
+      }
+
+      return nullptr;
+    }
+
+    // text of a string member, or empty if there's no such string
+    std::string String(const std::string& name) const {
+      const json_value* member = Get(name);
+      return (member != nullptr && member->kind == STRING ? member->text : std::string());
+    }
+  };
+
+  class json_parser {
+    public:
+    explicit json_parser(const std::string& input) : input_(input) {}
+
+    /**
+     * @return true if the whole input is one well formed value
+     */
+    bool Parse(json_value* res) {
+      if (!Value(res)) {
+        return false;
+      }
+
+      Skip();
+      return pos_ == input_.size();
+    }
+
+    private:
+    void Skip() {
+      while (pos_ < input_.size() && std::isspace(static_cast<unsigned char>(input_[pos_]))) {
+        pos_++;
+      }
+    }
+
+    bool Eat(char c) {
+      Skip();
+      if (pos_ < input_.size() && input_[pos_] == c) {
+        pos_++;
+        return true;
+      }
+
+      return false;
+    }
+
+    bool Value(json_value* res) {
+      Skip();
+      if (pos_ >= input_.size()) {
+        return false;
+      }
+
+      char c = input_[pos_];
+      if (c == '{') {
+        return Object(res);
+      } else if (c == '[') {
+        return Array(res);
+      } else if (c == '"') {
+        res->kind = json_value::STRING;
+        return String(&res->text);
+      } else if (c == '-' || std::isdigit(static_cast<unsigned char>(c))) {
+        return Number(res);
+      }
+
+      for (const char* literal : { "true", "false", "null" }) {
+        if (input_.compare(pos_, std::string(literal).size(), literal) == 0) {
+          res->kind = json_value::LITERAL;
+          res->text = literal;
+          pos_ += res->text.size();
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    bool Object(json_value* res) {
+      res->kind = json_value::OBJECT;
+      pos_++;
+      if (Eat('}')) {
+        return true;
+      }
+
+      do {
+        std::string name;
+        json_value member;
+        Skip();
+        if (!String(&name) || !Eat(':') || !Value(&member)) {
+          return false;
+        }
+
+        res->members.push_back(std::make_pair(name, member));
+      } while (Eat(','));
+
+      return Eat('}');
+    }
+
+    bool Array(json_value* res) {
+      res->kind = json_value::ARRAY;
+      pos_++;
+      if (Eat(']')) {
+        return true;
+      }
+
+      do {
+        json_value item;
+        if (!Value(&item)) {
+          return false;
+        }
+
+        res->items.push_back(item);
+      } while (Eat(','));
+
+      return Eat(']');
+    }
+
+    bool String(std::string* res) {
+      if (pos_ >= input_.size() || input_[pos_] != '"') {
+        return false;
+      }
+
+      for (pos_++; pos_ < input_.size(); pos_++) {
+        char c = input_[pos_];
+        if (c == '"') {
+          pos_++;
+          return true;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          return false;
+        } else if (c == '\\') {
+          // the writer only ever escapes quotes and backslashes
+          pos_++;
+          if (pos_ >= input_.size() || (input_[pos_] != '"' && input_[pos_] != '\\')) {
+            return false;
+          }
+
+          c = input_[pos_];
+        }
+
+        res->push_back(c);
+      }
+
+      return false;
+    }
+
+    bool Number(json_value* res) {
+      const char* start = input_.c_str() + pos_;
+      char* end = nullptr;
+      std::strtod(start, &end);
+      if (end == start) {
+        return false;
+      }
+
+      res->kind = json_value::NUMBER;
+      res->text = std::string(start, static_cast<size_t>(end - start));
+      pos_ += res->text.size();
+      return true;
+    }
+
+    const std::string& input_;
+    size_t pos_ = 0;
+  };
+
+  bool IsNumber(const json_value* value) {
+    return value != nullptr && value->kind == json_value::NUMBER;
+  }
+
+  json_value DumpTrace() {
+    std::ostringstream output;
+    util::TraceRecorder::Instance().WriteChromeJson(output);
+
+    std::string dump = output.str();
+    json_value res;
+    json_parser parser(dump);
+    if (!parser.Parse(&res)) {
+      res = json_value();
+    }
+
+    return res;
+  }
+}
+
+// a pool workload dumps as a chrome trace - well formed json, every event w the fields the viewer needs
+CHUNKER_TEST(trace_dump_is_chrome_json) {
+  util::TraceRecorder::Instance().Clear();
+  {
+    Pool pool(2, std::make_shared<traced_factory>(), 64);
+    std::vector<ChunkKey> keys;
+    for (long i = 0; i < 8; i++) {
+      keys.push_back(ChunkKey(ChunkIdentifier(i * 16, 0, 16, 16, ChunkNeighbors())));
+    }
+
+    pool.EnqueueBulk(keys);
+    pool.Wait();
+  }
+
+  json_value trace = DumpTrace();
+  CHUNKER_CHECK(trace.kind == json_value::OBJECT);
+
+  const json_value* events = trace.Get("traceEvents");
+  const json_value* other = trace.Get("otherData");
+  CHUNKER_CHECK(events != nullptr && events->kind == json_value::ARRAY);
+  CHUNKER_CHECK(trace.String("displayTimeUnit") == "ns");
+  CHUNKER_CHECK(other != nullptr && other->kind == json_value::OBJECT);
+  CHUNKER_CHECK(other != nullptr && IsNumber(other->Get("dropped_events")) && other->Get("dropped_events")->text == "0");
+  if (events == nullptr || events->kind != json_value::ARRAY) {
+    return;
+  }
+
+  bool well_formed = true;
+  std::map<std::string, int> counts;
+  std::map<std::string, int> open_async;
+  std::set<std::string> thread_names;
+  for (auto& event : events->items) {
+    std::string phase = event.String("ph");
+    std::string name = event.String("name");
+    well_formed = well_formed && event.kind == json_value::OBJECT && !name.empty() && IsNumber(event.Get("pid"))
+      && IsNumber(event.Get("tid"));
+
+    if (phase == "M") {
+      const json_value* args = event.Get("args");
+      well_formed = well_formed && name == "thread_name" && args != nullptr && !args->String("name").empty();
+      if (args != nullptr) {
+        thread_names.insert(args->String("name"));
+      }
+
+      continue;
+    }
+
+    well_formed = well_formed && !event.String("cat").empty() && IsNumber(event.Get("ts"));
+    if (phase == "X") {
+      well_formed = well_formed && IsNumber(event.Get("dur")) && event.Get("dur")->text[0] != '-';
+    } else if (phase == "i") {
+      well_formed = well_formed && event.String("s") == "t";
+    } else if (phase == "b" || phase == "e") {
+      // every end follows its begin, w the same id
+      well_formed = well_formed && IsNumber(event.Get("id"));
+      if (IsNumber(event.Get("id"))) {
+        open_async[event.Get("id")->text] += (phase == "b" ? 1 : -1);
+        well_formed = well_formed && open_async[event.Get("id")->text] >= 0;
+      }
+    } else {
+      well_formed = false;
+    }
+
+    counts[event.String("cat") + "/" + name + "/" + phase]++;
+  }
+
+  bool async_closed = true;
+  for (auto& async : open_async) {
+    async_closed = async_closed && async.second == 0;
+  }
+
+  CHUNKER_CHECK(well_formed);
+  CHUNKER_CHECK(async_closed);
+  CHUNKER_CHECK(open_async.size() == 8);
+
+  // one of each per chunk
+  CHUNKER_CHECK(counts["chunk/queued/b"] == 8);
+  CHUNKER_CHECK(counts["chunk/queued/e"] == 8);
+  CHUNKER_CHECK(counts["chunk/run/X"] == 8);
+  CHUNKER_CHECK(counts["chunk/generate/X"] == 8);
+  CHUNKER_CHECK(counts["chunk/cache_insert/X"] == 8);
+  CHUNKER_CHECK(counts["pool/enqueue_bulk/X"] == 1);
+  CHUNKER_CHECK(counts["pool/wait/X"] == 1);
+
+  bool named_worker = false;
+  for (auto& thread_name : thread_names) {
+    named_worker = named_worker || thread_name.compare(0, 13, "chunk worker ") == 0;
+  }
+
+  CHUNKER_CHECK(named_worker);
+}
+
+// names go through the json escaped - quotes and backslashes come back out as they went in
+CHUNKER_TEST(trace_dump_escapes_names) {
+  util::TraceRecorder::Instance().Clear();
+  CHUNKER_TRACE_INSTANT("say \"hi\"", "C:\\chunks\\", util::CountTraceArgs(3));
+
+  json_value trace = DumpTrace();
+  const json_value* events = trace.Get("traceEvents");
+  CHUNKER_CHECK(events != nullptr);
+
+  int found = 0;
+  for (size_t i = 0; events != nullptr && i < events->items.size(); i++) {
+    const json_value& event = events->items[i];
+    const json_value* args = event.Get("args");
+    if (event.String("ph") == "i" && event.String("cat") == "say \"hi\"" && event.String("name") == "C:\\chunks\\"
+      && args != nullptr && IsNumber(args->Get("count")) && args->Get("count")->text == "3") {
+      found++;
+    }
+  }
+
+  CHUNKER_CHECK(found == 1);
+}
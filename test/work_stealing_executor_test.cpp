@@ -0,0 +1,178 @@
+#include "test.hpp"
+
+#include "chunker/util/WorkStealingExecutor.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace chunker;
+
+namespace {
+  typedef util::WorkStealingExecutor<int> Executor;
+
+  // tasks below zero block until the gate opens. everything else just counts
+  struct gated_handler {
+    std::atomic<bool> open { false };
+    std::atomic<int> blocked { 0 };
+    std::atomic<int> done { 0 };
+
+    void operator()(size_t, int& task) {
+      if (task < 0) {
+        blocked++;
+        while (!open.load()) {
+          std::this_thread::yield();
+        }
+      }
+
+      done++;
+    }
+  };
+
+  // spins until done() or a second passes
+  template <typename Func>
+  bool WaitFor(Func done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (!done()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+
+      std::this_thread::yield();
+    }
+
+    return true;
+  }
+}
+
+// Wait() returns once every submitted task has run - one at a time or in bulk - and not before
+CHUNKER_TEST(executor_wait_covers_every_task) {
+  auto handler = std::make_shared<gated_handler>();
+  Executor executor(3, [handler](size_t worker, int& task) { (*handler)(worker, task); });
+
+  std::vector<int> bulk(40, 1);
+  bool all_done = true;
+  for (int round = 0; round < 20; round++) {
+    int before = handler->done.load();
+    executor.Submit(1);
+    executor.SubmitBulk(bulk.begin(), bulk.end());
+    executor.Submit(1);
+    executor.Wait();
+    all_done = all_done && (handler->done.load() - before == 42);
+  }
+
+  CHUNKER_CHECK(all_done);
+  CHUNKER_CHECK(executor.Pending() == 0);
+
+  // one task stuck - Wait() stays blocked on it
+  executor.Submit(-1);
+  std::future<void> waited = std::async(std::launch::async, [&] { executor.Wait(); });
+  CHUNKER_CHECK(waited.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+  handler->open = true;
+  waited.get();
+  CHUNKER_CHECK(executor.Pending() == 0);
+}
+
+// one worker stuck on a task - the others steal whatever's queued behind it
+CHUNKER_TEST(executor_steals_from_a_stuck_worker) {
+  auto handler = std::make_shared<gated_handler>();
+  Executor executor(2, [handler](size_t worker, int& task) { (*handler)(worker, task); });
+
+  // one block per worker - the stuck task is at the front of the first
+  std::vector<int> tasks(64, 1);
+  tasks[0] = -1;
+  executor.SubmitBulk(tasks.begin(), tasks.end());
+
+  CHUNKER_CHECK(WaitFor([&] { return handler->done.load() == 63; }));
+  CHUNKER_CHECK(handler->blocked.load() == 1);
+  CHUNKER_CHECK(WaitFor([&] { return executor.Pending() == 1; }));
+
+  handler->open = true;
+  executor.Wait();
+  CHUNKER_CHECK(handler->done.load() == 64);
+}
+
+// tasks still queued when the executor goes away are dropped, rather than run or waited on - parked workers included
+CHUNKER_TEST(executor_destructor_drops_queued_tasks) {
+  std::atomic<int> ran { 0 };
+  auto start = std::chrono::steady_clock::now();
+  {
+    Executor executor(1, [&](size_t, int&) {
+      ran++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+
+    std::vector<int> tasks(1000, 1);
+    executor.SubmitBulk(tasks.begin(), tasks.end());
+  }
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  CHUNKER_CHECK(ran.load() < 1000);
+  CHUNKER_CHECK(elapsed < std::chrono::milliseconds(500));
+
+  // idle long enough for every worker to park - they're woken to stop
+  start = std::chrono::steady_clock::now();
+  {
+    Executor executor(4, [](size_t, int&) {});
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+
+  CHUNKER_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+}
+
+// a hold keeps Wait() blocked as if a task were still pending, until it's released - tasks themselves still run
+CHUNKER_TEST(executor_hold_defers_wait) {
+  auto handler = std::make_shared<gated_handler>();
+  Executor executor(2, [handler](size_t worker, int& task) { (*handler)(worker, task); });
+
+  executor.Hold();
+  executor.Submit(1);
+  CHUNKER_CHECK(WaitFor([&] { return handler->done.load() == 1; }));
+  CHUNKER_CHECK(executor.Pending() == 1);
+
+  std::future<void> waited = std::async(std::launch::async, [&] { executor.Wait(); });
+  CHUNKER_CHECK(waited.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+  // from another thread, as the disk tier does
+  std::thread([&] { executor.Release(); }).join();
+  CHUNKER_CHECK(waited.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+
+  // a background hold only blocks WaitAll()
+  executor.Hold(true);
+  executor.Wait();
+  std::future<void> waited_all = std::async(std::launch::async, [&] { executor.WaitAll(); });
+  CHUNKER_CHECK(waited_all.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+  executor.Release(true);
+  CHUNKER_CHECK(waited_all.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(executor.Pending() == 0);
+}
+
+// background tasks run once workers are idle, and only WaitAll() waits on them - Wait() returns w one still stuck
+CHUNKER_TEST(executor_background_skips_wait) {
+  auto handler = std::make_shared<gated_handler>();
+  Executor executor(2, [handler](size_t worker, int& task) { (*handler)(worker, task); });
+
+  std::vector<int> background { -1, 1, 1 };
+  executor.SubmitBackground(background.begin(), background.end());
+  CHUNKER_CHECK(WaitFor([&] { return handler->blocked.load() == 1; }));
+
+  std::vector<int> foreground(32, 1);
+  executor.SubmitBulk(foreground.begin(), foreground.end());
+  std::future<void> waited = std::async(std::launch::async, [&] { executor.Wait(); });
+  CHUNKER_CHECK(waited.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(handler->done.load() >= 32);
+
+  std::future<void> waited_all = std::async(std::launch::async, [&] { executor.WaitAll(); });
+  CHUNKER_CHECK(waited_all.wait_for(std::chrono::milliseconds(50)) == std::future_status::timeout);
+
+  handler->open = true;
+  CHUNKER_CHECK(waited_all.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  CHUNKER_CHECK(handler->done.load() == 35);
+  CHUNKER_CHECK(executor.Pending() == 0);
+}